@@ -0,0 +1,97 @@
+/**
+ * @file load_generator.hpp
+ * @brief NTP load generator behind simple-ntpd-bench
+ */
+
+#pragma once
+
+#include "simple-ntpd/utils/histogram.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace simple_ntpd {
+
+/** @brief What a reply turned out to be */
+enum class ResponseCheck : uint8_t {
+  VALID,          // Well-formed server reply to our request
+  UNSYNCHRONIZED, // Well-formed, but the server says its clock is unsynchronized
+  KISS_OF_DEATH,  // Stratum 0 kiss code, e.g. RATE
+  SHORT,          // Fewer than 48 bytes
+  BAD_MODE,       // Not mode 4
+  BAD_VERSION,    // Not the version we sent
+  BAD_ORIGIN,     // Originate timestamp is not the request's transmit timestamp
+  BAD_TIMESTAMPS, // Receive or transmit timestamp missing or out of order
+  LATE,           // Matched a request already answered or timed out
+  COUNT
+};
+
+constexpr size_t kResponseCheckCount = static_cast<size_t>(ResponseCheck::COUNT);
+
+/** @brief Lower-case name of @p check, as printed in the report */
+const char *responseCheckName(ResponseCheck check);
+
+/**
+ * @brief Check a reply against the transmit timestamp its request carried.
+ *
+ * Never returns LATE; matching replies to outstanding requests is up to
+ * the caller.
+ */
+ResponseCheck checkResponse(const uint8_t *data, size_t length, uint64_t request_transmit);
+
+/** @brief Load shape */
+struct LoadOptions {
+  std::string target_address = "127.0.0.1"; // IPv4
+  uint16_t target_port = 123;
+  size_t threads = 1;            // Each owns its sockets and sends and receives
+  size_t sockets_per_thread = 8; // One source port each
+  size_t source_addresses = 1;   // Spread sockets over 127.0.0.1 and up; loopback only
+  uint64_t rate = 0;             // Requests per second over all threads; 0 = as fast as the window allows
+  size_t window = 64;            // Outstanding requests per socket
+  size_t batch = 32;             // Packets per sendmmsg/recvmmsg call
+  std::chrono::milliseconds duration{5000};
+  std::chrono::milliseconds timeout{1000}; // A request unanswered this long is lost
+};
+
+/** @brief Totals over all threads */
+struct LoadResult {
+  uint64_t sent = 0;
+  uint64_t send_errors = 0; // Packets sendmmsg refused
+  uint64_t received = 0;
+  uint64_t lost = 0; // Timed out, or still outstanding when the run ended
+  std::array<uint64_t, kResponseCheckCount> checks{};
+  double seconds = 0.0; // Length of the sending phase
+  LatencyHistogram::Snapshot rtt; // Valid and unsynchronized replies only
+
+  uint64_t count(ResponseCheck check) const { return checks[static_cast<size_t>(check)]; }
+  /** @brief Replies that failed a check, excluding kiss codes and late ones */
+  uint64_t invalid() const;
+};
+
+/**
+ * @brief Blast mode 3 requests at a server and measure its replies.
+ *
+ * Every thread keeps a window of outstanding requests on each of its
+ * sockets and sends and receives them in batches (sendmmsg and recvmmsg on
+ * Linux). A request's transmit timestamp is a cookie naming its socket and
+ * sequence number, so each reply is matched to its request by the
+ * originate timestamp the server echoes; the RTT comes from a local
+ * monotonic send time, not from the wire.
+ */
+class LoadGenerator {
+public:
+  explicit LoadGenerator(const LoadOptions &options);
+
+  /** @brief Check the options: address, counts and loopback-only sources */
+  bool validate(std::string &error) const;
+
+  /** @brief Run for the configured duration, then wait out the timeout */
+  bool run(LoadResult &result, std::string &error);
+
+private:
+  LoadOptions options_;
+};
+
+} // namespace simple_ntpd
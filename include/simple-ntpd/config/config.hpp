@@ -44,6 +44,12 @@ public:
     REDUCED_FUNCTIONALITY = 1,
     PRIORITIZE_TRUSTED = 2,
   };
+
+  enum class SystemClockDiscipline {
+    NONE = 0,    // Offset response timestamps only
+    KERNEL = 1,  // Steer the system clock via ntp_adjtime
+    DRY_RUN = 2, // Log kernel adjustments without applying them
+  };
   /**
    * @brief Constructor with default values
    */
@@ -88,6 +94,22 @@ public:
    */
   std::string toString() const;
 
+  /**
+   * @brief Whether anything needs the sync manager: upstream servers,
+   *        pools or a polled reference clock
+   */
+  bool hasSyncSources() const;
+
+  /**
+   * @brief Parse a system_clock_discipline value: none, kernel or dry_run
+   * @return false, leaving @p mode unchanged, for anything else
+   */
+  static bool parseSystemClockDiscipline(const std::string &value,
+                                         SystemClockDiscipline &mode);
+
+  /** @brief Config spelling of @p mode, e.g. "dry_run" */
+  static const char *systemClockDisciplineName(SystemClockDiscipline mode);
+
   // Network configuration
   std::string listen_address;
   port_t listen_port;
@@ -99,8 +121,15 @@ public:
   std::string reference_id;
   std::string reference_clock;
   std::vector<std::string> upstream_servers;
-  std::chrono::seconds sync_interval;
+  std::vector<std::string> upstream_pools; // Names expanded to several servers
+  uint32_t max_pool_associations;          // Associations per pool name
+  std::vector<std::string> peers;          // Symmetric peers (sibling servers)
+  std::chrono::seconds dns_cache_ttl;      // Resolver cache lifetime
+  std::chrono::seconds sync_interval; // Initial poll interval
+  int min_poll;                       // Poll exponent bounds (log2 seconds)
+  int max_poll;
   std::chrono::milliseconds timeout;
+  bool enable_iburst; // Rapid polling at startup
 
   // Logging configuration
   std::string log_file;
@@ -145,10 +174,12 @@ public:
   // Drift file configuration
   std::string drift_file;
   bool enable_drift_compensation;
+  SystemClockDiscipline system_clock_discipline;
 
   // Leap second configuration
   std::string leap_second_file;
   bool enable_leap_second_handling;
+  int leap_smear_interval; // Seconds to smear a leap over; 0 announces it
 
   // Reliability and resiliency
   bool enable_automatic_failover;
@@ -166,7 +197,52 @@ public:
   bool enable_upstream_failover;
   bool enable_dynamic_stratum_adjustment;
   bool enable_reference_clock_support;
-  std::string reference_clock_source; // local|hardware|gps|atomic
+  std::string reference_clock_source; // local|hardware|gps|atomic|shm
+  int reference_clock_shm_unit;       // ntpd SHM unit (segment key NTP0 + unit)
+  std::string reference_clock_refid;  // Reference ID while the refclock is selected
+
+  // Broadcast/multicast server (mode 5)
+  bool enable_broadcast;
+  std::string broadcast_address;          // host[:port]; broadcast or multicast group
+  std::chrono::seconds broadcast_interval;
+  int broadcast_ttl;                      // Multicast hop limit
+  uint32_t broadcast_key_id;              // authentication_keys entry; 0 sends no MAC
+
+  // Roughtime responder (signed time on its own UDP port)
+  bool enable_roughtime;
+  port_t roughtime_port;
+  std::string roughtime_key_file;                   // Hex Ed25519 seed; empty = ephemeral
+  int roughtime_batch_size;                         // Requests per signature, at most
+  std::chrono::milliseconds roughtime_batch_window; // Wait for a batch to fill
+  std::chrono::seconds roughtime_key_lifetime;      // Online key validity
+
+  // HTTP endpoint serving /metrics and /health from the running daemon
+  bool enable_metrics_http;
+  std::string metrics_http_address;
+  port_t metrics_http_port;
+  std::chrono::milliseconds metrics_http_cache_interval; // Reuse rendered metrics this long
+
+  // Unix control socket the CLI commands talk to
+  bool enable_control_socket;
+  std::string control_socket_path;
+
+  // Memory-mapped statistics file for external readers
+  bool enable_stats_segment;
+  std::string stats_segment_path;
+  std::chrono::milliseconds stats_segment_interval; // Publish period
+
+  // Cycle-counter cost of each request pipeline stage, per worker
+  bool enable_stage_accounting;
+
+  // Sampled request/response capture ring, dumped as pcap over the control socket
+  bool enable_packet_capture;
+  int capture_ring_size;             // Exchanges kept
+  int capture_sample_every;          // Keep every Nth matching exchange
+  bool capture_drops_only;           // Only requests that got no response
+  std::string capture_client_prefix; // IPv4 CIDR; empty = all clients
+
+  // In-memory history of upstream samples and clock state (control socket, metrics)
+  int clock_history_hours; // Window kept; 0 disables
 
 private:
   // Path of last-loaded configuration file (if any)
@@ -0,0 +1,128 @@
+/**
+ * @file capture.hpp
+ * @brief Sampled in-memory capture of request/response pairs, exported as
+ *        pcap
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace simple_ntpd {
+
+/** @brief Why a request got no response */
+enum class DropReason : uint8_t {
+  NONE,       // Answered
+  ACL,        // Denied by the access list
+  RATE_LIMIT, // Connection or request rate limit
+  DDOS,       // Anomaly detector, with graceful degradation on
+  CONNECTION, // No connection entry could be created
+  INVALID,    // Rejected by per-connection validation
+  PARSE,      // Not a parsable NTP packet
+  SEND        // sendto failed
+};
+
+/** @brief Lower-case name of @p reason, as used in probes and listings */
+const char *dropReasonName(DropReason reason);
+
+/**
+ * @brief One captured exchange. Fixed size and trivially copyable, so it
+ *        fits a ring slot; packets longer than kMaxBytes are truncated.
+ */
+struct CapturedExchange {
+  static constexpr size_t kMaxBytes = 96;
+
+  uint64_t ticket = 0;          // Capture order across all workers
+  int64_t received_unix_ns = 0; // Kernel receive timestamp
+  int64_t sent_unix_ns = 0;     // When the reply went to sendto; 0 if dropped
+  uint32_t client_addr = 0;     // Network byte order
+  uint16_t client_port = 0;     // Host byte order
+  uint16_t request_length = 0;  // Original lengths, before truncation
+  uint16_t response_length = 0; // 0 if dropped
+  DropReason drop = DropReason::NONE;
+  uint8_t request[kMaxBytes] = {};
+  uint8_t response[kMaxBytes] = {};
+};
+
+/**
+ * @brief Which exchanges to keep
+ */
+struct CaptureFilter {
+  uint32_t sample_every = 1; // Keep every Nth matching exchange
+  bool drops_only = false;   // Only requests that got no response
+  uint32_t network = 0;      // Client prefix, host byte order
+  uint32_t mask = 0;         // 0 matches every client
+};
+
+/**
+ * @brief Fixed ring of the most recent sampled exchanges.
+ *
+ * Lock-free for any number of writers: a writer takes a ticket with one
+ * fetch_add, claims the ticket's slot by moving its sequence from even to
+ * odd, copies the exchange in and makes the sequence even again. A slot
+ * still claimed by a slower writer one lap behind is skipped rather than
+ * waited for, and counted. Readers copy slots seqlock-style and never block
+ * writers.
+ *
+ * matches() is the only call on the hot path for exchanges that are not
+ * kept: a prefix compare and the calling worker's sampling countdown. The
+ * countdowns belong to the instance, so a capture restarted with a new
+ * filter or rate starts sampling afresh.
+ */
+class PacketCapture {
+public:
+  /** @param workers Worker threads that call matches(), one countdown each */
+  PacketCapture(size_t slots, const CaptureFilter &filter, uint32_t server_addr,
+                uint16_t server_port, size_t workers = 1);
+  ~PacketCapture();
+  PacketCapture(const PacketCapture &) = delete;
+  PacketCapture &operator=(const PacketCapture &) = delete;
+
+  /**
+   * @brief Whether to keep this exchange; counts toward sampling
+   * @param client_addr Network byte order
+   * @param worker Calling worker, selecting its sampling countdown
+   */
+  bool matches(uint32_t client_addr, bool dropped, size_t worker = 0);
+
+  /** @brief Store an exchange matches() accepted */
+  void record(const CapturedExchange &exchange);
+
+  /** @brief Valid slots, oldest first */
+  std::vector<CapturedExchange> snapshot() const;
+
+  /**
+   * @brief Write the ring as a pcap file (raw IPv4, nanosecond
+   *        timestamps): each request, then its response unless dropped
+   */
+  void writePcap(std::ostream &out) const;
+
+  /** @brief Exchanges written into the ring */
+  uint64_t captured() const {
+    return next_ticket_.load(std::memory_order_relaxed) - skipped();
+  }
+  /** @brief Sampled exchanges lost to a busy slot */
+  uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+  size_t capacity() const { return slot_count_; }
+
+private:
+  struct Slot;
+  struct Countdown;
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t slot_count_;
+  std::unique_ptr<Countdown[]> countdowns_;
+  size_t countdown_count_;
+  CaptureFilter filter_;
+  uint32_t server_addr_; // Network byte order
+  uint16_t server_port_;
+  std::atomic<uint64_t> next_ticket_{0};
+  std::atomic<uint64_t> skipped_{0};
+};
+
+} // namespace simple_ntpd
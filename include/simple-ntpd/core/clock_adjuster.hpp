@@ -0,0 +1,130 @@
+/**
+ * @file clock_adjuster.hpp
+ * @brief System clock steering backends (kernel ntp_adjtime and mock)
+ */
+
+#pragma once
+
+#include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/utils/logger.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Interface for steering the system clock.
+ *
+ * Offsets are seconds to add to the system clock, frequencies are
+ * dimensionless (s/s). All methods return false on failure.
+ */
+class ClockAdjuster {
+public:
+  virtual ~ClockAdjuster() = default;
+
+  virtual std::string name() const = 0;
+
+  /**
+   * @brief Whether adjustments really move the system clock. When true the
+   *        server stamps responses with the raw clock.
+   */
+  virtual bool steersSystemClock() const = 0;
+
+  /**
+   * @brief Hand an offset to the kernel PLL to slew out
+   * @param offset Offset (s), clamped to the kernel's +-0.5 s
+   * @param max_error Maximum error bound (s)
+   * @param est_error Estimated error (s)
+   * @param poll_log2 Poll interval exponent, sets the PLL time constant
+   */
+  virtual bool slew(double offset, double max_error, double est_error,
+                    int poll_log2) = 0;
+
+  /** @brief Step the clock by @p offset */
+  virtual bool step(double offset) = 0;
+
+  /** @brief Set the kernel frequency correction */
+  virtual bool setFrequency(double frequency) = 0;
+
+  /** @brief Read back the kernel frequency correction */
+  virtual bool readFrequency(double &frequency) = 0;
+
+  /** @brief Error text for the last failed call */
+  virtual std::string lastError() const { return {}; }
+};
+
+#ifdef __linux__
+/**
+ * @brief Drives the Linux kernel PLL through ntp_adjtime(2).
+ *        Requires CAP_SYS_TIME.
+ */
+class KernelClockAdjuster : public ClockAdjuster {
+public:
+  std::string name() const override { return "kernel"; }
+  bool steersSystemClock() const override { return true; }
+  bool slew(double offset, double max_error, double est_error,
+            int poll_log2) override;
+  bool step(double offset) override;
+  bool setFrequency(double frequency) override;
+  bool readFrequency(double &frequency) override;
+  std::string lastError() const override { return last_error_; }
+
+private:
+  std::string last_error_;
+};
+#endif
+
+/**
+ * @brief Records adjustments instead of applying them. Backs the dry-run
+ *        mode and lets tests exercise kernel discipline without privileges.
+ */
+class MockClockAdjuster : public ClockAdjuster {
+public:
+  enum class Action { SLEW, STEP, SET_FREQUENCY };
+
+  struct Call {
+    Action action;
+    double value;
+  };
+
+  /**
+   * @param steers Report steersSystemClock() as this value
+   * @param logger Optional; each adjustment is logged at info level
+   */
+  explicit MockClockAdjuster(bool steers = false,
+                             std::shared_ptr<Logger> logger = nullptr);
+
+  std::string name() const override { return "dry-run"; }
+  bool steersSystemClock() const override { return steers_; }
+  bool slew(double offset, double max_error, double est_error,
+            int poll_log2) override;
+  bool step(double offset) override;
+  bool setFrequency(double frequency) override;
+  bool readFrequency(double &frequency) override;
+
+  std::vector<Call> calls() const;
+  /** @brief Sum of all slewed and stepped offsets */
+  double appliedOffset() const;
+
+private:
+  void record(Action action, double value, const std::string &text);
+
+  bool steers_;
+  std::shared_ptr<Logger> logger_;
+  mutable std::mutex mutex_;
+  std::vector<Call> calls_;
+  double applied_offset_ = 0.0;
+  double frequency_ = 0.0;
+};
+
+/**
+ * @brief Create the adjuster for a configured mode
+ * @return nullptr for SystemClockDiscipline::NONE or when unsupported
+ */
+std::shared_ptr<ClockAdjuster>
+createClockAdjuster(NtpConfig::SystemClockDiscipline mode,
+                    std::shared_ptr<Logger> logger);
+
+} // namespace simple_ntpd
@@ -0,0 +1,145 @@
+/**
+ * @file clock_discipline.hpp
+ * @brief Phase/frequency clock model with drift file and holdover
+ */
+
+#pragma once
+
+#include "simple-ntpd/core/clock_filter.hpp"
+#include <string>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Plain-data copy of a ClockDiscipline model.
+ *
+ * Carries just enough to interpolate the correction and the error bound,
+ * so it can be published to the packet path and evaluated without locks.
+ */
+struct ClockModel {
+  bool valid = false; // False until the discipline has an estimate
+  double base_time = 0.0;
+  double base_offset = 0.0;
+  double residual = 0.0;
+  double slew = 1.0;
+  double frequency = 0.0;
+  double last_update = 0.0;
+  double dispersion = NTP_MAXDISP;
+
+  /** @brief Correction to add to the system clock at @p now (s) */
+  double offsetAt(double now) const;
+  /** @brief Dispersion at @p now, growing at PHI since the last update */
+  double dispersionAt(double now) const;
+};
+
+/**
+ * @brief Hybrid PLL/FLL clock discipline (after RFC 5905 section 11.3).
+ *
+ * Models the correction between the local system clock and true time as a
+ * phase plus a frequency. Each combined upstream offset updates the model;
+ * in between, offsetAt() interpolates so responses see smooth time rather
+ * than a step every poll interval. The residual phase error of an update is
+ * slewed in linearly over one poll interval.
+ *
+ * All times are monotonic seconds, offsets are seconds and frequencies are
+ * dimensionless (s/s); the drift file stores parts per million as ntpd does.
+ */
+class ClockDiscipline {
+public:
+  enum class State {
+    UNSET = 0, // No update yet
+    FREQ = 1,  // Measuring initial frequency (no drift file)
+    SYNC = 2,  // Normal PLL/FLL operation
+  };
+
+  static constexpr double kMaxFrequency = 500e-6;   // Frequency clamp
+  static constexpr double kStepThreshold = 0.128;   // Step instead of slew (s)
+  static constexpr double kFreqMeasureInterval = 900.0; // FREQ state span (s)
+  static constexpr double kAllanIntercept = 1500.0; // PLL/FLL crossover (s)
+  static constexpr double kFllGain = 0.25;
+
+  ClockDiscipline() = default;
+
+  /**
+   * @brief Feed a new combined offset measurement
+   * @param offset Measured offset of true time vs. the system clock (s)
+   * @param jitter System jitter of the measurement (s)
+   * @param now Monotonic time of the measurement (s)
+   * @param poll_interval Current poll interval, sets loop time constant (s)
+   * @return true if the update stepped the phase instead of slewing it
+   */
+  bool update(double offset, double jitter, double now, double poll_interval);
+
+  /**
+   * @brief Interpolated correction to add to the system clock at @p now
+   */
+  double offsetAt(double now) const;
+
+  /**
+   * @brief Dispersion of the model at @p now: the dispersion captured at the
+   *        last update plus PHI times the time since (RFC 5905 A.5.5.4)
+   */
+  double dispersionAt(double now) const;
+
+  /** @brief Seconds since the last update, 0 if never updated */
+  double ageAt(double now) const;
+
+  /** @brief Snapshot of the interpolation parameters */
+  ClockModel model() const;
+
+  State state() const { return state_; }
+  bool hasEstimate() const { return state_ != State::UNSET; }
+  double frequency() const { return frequency_; }
+  double jitter() const { return jitter_; }
+  double lastUpdateTime() const { return last_update_; }
+
+  /** @brief Seed the frequency (e.g. from a drift file) and skip FREQ state */
+  void setFrequency(double frequency);
+
+  /** @brief Disable frequency tracking: the model becomes phase-only */
+  void setFrequencyTracking(bool enabled) { track_frequency_ = enabled; }
+
+  /**
+   * @brief Load frequency (ppm) from an ntpd-style drift file
+   * @return true if a valid value was read
+   */
+  bool loadDriftFile(const std::string &path);
+
+  /**
+   * @brief Atomically write the current frequency (ppm) to @p path
+   * @return true if written
+   */
+  bool saveDriftFile(const std::string &path) const;
+
+  /**
+   * @brief Restore phase and frequency captured earlier (warm start)
+   * @param offset Correction at @p now (s)
+   * @param frequency Frequency (s/s)
+   * @param dispersion Dispersion at @p now (s)
+   * @param now Monotonic time (s)
+   */
+  void restore(double offset, double frequency, double dispersion, double now);
+
+private:
+  State state_ = State::UNSET;
+  bool track_frequency_ = true;
+  bool frequency_seeded_ = false;
+
+  // Piecewise model: offsetAt(t) = base_offset_ + frequency_*(t - base_time_)
+  //                                + residual_ * min(1, (t - base_time_)/slew_)
+  double base_time_ = 0.0;
+  double base_offset_ = 0.0;
+  double residual_ = 0.0;
+  double slew_ = 1.0;
+  double frequency_ = 0.0;
+
+  double last_update_ = 0.0;
+  double jitter_ = 0.0;
+  double dispersion_ = 0.0;
+
+  // FREQ state reference sample
+  double freq_ref_time_ = 0.0;
+  double freq_ref_offset_ = 0.0;
+};
+
+} // namespace simple_ntpd
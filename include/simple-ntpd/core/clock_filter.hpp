@@ -0,0 +1,188 @@
+/**
+ * @file clock_filter.hpp
+ * @brief RFC 5905 clock filter, selection, cluster and combine algorithms
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simple_ntpd {
+
+// RFC 5905 section 7.3 / appendix A.1.1 constants (seconds)
+constexpr double NTP_MAXDISP = 16.0;   // Maximum dispersion
+constexpr double NTP_MINDISP = 0.005;  // Minimum dispersion increment
+constexpr double NTP_MAXDIST = 1.5;    // Distance threshold
+constexpr double NTP_PHI = 15e-6;      // Frequency tolerance (15 ppm)
+constexpr size_t NTP_MIN_CLUSTER = 3;  // Minimum cluster survivors
+constexpr int NTP_MAXPOLL = 17;        // Maximum poll exponent (log2 s)
+constexpr int NTP_PGATE = 4;           // Poll-adjust gate
+constexpr int NTP_LIMIT = 30;          // Poll-adjust threshold
+
+/**
+ * @brief Per-association 8-stage clock filter (RFC 5905 section 10).
+ *
+ * Keeps the last eight (offset, delay, dispersion) samples, ages their
+ * dispersion at PHI and selects the minimum-delay sample as the
+ * association's offset estimate.
+ */
+class ClockFilter {
+public:
+  static constexpr size_t kStages = 8;
+
+  ClockFilter();
+
+  /**
+   * @brief Shift a new sample into the filter
+   * @param offset Sample offset (s)
+   * @param delay Sample round-trip delay (s)
+   * @param dispersion Sample dispersion (s)
+   * @param now Monotonic time of the sample (s)
+   */
+  void addSample(double offset, double delay, double dispersion, double now);
+
+  /**
+   * @brief Shift in a dummy sample after a lost poll so that dispersion of an
+   *        unreachable association grows toward MAXDISP.
+   */
+  void addMissedSample(double now);
+
+  /** @brief True once at least one real sample has been accepted. */
+  bool hasSample() const { return valid_samples_ > 0; }
+
+  double offset() const { return offset_; }
+  double delay() const { return delay_; }
+  double dispersion() const { return dispersion_; }
+  double jitter() const { return jitter_; }
+  /** @brief Monotonic time (s) of the sample currently selected */
+  double sampleTime() const { return sample_time_; }
+
+  /**
+   * @brief Root synchronization distance to this association (RFC 5905 A.5.5.2)
+   * @param now Monotonic time (s)
+   * @param root_delay Upstream advertised root delay (s)
+   * @param root_dispersion Upstream advertised root dispersion (s)
+   */
+  double rootDistance(double now, double root_delay,
+                      double root_dispersion) const;
+
+  void reset();
+
+private:
+  struct Stage {
+    double offset = 0.0;
+    double delay = NTP_MAXDISP;
+    double dispersion = NTP_MAXDISP;
+    double time = 0.0;
+    bool valid = false;
+  };
+
+  void shift(const Stage &stage);
+  void recompute();
+
+  std::array<Stage, kStages> stages_;
+  double last_update_ = 0.0;
+  size_t valid_samples_ = 0;
+
+  double offset_ = 0.0;
+  double delay_ = 0.0;
+  double dispersion_ = NTP_MAXDISP;
+  double jitter_ = 0.0;
+  double sample_time_ = 0.0;
+};
+
+/**
+ * @brief Adaptive poll exponent for one association.
+ *
+ * Uses the RFC 5905 appendix A.5.5.6 hysteresis: each sample whose offset
+ * change stays within PGATE times the jitter adds the poll exponent to a
+ * counter, each noisy sample subtracts twice that. The exponent goes up
+ * when the counter passes LIMIT and down when it passes -LIMIT, so stable
+ * upstreams are polled less often and noisy ones more often.
+ */
+class PollController {
+public:
+  PollController(int poll = 6, int min_poll = 6, int max_poll = 10);
+
+  /** @brief Change the bounds, clamping the current exponent into them */
+  void setBounds(int min_poll, int max_poll);
+  /** @brief Force the exponent (clamped) and clear the counter */
+  void setPoll(int poll);
+
+  int poll() const { return poll_; }
+  int count() const { return count_; }
+  /** @brief Current poll interval in seconds */
+  double interval() const;
+
+  /**
+   * @brief Account for a new sample
+   * @param offset_change New sample offset minus the previous estimate (s)
+   * @param jitter Association jitter before the sample (s)
+   * @return true if the exponent changed
+   */
+  bool update(double offset_change, double jitter);
+
+  /** @brief Back off one step for an unreachable upstream */
+  bool backoff();
+
+private:
+  int poll_;
+  int min_poll_;
+  int max_poll_;
+  int count_ = 0;
+};
+
+/**
+ * @brief Input to the selection algorithm: one association's current estimate.
+ */
+struct ClockCandidate {
+  std::string name;
+  uint8_t stratum = 16;
+  double offset = 0.0;
+  double delay = 0.0;
+  double dispersion = 0.0;
+  double jitter = 0.0;
+  double root_distance = 0.0; // See ClockFilter::rootDistance
+};
+
+/**
+ * @brief Outcome of select + cluster + combine over a candidate set.
+ */
+struct ClockSelection {
+  bool synchronized = false;
+  size_t system_peer = 0;             // Index into the candidate vector
+  std::vector<size_t> survivors;      // Cluster survivors, best first
+  std::vector<size_t> truechimers;    // Passed intersection, incl. outliers
+  std::vector<size_t> falsetickers;   // Rejected by intersection
+  double offset = 0.0;                // Combined offset (s)
+  double jitter = 0.0;                // Combined system jitter (s)
+};
+
+/**
+ * @brief Marzullo-style intersection (RFC 5905 A.5.5.1).
+ * @return Indices of candidates whose offset lies in the largest
+ *         intersection agreed by a majority; empty if no majority exists.
+ */
+std::vector<size_t> intersectCandidates(const std::vector<ClockCandidate> &candidates);
+
+/**
+ * @brief Cluster algorithm (RFC 5905 A.5.5.2): prune the outlier with the
+ *        largest selection jitter until at most NTP_MIN_CLUSTER remain or
+ *        pruning no longer helps. Survivors are returned sorted by merit.
+ */
+std::vector<size_t> clusterSurvivors(const std::vector<ClockCandidate> &candidates,
+                                     std::vector<size_t> survivors);
+
+/**
+ * @brief Run intersection, clustering and the weighted combine step.
+ * @param candidates Per-association estimates
+ * @param min_survivors Minimum truechimers needed to claim synchronization
+ */
+ClockSelection selectClockSources(const std::vector<ClockCandidate> &candidates,
+                                  size_t min_survivors = 1);
+
+} // namespace simple_ntpd
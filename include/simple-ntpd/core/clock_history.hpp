@@ -0,0 +1,117 @@
+/**
+ * @file clock_history.hpp
+ * @brief In-memory time series of upstream samples and system clock state
+ */
+
+#pragma once
+
+#include "simple-ntpd/utils/sample_ring.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace simple_ntpd {
+
+/** @brief One poll of one upstream association */
+struct PeerHistorySample {
+  int64_t unix_time = 0;
+  bool reachable = false; // false: the poll got no valid reply
+  char tally = ' ';       // Selection result after the poll, as in status
+  uint8_t stratum = 0;
+  int64_t offset_us = 0; // Measured by this poll
+  int64_t delay_us = 0;
+  int64_t jitter_us = 0; // Clock filter jitter after the poll
+};
+
+/** @brief Combined clock state after a polling round */
+struct ClockHistorySample {
+  int64_t unix_time = 0;
+  bool synced = false;
+  bool holdover = false;
+  uint8_t stratum = 0;
+  uint8_t survivors = 0;  // Sources the combined offset was built from
+  int64_t offset_us = 0;  // Combined offset of the survivors; 0 unless synced
+  int64_t jitter_us = 0;  // System jitter
+  double frequency_ppm = 0.0;
+  int64_t dispersion_us = 0; // Clock model error bound
+  int64_t root_delay_us = 0;
+  int64_t root_dispersion_us = 0;
+};
+
+/** @brief Samples of one association, oldest first */
+struct PeerHistory {
+  std::string server;
+  std::string address;
+  std::vector<PeerHistorySample> samples;
+};
+
+/** @brief Aggregates over the samples in the window */
+struct HistorySummary {
+  size_t samples = 0;
+  size_t good = 0;     // Synced, or reachable for an upstream
+  size_t selected = 0; // Upstream samples taken while a survivor or system peer
+  int64_t min_offset_us = 0; // Over good samples
+  int64_t max_offset_us = 0;
+  int64_t rms_offset_us = 0;
+  int64_t min_delay_us = 0; // Root delay for the system clock
+  int64_t max_delay_us = 0;
+  int64_t max_jitter_us = 0;
+};
+
+HistorySummary summarizeHistory(const std::vector<ClockHistorySample> &samples);
+HistorySummary summarizeHistory(const std::vector<PeerHistorySample> &samples);
+
+/** @brief One header line, then one whitespace-separated row per sample */
+std::string formatClockHistory(const std::vector<ClockHistorySample> &samples);
+std::string formatPeerHistory(const PeerHistory &history);
+
+/**
+ * @brief Per-association and system rings covering a time window.
+ *
+ * Each ring holds enough samples for the window at the given poll rate;
+ * reads drop samples older than the window. Associations that disappear
+ * (pool churn, config reload) lose their history on the next
+ * retainPeers(). Not thread-safe; UpstreamSyncManager guards it with its
+ * state mutex.
+ */
+class ClockHistory {
+public:
+  static constexpr size_t kMaxSamples = 65536; // Per ring
+
+  /**
+   * @brief Ring size for a window polled no faster than every 2^min_poll s,
+   *        with room for the rapid polls of iburst
+   */
+  static size_t capacityFor(int64_t window_seconds, int min_poll);
+
+  /** @brief Start over; a window of 0 disables recording */
+  void configure(int64_t window_seconds, size_t capacity);
+
+  bool enabled() const { return window_seconds_ > 0; }
+  int64_t windowSeconds() const { return window_seconds_; }
+  size_t capacity() const { return capacity_; }
+
+  void recordClock(const ClockHistorySample &sample);
+  void recordPeer(const std::string &server, const std::string &address,
+                  const PeerHistorySample &sample);
+
+  /** @brief Forget associations not in @p keep (server, address) */
+  void retainPeers(const std::vector<std::pair<std::string, std::string>> &keep);
+
+  /** @brief Newest system sample, if any */
+  bool latestClock(ClockHistorySample &out) const;
+
+  std::vector<ClockHistorySample> clock(int64_t now_unix) const;
+  std::vector<PeerHistory> peers(int64_t now_unix) const;
+
+private:
+  int64_t window_seconds_ = 0;
+  size_t capacity_ = 0;
+  SampleRing<ClockHistorySample> clock_;
+  std::map<std::pair<std::string, std::string>, SampleRing<PeerHistorySample>> peers_;
+};
+
+} // namespace simple_ntpd
@@ -0,0 +1,76 @@
+/**
+ * @file control_socket.hpp
+ * @brief Unix-domain control socket: the CLI's channel to the running daemon
+ */
+
+#pragma once
+
+#include "simple-ntpd/utils/logger.hpp"
+#include "simple-ntpd/utils/platform.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace simple_ntpd {
+
+/** Receives a response piece by piece; returns false once the reader is gone */
+using ControlSink = std::function<bool(const std::string &chunk)>;
+
+/**
+ * @brief Control protocol server.
+ *
+ * A client connects, sends one command line (status, stats, connections,
+ * reload, metrics, health or capture) and reads until the daemon closes. The reply
+ * starts with a status line, "OK" or "ERR <reason>", followed by the
+ * command's text, which is written to the socket as it is produced rather
+ * than assembled first. Clients are served one at a time on the control
+ * thread; a slow reader delays other control clients, never NTP workers.
+ */
+class ControlServer {
+public:
+  /**
+   * Runs @p command, writing the status line and body to the sink. Unknown
+   * commands are the handler's to reject.
+   */
+  using Handler = std::function<void(const std::string &command, const ControlSink &sink)>;
+
+  ControlServer(std::string path, std::shared_ptr<Logger> logger, Handler handler);
+  ~ControlServer();
+  ControlServer(const ControlServer &) = delete;
+  ControlServer &operator=(const ControlServer &) = delete;
+
+  /**
+   * @brief Bind and listen. A stale socket file is replaced; one another
+   *        process still answers on is not.
+   */
+  bool start();
+  void stop();
+
+  uint64_t commands() const { return commands_; }
+
+private:
+  void serveLoop();
+  void serveClient(socket_t client);
+
+  std::string path_;
+  std::shared_ptr<Logger> logger_;
+  Handler handler_;
+  socket_t socket_ = INVALID_SOCKET;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> commands_{0};
+};
+
+/**
+ * @brief Send @p command to the daemon at @p path and copy the body to
+ *        @p out as it arrives
+ * @param error Set to the connection error or the reason in an ERR reply
+ * @return true if the daemon replied OK
+ */
+bool queryControlSocket(const std::string &path, const std::string &command, std::ostream &out,
+                        std::string &error);
+
+} // namespace simple_ntpd
@@ -0,0 +1,98 @@
+/**
+ * @file leap_seconds.hpp
+ * @brief IERS/NIST leap-seconds.list table, leap announcement and smearing
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace simple_ntpd {
+
+/**
+ * @brief One row of leap-seconds.list: TAI-UTC from @p time onwards
+ */
+struct LeapSecond {
+  int64_t time = 0;    // POSIX seconds of the first second after the leap
+  int tai_offset = 0;  // TAI - UTC (s) from this time on
+};
+
+/**
+ * @brief What the packet path needs for the next leap second.
+ *
+ * Built on the control path from a LeapSecondTable; trivially copyable so
+ * it can be published through a SeqLock. The smear is stored as two line
+ * segments, so a response pays one multiply and one add for it.
+ */
+struct LeapSchedule {
+  bool has_table = false;     // A leap table is loaded
+  bool smearing = false;      // Smearing configured; never announce LI
+  int8_t step = 0;            // +1 inserted, -1 deleted, 0 no leap pending
+  int64_t leap_time = 0;      // POSIX time just after the leap
+  int64_t announce_from = 0;  // LI is set from here until leap_time
+  double smear_from = 0.0;    // Smear window (POSIX seconds); empty if off
+  double smear_until = 0.0;
+  double slope = 0.0;         // correction = slope * t + intercept
+  double intercept_before = 0.0;
+  double intercept_after = 0.0;
+  int64_t valid_until = INT64_MAX; // Rebuild the schedule from here on
+
+  /** @brief Leap indicator for responses at POSIX time @p now */
+  uint8_t leapIndicatorAt(int64_t now) const {
+    return (step == 0 || now < announce_from || now >= leap_time) ? 0 : (step > 0 ? 1 : 2);
+  }
+
+  /** @brief Seconds to add to served timestamps at POSIX time @p now */
+  double smearAt(double now) const {
+    if (now < smear_from || now >= smear_until) {
+      return 0.0;
+    }
+    return slope * now + (now < static_cast<double>(leap_time) ? intercept_before
+                                                                : intercept_after);
+  }
+};
+
+/**
+ * @brief Leap second table parsed from an IERS/NIST leap-seconds.list file.
+ *
+ * Data lines are "<NTP seconds> <TAI-UTC>"; "#@" carries the expiry and
+ * "#$" the last update. Times are kept as POSIX seconds.
+ */
+class LeapSecondTable {
+public:
+  /** @brief Parse a leap-seconds.list stream, replacing the table */
+  bool parse(std::istream &in, std::string &error);
+
+  /** @brief Parse the file at @p path, replacing the table */
+  bool loadFromFile(const std::string &path, std::string &error);
+
+  bool empty() const { return entries_.empty(); }
+  const std::vector<LeapSecond> &entries() const { return entries_; }
+  int64_t expires() const { return expires_; }
+  int64_t updated() const { return updated_; }
+  bool expiredAt(int64_t now) const { return expires_ != 0 && now >= expires_; }
+
+  /** @brief TAI - UTC (s) at POSIX time @p now; 0 before the table starts */
+  int taiOffsetAt(int64_t now) const;
+
+  /**
+   * @brief Schedule for the first leap whose announcement or smear window
+   *        has not finished at @p now.
+   *
+   * RFC 5905 warns of a leap in the last minute of the current day, so LI
+   * is announced during the final 24 hours. With @p smear_interval > 0 the
+   * step is spread linearly over that many seconds centred on the leap and
+   * LI is not announced, as the smeared timescale has no leap.
+   */
+  LeapSchedule scheduleAt(int64_t now, int64_t smear_interval) const;
+
+private:
+  std::vector<LeapSecond> entries_;
+  int64_t expires_ = 0;
+  int64_t updated_ = 0;
+};
+
+} // namespace simple_ntpd
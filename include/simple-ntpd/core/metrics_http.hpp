@@ -0,0 +1,101 @@
+/**
+ * @file metrics_http.hpp
+ * @brief Minimal HTTP listener serving /metrics and /health from the running
+ *        daemon
+ */
+
+#pragma once
+
+#include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/utils/logger.hpp"
+#include "simple-ntpd/utils/platform.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Non-blocking HTTP/1.x endpoint for scrapers and probes.
+ *
+ * One thread polls the listening socket and every open connection; sockets
+ * never block, so a slow or stalled client cannot hold up the others. Each
+ * response closes its connection.
+ *
+ * - GET /metrics: Prometheus text exposition. The text is rendered into a
+ *   buffer kept between requests and served from it until the cache
+ *   interval has passed, so scrapes in quick succession render once.
+ * - GET /health: the health report, with status 200 when healthy and 503
+ *   when degraded.
+ */
+class MetricsHttpServer {
+public:
+  /** Renders a response body */
+  using Renderer = std::function<std::string()>;
+  /** Appends the metrics text to a buffer reused between renders */
+  using MetricsRenderer = std::function<void(std::string &)>;
+
+  MetricsHttpServer(std::shared_ptr<NtpConfig> config, std::shared_ptr<Logger> logger,
+                    MetricsRenderer metrics, Renderer health);
+  ~MetricsHttpServer();
+  MetricsHttpServer(const MetricsHttpServer &) = delete;
+  MetricsHttpServer &operator=(const MetricsHttpServer &) = delete;
+
+  bool start();
+  void stop();
+
+  uint64_t requests() const { return requests_; }
+  /** Times /metrics was rendered rather than served from the cache */
+  uint64_t renders() const { return renders_; }
+
+private:
+  struct Client {
+    socket_t socket = INVALID_SOCKET;
+    std::string request;
+    std::string response;
+    size_t sent = 0;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  void serveLoop();
+  void acceptClients();
+  /** @return false once the connection is finished and should be closed */
+  bool readRequest(Client &client);
+  bool writeResponse(Client &client);
+  void buildResponse(const std::string &request, std::string &response);
+  const std::string &cachedMetrics();
+
+  std::shared_ptr<NtpConfig> config_;
+  std::shared_ptr<Logger> logger_;
+  MetricsRenderer metrics_;
+  Renderer health_;
+  socket_t socket_ = INVALID_SOCKET;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::vector<Client> clients_;
+
+  // Owned by the serving thread
+  std::string metrics_cache_;
+  std::chrono::steady_clock::time_point metrics_rendered_at_{};
+  bool metrics_valid_ = false;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> renders_{0};
+};
+
+/**
+ * @brief Fetch @p path from a running daemon's endpoint (blocking, with a
+ *        short timeout); used by the CLI and tests
+ * @param status HTTP status code on success
+ * @param body Response body on success
+ * @return false if the endpoint could not be reached or replied garbage
+ */
+bool fetchMetricsHttp(const std::string &address, port_t port, const std::string &path,
+                      int &status, std::string &body);
+
+} // namespace simple_ntpd
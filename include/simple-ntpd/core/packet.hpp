@@ -13,6 +13,7 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace simple_ntpd {
@@ -50,6 +51,54 @@ struct NtpTimestamp {
   static NtpTimestamp now();
 };
 
+/**
+ * @brief Convert microseconds to NTP short format (16.16 fixed-point
+ *        seconds), saturating at the field limits
+ */
+uint32_t microsecondsToShortFormat(int64_t us);
+
+/**
+ * @brief Convert NTP short format (16.16 fixed-point seconds) to microseconds
+ */
+int64_t shortFormatToMicroseconds(uint32_t value);
+
+/**
+ * @brief Measure the precision of the clock NtpTimestamp::now() reads.
+ *
+ * Takes the smallest non-zero step between back-to-back readings, which
+ * covers both the clock resolution and the cost of reading it, and returns
+ * it as a rounded log2 in seconds (as ntpd does), e.g. -23 for ~120 ns.
+ */
+int8_t measureClockPrecision();
+
+/**
+ * @brief Precision of the system clock, measured once on first use
+ */
+int8_t systemClockPrecision();
+
+/**
+ * @brief Digest length of the symmetric key MAC for @p algorithm: 16 for
+ *        MD5, 20 for SHA-1 and SHA-256 (truncated, as in ntpd), 0 for NONE
+ */
+size_t symmetricKeyDigestLength(NtpConfig::AuthAlgorithm algorithm);
+
+/**
+ * @brief Append an RFC 5905 MAC to a serialized packet: the key ID, then
+ *        the digest of the key followed by the packet
+ * @return false for NONE or if the digest could not be computed
+ */
+bool appendSymmetricKeyMac(std::vector<uint8_t> &data, uint32_t key_id,
+                           const std::string &key, NtpConfig::AuthAlgorithm algorithm);
+
+/**
+ * @brief Check the MAC that follows the 48-byte header of @p data
+ * @param key_id Set to the key ID the packet names, if it has a MAC
+ * @return false if there is no MAC, the key is unknown or the digest differs
+ */
+bool verifySymmetricKeyMac(const std::vector<uint8_t> &data,
+                           const std::unordered_map<uint32_t, std::string> &keys,
+                           NtpConfig::AuthAlgorithm algorithm, uint32_t &key_id);
+
 /**
  * @brief NTP packet structure
  *
@@ -100,6 +149,17 @@ struct NtpPacket {
                                         NtpStratum stratum,
                                         const std::string &reference_id);
 
+  /**
+   * @brief Create broadcast (mode 5) packet
+   * @param stratum Server stratum
+   * @param reference_id Reference identifier
+   * @param poll Broadcast interval (log2 seconds)
+   * @return Broadcast packet; originate and receive timestamps are zero
+   */
+  static NtpPacket createBroadcastPacket(NtpStratum stratum,
+                                         const std::string &reference_id,
+                                         int8_t poll);
+
   /**
    * @brief Parse from raw data
    * @param data Raw packet data
@@ -0,0 +1,111 @@
+/**
+ * @file refclock.hpp
+ * @brief Local reference clock drivers (ntpd/gpsd shared memory segment)
+ */
+
+#pragma once
+
+#include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/utils/logger.hpp"
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+
+namespace simple_ntpd {
+
+/**
+ * @brief One reading from a reference clock.
+ */
+struct RefClockSample {
+  double offset = 0.0;       // Reference time minus system time (s)
+  double receive_time = 0.0; // System (POSIX) time the reading was taken
+  int leap = 0;              // Leap indicator reported by the source
+  int precision = -20;       // Source precision (log2 s)
+};
+
+/**
+ * @brief Interface for local reference clocks.
+ *
+ * A reference clock is polled like an upstream association, but a sample
+ * is a (reference time, system time) pair taken locally, so it carries no
+ * network delay and the association is stratum 0.
+ */
+class RefClock {
+public:
+  virtual ~RefClock() = default;
+
+  /** @brief Association name, e.g. "SHM(0)" */
+  virtual std::string name() const = 0;
+
+  /** @brief Reference ID to advertise while this clock is the system peer */
+  virtual uint32_t referenceId() const = 0;
+
+  /** @brief Attach to the clock source; false with @p error on failure */
+  virtual bool open(std::string &error) = 0;
+
+  /**
+   * @brief Take the newest sample, if the source has written one since the
+   *        last poll. Must not block.
+   */
+  virtual bool poll(RefClockSample &sample) = 0;
+};
+
+/**
+ * @brief Layout of the ntpd SHM reference clock segment (struct shmTime),
+ *        as written by gpsd, chrony and other time sources.
+ */
+struct ShmTimeSegment {
+  int mode;  // 0: valid flag only; 1: count must not change during a read
+  volatile int count;
+  time_t clock_sec; // Reference time
+  int clock_usec;
+  time_t receive_sec; // System time when the reference time was captured
+  int receive_usec;
+  int leap;
+  int precision;
+  int nsamples;
+  volatile int valid;
+  unsigned clock_nsec; // Nanosecond copies of the times above
+  unsigned receive_nsec;
+  int dummy[8];
+};
+
+/** SysV IPC key of SHM unit 0 ("NTP0"); unit N uses the base plus N */
+constexpr int kShmKeyBase = 0x4e545030;
+
+/**
+ * @brief ntpd-compatible shared memory driver.
+ *
+ * Attaches (creating it if needed) the SysV segment for one unit; units 0
+ * and 1 are private to root, higher units are world-writable as in ntpd.
+ * Polling only reads and clears the segment, so it makes no system calls.
+ */
+class ShmRefClock : public RefClock {
+public:
+  ShmRefClock(int unit, const std::string &reference_id);
+  ~ShmRefClock() override;
+
+  ShmRefClock(const ShmRefClock &) = delete;
+  ShmRefClock &operator=(const ShmRefClock &) = delete;
+
+  std::string name() const override;
+  uint32_t referenceId() const override { return reference_id_; }
+  bool open(std::string &error) override;
+  bool poll(RefClockSample &sample) override;
+
+private:
+  int unit_;
+  uint32_t reference_id_;
+  ShmTimeSegment *segment_ = nullptr;
+};
+
+/**
+ * @brief Create the reference clock selected by reference_clock_source
+ * @return nullptr when reference clocks are disabled or the source has no
+ *         driver (e.g. "local")
+ */
+std::shared_ptr<RefClock> createRefClock(const NtpConfig &config,
+                                         std::shared_ptr<Logger> logger);
+
+} // namespace simple_ntpd
@@ -0,0 +1,214 @@
+/**
+ * @file roughtime.hpp
+ * @brief Roughtime responder: tag/value messages, Merkle-tree batching and
+ *        Ed25519 delegated signing (draft-ietf-ntp-roughtime)
+ */
+
+#pragma once
+
+#include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/utils/logger.hpp"
+#include "simple-ntpd/utils/platform.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct evp_pkey_st EVP_PKEY;
+
+namespace simple_ntpd {
+
+/** @brief Tag value: the four ASCII bytes read as a little-endian uint32 */
+constexpr uint32_t roughtimeTag(const char (&name)[5]) {
+  return static_cast<uint32_t>(static_cast<uint8_t>(name[0])) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(name[1])) << 8) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(name[2])) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(name[3])) << 24);
+}
+
+constexpr uint32_t kRoughtimeTagSIG = roughtimeTag("SIG\0");
+constexpr uint32_t kRoughtimeTagVER = roughtimeTag("VER\0");
+constexpr uint32_t kRoughtimeTagNONC = roughtimeTag("NONC");
+constexpr uint32_t kRoughtimeTagDELE = roughtimeTag("DELE");
+constexpr uint32_t kRoughtimeTagPATH = roughtimeTag("PATH");
+constexpr uint32_t kRoughtimeTagRADI = roughtimeTag("RADI");
+constexpr uint32_t kRoughtimeTagPUBK = roughtimeTag("PUBK");
+constexpr uint32_t kRoughtimeTagMIDP = roughtimeTag("MIDP");
+constexpr uint32_t kRoughtimeTagSREP = roughtimeTag("SREP");
+constexpr uint32_t kRoughtimeTagMINT = roughtimeTag("MINT");
+constexpr uint32_t kRoughtimeTagROOT = roughtimeTag("ROOT");
+constexpr uint32_t kRoughtimeTagCERT = roughtimeTag("CERT");
+constexpr uint32_t kRoughtimeTagMAXT = roughtimeTag("MAXT");
+constexpr uint32_t kRoughtimeTagINDX = roughtimeTag("INDX");
+constexpr uint32_t kRoughtimeTagZZZZ = roughtimeTag("ZZZZ");
+
+/** Protocol version we speak (draft 08 numbering); times are POSIX seconds */
+constexpr uint32_t kRoughtimeVersion = 0x80000008;
+/** Smallest request we answer, so a response never outweighs its request */
+constexpr size_t kRoughtimeMinRequestSize = 1024;
+constexpr size_t kRoughtimeNonceSize = 32;
+/** Signature contexts, including the trailing NUL */
+constexpr char kRoughtimeDelegationContext[] = "RoughTime v1 delegation signature--";
+constexpr char kRoughtimeResponseContext[] = "RoughTime v1 response signature";
+
+/**
+ * @brief Roughtime message: a map from tag to value.
+ *
+ * Wire form (all integers little-endian): number of tags N, N-1 value
+ * offsets, N tags in ascending order, then the values. Values are padded to
+ * a multiple of four bytes by the writer.
+ */
+class RoughtimeMessage {
+public:
+  void set(uint32_t tag, std::vector<uint8_t> value) { fields_[tag] = std::move(value); }
+  void setUint32(uint32_t tag, uint32_t value);
+  void setUint64(uint32_t tag, uint64_t value);
+  const std::vector<uint8_t> *find(uint32_t tag) const;
+  size_t size() const { return fields_.size(); }
+
+  std::vector<uint8_t> serialize() const;
+  bool parse(const uint8_t *data, size_t length);
+
+private:
+  std::map<uint32_t, std::vector<uint8_t>> fields_; // Sorted by tag
+};
+
+/** @brief Frame a message as a packet: "ROUGHTIM", length, message */
+std::vector<uint8_t> wrapRoughtimePacket(const RoughtimeMessage &message);
+
+/** @brief Parse a framed packet; false on a bad magic, length or message */
+bool unwrapRoughtimePacket(const uint8_t *data, size_t length, RoughtimeMessage &message);
+
+/** SHA-512 truncated to 32 bytes */
+using RoughtimeHash = std::array<uint8_t, 32>;
+
+/** @brief Leaf hash: H(0x00 || nonce) */
+RoughtimeHash roughtimeLeafHash(const uint8_t *nonce, size_t length);
+
+/** @brief Interior node hash: H(0x01 || left || right) */
+RoughtimeHash roughtimeNodeHash(const RoughtimeHash &left, const RoughtimeHash &right);
+
+/**
+ * @brief Merkle tree over the nonces of one batch.
+ *
+ * A level with an odd number of nodes pairs its last node with itself.
+ * Bit k of a leaf index says whether the node at level k is a right child,
+ * and the path lists the sibling hashes from the leaf upwards.
+ */
+class RoughtimeMerkleTree {
+public:
+  explicit RoughtimeMerkleTree(std::vector<RoughtimeHash> leaves);
+
+  const RoughtimeHash &root() const { return levels_.back().front(); }
+  std::vector<uint8_t> path(size_t index) const;
+
+private:
+  std::vector<std::vector<RoughtimeHash>> levels_;
+};
+
+/** @brief Fold @p path from @p leaf at @p index and compare with @p root */
+bool verifyRoughtimePath(const RoughtimeHash &leaf, uint32_t index,
+                         const std::vector<uint8_t> &path, const RoughtimeHash &root);
+
+/**
+ * @brief Long-term identity plus the delegated online key that signs
+ *        responses.
+ *
+ * The long-term key only signs delegations (DELE: online public key and its
+ * MINT..MAXT validity window), so it can stay cold; the online key is
+ * regenerated in memory every rotation.
+ */
+class RoughtimeSigner {
+public:
+  RoughtimeSigner();
+  ~RoughtimeSigner();
+  RoughtimeSigner(const RoughtimeSigner &) = delete;
+  RoughtimeSigner &operator=(const RoughtimeSigner &) = delete;
+
+  /** @brief Load the long-term key from a 32-byte Ed25519 seed */
+  bool setLongTermSeed(const std::vector<uint8_t> &seed, std::string &error);
+  /** @brief Use a fresh random long-term key */
+  bool generateLongTermKey(std::string &error);
+  /** @brief Long-term public key (32 bytes), published to clients */
+  std::vector<uint8_t> longTermPublicKey() const;
+
+  /**
+   * @brief Replace the online key with one valid from @p now for
+   *        @p lifetime seconds, delegated by the long-term key
+   */
+  bool rotate(int64_t now, int64_t lifetime, std::string &error);
+  /** @brief True once half the online key's lifetime has passed */
+  bool needsRotation(int64_t now) const { return !online_ || now >= rotate_at_; }
+  /** @brief True when there is no online key or its MAXT has passed */
+  bool expired(int64_t now) const { return !online_ || now > expires_at_; }
+
+  /**
+   * @brief Answer a batch with one signature.
+   * @param nonces 32-byte nonces of the batched requests
+   * @param midpoint POSIX seconds
+   * @param radius Uncertainty (s)
+   * @return One framed response per nonce, in order; empty on failure or
+   *         once @p midpoint is past the delegation's MAXT
+   */
+  std::vector<std::vector<uint8_t>> respond(const std::vector<std::vector<uint8_t>> &nonces,
+                                            uint64_t midpoint, uint32_t radius);
+
+private:
+  bool sign(EVP_PKEY *key, const char *context, size_t context_length,
+            const std::vector<uint8_t> &message, std::vector<uint8_t> &signature) const;
+
+  EVP_PKEY *long_term_ = nullptr;
+  EVP_PKEY *online_ = nullptr;
+  std::vector<uint8_t> cert_; // Serialized CERT for the current online key
+  int64_t rotate_at_ = 0;
+  int64_t expires_at_ = 0; // MAXT of the current delegation
+};
+
+/**
+ * @brief Roughtime responder on its own UDP port.
+ *
+ * Requests are read until the batch is full or the batch window closes,
+ * then answered together under one signature.
+ */
+class RoughtimeServer {
+public:
+  /** Current time (POSIX s) and radius (s); false when time is unusable */
+  using TimeSource = std::function<bool(uint64_t &midpoint, uint32_t &radius)>;
+
+  RoughtimeServer(std::shared_ptr<NtpConfig> config, std::shared_ptr<Logger> logger,
+                  TimeSource time_source);
+  ~RoughtimeServer();
+
+  bool start();
+  void stop();
+
+  std::vector<uint8_t> longTermPublicKey() const { return signer_.longTermPublicKey(); }
+  uint64_t requests() const { return requests_; }
+  uint64_t responses() const { return responses_; }
+  uint64_t batches() const { return batches_; }
+
+private:
+  bool loadKey(std::string &error);
+  void serveLoop();
+  void answerBatch(std::vector<std::vector<uint8_t>> &nonces,
+                   std::vector<struct sockaddr_storage> &peers,
+                   std::vector<socklen_t> &peer_lengths);
+
+  std::shared_ptr<NtpConfig> config_;
+  std::shared_ptr<Logger> logger_;
+  TimeSource time_source_;
+  RoughtimeSigner signer_;
+  socket_t socket_ = INVALID_SOCKET;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> responses_{0};
+  std::atomic<uint64_t> batches_{0};
+};
+
+} // namespace simple_ntpd
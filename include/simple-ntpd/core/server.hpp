@@ -10,13 +10,23 @@
 
 #include "simple-ntpd/utils/logger.hpp"
 #include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/core/capture.hpp"
 #include "simple-ntpd/core/connection.hpp"
+#include "simple-ntpd/core/control_socket.hpp"
+#include "simple-ntpd/core/leap_seconds.hpp"
+#include "simple-ntpd/core/metrics_http.hpp"
+#include "simple-ntpd/core/roughtime.hpp"
+#include "simple-ntpd/core/stats_segment.hpp"
 #include "simple-ntpd/core/upstream_sync.hpp"
+#include "simple-ntpd/utils/cycles.hpp"
+#include "simple-ntpd/utils/histogram.hpp"
 #include "simple-ntpd/utils/platform.hpp"
+#include "simple-ntpd/utils/seqlock.hpp"
 #include <arpa/inet.h>
+#include <array>
 #include <atomic>
+#include <condition_variable>
 #include <functional>
-#include <random>
 #include <unordered_map>
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -31,7 +41,7 @@
 namespace simple_ntpd {
 
 /**
- * @brief NTP server statistics
+ * @brief NTP server statistics, summed over all workers on read
  */
 struct NtpServerStats {
   uint64_t total_connections;
@@ -55,6 +65,133 @@ struct NtpServerStats {
         max_request_processing_time_us(0), min_request_processing_time_us(UINT64_MAX) {}
 };
 
+/**
+ * @brief Counters owned by one worker thread.
+ *
+ * Each worker keeps a private copy and publishes it after every packet into
+ * its own cache-line-aligned SeqLock, so the hot path never writes memory
+ * another worker writes; readers sum the published copies.
+ */
+struct WorkerStats {
+  uint64_t requests = 0;
+  uint64_t responses = 0;
+  uint64_t bytes = 0;
+  uint64_t errors = 0;
+  uint64_t connections = 0;
+  uint64_t processing_time_us = 0;
+  uint64_t processed = 0;
+  uint64_t max_processing_time_us = 0;
+  uint64_t min_processing_time_us = UINT64_MAX;
+};
+
+/**
+ * @brief Latency distributions recorded by one worker thread
+ */
+struct WorkerLatency {
+  LatencyHistogram processing;     // processPacket, start to end
+  LatencyHistogram kernel_to_user; // Kernel receive timestamp to recvmsg returning
+  LatencyHistogram residence;      // Kernel receive timestamp to handing the reply to sendto
+};
+
+/**
+ * @brief Latency histograms merged over all workers
+ */
+struct LatencySnapshot {
+  LatencyHistogram::Snapshot processing;
+  LatencyHistogram::Snapshot kernel_to_user;
+  LatencyHistogram::Snapshot residence;
+};
+
+/**
+ * @brief Stages of handling one request, in pipeline order
+ */
+enum class PipelineStage : size_t {
+  RECEIVE,    // recvmsg returning a packet and reading its timestamp
+  ACL,        // Client address formatting and the ACL check
+  RATE_LIMIT, // Rate limiting and DDoS anomaly checks
+  LOOKUP,     // Connection table lookup or insert
+  PARSE,      // Per-connection validation and parsing the request
+  BUILD,      // Building and serializing the response
+  SEND,       // sendto
+  COUNT
+};
+
+constexpr size_t kPipelineStageCount = static_cast<size_t>(PipelineStage::COUNT);
+/** Label values for metrics and status, indexed by PipelineStage */
+constexpr std::array<const char *, kPipelineStageCount> kPipelineStageNames = {
+    "receive", "acl", "rate_limit", "lookup", "parse", "build", "send"};
+
+/**
+ * @brief Cycle totals per pipeline stage; snapshots of several workers merge
+ */
+struct StageSnapshot {
+  std::array<uint64_t, kPipelineStageCount> cycles{};
+  std::array<uint64_t, kPipelineStageCount> calls{};
+
+  void merge(const StageSnapshot &other) {
+    for (size_t i = 0; i < kPipelineStageCount; ++i) {
+      cycles[i] += other.cycles[i];
+      calls[i] += other.calls[i];
+    }
+  }
+};
+
+/**
+ * @brief Cycle totals per pipeline stage recorded by one worker thread.
+ *
+ * Same single-writer scheme as LatencyHistogram: the worker adds with
+ * relaxed load/store pairs, any thread may take a snapshot.
+ */
+struct alignas(64) WorkerStages {
+  std::array<std::atomic<uint64_t>, kPipelineStageCount> cycles{};
+  std::array<std::atomic<uint64_t>, kPipelineStageCount> calls{};
+
+  void add(PipelineStage stage, uint64_t elapsed) {
+    const size_t i = static_cast<size_t>(stage);
+    cycles[i].store(cycles[i].load(std::memory_order_relaxed) + elapsed,
+                    std::memory_order_relaxed);
+    calls[i].store(calls[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  StageSnapshot snapshot() const {
+    StageSnapshot out;
+    for (size_t i = 0; i < kPipelineStageCount; ++i) {
+      out.cycles[i] = cycles[i].load(std::memory_order_relaxed);
+      out.calls[i] = calls[i].load(std::memory_order_relaxed);
+    }
+    return out;
+  }
+};
+
+/**
+ * @brief Charges the cycles since the previous mark to a stage. Does nothing
+ *        when built without a WorkerStages, so the disabled cost is a branch.
+ */
+class StageTimer {
+public:
+  explicit StageTimer(WorkerStages *stages) : stages_(stages) {}
+
+  /** @brief Start the first stage now */
+  void start() {
+    if (stages_) {
+      last_ = readCycleCounter();
+    }
+  }
+
+  /** @brief End @p stage now and start the next one */
+  void mark(PipelineStage stage) {
+    if (stages_) {
+      const uint64_t now = readCycleCounter();
+      stages_->add(stage, now - last_);
+      last_ = now;
+    }
+  }
+
+private:
+  WorkerStages *stages_;
+  uint64_t last_ = 0;
+};
+
 /**
  * @brief NTP server class
  *
@@ -114,12 +251,36 @@ public:
    */
   NtpServerStats getStats() const;
 
+  /**
+   * @brief Per-worker counters, indexed by worker thread
+   * @return One consistent snapshot per worker
+   */
+  std::vector<WorkerStats> getWorkerStats() const;
+
+  /**
+   * @brief Latency histograms of all workers, merged
+   * @return Processing, kernel-to-user and residence time distributions
+   */
+  LatencySnapshot getLatencySnapshot() const;
+
+  /**
+   * @brief Pipeline stage cycle totals, indexed by worker thread
+   * @return Empty counts unless enable_stage_accounting is on
+   */
+  std::vector<StageSnapshot> getStageSnapshots() const;
+
   /**
    * @brief Export Prometheus metrics in text format
    * @return Metrics string
    */
   std::string exportPrometheusMetrics() const;
 
+  /**
+   * @brief Append the Prometheus text exposition to @p out, so a caller
+   *        that clears and reuses one buffer keeps its capacity
+   */
+  void appendPrometheusMetrics(std::string &out) const;
+
   /**
    * @brief Run health checks and return report
    * @return Health report
@@ -138,12 +299,32 @@ public:
    */
   std::shared_ptr<NtpConfig> getConfig() const;
 
+  /**
+   * @brief Get the counter summary printed by the stats command
+   * @return Statistics report
+   */
+  std::string getStatsReport() const;
+
+  /**
+   * @brief Write the packet capture ring as a pcap file
+   * @return false if enable_packet_capture was off at start
+   */
+  bool writePacketCapture(std::ostream &out) const;
+
   /**
    * @brief List active client connections
    * @return Human-readable connection list
    */
   std::string listConnections() const;
 
+  /**
+   * @brief Write the connection list to @p sink in pieces of up to
+   *        @p batch entries, without holding the table lock while writing
+   * @param sink Receives each piece; returning false stops the listing
+   * @param batch Entries copied out per lock acquisition
+   */
+  void streamConnections(const ControlSink &sink, size_t batch = 256) const;
+
   /**
    * @brief Upstream sync manager (may be null if no upstreams configured)
    */
@@ -240,34 +421,89 @@ private:
 
   /**
    * @brief Process incoming packets
+   * @param worker Worker thread ID
+   * @param stats Private counters of the calling worker
+   * @param published Where the worker publishes them after each packet
+   * @param latency Histograms of the calling worker
+   * @param stages Stage cycle totals of the calling worker
    */
-  void processIncomingPackets();
+  void processIncomingPackets(size_t worker, WorkerStats &stats,
+                              SeqLock<WorkerStats> &published, WorkerLatency &latency,
+                              WorkerStages &stages);
 
   /**
    * @brief Process a single packet
    * @param data Packet data
    * @param client_addr Client address
+   * @param worker Worker thread ID
+   * @param stats Counters of the calling worker
+   * @param latency Histograms of the calling worker
+   * @param received Kernel receive timestamp, or when recvmsg returned
+   * @param timer Stage timer, started before the packet was received
    */
   void processPacket(const std::vector<uint8_t> &data,
-                     const struct sockaddr_in &client_addr);
+                     const struct sockaddr_in &client_addr, size_t worker, WorkerStats &stats,
+                     WorkerLatency &latency, std::chrono::system_clock::time_point received,
+                     StageTimer &timer);
+  /** @brief Fire the drop probe and offer the request to the capture ring */
+  void noteDrop(const std::vector<uint8_t> &data, const struct sockaddr_in &client_addr,
+                size_t worker, std::chrono::system_clock::time_point received,
+                DropReason reason);
   bool isClientAllowed(const std::string &client_ip) const;
   bool isRateLimitExceeded(const std::string &client_ip);
   bool isDdosAnomaly(const std::string &client_ip);
   void persistState() const;
   void loadState();
   void backupConfig() const;
-  std::string selectUpstreamServer();
-  void applyDynamicStratum();
+  void applyDynamicStratum(const WorkerStats &stats);
   std::string effectiveReferenceId() const;
+  void loadLeapSeconds();
+  void refreshLeapSchedule(int64_t now);
+
+  /**
+   * @brief Fill stratum, reference ID, root distance and leap indicator from
+   *        the sync state and correct the timestamps; shared by unicast
+   *        replies and broadcasts
+   * @return true if synchronized to a source
+   */
+  bool applySyncState(NtpPacket &packet);
+
+  // Broadcast/multicast (mode 5) sender
+  bool startBroadcast();
+  void stopBroadcast();
+  void broadcastLoop();
+  bool sendBroadcast();
+
+  /**
+   * @brief Corrected time and its uncertainty for Roughtime responses
+   * @return false while sync sources are configured but none is selected
+   */
+  bool roughtimeNow(uint64_t &midpoint, uint32_t &radius);
+
+  /**
+   * @brief Run one control socket command against live state
+   * @param command Command name
+   * @param sink Receives the status line and the reply text
+   */
+  void handleControlCommand(const std::string &command, const ControlSink &sink);
+
+  // Memory-mapped statistics segment; only the publisher thread writes it
+  // while the server runs, stop() writes the final copy
+  bool startStatsSegment();
+  void stopStatsSegment();
+  void statsSegmentLoop();
+  StatsSegmentPayload collectStatsSegment();
 
   /**
    * @brief Get or create connection for client
    * @param client_ip Client IP address
    * @param client_port Client port
+   * @param stats Counters of the calling worker
    * @return Connection object
    */
   std::shared_ptr<NtpConnection>
-  getOrCreateConnection(const std::string &client_ip, uint16_t client_port);
+  getOrCreateConnection(const std::string &client_ip, uint16_t client_port,
+                        WorkerStats &stats);
 
 private:
   std::shared_ptr<NtpConfig> config_;
@@ -285,6 +521,8 @@ private:
   // Connection management
   std::unordered_map<std::string, std::shared_ptr<NtpConnection>> active_connections_;
   mutable std::mutex connections_mutex_;
+  // Size of active_connections_, readable without connections_mutex_
+  std::atomic<size_t> active_connection_count_{0};
 
   // Threading
   std::thread accept_thread_;
@@ -304,9 +542,14 @@ private:
   void stopConfigWatcher();
   void configWatcherLoop();
 
-  // Statistics
-  NtpServerStats stats_;
+  // Statistics: one published block per worker, summed on read. Blocks are
+  // never freed while the server exists, so totals survive restarts; the
+  // mutex only guards growing the list.
+  std::chrono::steady_clock::time_point stats_start_time_;
   mutable std::mutex stats_mutex_;
+  std::vector<std::unique_ptr<SeqLock<WorkerStats>>> worker_stats_;
+  std::vector<std::unique_ptr<WorkerLatency>> worker_latency_;
+  std::vector<std::unique_ptr<WorkerStages>> worker_stages_;
 
   // Configuration change callback
   std::function<void()> config_change_callback_;
@@ -315,13 +558,48 @@ private:
   std::chrono::steady_clock::time_point last_cleanup_time_;
   std::chrono::seconds cleanup_interval_;
   std::atomic<uint32_t> restart_count_;
-  std::vector<std::string> healthy_upstreams_;
-  std::atomic<size_t> upstream_rr_index_;
   mutable std::mutex security_mutex_;
   std::unordered_map<std::string, std::pair<uint64_t, uint32_t>> connection_rate_buckets_;
   std::unordered_map<std::string, std::pair<uint64_t, uint32_t>> request_second_buckets_;
-  std::mt19937 rng_;
   std::shared_ptr<UpstreamSyncManager> upstream_sync_;
+  uint32_t precision_dispersion_ = 1; // 2^precision in NTP short format
+
+  // Leap seconds: the table lives on the control path, responses read the
+  // schedule for the next leap
+  mutable std::mutex leap_mutex_;
+  LeapSecondTable leap_table_;
+  std::string leap_error_;
+  SeqLock<LeapSchedule> leap_schedule_;
+
+  // Broadcast mode: one packet per interval to a broadcast or multicast address
+  std::thread broadcast_thread_;
+  std::mutex broadcast_mutex_;
+  std::condition_variable broadcast_cv_;
+  std::atomic<bool> broadcast_running_{false};
+  socket_t broadcast_socket_ = INVALID_SOCKET;
+  struct sockaddr_storage broadcast_dest_ {};
+  socklen_t broadcast_dest_len_ = 0;
+  std::atomic<uint64_t> broadcasts_sent_{0};
+
+  // Roughtime responder; kept after stop() so its counters stay readable
+  std::unique_ptr<RoughtimeServer> roughtime_;
+
+  // HTTP endpoint for scrapes and health probes of this instance
+  std::unique_ptr<MetricsHttpServer> metrics_http_;
+
+  // Unix control socket for the CLI
+  std::unique_ptr<ControlServer> control_;
+
+  // Statistics segment for external readers
+  StatsSegment stats_segment_;
+  std::thread stats_segment_thread_;
+  std::mutex stats_segment_mutex_;
+  std::condition_variable stats_segment_cv_;
+  std::atomic<bool> stats_segment_running_{false};
+
+  // Sampled exchanges; null unless enabled. Built before the workers start
+  // and kept after stop() so the last capture can still be dumped.
+  std::unique_ptr<PacketCapture> capture_;
 
   // Platform-specific data
   struct sockaddr_in server_addr_;
@@ -0,0 +1,98 @@
+/**
+ * @file stats_segment.hpp
+ * @brief Memory-mapped statistics file that external agents read without
+ *        talking to the daemon
+ */
+
+#pragma once
+
+#include "simple-ntpd/utils/histogram.hpp"
+#include "simple-ntpd/utils/seqlock.hpp"
+#include <cstdint>
+#include <string>
+
+namespace simple_ntpd {
+
+constexpr char kStatsSegmentMagic[8] = {'S', 'N', 'T', 'P', 'D', 'S', 'T', 'S'};
+/** Bumped whenever StatsSegmentPayload changes layout */
+constexpr uint32_t kStatsSegmentVersion = 1;
+
+/**
+ * @brief Everything published per interval. Plain fixed-size fields in
+ *        host byte order; the layout is part of the file format.
+ */
+struct StatsSegmentPayload {
+  int64_t published_unix_ns = 0; // When this copy was written
+  int64_t started_unix_ns = 0;   // When the server started
+  int64_t pid = 0;               // Writer process
+  uint64_t total_connections = 0;
+  uint64_t active_connections = 0;
+  uint64_t total_requests = 0;
+  uint64_t total_responses = 0;
+  uint64_t total_bytes = 0;
+  uint64_t total_errors = 0;
+  uint64_t processing_time_us = 0;
+  uint64_t processed_requests = 0;
+  int64_t clock_offset_us = 0;
+  double frequency_ppm = 0.0;
+  uint32_t worker_threads = 0;
+  uint8_t running = 0;        // 0 once the server has stopped
+  uint8_t synced = 0;         // 1 while a sync source is selected
+  uint8_t stratum = 0;        // Stratum announced in responses
+  uint8_t leap_indicator = 0; // LI announced in responses
+  LatencyHistogram::Snapshot processing;
+  LatencyHistogram::Snapshot kernel_to_user;
+  LatencyHistogram::Snapshot residence;
+};
+
+/**
+ * @brief Fixed header at offset 0 of the file. The payload follows at
+ *        offset header_size as a SeqLock: a uint64 sequence (odd while an
+ *        update is in progress), then payload_size bytes of payload.
+ */
+struct StatsSegmentHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t payload_size;
+  uint8_t reserved[40];
+};
+static_assert(sizeof(StatsSegmentHeader) == 64, "header is one cache line");
+
+/**
+ * @brief Writer side: owns the mapping and publishes into it.
+ *
+ * The file stays in place after close() and after a crash, so the last
+ * published counters remain readable until the next start overwrites them.
+ * Only one thread may publish at a time.
+ */
+class StatsSegment {
+public:
+  StatsSegment() = default;
+  ~StatsSegment();
+  StatsSegment(const StatsSegment &) = delete;
+  StatsSegment &operator=(const StatsSegment &) = delete;
+
+  /** @brief Create or reinitialize the file at @p path and map it */
+  bool open(const std::string &path, std::string &error);
+  void publish(const StatsSegmentPayload &payload);
+  /** @brief Unmap; the file keeps its contents */
+  void close();
+  bool isOpen() const { return lock_ != nullptr; }
+
+private:
+  void *map_ = nullptr;
+  size_t size_ = 0;
+  SeqLock<StatsSegmentPayload> *lock_ = nullptr;
+};
+
+/**
+ * @brief Reader side: map @p path read-only and copy out a consistent
+ *        payload
+ * @return false if the file is missing, of another version, or caught
+ *         mid-update too many times in a row (e.g. the writer died during
+ *         one)
+ */
+bool readStatsSegment(const std::string &path, StatsSegmentPayload &payload, std::string &error);
+
+} // namespace simple_ntpd
@@ -6,14 +6,28 @@
 #pragma once
 
 #include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/core/clock_adjuster.hpp"
+#include "simple-ntpd/core/clock_discipline.hpp"
+#include "simple-ntpd/core/clock_filter.hpp"
+#include "simple-ntpd/core/clock_history.hpp"
+#include "simple-ntpd/core/packet.hpp"
+#include "simple-ntpd/core/refclock.hpp"
 #include "simple-ntpd/utils/logger.hpp"
+#include "simple-ntpd/utils/platform.hpp"
+#include "simple-ntpd/utils/resolver.hpp"
+#include "simple-ntpd/utils/seqlock.hpp"
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <string>
+#include <sys/socket.h>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace simple_ntpd {
 
@@ -23,17 +37,229 @@ struct UpstreamSyncResult {
   int64_t offset_us = 0;
   int64_t delay_us = 0;
   uint8_t stratum = 0;
+  // Upstream-advertised header fields
+  uint8_t leap_indicator = 0;
+  int8_t precision = 0;
+  uint32_t reference_id = 0;
+  int64_t root_delay_us = 0;
+  int64_t root_dispersion_us = 0;
 };
 
-/** Query a single upstream NTP server (UDP port 123). */
+/**
+ * @brief Running health record for one upstream association.
+ *
+ * reach is the classic 8-bit reachability register: shifted left on every
+ * poll, with bit 0 set when the poll was answered.
+ */
+struct UpstreamHealth {
+  uint8_t reach = 0;
+  uint64_t polls = 0;
+  uint64_t errors = 0;       // Unanswered or rejected polls
+  double delay_score = 0.0;  // Smoothed round-trip delay (s)
+  double jitter_score = 0.0; // Smoothed filter jitter (s)
+
+  void recordPoll(bool answered);
+  void recordSample(double delay, double jitter);
+  /** @brief Unanswered polls among the last eight */
+  int recentMisses() const;
+};
+
+/**
+ * @brief LEAST_ERRORS ordering: fewer recent misses, then a lower lifetime
+ *        error rate, then a lower delay plus jitter score.
+ */
+bool healthierThan(const UpstreamHealth &a, const UpstreamHealth &b);
+
+/** @brief Config spelling of a selection policy, e.g. "least_errors" */
+const char *selectionPolicyName(NtpConfig::UpstreamSelectionAlgorithm policy);
+
+/**
+ * @brief Choose the system peer among the cluster survivors.
+ *
+ * Every survivor agrees on the time, so the policy only decides which one
+ * supplies stratum, reference ID and root distance. The current system
+ * peer is kept while it survives and passes the failover check; the policy
+ * only picks a replacement, so the clock does not hop between servers.
+ * @param survivors Health of each survivor, in RFC 5905 merit order
+ * @param current Index of the current system peer in @p survivors, or
+ *        survivors.size() if it is not among them
+ * @param failover Pass over survivors that missed half of their last eight
+ *        polls while another one qualifies
+ * @param round Round counter used by ROUND_ROBIN
+ * @param random Random value used by RANDOM
+ * @return Index into @p survivors
+ */
+size_t selectSystemPeer(NtpConfig::UpstreamSelectionAlgorithm policy,
+                        const std::vector<const UpstreamHealth *> &survivors, size_t current,
+                        bool failover, uint64_t round, uint64_t random);
+
+/**
+ * @brief Per-upstream view exposed through statusSummary and metrics.
+ */
+struct UpstreamPeerStatus {
+  std::string server;
+  std::string address; // Resolved address, empty while unresolved
+  char tally = ' '; // '*' system peer, '+' survivor, '-' outlier, 'x' falseticker
+  bool reachable = false;
+  bool symmetric = false; // Symmetric peer rather than a server
+  uint8_t stratum = 0;
+  int64_t offset_us = 0;
+  int64_t delay_us = 0;
+  int64_t jitter_us = 0;
+  int64_t root_distance_us = 0;
+  int poll = 0; // Current poll exponent (log2 s)
+  UpstreamHealth health;
+};
+
+/**
+ * @brief Split an upstream spec ("host", "host:port", "[v6]:port") into
+ *        host and service strings. The service defaults to "123".
+ */
+void splitUpstreamHostPort(const std::string &spec, std::string &host,
+                           std::string &service);
+
+/**
+ * @brief Long-lived state for one upstream address.
+ *
+ * A configured server or peer yields one association, a pool name several.
+ * Each association owns a connected, non-blocking UDP socket that is kept
+ * open across sync rounds, so a round only costs one send and one receive
+ * per server. Addresses come from the resolver cache; polling never touches DNS.
+ */
+struct UpstreamAssociation {
+  std::string spec; // As configured, e.g. "time.example.com:123"
+  std::string host;
+  std::string service;
+  bool pool_member = false;
+  // Symmetric peers poll in mode 1 from the listen address and drop replies
+  // from siblings that are synchronized to us (their refid is our address).
+  bool symmetric = false;
+  std::string bind_address;
+  uint32_t local_reference_id = 0; // Our address as the peer sees it
+  socket_t socket = INVALID_SOCKET;
+  struct sockaddr_storage address {};
+  socklen_t address_len = 0; // 0 while the name is unresolved
+  std::string address_text;
+  uint32_t consecutive_failures = 0;
+
+  // In-flight request state
+  bool awaiting_reply = false;
+  NtpTimestamp origin_ts;
+  std::chrono::steady_clock::time_point deadline{};
+
+  UpstreamSyncResult last_result;
+
+  // Clock filter state fed by successful polls
+  ClockFilter filter;
+  UpstreamSyncResult last_sample; // Most recent successful reply
+
+  // Adaptive poll schedule
+  PollController poll;
+  double next_poll = 0.0; // Monotonic seconds; 0 means due now
+
+  UpstreamHealth health;
+
+  // Local reference clock polled in place of a network server
+  std::shared_ptr<RefClock> refclock;
+};
+
+/**
+ * @brief Poll a set of associations concurrently.
+ *
+ * Sends one client request on every association, then waits on all sockets
+ * at once until each has answered or reached its own timeout. Returns one
+ * result per association, in the same order.
+ */
+std::vector<UpstreamSyncResult>
+pollUpstreamAssociations(std::vector<UpstreamAssociation *> &associations,
+                         std::chrono::milliseconds timeout);
+
+/** Close the association socket; the address is kept for reopening. */
+void resetUpstreamAssociation(UpstreamAssociation &association);
+
+/** Query a single upstream NTP server (UDP port 123 unless host:port). */
 UpstreamSyncResult queryUpstreamServer(const std::string &host,
                                        std::chrono::milliseconds timeout);
 
+/**
+ * @brief Per-association state carried across restarts.
+ */
+struct UpstreamAssociationState {
+  std::string spec;
+  std::string address;
+  uint8_t stratum = 0;
+  uint32_t consecutive_failures = 0;
+  int poll = 0; // Poll exponent; 0 if unknown
+  uint8_t reach = 0;
+  uint64_t polls = 0;
+  uint64_t errors = 0;
+};
+
+/**
+ * @brief Clock and upstream state persisted in state_file for warm starts.
+ */
+struct UpstreamSyncState {
+  double saved_at = 0.0; // Unix seconds
+  bool synced = false;
+  double offset = 0.0;     // Model correction at saved_at (s)
+  double frequency = 0.0;  // s/s
+  double dispersion = 0.0; // At saved_at (s)
+  uint8_t stratum = 0;     // Upstream (system peer) stratum
+  std::string upstream;
+  int64_t jitter_us = 0;
+  std::vector<UpstreamAssociationState> associations;
+};
+
+/** Render @p state as the "upstream_sync" JSON object of the state file. */
+std::string formatUpstreamSyncState(const UpstreamSyncState &state);
+
+/**
+ * Read the "upstream_sync" object back from a state file; false if it is
+ * absent or malformed, or the build has no JSON support.
+ */
+bool parseUpstreamSyncState(const std::string &text, UpstreamSyncState &state);
+
+/**
+ * @brief Synchronization state the response path needs, published by the
+ *        sync thread as one consistent, lock-free snapshot.
+ *
+ * Time-dependent values (offset, dispersion, validity) are evaluated by the
+ * reader from the clock model, so the snapshot only changes when the sync
+ * thread learns something new.
+ */
+struct SyncSnapshot {
+  ClockModel clock;
+  bool synced = false;         // Synchronized or in holdover
+  bool steering = false;       // System clock is steered; no response offset
+  uint8_t leap = 0;            // System peer leap indicator
+  uint8_t stratum = 0;         // System peer stratum; 0 if none
+  uint32_t reference_id = 0;   // System peer reference ID (RFC 5905 refid)
+  int64_t root_delay_us = 0;   // System peer root delay plus path delay
+  int64_t root_dispersion_us = 0; // System peer root dispersion plus ours
+
+  /** @brief Monotonic clock (s) the snapshot's times refer to */
+  static double monotonicNow();
+
+  /** @brief Synchronized and the model's error bound is still usable */
+  bool syncedAt(double now) const {
+    return synced && clock.valid && clock.dispersionAt(now) < NTP_MAXDIST;
+  }
+  /** @brief Correction for response timestamps (us); 0 when steering */
+  int64_t offsetUsAt(double now) const;
+  /** @brief Stratum to advertise: one below the system peer when synced */
+  uint8_t stratumAt(double now, uint8_t configured_stratum) const;
+  /** @brief Root dispersion (us) grown at PHI since the last clock update */
+  int64_t rootDispersionUsAt(double now) const;
+};
+
 /**
  * @brief Background upstream synchronization manager.
  *
- * Periodically queries configured upstream servers and tracks clock offset
- * and stratum for downstream responses.
+ * Queries configured upstream servers, runs each reply through a
+ * per-upstream clock filter, and combines the survivors of the RFC 5905
+ * selection and cluster algorithms into the offset and stratum used for
+ * downstream responses. Every association keeps its own poll interval,
+ * so a round only polls the associations that are due.
  */
 class UpstreamSyncManager {
 public:
@@ -44,30 +270,120 @@ public:
   void start();
   void stop();
 
+  /** @brief Poll every association now, regardless of its schedule */
   UpstreamSyncResult syncOnce();
 
+  /** @brief Snapshot clock model and associations for persistence */
+  UpstreamSyncState captureState() const;
+
+  /**
+   * @brief Warm start from a persisted snapshot (call before start()).
+   *
+   * Saved addresses seed the resolver so the first round needs no DNS. The
+   * clock model is projected forward by the elapsed time and served in
+   * holdover until live samples arrive, provided its dispersion is still
+   * under the distance threshold.
+   * @return true if the clock model was restored
+   */
+  bool restoreState(const UpstreamSyncState &state);
+
+  /**
+   * @brief Replace the system clock backend (call before start()). A backend
+   *        that steers the clock makes clockOffsetUs() return 0.
+   */
+  void setClockAdjuster(std::shared_ptr<ClockAdjuster> adjuster);
+
+  /** @brief True while the system clock itself is being disciplined */
+  bool steersSystemClock() const { return steering_clock_; }
+
+  /**
+   * @brief Lock-free copy of the published sync state; this is what the
+   *        packet path reads (the accessors below wrap it)
+   */
+  SyncSnapshot snapshot() const { return snapshot_.load(); }
+
   int64_t clockOffsetUs() const;
   uint8_t effectiveStratum(uint8_t configured_stratum) const;
   std::string syncedUpstream() const;
   std::chrono::system_clock::time_point lastSyncTime() const;
   bool isSynced() const;
+  int64_t systemJitterUs() const;
+  double frequencyPpm() const;
+  bool inHoldover() const;
+  int64_t dispersionUs() const;
+  std::vector<UpstreamPeerStatus> peerStatus() const;
   std::string statusSummary() const;
 
+  /** @brief History window in seconds; 0 when clock history is off */
+  int64_t historyWindowSeconds() const;
+  /** @brief System clock state over the history window, oldest first */
+  std::vector<ClockHistorySample> clockHistory() const;
+  /** @brief Per-association poll results over the history window */
+  std::vector<PeerHistory> upstreamHistory() const;
+
 private:
   void syncLoop();
+  UpstreamSyncResult runRound(bool poll_all);
+  std::chrono::milliseconds nextPollDelay();
+  void reconcileAssociations();
+  void noteFailures(const std::vector<UpstreamAssociation *> &batch, double now);
+  bool syncedAt(double now) const;
+  bool steerSystemClock(double offset, double max_error, double est_error,
+                        int poll_log2, double &frequency);
+  void saveDriftFile(bool force);
+  void publishSnapshotLocked();
+  void recordHistoryLocked(const std::vector<bool> &polled, const ClockSelection &selection,
+                           bool fresh_sample, double now);
 
   std::shared_ptr<NtpConfig> config_;
   std::shared_ptr<Logger> logger_;
   std::thread sync_thread_;
   std::atomic<bool> running_{false};
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+
+  // Serializes polling rounds; guards associations_ and banned_addresses_
+  std::mutex poll_mutex_;
+  std::vector<UpstreamAssociation> associations_;
+  AsyncResolver resolver_;
+  // Pool addresses that stopped answering, with monotonic ban expiry
+  std::unordered_map<std::string, double> banned_addresses_;
+  // Saved per-association state applied when the association is recreated
+  std::unordered_map<std::string, UpstreamAssociationState> restored_associations_;
+  // Local reference clock, polled as one more association
+  std::shared_ptr<RefClock> refclock_;
+  // System peer policy state; the peer is kept by spec and address
+  std::string system_peer_spec_;
+  std::string system_peer_address_;
+  uint64_t selection_round_ = 0;
+  std::mt19937_64 rng_{std::random_device{}()};
 
   mutable std::mutex state_mutex_;
-  int64_t clock_offset_us_ = 0;
   int64_t last_delay_us_ = 0;
   uint8_t upstream_stratum_ = 0;
   std::string synced_upstream_;
   std::chrono::system_clock::time_point last_sync_time_{};
   bool synced_ = false;
+  int64_t system_jitter_us_ = 0;
+  std::vector<UpstreamPeerStatus> peer_status_;
+  // Disciplined clock model; keeps time through holdover
+  ClockDiscipline discipline_;
+  bool holdover_ = false;
+  double last_drift_save_ = 0.0;
+  std::string clock_backend_ = "response offset";
+  // System peer header fields passed on to clients
+  uint8_t system_leap_ = 0;
+  uint32_t system_reference_id_ = 0;
+  int64_t system_root_delay_us_ = 0;
+  int64_t system_root_dispersion_us_ = 0;
+  // Written under state_mutex_, read lock-free by the packet path
+  SeqLock<SyncSnapshot> snapshot_;
+  // Recent per-association samples and system clock state
+  ClockHistory history_;
+
+  // Optional system clock backend; only touched by the polling thread
+  std::shared_ptr<ClockAdjuster> adjuster_;
+  std::atomic<bool> steering_clock_{false};
 };
 
 } // namespace simple_ntpd
@@ -0,0 +1,57 @@
+/**
+ * @file cycles.hpp
+ * @brief Cheap monotonic cycle counter for timing short code paths
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace simple_ntpd {
+
+/**
+ * @brief Read the CPU cycle counter: TSC on x86, the virtual counter on
+ *        AArch64, steady_clock nanoseconds elsewhere.
+ *
+ * Unserialized, so the CPU may move it a few instructions either way; fine
+ * for stages of a hundred cycles and more. Assumes a constant-rate counter
+ * (constant_tsc on any x86 of the last decade).
+ */
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t value;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+  return value;
+#else
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+#endif
+}
+
+/**
+ * @brief Counter ticks per second, measured against steady_clock on first
+ *        use (blocks for about 20 ms once)
+ */
+inline double cycleCounterHz() {
+  static const double hz = [] {
+    const auto wall_start = std::chrono::steady_clock::now();
+    const uint64_t start = readCycleCounter();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const uint64_t end = readCycleCounter();
+    const auto wall = std::chrono::steady_clock::now() - wall_start;
+    const double seconds = std::chrono::duration<double>(wall).count();
+    return seconds > 0.0 && end > start ? static_cast<double>(end - start) / seconds : 1e9;
+  }();
+  return hz;
+}
+
+} // namespace simple_ntpd
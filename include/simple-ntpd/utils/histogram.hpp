@@ -0,0 +1,126 @@
+/**
+ * @file histogram.hpp
+ * @brief Log-linear (HDR-style) latency histogram with a single-writer,
+ *        allocation-free record path
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Nanosecond latency histogram.
+ *
+ * Values below 16 ns get a bucket each; above that every power of two is
+ * split into 16 linear sub-buckets, so any recorded value is known to within
+ * 1/16 (6.25%). Values of 2^40 ns (about 18 minutes) and more share the last
+ * bucket.
+ *
+ * One thread records; a record is a count-leading-zeros and two relaxed
+ * load/store pairs, with no read-modify-write and no allocation. Any thread
+ * may take a snapshot; buckets are read individually, so a snapshot taken
+ * while recording may miss the newest values but never sees torn counts.
+ */
+class alignas(64) LatencyHistogram {
+public:
+  static constexpr unsigned kSubBucketBits = 4;
+  static constexpr unsigned kMaxExponent = 40;
+  static constexpr size_t kBucketCount = static_cast<size_t>(kMaxExponent - kSubBucketBits + 1)
+                                         << kSubBucketBits;
+
+  /** @brief Plain copy of the counts; snapshots of several writers merge */
+  struct Snapshot {
+    std::array<uint64_t, kBucketCount> counts{};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+
+    void merge(const Snapshot &other) {
+      for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] += other.counts[i];
+      }
+      count += other.count;
+      sum_ns += other.sum_ns;
+    }
+
+    /** @brief Number of values below @p bound_ns (exact at powers of two) */
+    uint64_t countBelow(uint64_t bound_ns) const {
+      uint64_t below = 0;
+      for (size_t i = 0; i < kBucketCount && bucketUpperBound(i) <= bound_ns; ++i) {
+        below += counts[i];
+      }
+      return below;
+    }
+
+    /** @brief Highest value equivalent to the @p quantile (0-1); 0 if empty */
+    uint64_t valueAtQuantile(double quantile) const {
+      if (count == 0) {
+        return 0;
+      }
+      const double wanted = quantile * static_cast<double>(count);
+      uint64_t rank = static_cast<uint64_t>(wanted);
+      rank = rank < 1 ? 1 : (static_cast<double>(rank) < wanted ? rank + 1 : rank);
+      uint64_t seen = 0;
+      for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+          return bucketUpperBound(i) - 1;
+        }
+      }
+      return bucketUpperBound(kBucketCount - 1) - 1;
+    }
+  };
+
+  /** @brief Record one value; only the owning thread may call this */
+  void record(uint64_t value_ns) {
+    std::atomic<uint64_t> &bucket = counts_[bucketIndex(value_ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_ns_.store(sum_ns_.load(std::memory_order_relaxed) + value_ns, std::memory_order_relaxed);
+  }
+
+  /** @brief Copy of the current counts; safe from any thread */
+  Snapshot snapshot() const {
+    Snapshot out;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      out.counts[i] = counts_[i].load(std::memory_order_relaxed);
+      out.count += out.counts[i];
+    }
+    out.sum_ns = sum_ns_.load(std::memory_order_relaxed);
+    return out;
+  }
+
+  static size_t bucketIndex(uint64_t value_ns) {
+    constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+    if (value_ns < kSubBuckets) {
+      return static_cast<size_t>(value_ns);
+    }
+    const unsigned exponent = 63u - static_cast<unsigned>(__builtin_clzll(value_ns));
+    if (exponent >= kMaxExponent) {
+      return kBucketCount - 1;
+    }
+    const unsigned shift = exponent - kSubBucketBits;
+    const uint64_t sub = (value_ns >> shift) & (kSubBuckets - 1);
+    return (static_cast<size_t>(shift + 1) << kSubBucketBits) + static_cast<size_t>(sub);
+  }
+
+  /** @brief First value past bucket @p index */
+  static uint64_t bucketUpperBound(size_t index) {
+    constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+    if (index < kSubBuckets) {
+      return index + 1;
+    }
+    const unsigned shift = static_cast<unsigned>(index >> kSubBucketBits) - 1;
+    const uint64_t sub = index & (kSubBuckets - 1);
+    return (kSubBuckets + sub + 1) << shift;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, kBucketCount> counts_{};
+  std::atomic<uint64_t> sum_ns_{0};
+};
+
+} // namespace simple_ntpd
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace simple_ntpd {
@@ -12,4 +13,12 @@ namespace simple_ntpd {
 /** @brief Check whether @p ip is contained in @p cidr (IPv4 only). */
 bool isIpInCidr(const std::string &ip, const std::string &cidr);
 
+/**
+ * @brief Parse an IPv4 "a.b.c.d/len" or bare address (a /32)
+ * @param network Masked network address, host byte order
+ * @param mask Prefix mask, host byte order
+ * @return false if @p cidr is malformed
+ */
+bool parseIpv4Cidr(const std::string &cidr, uint32_t &network, uint32_t &mask);
+
 } // namespace simple_ntpd
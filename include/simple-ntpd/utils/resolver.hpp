@@ -0,0 +1,116 @@
+/**
+ * @file resolver.hpp
+ * @brief Background DNS resolver with a TTL cache
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_ntpd {
+
+/**
+ * @brief One resolved socket address.
+ */
+struct ResolvedAddress {
+  struct sockaddr_storage storage {};
+  socklen_t length = 0;
+  std::string text; // "192.0.2.1:123" or "[2001:db8::1]:123"
+};
+
+/**
+ * @brief Resolve @p host / @p service with a blocking getaddrinfo call.
+ *
+ * IPv4 and IPv6 UDP addresses are returned de-duplicated, in resolver order.
+ * @param numeric_only Only accept numeric hosts (never touches DNS)
+ * @return false if nothing could be resolved
+ */
+bool resolveAddresses(const std::string &host, const std::string &service,
+                      std::vector<ResolvedAddress> &out, bool numeric_only = false);
+
+/**
+ * @brief Asynchronous resolver with a cache.
+ *
+ * Lookups never block: they return the cached answer (even an expired one,
+ * while a refresh runs) and queue a background getaddrinfo call when the
+ * entry is missing or past its lifetime. getaddrinfo does not report record
+ * TTLs, so positive answers live for a configured TTL and failures for a
+ * shorter negative TTL. Numeric addresses are resolved inline and never
+ * expire.
+ */
+class AsyncResolver {
+public:
+  explicit AsyncResolver(std::chrono::seconds ttl = std::chrono::seconds(3600),
+                         std::chrono::seconds negative_ttl = std::chrono::seconds(60));
+  ~AsyncResolver();
+
+  AsyncResolver(const AsyncResolver &) = delete;
+  AsyncResolver &operator=(const AsyncResolver &) = delete;
+
+  void setTtl(std::chrono::seconds ttl);
+
+  /**
+   * @brief Cached addresses for host/service; schedules a refresh if needed
+   * @return true if an answer (possibly stale) with addresses is cached
+   */
+  bool lookup(const std::string &host, const std::string &service,
+              std::vector<ResolvedAddress> &out);
+
+  /**
+   * @brief Block until every name has an answer (positive or negative) or
+   *        until @p timeout passes. Used only on cold start.
+   */
+  void waitFor(const std::vector<std::pair<std::string, std::string>> &names,
+               std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Prime the cache with addresses remembered from an earlier run.
+   *        They are served at once and refreshed on first lookup.
+   */
+  void seed(const std::string &host, const std::string &service,
+            const std::vector<ResolvedAddress> &addresses);
+
+  /** @brief Expire the cached answer and re-resolve in the background */
+  void refresh(const std::string &host, const std::string &service);
+
+  /** @brief Number of background lookups performed (for tests/metrics) */
+  uint64_t resolutionCount() const;
+
+  void stop();
+
+private:
+  struct Entry {
+    std::vector<ResolvedAddress> addresses;
+    std::chrono::steady_clock::time_point expires{};
+    bool answered = false;  // At least one lookup finished
+    bool in_flight = false; // Queued or resolving
+    bool permanent = false; // Numeric host
+  };
+
+  static std::string key(const std::string &host, const std::string &service);
+  void schedule(const std::string &key, Entry &entry);
+  void workerLoop();
+
+  std::chrono::seconds ttl_;
+  std::chrono::seconds negative_ttl_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::unordered_map<std::string, Entry> cache_;
+  std::deque<std::string> queue_;
+  uint64_t resolutions_ = 0;
+  bool running_ = true;
+  std::thread worker_;
+};
+
+} // namespace simple_ntpd
@@ -0,0 +1,63 @@
+/**
+ * @file sample_ring.hpp
+ * @brief Fixed-capacity ring that keeps the most recent values
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Ring of the last @p capacity values pushed.
+ *
+ * Storage is allocated once; a push overwrites the oldest value when the
+ * ring is full and never allocates. Not thread-safe: the owner serializes
+ * access.
+ */
+template <typename T> class SampleRing {
+public:
+  explicit SampleRing(size_t capacity = 1)
+      : slots_(capacity > 0 ? capacity : 1) {}
+
+  void push(const T &value) {
+    slots_[next_] = value;
+    next_ = (next_ + 1) % slots_.size();
+    if (size_ < slots_.size()) {
+      ++size_;
+    }
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return slots_.size(); }
+  bool empty() const { return size_ == 0; }
+
+  /** @brief Most recently pushed value; the ring must not be empty */
+  const T &newest() const { return slots_[(next_ + slots_.size() - 1) % slots_.size()]; }
+
+  /** @brief Call @p visit on each value, oldest first */
+  template <typename Visit> void forEach(Visit visit) const {
+    size_t index = (next_ + slots_.size() - size_) % slots_.size();
+    for (size_t i = 0; i < size_; ++i) {
+      visit(slots_[index]);
+      index = (index + 1) % slots_.size();
+    }
+  }
+
+  /** @brief Copy of the values, oldest first */
+  std::vector<T> values() const {
+    std::vector<T> out;
+    out.reserve(size_);
+    forEach([&out](const T &value) { out.push_back(value); });
+    return out;
+  }
+
+private:
+  std::vector<T> slots_;
+  size_t next_ = 0;
+  size_t size_ = 0;
+};
+
+} // namespace simple_ntpd
@@ -0,0 +1,102 @@
+/**
+ * @file seqlock.hpp
+ * @brief Single-writer sequence lock for publishing small snapshots
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Sequence lock holding one trivially copyable value.
+ *
+ * The writer bumps the sequence to an odd value, stores the payload and
+ * bumps it back to even; readers copy the payload and retry if the sequence
+ * moved or was odd. Readers never write shared memory, so any number of
+ * worker threads can read concurrently without bouncing a lock's cache line
+ * between cores. The payload lives in relaxed atomic words, which keeps
+ * concurrent reads free of data races.
+ *
+ * Stores must be serialized by the caller (one writer at a time).
+ */
+template <typename T> class alignas(64) SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>, "SeqLock payload must be trivially copyable");
+
+public:
+  SeqLock() { store(T{}); }
+  explicit SeqLock(const T &value) { store(value); }
+
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  /** @brief Publish @p value; callers must not store concurrently */
+  void store(const T &value) {
+    std::array<uint64_t, kWords> buffer{};
+    std::memcpy(buffer.data(), &value, sizeof(T));
+    const uint64_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(buffer[i], std::memory_order_relaxed);
+    }
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  /** @brief Consistent copy of the last published value */
+  T load() const {
+    std::array<uint64_t, kWords> buffer{};
+    uint64_t before = 0;
+    uint64_t after = 0;
+    do {
+      before = sequence_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < kWords; ++i) {
+        buffer[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+    T value;
+    std::memcpy(static_cast<void *>(&value), buffer.data(), sizeof(T));
+    return value;
+  }
+
+  /**
+   * @brief Like load(), but gives up after @p attempts torn reads; for
+   *        readers in another process, whose writer may have died mid-store
+   * @return false if no consistent copy was read
+   */
+  bool tryLoad(T &out, unsigned attempts) const {
+    std::array<uint64_t, kWords> buffer{};
+    for (unsigned attempt = 0; attempt < attempts; ++attempt) {
+      const uint64_t before = sequence_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < kWords; ++i) {
+        buffer[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((before & 1) == 0 && before == sequence_.load(std::memory_order_relaxed)) {
+        std::memcpy(static_cast<void *>(&out), buffer.data(), sizeof(T));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** @brief Number of completed stores */
+  uint64_t version() const { return sequence_.load(std::memory_order_acquire) / 2; }
+
+private:
+  static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // The class is cache-line aligned and padded, so readers never share a
+  // line with unrelated writes.
+  std::atomic<uint64_t> sequence_{0};
+  std::array<std::atomic<uint64_t>, kWords> words_{};
+};
+
+} // namespace simple_ntpd
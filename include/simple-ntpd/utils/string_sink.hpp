@@ -0,0 +1,41 @@
+/**
+ * @file string_sink.hpp
+ * @brief Output stream buffer that appends to a caller-owned string
+ */
+
+#pragma once
+
+#include <streambuf>
+#include <string>
+
+namespace simple_ntpd {
+
+/**
+ * @brief Stream buffer appending everything written to @p target.
+ *
+ * Lets ostream-based renderers write into a string the caller reuses, so a
+ * cleared buffer keeps its capacity from one render to the next instead of
+ * a std::stringstream allocating and copying a fresh one each time.
+ */
+class StringSink : public std::streambuf {
+public:
+  explicit StringSink(std::string &target) : target_(target) {}
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      target_.push_back(traits_type::to_char_type(ch));
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const char *data, std::streamsize count) override {
+    target_.append(data, static_cast<size_t>(count));
+    return count;
+  }
+
+private:
+  std::string &target_;
+};
+
+} // namespace simple_ntpd
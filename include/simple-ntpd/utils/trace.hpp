@@ -0,0 +1,30 @@
+/**
+ * @file trace.hpp
+ * @brief USDT static tracepoints (provider "simple_ntpd")
+ *
+ * Built on sys/sdt.h when the build finds it (ENABLE_USDT). A probe is a
+ * single nop plus an ELF note; with no tracer attached it costs nothing
+ * beyond keeping its arguments in registers. Without sys/sdt.h the macros
+ * expand to nothing and their arguments are not evaluated.
+ *
+ * Arguments must be integers or pointers: pass addresses and ports as
+ * numbers and reasons as string literals, never formatted strings.
+ *
+ *   bpftrace -e 'usdt:/usr/bin/simple-ntpd:simple_ntpd:packet__drop
+ *                { @[str(arg2)] = count(); }'
+ */
+
+#pragma once
+
+#if defined(SIMPLE_NTPD_HAVE_USDT)
+#include <sys/sdt.h>
+#define SIMPLE_NTPD_PROBE3(name, a, b, c) DTRACE_PROBE3(simple_ntpd, name, a, b, c)
+#define SIMPLE_NTPD_PROBE4(name, a, b, c, d) DTRACE_PROBE4(simple_ntpd, name, a, b, c, d)
+#else
+#define SIMPLE_NTPD_PROBE3(name, a, b, c)                                                         \
+  do {                                                                                             \
+  } while (0)
+#define SIMPLE_NTPD_PROBE4(name, a, b, c, d)                                                      \
+  do {                                                                                             \
+  } while (0)
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file bench.cpp
+ * @brief simple-ntpd-bench: NTP load generator and latency benchmark
+ * @author SimpleDaemons
+ * @copyright 2024 SimpleDaemons
+ * @license Apache-2.0
+ */
+
+#include "simple-ntpd/bench/load_generator.hpp"
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace simple_ntpd;
+
+/**
+ * @brief Print usage information
+ */
+void printUsage() {
+  std::cout << "Usage: simple-ntpd-bench [OPTIONS] [ADDRESS[:PORT]]" << std::endl;
+  std::cout << "\nSends NTP client requests to ADDRESS (default 127.0.0.1:123) and reports"
+            << std::endl;
+  std::cout << "throughput, loss, RTT percentiles and malformed replies." << std::endl;
+  std::cout << "\nOptions:" << std::endl;
+  std::cout << "  --help, -h           Show this help message" << std::endl;
+  std::cout << "  --duration, -d SEC   Sending time in seconds (default 5)" << std::endl;
+  std::cout << "  --threads, -t N      Sender threads (default 1)" << std::endl;
+  std::cout << "  --sockets, -s N      Source ports per thread (default 8)" << std::endl;
+  std::cout << "  --sources, -a N      Source addresses from 127.0.0.1 up (default 1)"
+            << std::endl;
+  std::cout << "  --rate, -r N         Requests per second; 0 = unpaced (default 0)"
+            << std::endl;
+  std::cout << "  --window, -w N       Outstanding requests per socket (default 64)"
+            << std::endl;
+  std::cout << "  --batch, -b N        Packets per sendmmsg/recvmmsg (default 32)" << std::endl;
+  std::cout << "  --timeout MS         Wait before a request counts as lost (default 1000)"
+            << std::endl;
+
+  std::cout << "\nExamples:" << std::endl;
+  std::cout << "  simple-ntpd-bench -t 4 -a 64 -d 10 127.0.0.1:123" << std::endl;
+  std::cout << "  simple-ntpd-bench --rate 50000 192.0.2.10" << std::endl;
+}
+
+/**
+ * @brief Parse command line arguments
+ * @return true to run, false to exit with @p exit_code
+ */
+bool parseCommandLine(int argc, char *argv[], LoadOptions &options, int &exit_code) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      exit_code = 0;
+      return false;
+    }
+    if (arg[0] != '-') {
+      const size_t colon = arg.rfind(':');
+      options.target_address = arg.substr(0, colon);
+      if (colon != std::string::npos) {
+        int port = 0;
+        try {
+          size_t used = 0;
+          const std::string text = arg.substr(colon + 1);
+          port = std::stoi(text, &used);
+          if (used != text.size()) {
+            port = 0;
+          }
+        } catch (const std::exception &) {
+          port = 0;
+        }
+        if (port < 1 || port > 65535) {
+          std::cerr << "Error: Invalid port in " << arg << std::endl;
+          return false;
+        }
+        options.target_port = static_cast<uint16_t>(port);
+      }
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Error: " << arg << " requires a value" << std::endl;
+      return false;
+    }
+    const std::string value = argv[++i];
+    try {
+      if (arg == "--duration" || arg == "-d") {
+        options.duration = std::chrono::milliseconds(
+            static_cast<int64_t>(std::stod(value) * 1000.0));
+      } else if (arg == "--threads" || arg == "-t") {
+        options.threads = std::stoul(value);
+      } else if (arg == "--sockets" || arg == "-s") {
+        options.sockets_per_thread = std::stoul(value);
+      } else if (arg == "--sources" || arg == "-a") {
+        options.source_addresses = std::stoul(value);
+      } else if (arg == "--rate" || arg == "-r") {
+        options.rate = std::stoull(value);
+      } else if (arg == "--window" || arg == "-w") {
+        options.window = std::stoul(value);
+      } else if (arg == "--batch" || arg == "-b") {
+        options.batch = std::stoul(value);
+      } else if (arg == "--timeout") {
+        options.timeout = std::chrono::milliseconds(std::stoll(value));
+      } else {
+        std::cerr << "Error: Unknown option: " << arg << std::endl;
+        printUsage();
+        return false;
+      }
+    } catch (const std::exception &) {
+      std::cerr << "Error: Invalid value for " << arg << ": " << value << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Print the run's totals, rates and RTT percentiles
+ */
+void printReport(const LoadResult &result) {
+  const double seconds = result.seconds > 0.0 ? result.seconds : 1.0;
+  const uint64_t valid = result.count(ResponseCheck::VALID);
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "Sent:           " << result.sent << " (" << result.sent / seconds << " req/s)"
+            << std::endl;
+  std::cout << "Received:       " << result.received << std::endl;
+  std::cout << "Valid:          " << valid << " (" << valid / seconds << " resp/s)" << std::endl;
+  std::cout << "Unsynchronized: " << result.count(ResponseCheck::UNSYNCHRONIZED) << std::endl;
+  std::cout << "Kiss-of-death:  " << result.count(ResponseCheck::KISS_OF_DEATH) << std::endl;
+  std::cout << "Invalid:        " << result.invalid();
+  for (size_t i = 0; i < kResponseCheckCount; ++i) {
+    const auto check = static_cast<ResponseCheck>(i);
+    if (result.checks[i] > 0 && check != ResponseCheck::VALID &&
+        check != ResponseCheck::UNSYNCHRONIZED && check != ResponseCheck::KISS_OF_DEATH &&
+        check != ResponseCheck::LATE) {
+      std::cout << " " << responseCheckName(check) << "=" << result.checks[i];
+    }
+  }
+  std::cout << std::endl;
+  std::cout << "Late:           " << result.count(ResponseCheck::LATE) << std::endl;
+  std::cout << std::setprecision(3);
+  std::cout << "Lost:           " << result.lost << " ("
+            << (result.sent > 0 ? 100.0 * result.lost / result.sent : 0.0) << "%)" << std::endl;
+  if (result.send_errors > 0) {
+    std::cout << "Send errors:    " << result.send_errors << std::endl;
+  }
+
+  const LatencyHistogram::Snapshot &rtt = result.rtt;
+  if (rtt.count > 0) {
+    auto us = [&rtt](double quantile) { return rtt.valueAtQuantile(quantile) / 1000.0; };
+    std::cout << std::setprecision(1);
+    std::cout << "RTT (us):       mean " << rtt.sum_ns / 1000.0 / rtt.count << "  p50 "
+              << us(0.5) << "  p90 " << us(0.9) << "  p99 " << us(0.99) << "  p99.9 "
+              << us(0.999) << "  max " << us(1.0) << std::endl;
+  }
+}
+
+/**
+ * @brief Main function
+ * @return 0 if valid replies came back and none was malformed
+ */
+int main(int argc, char *argv[]) {
+  LoadOptions options;
+  int exit_code = 1;
+  if (!parseCommandLine(argc, argv, options, exit_code)) {
+    return exit_code;
+  }
+
+  LoadGenerator generator(options);
+  std::string error;
+  if (!generator.validate(error)) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  std::cout << "Benchmarking " << options.target_address << ":" << options.target_port
+            << " for " << options.duration.count() / 1000.0 << " s: " << options.threads
+            << " threads x " << options.sockets_per_thread << " sockets, "
+            << options.source_addresses << " source addresses, window " << options.window
+            << ", batch " << options.batch << std::endl;
+
+  LoadResult result;
+  if (!generator.run(result, error)) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  printReport(result);
+  return result.count(ResponseCheck::VALID) > 0 && result.invalid() == 0 ? 0 : 1;
+}
@@ -10,6 +10,7 @@
 #include "simple-ntpd/config/config.hpp"
 #include "simple-ntpd/core/server.hpp"
 #include <csignal>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <signal.h>
@@ -23,6 +24,8 @@ std::shared_ptr<NtpServer> g_server;
 Logger *g_logger = nullptr;
 std::atomic<bool> g_shutdown_requested(false);
 static std::string g_startup_command;
+static std::string g_capture_path;
+static std::string g_history_server;
 
 /**
  * @brief Signal handler for graceful shutdown
@@ -74,6 +77,8 @@ void printUsage() {
   std::cout << "  test                 Test server configuration" << std::endl;
   std::cout << "  stats                Show server statistics" << std::endl;
   std::cout << "  connections          List active connections" << std::endl;
+  std::cout << "  capture FILE         Save the daemon's packet capture as pcap" << std::endl;
+  std::cout << "  history [SERVER]     Show clock history, or one upstream's" << std::endl;
 
   std::cout << "\nExamples:" << std::endl;
   std::cout << "  simple-ntpd start --config /etc/simple-ntpd/config.conf"
@@ -194,8 +199,14 @@ bool parseCommandLine(int argc, char *argv[],
       }
       return false;
     } else if (arg[0] != '-') {
-      // This is a command
-      command = arg;
+      // This is a command, the output file of capture or the history server
+      if (command == "capture" && g_capture_path.empty()) {
+        g_capture_path = arg;
+      } else if (command == "history" && g_history_server.empty()) {
+        g_history_server = arg;
+      } else {
+        command = arg;
+      }
     } else {
       std::cerr << "Error: Unknown option: " << arg << std::endl;
       printUsage();
@@ -247,6 +258,16 @@ bool parseCommandLine(int argc, char *argv[],
   } else if (command == "connections") {
     g_startup_command = command;
     return true;
+  } else if (command == "history") {
+    g_startup_command = command;
+    return true;
+  } else if (command == "capture") {
+    if (g_capture_path.empty()) {
+      std::cerr << "Error: capture requires an output file" << std::endl;
+      return false;
+    }
+    g_startup_command = command;
+    return true;
   } else {
     std::cerr << "Error: Unknown command: " << command << std::endl;
     printUsage();
@@ -321,6 +342,72 @@ int main(int argc, char *argv[]) {
     g_logger->info("Starting simple-ntpd v1.0.0");
     g_logger->info("Configuration: " + config->toString());
 
+    // With the control socket enabled, query commands and reload go to the
+    // running daemon rather than to a fresh instance
+    if (config->enable_control_socket &&
+        (g_startup_command == "status" || g_startup_command == "stats" ||
+         g_startup_command == "connections" || g_startup_command == "reload" ||
+         g_startup_command == "metrics" || g_startup_command == "health")) {
+      std::string error;
+      if (!queryControlSocket(config->control_socket_path, g_startup_command, std::cout,
+                              error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+      }
+      return 0;
+    }
+
+    // Like the capture ring, the history only exists inside the running daemon
+    if (g_startup_command == "history") {
+      if (!config->enable_control_socket) {
+        std::cerr << "Error: history needs enable_control_socket" << std::endl;
+        return 1;
+      }
+      const std::string query =
+          g_history_server.empty() ? "history" : "history " + g_history_server;
+      std::string error;
+      if (!queryControlSocket(config->control_socket_path, query, std::cout, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+      }
+      return 0;
+    }
+
+    // The capture ring only exists inside the running daemon
+    if (g_startup_command == "capture") {
+      if (!config->enable_control_socket) {
+        std::cerr << "Error: capture needs enable_control_socket" << std::endl;
+        return 1;
+      }
+      std::ofstream out(g_capture_path, std::ios::binary | std::ios::trunc);
+      if (!out) {
+        std::cerr << "Error: cannot write " << g_capture_path << std::endl;
+        return 1;
+      }
+      std::string error;
+      if (!queryControlSocket(config->control_socket_path, "capture", out, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+      }
+      std::cout << "Wrote " << g_capture_path << std::endl;
+      return 0;
+    }
+
+    // Likewise for metrics and health over the HTTP endpoint
+    if (config->enable_metrics_http &&
+        (g_startup_command == "metrics" || g_startup_command == "health")) {
+      int status = 0;
+      std::string body;
+      if (!fetchMetricsHttp(config->metrics_http_address, config->metrics_http_port,
+                            "/" + g_startup_command, status, body)) {
+        std::cerr << "No daemon answering on " << config->metrics_http_address << ":"
+                  << config->metrics_http_port << std::endl;
+        return 1;
+      }
+      std::cout << body;
+      return status == 200 ? 0 : 1;
+    }
+
     // Initialize signal handlers
     initializeSignalHandlers();
 
@@ -358,14 +445,7 @@ int main(int argc, char *argv[]) {
       g_server->stop();
       return 0;
     } else if (g_startup_command == "stats") {
-      const auto stats = g_server->getStats();
-      std::cout << "NTP Server Statistics:\n";
-      std::cout << "  Total Connections: " << stats.total_connections << "\n";
-      std::cout << "  Active Connections: " << stats.active_connections << "\n";
-      std::cout << "  Total Requests: " << stats.total_requests << "\n";
-      std::cout << "  Total Responses: " << stats.total_responses << "\n";
-      std::cout << "  Total Errors: " << stats.total_errors << "\n";
-      std::cout << "  Bytes Transferred: " << stats.total_bytes_transferred << "\n";
+      std::cout << g_server->getStatsReport();
       g_server->stop();
       return 0;
     } else if (g_startup_command == "connections") {
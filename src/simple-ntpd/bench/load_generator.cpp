@@ -0,0 +1,465 @@
+/**
+ * @file load_generator.cpp
+ * @brief Batched UDP load generator with reply checking and RTT histograms
+ */
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/bench/load_generator.hpp"
+#include "simple-ntpd/core/packet.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace simple_ntpd {
+
+namespace {
+constexpr int kReceiveBufferBytes = 4 * 1024 * 1024;
+// Longest poll() wait while nothing was sent, so pacing stays responsive.
+constexpr int kIdlePollMs = 1;
+
+using Packet = std::array<uint8_t, NTP_PACKET_SIZE>;
+
+int64_t monotonicNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t read64(const uint8_t *data) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+void write64(uint8_t *data, uint64_t value) {
+  for (int i = 7; i >= 0; --i) {
+    data[i] = static_cast<uint8_t>(value);
+    value >>= 8;
+  }
+}
+
+struct Outstanding {
+  uint32_t sequence = 0;
+  bool pending = false;
+  int64_t sent_ns = 0;
+};
+
+// One source port: a connected socket and its window of requests. The
+// cookie's upper half is the socket id, the lower half the sequence.
+struct BenchSocket {
+  int fd = -1;
+  uint32_t id = 0;
+  uint32_t next_sequence = 0;
+  std::vector<Outstanding> slots;
+};
+
+struct ThreadResult {
+  uint64_t sent = 0;
+  uint64_t send_errors = 0;
+  uint64_t received = 0;
+  uint64_t lost = 0;
+  std::array<uint64_t, kResponseCheckCount> checks{};
+  int64_t sending_ns = 0;
+  LatencyHistogram rtt;
+};
+
+// Scratch buffers for one batched send or receive.
+struct Batch {
+  explicit Batch(size_t size) : packets(size), iov(size), lengths(size) {
+#if defined(__linux__)
+    headers.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+      iov[i].iov_base = packets[i].data();
+      iov[i].iov_len = packets[i].size();
+      std::memset(&headers[i], 0, sizeof(headers[i]));
+      headers[i].msg_hdr.msg_iov = &iov[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+  }
+
+  std::vector<Packet> packets;
+  std::vector<struct iovec> iov;
+  std::vector<size_t> lengths;
+#if defined(__linux__)
+  std::vector<struct mmsghdr> headers;
+#endif
+};
+
+// Packets sent from the front of the batch without blocking, or -1 with
+// errno set.
+int sendBatch(int fd, Batch &batch, size_t count) {
+#if defined(__linux__)
+  return sendmmsg(fd, batch.headers.data(), static_cast<unsigned>(count), MSG_DONTWAIT);
+#else
+  size_t sent = 0;
+  for (; sent < count; ++sent) {
+    if (send(fd, batch.packets[sent].data(), batch.packets[sent].size(), MSG_DONTWAIT) < 0) {
+      return sent > 0 ? static_cast<int>(sent) : -1;
+    }
+  }
+  return static_cast<int>(sent);
+#endif
+}
+
+// Datagrams received into the batch without blocking, or -1 with errno set.
+int receiveBatch(int fd, Batch &batch) {
+#if defined(__linux__)
+  for (auto &header : batch.headers) {
+    header.msg_hdr.msg_flags = 0;
+  }
+  const int received = recvmmsg(fd, batch.headers.data(),
+                                static_cast<unsigned>(batch.headers.size()), MSG_DONTWAIT, nullptr);
+  for (int i = 0; i < received; ++i) {
+    batch.lengths[i] = batch.headers[i].msg_len;
+  }
+  return received;
+#else
+  size_t received = 0;
+  for (; received < batch.packets.size(); ++received) {
+    const ssize_t n = recv(fd, batch.packets[received].data(), batch.packets[received].size(),
+                           MSG_DONTWAIT);
+    if (n < 0) {
+      return received > 0 ? static_cast<int>(received) : -1;
+    }
+    batch.lengths[received] = static_cast<size_t>(n);
+  }
+  return static_cast<int>(received);
+#endif
+}
+
+bool isLoopback(const struct in_addr &addr) { return (ntohl(addr.s_addr) >> 24) == 127; }
+
+class Worker {
+public:
+  Worker(const LoadOptions &options, ThreadResult &result, int64_t start_ns)
+      : options_(options), result_(result), start_ns_(start_ns), send_(options.batch),
+        receive_(options.batch) {
+    // Every request is the codec's client request; only the cookie changes.
+    const auto request = NtpPacket::createClientRequest().serializeToData();
+    std::copy_n(request.begin(), request_.size(), request_.begin());
+  }
+
+  ~Worker() {
+    for (auto &sock : sockets_) {
+      if (sock.fd >= 0) {
+        close(sock.fd);
+      }
+    }
+  }
+
+  bool open(size_t first_socket, std::string &error) {
+    struct sockaddr_in target {};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(options_.target_port);
+    inet_pton(AF_INET, options_.target_address.c_str(), &target.sin_addr);
+    for (size_t i = 0; i < options_.sockets_per_thread; ++i) {
+      const size_t index = first_socket + i;
+      BenchSocket sock;
+      sock.id = static_cast<uint32_t>(index + 1); // Never an all-zero cookie
+      sock.slots.resize(options_.window);
+      sock.fd = socket(AF_INET, SOCK_DGRAM, 0);
+      if (sock.fd < 0) {
+        error = "socket: " + std::string(std::strerror(errno));
+        return false;
+      }
+      sockets_.push_back(sock);
+      setsockopt(sock.fd, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferBytes,
+                 sizeof(kReceiveBufferBytes));
+      if (options_.source_addresses > 1) {
+        struct sockaddr_in source {};
+        source.sin_family = AF_INET;
+        source.sin_addr.s_addr =
+            htonl(INADDR_LOOPBACK + static_cast<uint32_t>(index % options_.source_addresses));
+        if (bind(sock.fd, reinterpret_cast<struct sockaddr *>(&source), sizeof(source)) != 0) {
+          error = "bind: " + std::string(std::strerror(errno));
+          return false;
+        }
+      }
+      if (connect(sock.fd, reinterpret_cast<struct sockaddr *>(&target), sizeof(target)) != 0) {
+        error = "connect: " + std::string(std::strerror(errno));
+        return false;
+      }
+    }
+    pollfds_.resize(sockets_.size());
+    for (size_t i = 0; i < sockets_.size(); ++i) {
+      pollfds_[i].fd = sockets_[i].fd;
+      pollfds_[i].events = POLLIN;
+    }
+    return true;
+  }
+
+  void run() {
+    const int64_t deadline = start_ns_ + std::chrono::nanoseconds(options_.duration).count();
+    const int64_t timeout_ns = std::chrono::nanoseconds(options_.timeout).count();
+    const double rate = static_cast<double>(options_.rate) / static_cast<double>(options_.threads);
+    int64_t now = monotonicNs();
+    while (now < deadline + timeout_ns) {
+      bool sent_any = false;
+      if (now < deadline) {
+        for (auto &sock : sockets_) {
+          uint64_t budget = options_.batch;
+          if (rate > 0.0) {
+            const auto allowed =
+                static_cast<uint64_t>(rate * static_cast<double>(now - start_ns_) / 1e9);
+            budget = allowed > result_.sent ? std::min(budget, allowed - result_.sent) : 0;
+          }
+          sent_any |= sendRequests(sock, static_cast<size_t>(budget), now, timeout_ns);
+        }
+        result_.sending_ns = now - start_ns_;
+      } else if (outstanding_ == 0) {
+        break;
+      }
+      poll(pollfds_.data(), pollfds_.size(), sent_any ? 0 : kIdlePollMs);
+      now = monotonicNs();
+      for (size_t i = 0; i < sockets_.size(); ++i) {
+        if ((pollfds_[i].revents & (POLLIN | POLLERR)) != 0) {
+          receiveReplies(sockets_[i], now);
+        }
+      }
+      now = monotonicNs();
+    }
+    for (auto &sock : sockets_) {
+      for (auto &slot : sock.slots) {
+        result_.lost += slot.pending ? 1 : 0;
+      }
+    }
+  }
+
+private:
+  bool sendRequests(BenchSocket &sock, size_t budget, int64_t now, int64_t timeout_ns) {
+    size_t count = 0;
+    while (count < budget) {
+      Outstanding &slot = sock.slots[(sock.next_sequence + count) % sock.slots.size()];
+      if (slot.pending) {
+        // Slots are reused in order, so this is the oldest request.
+        if (now - slot.sent_ns < timeout_ns) {
+          break;
+        }
+        slot.pending = false;
+        --outstanding_;
+        ++result_.lost;
+      }
+      Packet &packet = send_.packets[count];
+      packet = request_;
+      const auto sequence = static_cast<uint32_t>(sock.next_sequence + count);
+      write64(packet.data() + 40, (static_cast<uint64_t>(sock.id) << 32) | sequence);
+      ++count;
+    }
+    if (count == 0) {
+      return false;
+    }
+    const int sent = sendBatch(sock.fd, send_, count);
+    if (sent < 0) {
+      // A full socket buffer just means the window waits; anything else
+      // (ECONNREFUSED from an earlier ICMP unreachable) is reported.
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+        result_.send_errors += count;
+      }
+      return false;
+    }
+    for (int i = 0; i < sent; ++i) {
+      Outstanding &slot = sock.slots[sock.next_sequence % sock.slots.size()];
+      slot.sequence = sock.next_sequence++;
+      slot.pending = true;
+      slot.sent_ns = now;
+    }
+    outstanding_ += static_cast<size_t>(sent);
+    result_.sent += static_cast<uint64_t>(sent);
+    return sent > 0;
+  }
+
+  void receiveReplies(BenchSocket &sock, int64_t now) {
+    for (;;) {
+      const int received = receiveBatch(sock.fd, receive_);
+      if (received <= 0) {
+        return;
+      }
+      for (int i = 0; i < received; ++i) {
+        noteReply(sock, receive_.packets[i].data(), receive_.lengths[i], now);
+      }
+      if (static_cast<size_t>(received) < receive_.packets.size()) {
+        return;
+      }
+    }
+  }
+
+  void noteReply(BenchSocket &sock, const uint8_t *data, size_t length, int64_t now) {
+    ++result_.received;
+    const uint64_t origin = length >= NTP_PACKET_SIZE ? read64(data + 24) : 0;
+    const auto sequence = static_cast<uint32_t>(origin);
+    const bool ours = (origin >> 32) == sock.id;
+    Outstanding &slot = sock.slots[sequence % sock.slots.size()];
+    ResponseCheck check = checkResponse(data, length, origin);
+    if (ours && slot.pending && slot.sequence == sequence) {
+      slot.pending = false;
+      --outstanding_;
+      if (check == ResponseCheck::VALID || check == ResponseCheck::UNSYNCHRONIZED) {
+        result_.rtt.record(static_cast<uint64_t>(now - slot.sent_ns));
+      }
+    } else if (check == ResponseCheck::VALID || check == ResponseCheck::UNSYNCHRONIZED ||
+               check == ResponseCheck::KISS_OF_DEATH) {
+      // Well-formed, but not for a request we are waiting on.
+      check = ours && sequence < sock.next_sequence ? ResponseCheck::LATE
+                                                     : ResponseCheck::BAD_ORIGIN;
+    }
+    ++result_.checks[static_cast<size_t>(check)];
+  }
+
+  const LoadOptions &options_;
+  ThreadResult &result_;
+  int64_t start_ns_;
+  std::vector<BenchSocket> sockets_;
+  std::vector<struct pollfd> pollfds_;
+  size_t outstanding_ = 0;
+  Packet request_{};
+  Batch send_;
+  Batch receive_;
+};
+} // namespace
+
+const char *responseCheckName(ResponseCheck check) {
+  switch (check) {
+  case ResponseCheck::VALID:
+    return "valid";
+  case ResponseCheck::UNSYNCHRONIZED:
+    return "unsynchronized";
+  case ResponseCheck::KISS_OF_DEATH:
+    return "kiss_of_death";
+  case ResponseCheck::SHORT:
+    return "short";
+  case ResponseCheck::BAD_MODE:
+    return "bad_mode";
+  case ResponseCheck::BAD_VERSION:
+    return "bad_version";
+  case ResponseCheck::BAD_ORIGIN:
+    return "bad_origin";
+  case ResponseCheck::BAD_TIMESTAMPS:
+    return "bad_timestamps";
+  case ResponseCheck::LATE:
+    return "late";
+  case ResponseCheck::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+ResponseCheck checkResponse(const uint8_t *data, size_t length, uint64_t request_transmit) {
+  if (length < NTP_PACKET_SIZE) {
+    return ResponseCheck::SHORT;
+  }
+  if ((data[0] & 0x07) != static_cast<uint8_t>(NtpMode::SERVER)) {
+    return ResponseCheck::BAD_MODE;
+  }
+  if (((data[0] >> 3) & 0x07) != NTP_VERSION) {
+    return ResponseCheck::BAD_VERSION;
+  }
+  if (read64(data + 24) != request_transmit) {
+    return ResponseCheck::BAD_ORIGIN;
+  }
+  if (data[1] == 0) {
+    return ResponseCheck::KISS_OF_DEATH;
+  }
+  const uint64_t receive = read64(data + 32);
+  const uint64_t transmit = read64(data + 40);
+  // Signed difference, so the comparison survives the 2036 era rollover.
+  if (receive == 0 || transmit == 0 || static_cast<int64_t>(transmit - receive) < 0) {
+    return ResponseCheck::BAD_TIMESTAMPS;
+  }
+  if ((data[0] >> 6) == 3 || data[1] >= 16) {
+    return ResponseCheck::UNSYNCHRONIZED;
+  }
+  return ResponseCheck::VALID;
+}
+
+uint64_t LoadResult::invalid() const {
+  uint64_t total = 0;
+  for (size_t i = 0; i < kResponseCheckCount; ++i) {
+    const auto check = static_cast<ResponseCheck>(i);
+    if (check != ResponseCheck::VALID && check != ResponseCheck::UNSYNCHRONIZED &&
+        check != ResponseCheck::KISS_OF_DEATH && check != ResponseCheck::LATE) {
+      total += checks[i];
+    }
+  }
+  return total;
+}
+
+LoadGenerator::LoadGenerator(const LoadOptions &options) : options_(options) {}
+
+bool LoadGenerator::validate(std::string &error) const {
+  struct in_addr target {};
+  if (inet_pton(AF_INET, options_.target_address.c_str(), &target) != 1) {
+    error = "target must be an IPv4 address: " + options_.target_address;
+    return false;
+  }
+  if (options_.target_port == 0) {
+    error = "target port must not be 0";
+  } else if (options_.threads < 1 || options_.threads > 256) {
+    error = "threads must be in range 1-256";
+  } else if (options_.sockets_per_thread < 1 || options_.sockets_per_thread > 1024) {
+    error = "sockets per thread must be in range 1-1024";
+  } else if (options_.source_addresses < 1 || options_.source_addresses > 65536) {
+    error = "source addresses must be in range 1-65536";
+  } else if (options_.source_addresses > 1 && !isLoopback(target)) {
+    error = "several source addresses need a loopback (127.0.0.0/8) target";
+  } else if (options_.window < 1 || options_.window > 65536) {
+    error = "window must be in range 1-65536";
+  } else if (options_.batch < 1 || options_.batch > 1024) {
+    error = "batch must be in range 1-1024";
+  } else if (options_.duration.count() <= 0 || options_.timeout.count() <= 0) {
+    error = "duration and timeout must be positive";
+  } else {
+    return true;
+  }
+  return false;
+}
+
+bool LoadGenerator::run(LoadResult &result, std::string &error) {
+  if (!validate(error)) {
+    return false;
+  }
+  std::vector<ThreadResult> results(options_.threads);
+  std::vector<std::unique_ptr<Worker>> workers;
+  const int64_t start_ns = monotonicNs();
+  for (size_t t = 0; t < options_.threads; ++t) {
+    workers.push_back(std::make_unique<Worker>(options_, results[t], start_ns));
+    if (!workers.back()->open(t * options_.sockets_per_thread, error)) {
+      return false;
+    }
+  }
+  std::vector<std::thread> threads;
+  for (auto &worker : workers) {
+    threads.emplace_back([&worker] { worker->run(); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  result = LoadResult{};
+  int64_t sending_ns = 0;
+  for (const ThreadResult &r : results) {
+    result.sent += r.sent;
+    result.send_errors += r.send_errors;
+    result.received += r.received;
+    result.lost += r.lost;
+    for (size_t i = 0; i < kResponseCheckCount; ++i) {
+      result.checks[i] += r.checks[i];
+    }
+    result.rtt.merge(r.rtt.snapshot());
+    sending_ns = std::max(sending_ns, r.sending_ns);
+  }
+  result.seconds = static_cast<double>(sending_ns) / 1e9;
+  return true;
+}
+
+} // namespace simple_ntpd
@@ -7,6 +7,7 @@
  */
 
 #include "simple-ntpd/config/config.hpp"
+#include "simple-ntpd/utils/net.hpp"
 #include <algorithm>
 #include <cctype>
 #include <cstdlib>
@@ -16,6 +17,23 @@
 
 namespace simple_ntpd {
 
+namespace {
+// Parse a comma-separated list, trimming whitespace and dropping empties.
+std::vector<std::string> splitCommaList(const std::string &value) {
+  std::vector<std::string> items;
+  std::stringstream ss(value);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    item.erase(0, item.find_first_not_of(" \t"));
+    item.erase(item.find_last_not_of(" \t") + 1);
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+} // namespace
+
 // NtpConfig implementation
 NtpConfig::NtpConfig() { setDefaults(); }
 
@@ -29,8 +47,15 @@ void NtpConfig::setDefaults() {
   reference_clock = "LOCAL";
   reference_id = "LOCL";
   upstream_servers = {"pool.ntp.org", "time.nist.gov"};
+  upstream_pools.clear();
+  peers.clear();
+  max_pool_associations = 4;
+  dns_cache_ttl = std::chrono::seconds(3600);
   sync_interval = std::chrono::seconds(64);
+  min_poll = 6;
+  max_poll = 10;
   timeout = std::chrono::milliseconds(1000);
+  enable_iburst = true;
 
   log_level = LogLevel::INFO;
   log_file = "/var/log/simple-ntpd/simple-ntpd.log";
@@ -68,9 +93,11 @@ void NtpConfig::setDefaults() {
 
   drift_file = "/var/lib/simple-ntpd/drift";
   enable_drift_compensation = true;
+  system_clock_discipline = SystemClockDiscipline::NONE;
 
   leap_second_file = "/var/lib/simple-ntpd/leap-seconds.list";
   enable_leap_second_handling = true;
+  leap_smear_interval = 0;
 
   enable_automatic_failover = false;
   enable_self_healing = false;
@@ -87,6 +114,35 @@ void NtpConfig::setDefaults() {
   enable_dynamic_stratum_adjustment = false;
   enable_reference_clock_support = false;
   reference_clock_source = "local";
+  reference_clock_shm_unit = 0;
+  reference_clock_refid = "SHM";
+  enable_broadcast = false;
+  broadcast_address = "224.0.1.1";
+  broadcast_interval = std::chrono::seconds(64);
+  broadcast_ttl = 1;
+  broadcast_key_id = 0;
+  enable_roughtime = false;
+  roughtime_port = 2002;
+  roughtime_key_file = "";
+  roughtime_batch_size = 64;
+  roughtime_batch_window = std::chrono::milliseconds(5);
+  roughtime_key_lifetime = std::chrono::seconds(86400);
+  enable_metrics_http = false;
+  metrics_http_address = "127.0.0.1";
+  metrics_http_port = 9560;
+  metrics_http_cache_interval = std::chrono::milliseconds(1000);
+  enable_control_socket = false;
+  control_socket_path = "/run/simple-ntpd/control.sock";
+  enable_stats_segment = false;
+  stats_segment_path = "/run/simple-ntpd/stats";
+  stats_segment_interval = std::chrono::milliseconds(1000);
+  enable_stage_accounting = false;
+  enable_packet_capture = false;
+  capture_ring_size = 4096;
+  capture_sample_every = 1;
+  capture_drops_only = false;
+  capture_client_prefix = "";
+  clock_history_hours = 24;
 }
 
 bool NtpConfig::loadFromFile(const std::string &config_file) {
@@ -117,6 +173,41 @@ bool NtpConfig::loadFromCommandLine(int argc, char *argv[]) {
   return true;
 }
 
+bool NtpConfig::hasSyncSources() const {
+  std::string source = reference_clock_source;
+  std::transform(source.begin(), source.end(), source.begin(), ::tolower);
+  return !upstream_servers.empty() || !upstream_pools.empty() || !peers.empty() ||
+         (enable_reference_clock_support && source == "shm");
+}
+
+bool NtpConfig::parseSystemClockDiscipline(const std::string &value,
+                                           SystemClockDiscipline &mode) {
+  std::string name = value;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  if (name == "kernel") {
+    mode = SystemClockDiscipline::KERNEL;
+  } else if (name == "dry_run" || name == "dry-run") {
+    mode = SystemClockDiscipline::DRY_RUN;
+  } else if (name == "none") {
+    mode = SystemClockDiscipline::NONE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *NtpConfig::systemClockDisciplineName(SystemClockDiscipline mode) {
+  switch (mode) {
+  case SystemClockDiscipline::KERNEL:
+    return "kernel";
+  case SystemClockDiscipline::DRY_RUN:
+    return "dry_run";
+  case SystemClockDiscipline::NONE:
+  default:
+    return "none";
+  }
+}
+
 bool NtpConfig::validate() const {
   std::vector<std::string> errors;
   return validateDetailed(errors);
@@ -149,10 +240,25 @@ bool NtpConfig::validateDetailed(std::vector<std::string> &errors) const {
     errors.push_back("sync_interval must be in range 1-86400 seconds");
   }
 
+  if (min_poll < 0 || min_poll > 17 || max_poll < 0 || max_poll > 17) {
+    errors.push_back("min_poll and max_poll must be in range 0-17");
+  } else if (min_poll > max_poll) {
+    errors.push_back("min_poll must not exceed max_poll");
+  }
+
   if (timeout.count() < 10 || timeout.count() > 60000) {
     errors.push_back("timeout must be in range 10-60000 milliseconds");
   }
 
+  if (!upstream_pools.empty() &&
+      (max_pool_associations < 1 || max_pool_associations > 16)) {
+    errors.push_back("max_pool_associations must be in range 1-16");
+  }
+
+  if (dns_cache_ttl.count() < 1 || dns_cache_ttl.count() > 86400) {
+    errors.push_back("dns_cache_ttl must be in range 1-86400 seconds");
+  }
+
   if (stats_interval.count() < 1 || stats_interval.count() > 3600) {
     errors.push_back("stats_interval must be in range 1-3600 seconds");
   }
@@ -160,6 +266,91 @@ bool NtpConfig::validateDetailed(std::vector<std::string> &errors) const {
   if (reference_id.size() != 4) {
     errors.push_back("reference_id must be exactly 4 characters");
   }
+  if (reference_clock_shm_unit < 0 || reference_clock_shm_unit > 255) {
+    errors.push_back("reference_clock_shm_unit must be in range 0-255");
+  }
+  if (reference_clock_refid.empty() || reference_clock_refid.size() > 4) {
+    errors.push_back("reference_clock_refid must be 1-4 characters");
+  }
+
+  if (enable_broadcast) {
+    if (broadcast_address.empty()) {
+      errors.push_back("broadcast_address is required when enable_broadcast=true");
+    }
+    if (broadcast_interval.count() < 1 || broadcast_interval.count() > 86400) {
+      errors.push_back("broadcast_interval must be in range 1-86400 seconds");
+    }
+    if (broadcast_ttl < 1 || broadcast_ttl > 255) {
+      errors.push_back("broadcast_ttl must be in range 1-255");
+    }
+    if (broadcast_key_id != 0 && (authentication_algorithm == AuthAlgorithm::NONE ||
+                                  authentication_keys.count(broadcast_key_id) == 0)) {
+      errors.push_back("broadcast_key_id needs an authentication_keys entry and an "
+                       "authentication_algorithm");
+    }
+  }
+
+  if (enable_roughtime) {
+    if (roughtime_port == 0 || roughtime_port == listen_port) {
+      errors.push_back("roughtime_port must be non-zero and differ from listen_port");
+    }
+    if (roughtime_batch_size < 1 || roughtime_batch_size > 1024) {
+      errors.push_back("roughtime_batch_size must be in range 1-1024");
+    }
+    if (roughtime_batch_window.count() < 0 || roughtime_batch_window.count() > 1000) {
+      errors.push_back("roughtime_batch_window must be in range 0-1000 milliseconds");
+    }
+    if (roughtime_key_lifetime.count() < 60 || roughtime_key_lifetime.count() > 2592000) {
+      errors.push_back("roughtime_key_lifetime must be in range 60-2592000 seconds");
+    }
+  }
+
+  if (enable_metrics_http) {
+    struct in_addr addr {};
+    if (inet_pton(AF_INET, metrics_http_address.c_str(), &addr) != 1) {
+      errors.push_back("metrics_http_address must be an IPv4 address");
+    }
+    if (metrics_http_port == 0) {
+      errors.push_back("metrics_http_port must be non-zero");
+    }
+    if (metrics_http_cache_interval.count() < 0 ||
+        metrics_http_cache_interval.count() > 60000) {
+      errors.push_back("metrics_http_cache_interval must be in range 0-60000 milliseconds");
+    }
+  }
+
+  // sun_path holds 108 bytes including the terminating NUL on Linux
+  if (enable_control_socket && (control_socket_path.empty() || control_socket_path.size() > 107)) {
+    errors.push_back("control_socket_path must be set and at most 107 characters");
+  }
+
+  if (enable_stats_segment) {
+    if (stats_segment_path.empty()) {
+      errors.push_back("stats_segment_path is required when enable_stats_segment=true");
+    }
+    if (stats_segment_interval.count() < 10 || stats_segment_interval.count() > 60000) {
+      errors.push_back("stats_segment_interval must be in range 10-60000 milliseconds");
+    }
+  }
+
+  if (enable_packet_capture) {
+    if (capture_ring_size < 16 || capture_ring_size > 1048576) {
+      errors.push_back("capture_ring_size must be in range 16-1048576");
+    }
+    if (capture_sample_every < 1 || capture_sample_every > 1000000) {
+      errors.push_back("capture_sample_every must be in range 1-1000000");
+    }
+    uint32_t network = 0;
+    uint32_t mask = 0;
+    if (!capture_client_prefix.empty() &&
+        !parseIpv4Cidr(capture_client_prefix, network, mask)) {
+      errors.push_back("capture_client_prefix must be an IPv4 address or CIDR prefix");
+    }
+  }
+
+  if (clock_history_hours < 0 || clock_history_hours > 168) {
+    errors.push_back("clock_history_hours must be in range 0-168");
+  }
 
   if (log_max_size_bytes > 0 && log_max_size_bytes < 1024) {
     errors.push_back("log_max_size_bytes must be 0 or >= 1024");
@@ -177,9 +368,18 @@ bool NtpConfig::validateDetailed(std::vector<std::string> &errors) const {
     errors.push_back("authentication_key set while enable_authentication=false");
   }
 
+#ifndef __linux__
+  if (system_clock_discipline == SystemClockDiscipline::KERNEL) {
+    errors.push_back("system_clock_discipline=kernel is only supported on Linux");
+  }
+#endif
+
   if (enable_leap_second_handling && leap_second_file.empty()) {
     errors.push_back("leap_second_file is required when enable_leap_second_handling=true");
   }
+  if (leap_smear_interval < 0 || leap_smear_interval > 172800) {
+    errors.push_back("leap_smear_interval must be in range 0-172800 seconds");
+  }
 
   if (enable_statistics && stats_interval.count() <= 0) {
     errors.push_back("stats_interval must be > 0 when enable_statistics=true");
@@ -247,6 +447,8 @@ std::string NtpConfig::toString() const {
   ss << "  Statistics: " << (enable_statistics ? "Yes" : "No") << "\n";
   ss << "  Drift Compensation: " << (enable_drift_compensation ? "Yes" : "No")
      << "\n";
+  ss << "  System Clock Discipline: " << systemClockDisciplineName(system_clock_discipline)
+     << "\n";
   ss << "  Leap Second Handling: "
      << (enable_leap_second_handling ? "Yes" : "No") << "\n";
   ss << "  Automatic Failover: " << (enable_automatic_failover ? "Yes" : "No") << "\n";
@@ -341,17 +543,24 @@ bool NtpConfig::parseCommandLineArg(const std::string &key,
   } else if (lower_key == "reference_id" || lower_key == "ref_id") {
     reference_id = value;
   } else if (lower_key == "upstream_servers" || lower_key == "servers") {
-    // Parse comma-separated list
-    std::stringstream ss(value);
-    std::string server;
-    upstream_servers.clear();
-    while (std::getline(ss, server, ',')) {
-      // Remove whitespace
-      server.erase(0, server.find_first_not_of(" \t"));
-      server.erase(server.find_last_not_of(" \t") + 1);
-      if (!server.empty()) {
-        upstream_servers.push_back(server);
-      }
+    upstream_servers = splitCommaList(value);
+  } else if (lower_key == "enable_iburst" || lower_key == "iburst") {
+    enable_iburst = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "upstream_pools" || lower_key == "pools") {
+    upstream_pools = splitCommaList(value);
+  } else if (lower_key == "peers" || lower_key == "peer") {
+    peers = splitCommaList(value);
+  } else if (lower_key == "max_pool_associations" || lower_key == "pool_max_sources") {
+    try {
+      max_pool_associations = static_cast<uint32_t>(std::stoul(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "dns_cache_ttl") {
+    try {
+      dns_cache_ttl = std::chrono::seconds(std::stoll(value));
+    } catch (const std::exception &) {
+      return false;
     }
   } else if (lower_key == "sync_interval") {
     try {
@@ -360,6 +569,18 @@ bool NtpConfig::parseCommandLineArg(const std::string &key,
     } catch (const std::exception &) {
       return false;
     }
+  } else if (lower_key == "min_poll" || lower_key == "minpoll") {
+    try {
+      min_poll = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "max_poll" || lower_key == "maxpoll") {
+    try {
+      max_poll = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
   } else if (lower_key == "timeout") {
     try {
       int ms = std::stoi(value);
@@ -522,12 +743,20 @@ bool NtpConfig::parseCommandLineArg(const std::string &key,
              lower_key == "drift_comp") {
     enable_drift_compensation =
         (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "system_clock_discipline" || lower_key == "clock_discipline") {
+    return parseSystemClockDiscipline(value, system_clock_discipline);
   } else if (lower_key == "leap_second_file" || lower_key == "leap_seconds") {
     leap_second_file = value;
   } else if (lower_key == "enable_leap_second_handling" ||
              lower_key == "leap_handling") {
     enable_leap_second_handling =
         (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "leap_smear_interval" || lower_key == "leapsmearinterval") {
+    try {
+      leap_smear_interval = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
   } else if (lower_key == "enable_automatic_failover" || lower_key == "auto_failover") {
     enable_automatic_failover = (value == "true" || value == "1" || value == "yes");
   } else if (lower_key == "enable_self_healing" || lower_key == "self_healing") {
@@ -576,6 +805,120 @@ bool NtpConfig::parseCommandLineArg(const std::string &key,
     enable_reference_clock_support = (value == "true" || value == "1" || value == "yes");
   } else if (lower_key == "reference_clock_source") {
     reference_clock_source = value;
+  } else if (lower_key == "reference_clock_shm_unit") {
+    try {
+      reference_clock_shm_unit = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "reference_clock_refid") {
+    reference_clock_refid = value;
+  } else if (lower_key == "enable_broadcast" || lower_key == "broadcast") {
+    enable_broadcast = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "broadcast_address") {
+    broadcast_address = value;
+  } else if (lower_key == "broadcast_interval") {
+    try {
+      broadcast_interval = std::chrono::seconds(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "broadcast_ttl") {
+    try {
+      broadcast_ttl = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "broadcast_key_id" || lower_key == "broadcast_key") {
+    try {
+      broadcast_key_id = static_cast<uint32_t>(std::stoul(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "enable_roughtime" || lower_key == "roughtime") {
+    enable_roughtime = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "roughtime_port") {
+    try {
+      roughtime_port = static_cast<port_t>(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "roughtime_key_file") {
+    roughtime_key_file = value;
+  } else if (lower_key == "roughtime_batch_size") {
+    try {
+      roughtime_batch_size = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "roughtime_batch_window") {
+    try {
+      roughtime_batch_window = std::chrono::milliseconds(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "roughtime_key_lifetime") {
+    try {
+      roughtime_key_lifetime = std::chrono::seconds(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "enable_metrics_http" || lower_key == "metrics_http") {
+    enable_metrics_http = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "metrics_http_address") {
+    metrics_http_address = value;
+  } else if (lower_key == "metrics_http_port") {
+    try {
+      metrics_http_port = static_cast<port_t>(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "metrics_http_cache_interval") {
+    try {
+      metrics_http_cache_interval = std::chrono::milliseconds(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "enable_control_socket" || lower_key == "control_socket") {
+    enable_control_socket = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "control_socket_path") {
+    control_socket_path = value;
+  } else if (lower_key == "enable_stats_segment" || lower_key == "stats_segment") {
+    enable_stats_segment = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "stats_segment_path") {
+    stats_segment_path = value;
+  } else if (lower_key == "stats_segment_interval") {
+    try {
+      stats_segment_interval = std::chrono::milliseconds(std::stoi(value));
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "enable_stage_accounting" || lower_key == "stage_accounting") {
+    enable_stage_accounting = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "enable_packet_capture" || lower_key == "packet_capture") {
+    enable_packet_capture = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "capture_ring_size") {
+    try {
+      capture_ring_size = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "capture_sample_every") {
+    try {
+      capture_sample_every = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
+  } else if (lower_key == "capture_drops_only") {
+    capture_drops_only = (value == "true" || value == "1" || value == "yes");
+  } else if (lower_key == "capture_client_prefix") {
+    capture_client_prefix = value;
+  } else if (lower_key == "clock_history_hours") {
+    try {
+      clock_history_hours = std::stoi(value);
+    } catch (const std::exception &) {
+      return false;
+    }
   }
 
   return true;
@@ -633,6 +976,27 @@ void NtpConfig::applyEnvironmentOverrides() {
       }
     }
   }
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_UPSTREAM_POOLS");
+    if (v) {
+      upstream_pools = splitCommaList(v);
+    }
+  }
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_PEERS");
+    if (v) {
+      peers = splitCommaList(v);
+    }
+  }
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_DNS_CACHE_TTL_SEC");
+    if (v) {
+      try {
+        dns_cache_ttl = std::chrono::seconds(std::stoll(v));
+      } catch (const std::exception &) {
+      }
+    }
+  }
   {
     const char *v = std::getenv("SIMPLE_NTPD_SYNC_INTERVAL_SEC");
     if (v) {
@@ -675,8 +1039,19 @@ void NtpConfig::applyEnvironmentOverrides() {
   apply_string("SIMPLE_NTPD_TLS_CERT_FILE", tls_cert_file);
   apply_string("SIMPLE_NTPD_TLS_KEY_FILE", tls_key_file);
   apply_string("SIMPLE_NTPD_TLS_CA_FILE", tls_ca_file);
+  apply_bool("SIMPLE_NTPD_ENABLE_IBURST", enable_iburst);
+  apply_int("SIMPLE_NTPD_MIN_POLL", min_poll);
+  apply_int("SIMPLE_NTPD_MAX_POLL", max_poll);
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_SYSTEM_CLOCK_DISCIPLINE");
+    if (v) {
+      // Same names as the config file; anything else is ignored.
+      parseSystemClockDiscipline(v, system_clock_discipline);
+    }
+  }
   apply_bool("SIMPLE_NTPD_ENABLE_LEAP_SECOND_HANDLING", enable_leap_second_handling);
   apply_string("SIMPLE_NTPD_LEAP_SECOND_FILE", leap_second_file);
+  apply_int("SIMPLE_NTPD_LEAP_SMEAR_INTERVAL", leap_smear_interval);
   apply_bool("SIMPLE_NTPD_ENABLE_AUTO_FAILOVER", enable_automatic_failover);
   apply_bool("SIMPLE_NTPD_ENABLE_SELF_HEALING", enable_self_healing);
   apply_bool("SIMPLE_NTPD_ENABLE_GRACEFUL_DEGRADATION", enable_graceful_degradation);
@@ -691,6 +1066,75 @@ void NtpConfig::applyEnvironmentOverrides() {
   apply_bool("SIMPLE_NTPD_ENABLE_DYNAMIC_STRATUM", enable_dynamic_stratum_adjustment);
   apply_bool("SIMPLE_NTPD_ENABLE_REFERENCE_CLOCK_SUPPORT", enable_reference_clock_support);
   apply_string("SIMPLE_NTPD_REFERENCE_CLOCK_SOURCE", reference_clock_source);
+  apply_int("SIMPLE_NTPD_REFERENCE_CLOCK_SHM_UNIT", reference_clock_shm_unit);
+  apply_string("SIMPLE_NTPD_REFERENCE_CLOCK_REFID", reference_clock_refid);
+  apply_bool("SIMPLE_NTPD_ENABLE_BROADCAST", enable_broadcast);
+  apply_string("SIMPLE_NTPD_BROADCAST_ADDRESS", broadcast_address);
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_BROADCAST_INTERVAL_SEC");
+    if (v) {
+      try {
+        broadcast_interval = std::chrono::seconds(std::stoll(v));
+      } catch (const std::exception &) {
+      }
+    }
+  }
+  apply_int("SIMPLE_NTPD_BROADCAST_TTL", broadcast_ttl);
+  apply_int("SIMPLE_NTPD_BROADCAST_KEY_ID", broadcast_key_id);
+  apply_bool("SIMPLE_NTPD_ENABLE_ROUGHTIME", enable_roughtime);
+  apply_int("SIMPLE_NTPD_ROUGHTIME_PORT", roughtime_port);
+  apply_string("SIMPLE_NTPD_ROUGHTIME_KEY_FILE", roughtime_key_file);
+  apply_int("SIMPLE_NTPD_ROUGHTIME_BATCH_SIZE", roughtime_batch_size);
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_ROUGHTIME_BATCH_WINDOW_MS");
+    if (v) {
+      try {
+        roughtime_batch_window = std::chrono::milliseconds(std::stoll(v));
+      } catch (const std::exception &) {
+      }
+    }
+  }
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_ROUGHTIME_KEY_LIFETIME_SEC");
+    if (v) {
+      try {
+        roughtime_key_lifetime = std::chrono::seconds(std::stoll(v));
+      } catch (const std::exception &) {
+      }
+    }
+  }
+  apply_bool("SIMPLE_NTPD_ENABLE_METRICS_HTTP", enable_metrics_http);
+  apply_string("SIMPLE_NTPD_METRICS_HTTP_ADDRESS", metrics_http_address);
+  apply_int("SIMPLE_NTPD_METRICS_HTTP_PORT", metrics_http_port);
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_METRICS_HTTP_CACHE_INTERVAL_MS");
+    if (v) {
+      try {
+        metrics_http_cache_interval = std::chrono::milliseconds(std::stoll(v));
+      } catch (const std::exception &) {
+      }
+    }
+  }
+  apply_bool("SIMPLE_NTPD_ENABLE_CONTROL_SOCKET", enable_control_socket);
+  apply_string("SIMPLE_NTPD_CONTROL_SOCKET_PATH", control_socket_path);
+  apply_bool("SIMPLE_NTPD_ENABLE_STATS_SEGMENT", enable_stats_segment);
+  apply_string("SIMPLE_NTPD_STATS_SEGMENT_PATH", stats_segment_path);
+  {
+    const char *v = std::getenv("SIMPLE_NTPD_STATS_SEGMENT_INTERVAL_MS");
+    if (v) {
+      try {
+        stats_segment_interval = std::chrono::milliseconds(std::stoll(v));
+      } catch (const std::exception &) {
+      }
+    }
+  }
+  apply_bool("SIMPLE_NTPD_ENABLE_STAGE_ACCOUNTING", enable_stage_accounting);
+  apply_bool("SIMPLE_NTPD_ENABLE_PACKET_CAPTURE", enable_packet_capture);
+  apply_int("SIMPLE_NTPD_CAPTURE_RING_SIZE", capture_ring_size);
+  apply_int("SIMPLE_NTPD_CAPTURE_SAMPLE_EVERY", capture_sample_every);
+  apply_bool("SIMPLE_NTPD_CAPTURE_DROPS_ONLY", capture_drops_only);
+  apply_string("SIMPLE_NTPD_CAPTURE_CLIENT_PREFIX", capture_client_prefix);
+  apply_int("SIMPLE_NTPD_CLOCK_HISTORY_HOURS", clock_history_hours);
 }
 
 bool NtpConfig::parseAuthenticationKeySpec(const std::string &spec) {
@@ -49,11 +49,37 @@ bool ConfigParser::parseKeyValue(const std::string &key, const std::string &valu
     config.reference_id = value;
   } else if (lower_key == "upstream_servers" || lower_key == "servers") {
     config.upstream_servers = parseList(value);
+  } else if (lower_key == "enable_iburst" || lower_key == "iburst") {
+    config.enable_iburst = stringToBool(value);
+  } else if (lower_key == "upstream_pools" || lower_key == "pools") {
+    config.upstream_pools = parseList(value);
+  } else if (lower_key == "peers" || lower_key == "peer") {
+    config.peers = parseList(value);
+  } else if (lower_key == "max_pool_associations" || lower_key == "pool_max_sources") {
+    unsigned int v;
+    if (stringToUInt(value, v)) {
+      config.max_pool_associations = v;
+    }
+  } else if (lower_key == "dns_cache_ttl") {
+    int seconds;
+    if (stringToInt(value, seconds)) {
+      config.dns_cache_ttl = std::chrono::seconds(seconds);
+    }
   } else if (lower_key == "sync_interval") {
     int seconds;
     if (stringToInt(value, seconds)) {
       config.sync_interval = std::chrono::seconds(seconds);
     }
+  } else if (lower_key == "min_poll" || lower_key == "minpoll") {
+    int exponent;
+    if (stringToInt(value, exponent)) {
+      config.min_poll = exponent;
+    }
+  } else if (lower_key == "max_poll" || lower_key == "maxpoll") {
+    int exponent;
+    if (stringToInt(value, exponent)) {
+      config.max_poll = exponent;
+    }
   } else if (lower_key == "timeout") {
     int ms;
     if (stringToInt(value, ms)) {
@@ -148,10 +174,17 @@ bool ConfigParser::parseKeyValue(const std::string &key, const std::string &valu
     config.drift_file = value;
   } else if (lower_key == "enable_drift_compensation" || lower_key == "drift_comp") {
     config.enable_drift_compensation = stringToBool(value);
+  } else if (lower_key == "system_clock_discipline" || lower_key == "clock_discipline") {
+    return NtpConfig::parseSystemClockDiscipline(value, config.system_clock_discipline);
   } else if (lower_key == "leap_second_file" || lower_key == "leap_seconds") {
     config.leap_second_file = value;
   } else if (lower_key == "enable_leap_second_handling" || lower_key == "leap_handling") {
     config.enable_leap_second_handling = stringToBool(value);
+  } else if (lower_key == "leap_smear_interval" || lower_key == "leapsmearinterval") {
+    int seconds;
+    if (stringToInt(value, seconds)) {
+      config.leap_smear_interval = seconds;
+    }
   } else if (lower_key == "enable_automatic_failover" || lower_key == "auto_failover") {
     config.enable_automatic_failover = stringToBool(value);
   } else if (lower_key == "enable_self_healing" || lower_key == "self_healing") {
@@ -189,6 +222,106 @@ bool ConfigParser::parseKeyValue(const std::string &key, const std::string &valu
     config.enable_reference_clock_support = stringToBool(value);
   } else if (lower_key == "reference_clock_source") {
     config.reference_clock_source = value;
+  } else if (lower_key == "reference_clock_shm_unit") {
+    int unit;
+    if (stringToInt(value, unit)) {
+      config.reference_clock_shm_unit = unit;
+    }
+  } else if (lower_key == "reference_clock_refid") {
+    config.reference_clock_refid = value;
+  } else if (lower_key == "enable_broadcast" || lower_key == "broadcast") {
+    config.enable_broadcast = stringToBool(value);
+  } else if (lower_key == "broadcast_address") {
+    config.broadcast_address = value;
+  } else if (lower_key == "broadcast_interval") {
+    int seconds;
+    if (stringToInt(value, seconds)) {
+      config.broadcast_interval = std::chrono::seconds(seconds);
+    }
+  } else if (lower_key == "broadcast_ttl") {
+    int ttl;
+    if (stringToInt(value, ttl)) {
+      config.broadcast_ttl = ttl;
+    }
+  } else if (lower_key == "broadcast_key_id" || lower_key == "broadcast_key") {
+    unsigned int key_id;
+    if (stringToUInt(value, key_id)) {
+      config.broadcast_key_id = key_id;
+    }
+  } else if (lower_key == "enable_roughtime" || lower_key == "roughtime") {
+    config.enable_roughtime = stringToBool(value);
+  } else if (lower_key == "roughtime_port") {
+    int port;
+    if (stringToInt(value, port)) {
+      config.roughtime_port = static_cast<port_t>(port);
+    }
+  } else if (lower_key == "roughtime_key_file") {
+    config.roughtime_key_file = value;
+  } else if (lower_key == "roughtime_batch_size") {
+    int size;
+    if (stringToInt(value, size)) {
+      config.roughtime_batch_size = size;
+    }
+  } else if (lower_key == "roughtime_batch_window") {
+    int ms;
+    if (stringToInt(value, ms)) {
+      config.roughtime_batch_window = std::chrono::milliseconds(ms);
+    }
+  } else if (lower_key == "roughtime_key_lifetime") {
+    int seconds;
+    if (stringToInt(value, seconds)) {
+      config.roughtime_key_lifetime = std::chrono::seconds(seconds);
+    }
+  } else if (lower_key == "enable_metrics_http" || lower_key == "metrics_http") {
+    config.enable_metrics_http = stringToBool(value);
+  } else if (lower_key == "metrics_http_address") {
+    config.metrics_http_address = value;
+  } else if (lower_key == "metrics_http_port") {
+    int port;
+    if (stringToInt(value, port)) {
+      config.metrics_http_port = static_cast<port_t>(port);
+    }
+  } else if (lower_key == "metrics_http_cache_interval") {
+    int ms;
+    if (stringToInt(value, ms)) {
+      config.metrics_http_cache_interval = std::chrono::milliseconds(ms);
+    }
+  } else if (lower_key == "enable_control_socket" || lower_key == "control_socket") {
+    config.enable_control_socket = stringToBool(value);
+  } else if (lower_key == "control_socket_path") {
+    config.control_socket_path = value;
+  } else if (lower_key == "enable_stats_segment" || lower_key == "stats_segment") {
+    config.enable_stats_segment = stringToBool(value);
+  } else if (lower_key == "stats_segment_path") {
+    config.stats_segment_path = value;
+  } else if (lower_key == "stats_segment_interval") {
+    int ms;
+    if (stringToInt(value, ms)) {
+      config.stats_segment_interval = std::chrono::milliseconds(ms);
+    }
+  } else if (lower_key == "enable_stage_accounting" || lower_key == "stage_accounting") {
+    config.enable_stage_accounting = stringToBool(value);
+  } else if (lower_key == "enable_packet_capture" || lower_key == "packet_capture") {
+    config.enable_packet_capture = stringToBool(value);
+  } else if (lower_key == "capture_ring_size") {
+    int size;
+    if (stringToInt(value, size)) {
+      config.capture_ring_size = size;
+    }
+  } else if (lower_key == "capture_sample_every") {
+    int every;
+    if (stringToInt(value, every)) {
+      config.capture_sample_every = every;
+    }
+  } else if (lower_key == "capture_drops_only") {
+    config.capture_drops_only = stringToBool(value);
+  } else if (lower_key == "capture_client_prefix") {
+    config.capture_client_prefix = value;
+  } else if (lower_key == "clock_history_hours") {
+    int hours;
+    if (stringToInt(value, hours)) {
+      config.clock_history_hours = hours;
+    }
   } else {
     // Unknown key, ignore
     return false;
@@ -0,0 +1,212 @@
+/**
+ * @file capture.cpp
+ * @brief Sampled packet capture ring and pcap export
+ */
+
+#include <arpa/inet.h>
+
+#include "simple-ntpd/core/capture.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+namespace simple_ntpd {
+
+static_assert(std::is_trivially_copyable_v<CapturedExchange>, "ring slots hold raw copies");
+
+namespace {
+constexpr size_t kWords = (sizeof(CapturedExchange) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+// A reader that keeps catching one slot mid-write moves on without it.
+constexpr unsigned kReadAttempts = 4;
+
+constexpr uint32_t kPcapMagicNanoseconds = 0xa1b23c4d;
+constexpr uint32_t kLinkTypeRaw = 101; // Bare IPv4 packets
+constexpr size_t kHeadersSize = 20 + 8; // IPv4 + UDP
+
+template <typename T> void put(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+uint16_t ipv4Checksum(const uint8_t *header) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < 20; i += 2) {
+    sum += static_cast<uint32_t>(header[i] << 8 | header[i + 1]);
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return static_cast<uint16_t>(~sum);
+}
+
+// One pcap record: IPv4 and UDP headers built around the NTP payload.
+void writePacket(std::string &out, int64_t unix_ns, uint32_t src_addr, uint16_t src_port,
+                 uint32_t dst_addr, uint16_t dst_port, const uint8_t *payload, size_t length,
+                 uint16_t id) {
+  const size_t kept = std::min(length, CapturedExchange::kMaxBytes);
+  put(out, static_cast<uint32_t>(unix_ns / 1000000000));
+  put(out, static_cast<uint32_t>(unix_ns % 1000000000));
+  put(out, static_cast<uint32_t>(kHeadersSize + kept));
+  put(out, static_cast<uint32_t>(kHeadersSize + length));
+
+  uint8_t headers[kHeadersSize] = {};
+  const uint16_t total = static_cast<uint16_t>(kHeadersSize + length);
+  headers[0] = 0x45; // IPv4, 20-byte header
+  headers[2] = static_cast<uint8_t>(total >> 8);
+  headers[3] = static_cast<uint8_t>(total);
+  headers[4] = static_cast<uint8_t>(id >> 8);
+  headers[5] = static_cast<uint8_t>(id);
+  headers[6] = 0x40; // Don't fragment
+  headers[8] = 64;   // TTL
+  headers[9] = IPPROTO_UDP;
+  std::memcpy(headers + 12, &src_addr, 4);
+  std::memcpy(headers + 16, &dst_addr, 4);
+  const uint16_t checksum = ipv4Checksum(headers);
+  headers[10] = static_cast<uint8_t>(checksum >> 8);
+  headers[11] = static_cast<uint8_t>(checksum);
+  const uint16_t udp_length = static_cast<uint16_t>(8 + length);
+  headers[20] = static_cast<uint8_t>(src_port >> 8);
+  headers[21] = static_cast<uint8_t>(src_port);
+  headers[22] = static_cast<uint8_t>(dst_port >> 8);
+  headers[23] = static_cast<uint8_t>(dst_port);
+  headers[24] = static_cast<uint8_t>(udp_length >> 8);
+  headers[25] = static_cast<uint8_t>(udp_length);
+  // UDP checksum 0: not computed, which IPv4 allows.
+  out.append(reinterpret_cast<const char *>(headers), sizeof(headers));
+  out.append(reinterpret_cast<const char *>(payload), kept);
+}
+} // namespace
+
+struct alignas(64) PacketCapture::Slot {
+  std::atomic<uint64_t> sequence{0}; // 0 = never written, odd = being written
+  std::array<std::atomic<uint64_t>, kWords> words{};
+};
+
+// Only its worker touches a countdown; the padding keeps workers off each
+// other's cache lines. Relaxed atomics because worker ids beyond the
+// count share one.
+struct alignas(64) PacketCapture::Countdown {
+  std::atomic<uint32_t> remaining{0};
+};
+
+const char *dropReasonName(DropReason reason) {
+  switch (reason) {
+  case DropReason::NONE:
+    return "none";
+  case DropReason::ACL:
+    return "acl";
+  case DropReason::RATE_LIMIT:
+    return "rate_limit";
+  case DropReason::DDOS:
+    return "ddos";
+  case DropReason::CONNECTION:
+    return "connection";
+  case DropReason::INVALID:
+    return "invalid";
+  case DropReason::PARSE:
+    return "parse";
+  case DropReason::SEND:
+    return "send";
+  }
+  return "unknown";
+}
+
+PacketCapture::PacketCapture(size_t slots, const CaptureFilter &filter, uint32_t server_addr,
+                             uint16_t server_port, size_t workers)
+    : slots_(new Slot[std::max<size_t>(slots, 1)]), slot_count_(std::max<size_t>(slots, 1)),
+      countdowns_(new Countdown[std::max<size_t>(workers, 1)]),
+      countdown_count_(std::max<size_t>(workers, 1)), filter_(filter),
+      server_addr_(server_addr), server_port_(server_port) {}
+
+PacketCapture::~PacketCapture() = default;
+
+bool PacketCapture::matches(uint32_t client_addr, bool dropped, size_t worker) {
+  if (filter_.drops_only && !dropped) {
+    return false;
+  }
+  if ((ntohl(client_addr) & filter_.mask) != filter_.network) {
+    return false;
+  }
+  if (filter_.sample_every <= 1) {
+    return true;
+  }
+  // Per worker, so sampling takes no shared write.
+  std::atomic<uint32_t> &countdown = countdowns_[worker % countdown_count_].remaining;
+  uint32_t remaining = countdown.load(std::memory_order_relaxed);
+  if (remaining == 0) {
+    remaining = filter_.sample_every;
+  }
+  countdown.store(--remaining, std::memory_order_relaxed);
+  return remaining == 0;
+}
+
+void PacketCapture::record(const CapturedExchange &exchange) {
+  const uint64_t ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = slots_[ticket % slot_count_];
+  uint64_t seq = slot.sequence.load(std::memory_order_relaxed);
+  if ((seq & 1) != 0 ||
+      !slot.sequence.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+    skipped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  CapturedExchange stored = exchange;
+  stored.ticket = ticket;
+  std::array<uint64_t, kWords> buffer{};
+  std::memcpy(buffer.data(), &stored, sizeof(stored));
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < kWords; ++i) {
+    slot.words[i].store(buffer[i], std::memory_order_relaxed);
+  }
+  slot.sequence.store(seq + 2, std::memory_order_release);
+}
+
+std::vector<CapturedExchange> PacketCapture::snapshot() const {
+  std::vector<CapturedExchange> out;
+  std::array<uint64_t, kWords> buffer{};
+  for (size_t s = 0; s < slot_count_; ++s) {
+    const Slot &slot = slots_[s];
+    for (unsigned attempt = 0; attempt < kReadAttempts; ++attempt) {
+      const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+      if (before == 0) {
+        break;
+      }
+      for (size_t i = 0; i < kWords; ++i) {
+        buffer[i] = slot.words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((before & 1) == 0 && before == slot.sequence.load(std::memory_order_relaxed)) {
+        out.emplace_back();
+        std::memcpy(static_cast<void *>(&out.back()), buffer.data(), sizeof(CapturedExchange));
+        break;
+      }
+    }
+  }
+  std::sort(out.begin(), out.end(), [](const CapturedExchange &a, const CapturedExchange &b) {
+    return a.ticket < b.ticket;
+  });
+  return out;
+}
+
+void PacketCapture::writePcap(std::ostream &out) const {
+  std::string data;
+  put(data, kPcapMagicNanoseconds);
+  put(data, static_cast<uint16_t>(2)); // Version 2.4
+  put(data, static_cast<uint16_t>(4));
+  put(data, static_cast<int32_t>(0));  // UTC
+  put(data, static_cast<uint32_t>(0)); // Timestamp accuracy
+  put(data, static_cast<uint32_t>(65535));
+  put(data, kLinkTypeRaw);
+  for (const CapturedExchange &exchange : snapshot()) {
+    const uint16_t id = static_cast<uint16_t>(exchange.ticket);
+    writePacket(data, exchange.received_unix_ns, exchange.client_addr, exchange.client_port,
+                server_addr_, server_port_, exchange.request, exchange.request_length, id);
+    if (exchange.drop == DropReason::NONE) {
+      writePacket(data, exchange.sent_unix_ns, server_addr_, server_port_, exchange.client_addr,
+                  exchange.client_port, exchange.response, exchange.response_length, id);
+    }
+  }
+  out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+} // namespace simple_ntpd
@@ -0,0 +1,180 @@
+/**
+ * @file clock_adjuster.cpp
+ * @brief System clock steering backends (kernel ntp_adjtime and mock)
+ */
+
+#include "simple-ntpd/core/clock_adjuster.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/timex.h>
+#endif
+
+namespace simple_ntpd {
+
+#ifdef __linux__
+namespace {
+// Kernel PLL phase limit (MAXPHASE) and frequency scale (16.16 ppm).
+constexpr double kMaxKernelPhase = 0.5;
+constexpr double kFrequencyScale = 65536.0 * 1e6;
+
+long secondsToKernelUs(double seconds) {
+  return static_cast<long>(std::min(1e9, std::fabs(seconds) * 1e6));
+}
+} // namespace
+
+bool KernelClockAdjuster::slew(double offset, double max_error, double est_error,
+                               int poll_log2) {
+  struct timex current {};
+  if (ntp_adjtime(&current) == -1) {
+    last_error_ = std::strerror(errno);
+    return false;
+  }
+
+  struct timex tx {};
+  tx.modes = ADJ_OFFSET | ADJ_NANO | ADJ_STATUS | ADJ_MAXERROR | ADJ_ESTERROR |
+             ADJ_TIMECONST;
+  const double clamped = std::max(-kMaxKernelPhase, std::min(kMaxKernelPhase, offset));
+  tx.offset = static_cast<long>(std::llround(clamped * 1e9));
+  // Keep leap bits, hand the clock to the PLL and mark it synchronized.
+  tx.status = (current.status | STA_PLL) & ~(STA_UNSYNC | STA_FLL | STA_FREQHOLD);
+  tx.maxerror = secondsToKernelUs(max_error);
+  tx.esterror = secondsToKernelUs(est_error);
+  // Under STA_NANO the kernel takes the poll exponent as the time constant
+  // as-is; it only adds four itself in microsecond mode.
+  tx.constant = std::clamp(poll_log2, 0, 10);
+  if (ntp_adjtime(&tx) == -1) {
+    last_error_ = std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool KernelClockAdjuster::step(double offset) {
+  struct timex tx {};
+  tx.modes = ADJ_SETOFFSET | ADJ_NANO;
+  const long long ns = std::llround(offset * 1e9);
+  long long sec = ns / 1000000000LL;
+  long long nsec = ns % 1000000000LL;
+  // The kernel wants a non-negative sub-second part.
+  if (nsec < 0) {
+    nsec += 1000000000LL;
+    sec -= 1;
+  }
+  tx.time.tv_sec = static_cast<time_t>(sec);
+  tx.time.tv_usec = static_cast<suseconds_t>(nsec);
+  if (ntp_adjtime(&tx) == -1) {
+    last_error_ = std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool KernelClockAdjuster::setFrequency(double frequency) {
+  struct timex tx {};
+  tx.modes = ADJ_FREQUENCY;
+  tx.freq = static_cast<long>(std::llround(frequency * kFrequencyScale));
+  if (ntp_adjtime(&tx) == -1) {
+    last_error_ = std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool KernelClockAdjuster::readFrequency(double &frequency) {
+  struct timex tx {};
+  if (ntp_adjtime(&tx) == -1) {
+    last_error_ = std::strerror(errno);
+    return false;
+  }
+  frequency = static_cast<double>(tx.freq) / kFrequencyScale;
+  return true;
+}
+#endif
+
+// MockClockAdjuster implementation
+MockClockAdjuster::MockClockAdjuster(bool steers, std::shared_ptr<Logger> logger)
+    : steers_(steers), logger_(std::move(logger)) {}
+
+void MockClockAdjuster::record(Action action, double value, const std::string &text) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    calls_.push_back({action, value});
+  }
+  if (logger_) {
+    logger_->info("Clock discipline (dry-run): would " + text);
+  }
+}
+
+bool MockClockAdjuster::slew(double offset, double /*max_error*/, double /*est_error*/,
+                             int poll_log2) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    applied_offset_ += offset;
+  }
+  record(Action::SLEW, offset,
+         "slew " + std::to_string(offset * 1e6) + " us (poll 2^" +
+             std::to_string(poll_log2) + ")");
+  return true;
+}
+
+bool MockClockAdjuster::step(double offset) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    applied_offset_ += offset;
+  }
+  record(Action::STEP, offset, "step " + std::to_string(offset * 1e6) + " us");
+  return true;
+}
+
+bool MockClockAdjuster::setFrequency(double frequency) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frequency_ = frequency;
+  }
+  record(Action::SET_FREQUENCY, frequency,
+         "set frequency " + std::to_string(frequency * 1e6) + " ppm");
+  return true;
+}
+
+bool MockClockAdjuster::readFrequency(double &frequency) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frequency = frequency_;
+  return true;
+}
+
+std::vector<MockClockAdjuster::Call> MockClockAdjuster::calls() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return calls_;
+}
+
+double MockClockAdjuster::appliedOffset() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return applied_offset_;
+}
+
+std::shared_ptr<ClockAdjuster>
+createClockAdjuster(NtpConfig::SystemClockDiscipline mode,
+                    std::shared_ptr<Logger> logger) {
+  switch (mode) {
+  case NtpConfig::SystemClockDiscipline::KERNEL:
+#ifdef __linux__
+    return std::make_shared<KernelClockAdjuster>();
+#else
+    if (logger) {
+      logger->error("Kernel clock discipline is not supported on this platform");
+    }
+    return nullptr;
+#endif
+  case NtpConfig::SystemClockDiscipline::DRY_RUN:
+    return std::make_shared<MockClockAdjuster>(false, std::move(logger));
+  case NtpConfig::SystemClockDiscipline::NONE:
+  default:
+    return nullptr;
+  }
+}
+
+} // namespace simple_ntpd
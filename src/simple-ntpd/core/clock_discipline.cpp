@@ -0,0 +1,170 @@
+/**
+ * @file clock_discipline.cpp
+ * @brief Phase/frequency clock model with drift file and holdover
+ */
+
+#include "simple-ntpd/core/clock_discipline.hpp"
+#include "simple-ntpd/core/clock_filter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace simple_ntpd {
+
+namespace {
+// PLL time constant as a multiple of the poll interval. Larger is smoother
+// but slower to pull in a frequency error.
+constexpr double kPllTimeConstantFactor = 4.0;
+
+double clampFrequency(double frequency) {
+  return std::max(-ClockDiscipline::kMaxFrequency,
+                  std::min(ClockDiscipline::kMaxFrequency, frequency));
+}
+} // namespace
+
+bool ClockDiscipline::update(double offset, double jitter, double now,
+                             double poll_interval) {
+  poll_interval = std::max(1.0, poll_interval);
+  const double mu = state_ == State::UNSET ? 0.0 : std::max(0.0, now - last_update_);
+  const double predicted = offsetAt(now);
+  const double error = offset - predicted;
+  bool stepped = false;
+
+  if (state_ == State::UNSET || std::fabs(error) > kStepThreshold) {
+    // First sample or a large error: take the measurement as-is.
+    base_offset_ = offset;
+    residual_ = 0.0;
+    stepped = true;
+    if (state_ == State::UNSET) {
+      state_ = (track_frequency_ && !frequency_seeded_) ? State::FREQ : State::SYNC;
+      freq_ref_time_ = now;
+      freq_ref_offset_ = offset;
+    }
+  } else {
+    if (state_ == State::FREQ) {
+      // Without a drift file, measure the frequency directly once enough
+      // time has passed for the measurement to beat the phase noise.
+      const double span = now - freq_ref_time_;
+      if (span >= kFreqMeasureInterval) {
+        frequency_ = clampFrequency((offset - freq_ref_offset_) / span);
+        state_ = State::SYNC;
+      }
+    } else if (track_frequency_ && mu > 0.0) {
+      if (mu >= kAllanIntercept) {
+        // FLL: the residual over a long interval is a frequency error.
+        frequency_ += kFllGain * error / mu;
+      } else {
+        // PLL: integrate the phase error.
+        const double tau = kPllTimeConstantFactor * poll_interval;
+        frequency_ += error * mu / (4.0 * tau * tau);
+      }
+      frequency_ = clampFrequency(frequency_);
+    }
+    // Keep the phase continuous and slew the residual over one poll.
+    base_offset_ = predicted;
+    residual_ = error;
+  }
+
+  base_time_ = now;
+  slew_ = poll_interval;
+  last_update_ = now;
+  jitter_ = std::max(0.0, jitter);
+  // Dispersion at the update: the measurement jitter plus the step the
+  // model had to absorb.
+  dispersion_ = std::min(NTP_MAXDISP, jitter_ + (stepped ? 0.0 : std::fabs(error)));
+  return stepped;
+}
+
+// ClockModel implementation
+double ClockModel::offsetAt(double now) const {
+  if (!valid) {
+    return 0.0;
+  }
+  const double elapsed = std::max(0.0, now - base_time);
+  return base_offset + frequency * elapsed + residual * std::min(1.0, elapsed / slew);
+}
+
+double ClockModel::dispersionAt(double now) const {
+  if (!valid) {
+    return NTP_MAXDISP;
+  }
+  return std::min(NTP_MAXDISP, dispersion + NTP_PHI * std::max(0.0, now - last_update));
+}
+
+// ClockDiscipline implementation
+ClockModel ClockDiscipline::model() const {
+  ClockModel m;
+  m.valid = state_ != State::UNSET;
+  m.base_time = base_time_;
+  m.base_offset = base_offset_;
+  m.residual = residual_;
+  m.slew = slew_;
+  m.frequency = frequency_;
+  m.last_update = last_update_;
+  m.dispersion = dispersion_;
+  return m;
+}
+
+double ClockDiscipline::offsetAt(double now) const { return model().offsetAt(now); }
+
+double ClockDiscipline::dispersionAt(double now) const { return model().dispersionAt(now); }
+
+double ClockDiscipline::ageAt(double now) const {
+  if (state_ == State::UNSET) {
+    return 0.0;
+  }
+  return std::max(0.0, now - last_update_);
+}
+
+void ClockDiscipline::setFrequency(double frequency) {
+  frequency_ = clampFrequency(frequency);
+  if (state_ == State::FREQ) {
+    state_ = State::SYNC;
+  }
+  // A seeded frequency lets the first update go straight to SYNC.
+  frequency_seeded_ = true;
+}
+
+bool ClockDiscipline::loadDriftFile(const std::string &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  double ppm = 0.0;
+  if (!(file >> ppm) || !std::isfinite(ppm) || std::fabs(ppm) > kMaxFrequency * 1e6) {
+    return false;
+  }
+  setFrequency(ppm * 1e-6);
+  return true;
+}
+
+bool ClockDiscipline::saveDriftFile(const std::string &path) const {
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f\n", frequency_ * 1e6);
+    file << buf;
+    if (!file.good()) {
+      return false;
+    }
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+void ClockDiscipline::restore(double offset, double frequency, double dispersion,
+                              double now) {
+  frequency_ = clampFrequency(frequency);
+  base_offset_ = offset;
+  base_time_ = now;
+  residual_ = 0.0;
+  last_update_ = now;
+  dispersion_ = std::min(NTP_MAXDISP, std::max(0.0, dispersion));
+  state_ = State::SYNC;
+}
+
+} // namespace simple_ntpd
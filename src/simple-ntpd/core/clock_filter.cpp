@@ -0,0 +1,350 @@
+/**
+ * @file clock_filter.cpp
+ * @brief RFC 5905 clock filter, selection, cluster and combine algorithms
+ */
+
+#include "simple-ntpd/core/clock_filter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace simple_ntpd {
+
+namespace {
+// Floor for jitter so that a single clean sample never claims zero error.
+constexpr double kJitterFloor = 1e-6;
+// Offset changes below this always count as stable for poll adjustment;
+// sub-millisecond wander is noise, not a reason to poll faster.
+constexpr double kPollGateFloor = 500e-6;
+
+double candidateMetric(const ClockCandidate &c) {
+  return static_cast<double>(c.stratum) * NTP_MAXDIST + c.root_distance;
+}
+} // namespace
+
+// ClockFilter implementation
+ClockFilter::ClockFilter() { reset(); }
+
+void ClockFilter::reset() {
+  stages_.fill(Stage{});
+  last_update_ = 0.0;
+  valid_samples_ = 0;
+  offset_ = 0.0;
+  delay_ = 0.0;
+  dispersion_ = NTP_MAXDISP;
+  jitter_ = 0.0;
+  sample_time_ = 0.0;
+}
+
+void ClockFilter::shift(const Stage &stage) {
+  // Age every stored sample before the new one is inserted.
+  const double elapsed = last_update_ > 0.0 ? stage.time - last_update_ : 0.0;
+  for (auto &s : stages_) {
+    s.dispersion = std::min(NTP_MAXDISP, s.dispersion + NTP_PHI * std::max(0.0, elapsed));
+  }
+  last_update_ = stage.time;
+
+  for (size_t i = kStages - 1; i > 0; --i) {
+    stages_[i] = stages_[i - 1];
+  }
+  stages_[0] = stage;
+
+  valid_samples_ = static_cast<size_t>(
+      std::count_if(stages_.begin(), stages_.end(),
+                    [](const Stage &s) { return s.valid; }));
+  recompute();
+}
+
+void ClockFilter::addSample(double offset, double delay, double dispersion,
+                            double now) {
+  Stage stage;
+  stage.offset = offset;
+  stage.delay = std::max(0.0, delay);
+  stage.dispersion = std::min(NTP_MAXDISP, dispersion);
+  stage.time = now;
+  stage.valid = true;
+  shift(stage);
+}
+
+void ClockFilter::addMissedSample(double now) {
+  Stage stage;
+  stage.time = now;
+  shift(stage);
+}
+
+void ClockFilter::recompute() {
+  std::array<const Stage *, kStages> sorted{};
+  for (size_t i = 0; i < kStages; ++i) {
+    sorted[i] = &stages_[i];
+  }
+  // Valid samples by ascending delay; invalid and fully dispersed ones last.
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Stage *a, const Stage *b) {
+                     const double da = (a->valid && a->dispersion < NTP_MAXDISP)
+                                           ? a->delay
+                                           : NTP_MAXDISP;
+                     const double db = (b->valid && b->dispersion < NTP_MAXDISP)
+                                           ? b->delay
+                                           : NTP_MAXDISP;
+                     return da < db;
+                   });
+
+  double dispersion = 0.0;
+  for (size_t i = 0; i < kStages; ++i) {
+    dispersion += std::min(sorted[i]->dispersion, NTP_MAXDISP) /
+                  std::ldexp(1.0, static_cast<int>(i) + 1);
+  }
+  dispersion_ = dispersion;
+
+  if (valid_samples_ == 0 || !sorted[0]->valid) {
+    return;
+  }
+
+  const Stage &best = *sorted[0];
+  offset_ = best.offset;
+  delay_ = best.delay;
+  sample_time_ = best.time;
+
+  double sum = 0.0;
+  size_t n = 0;
+  for (const Stage *s : sorted) {
+    if (!s->valid) {
+      continue;
+    }
+    sum += (s->offset - best.offset) * (s->offset - best.offset);
+    ++n;
+  }
+  jitter_ = n > 1 ? std::sqrt(sum / static_cast<double>(n - 1)) : 0.0;
+  jitter_ = std::max(jitter_, kJitterFloor);
+}
+
+double ClockFilter::rootDistance(double now, double root_delay,
+                                 double root_dispersion) const {
+  if (!hasSample()) {
+    return NTP_MAXDISP;
+  }
+  return std::max(NTP_MINDISP, root_delay + delay_) / 2.0 + root_dispersion +
+         dispersion_ + NTP_PHI * std::max(0.0, now - sample_time_) + jitter_;
+}
+
+// PollController implementation
+PollController::PollController(int poll, int min_poll, int max_poll)
+    : poll_(poll), min_poll_(min_poll), max_poll_(max_poll) {
+  setBounds(min_poll, max_poll);
+}
+
+void PollController::setBounds(int min_poll, int max_poll) {
+  min_poll_ = std::clamp(min_poll, 0, NTP_MAXPOLL);
+  max_poll_ = std::clamp(max_poll, min_poll_, NTP_MAXPOLL);
+  poll_ = std::clamp(poll_, min_poll_, max_poll_);
+}
+
+void PollController::setPoll(int poll) {
+  poll_ = std::clamp(poll, min_poll_, max_poll_);
+  count_ = 0;
+}
+
+double PollController::interval() const { return std::ldexp(1.0, poll_); }
+
+bool PollController::update(double offset_change, double jitter) {
+  const double gate = std::max(kPollGateFloor, NTP_PGATE * jitter);
+  // Sub-second polls (exponent 0) still need to make progress.
+  const int weight = std::max(1, poll_);
+  if (std::fabs(offset_change) < gate) {
+    count_ += weight;
+    if (count_ > NTP_LIMIT) {
+      count_ = NTP_LIMIT;
+      if (poll_ < max_poll_) {
+        count_ = 0;
+        ++poll_;
+        return true;
+      }
+    }
+    return false;
+  }
+  count_ -= 2 * weight;
+  if (count_ < -NTP_LIMIT) {
+    count_ = -NTP_LIMIT;
+    if (poll_ > min_poll_) {
+      count_ = 0;
+      --poll_;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PollController::backoff() {
+  count_ = 0;
+  if (poll_ >= max_poll_) {
+    return false;
+  }
+  ++poll_;
+  return true;
+}
+
+// Selection algorithms
+std::vector<size_t> intersectCandidates(const std::vector<ClockCandidate> &candidates) {
+  struct Endpoint {
+    double edge;
+    int type; // -1 lower edge, 0 midpoint, +1 upper edge
+  };
+
+  const size_t n = candidates.size();
+  std::vector<Endpoint> endpoints;
+  endpoints.reserve(n * 3);
+  for (const auto &c : candidates) {
+    endpoints.push_back({c.offset - c.root_distance, -1});
+    endpoints.push_back({c.offset, 0});
+    endpoints.push_back({c.offset + c.root_distance, +1});
+  }
+  std::sort(endpoints.begin(), endpoints.end(),
+            [](const Endpoint &a, const Endpoint &b) { return a.edge < b.edge; });
+
+  double low = std::numeric_limits<double>::max();
+  double high = std::numeric_limits<double>::lowest();
+  bool found_interval = false;
+
+  for (size_t allow = 0; 2 * allow < n; ++allow) {
+    size_t found = 0;
+    int chime = 0;
+    low = std::numeric_limits<double>::max();
+    for (const auto &e : endpoints) {
+      chime -= e.type;
+      if (chime >= static_cast<int>(n - allow)) {
+        low = e.edge;
+        break;
+      }
+      if (e.type == 0) {
+        ++found;
+      }
+    }
+
+    chime = 0;
+    high = std::numeric_limits<double>::lowest();
+    for (auto it = endpoints.rbegin(); it != endpoints.rend(); ++it) {
+      chime += it->type;
+      if (chime >= static_cast<int>(n - allow)) {
+        high = it->edge;
+        break;
+      }
+      if (it->type == 0) {
+        ++found;
+      }
+    }
+
+    // Midpoints outside the interval are falsetickers; more than we allow
+    // means try again with a larger allowance.
+    if (found > allow) {
+      continue;
+    }
+    if (high > low) {
+      found_interval = true;
+      break;
+    }
+  }
+
+  std::vector<size_t> truechimers;
+  if (!found_interval) {
+    return truechimers;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (candidates[i].offset >= low && candidates[i].offset <= high) {
+      truechimers.push_back(i);
+    }
+  }
+  return truechimers;
+}
+
+std::vector<size_t> clusterSurvivors(const std::vector<ClockCandidate> &candidates,
+                                     std::vector<size_t> survivors) {
+  std::sort(survivors.begin(), survivors.end(), [&](size_t a, size_t b) {
+    return candidateMetric(candidates[a]) < candidateMetric(candidates[b]);
+  });
+
+  while (survivors.size() > NTP_MIN_CLUSTER) {
+    double max_selection_jitter = -1.0;
+    size_t worst = 0;
+    double min_peer_jitter = std::numeric_limits<double>::max();
+
+    for (size_t i = 0; i < survivors.size(); ++i) {
+      const auto &ci = candidates[survivors[i]];
+      double sum = 0.0;
+      for (size_t j = 0; j < survivors.size(); ++j) {
+        const double d = ci.offset - candidates[survivors[j]].offset;
+        sum += d * d;
+      }
+      const double selection_jitter =
+          std::sqrt(sum / static_cast<double>(survivors.size() - 1));
+      if (selection_jitter > max_selection_jitter) {
+        max_selection_jitter = selection_jitter;
+        worst = i;
+      }
+      min_peer_jitter = std::min(min_peer_jitter, ci.jitter);
+    }
+
+    if (max_selection_jitter <= min_peer_jitter) {
+      break;
+    }
+    survivors.erase(survivors.begin() + static_cast<std::ptrdiff_t>(worst));
+  }
+  return survivors;
+}
+
+ClockSelection selectClockSources(const std::vector<ClockCandidate> &candidates,
+                                  size_t min_survivors) {
+  ClockSelection selection;
+
+  // Only associations within the distance threshold may vote.
+  std::vector<ClockCandidate> fit;
+  std::vector<size_t> fit_index;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const auto &c = candidates[i];
+    if (c.stratum >= 16 || c.root_distance >= NTP_MAXDIST) {
+      continue;
+    }
+    fit.push_back(c);
+    fit_index.push_back(i);
+  }
+
+  const std::vector<size_t> chimers = intersectCandidates(fit);
+  for (size_t k = 0; k < fit.size(); ++k) {
+    if (std::find(chimers.begin(), chimers.end(), k) == chimers.end()) {
+      selection.falsetickers.push_back(fit_index[k]);
+    }
+  }
+  if (chimers.empty() || chimers.size() < std::max<size_t>(1, min_survivors)) {
+    return selection;
+  }
+
+  for (size_t k : chimers) {
+    selection.truechimers.push_back(fit_index[k]);
+  }
+  const std::vector<size_t> clustered = clusterSurvivors(fit, chimers);
+  for (size_t k : clustered) {
+    selection.survivors.push_back(fit_index[k]);
+  }
+
+  // Combine: weight each survivor by the reciprocal of its root distance.
+  const ClockCandidate &peer = fit[clustered.front()];
+  double sum_weight = 0.0;
+  double sum_offset = 0.0;
+  double sum_jitter = 0.0;
+  for (size_t k : clustered) {
+    const auto &c = fit[k];
+    const double distance = std::max(c.root_distance, NTP_MINDISP / 2.0);
+    sum_weight += 1.0 / distance;
+    sum_offset += c.offset / distance;
+    sum_jitter += (c.offset - peer.offset) * (c.offset - peer.offset) / distance;
+  }
+  const double selection_jitter = std::sqrt(sum_jitter / sum_weight);
+
+  selection.synchronized = true;
+  selection.system_peer = selection.survivors.front();
+  selection.offset = sum_offset / sum_weight;
+  selection.jitter =
+      std::sqrt(peer.jitter * peer.jitter + selection_jitter * selection_jitter);
+  return selection;
+}
+
+} // namespace simple_ntpd
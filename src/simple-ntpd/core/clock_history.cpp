@@ -0,0 +1,181 @@
+/**
+ * @file clock_history.cpp
+ * @brief Clock quality history rings, summaries and listings
+ */
+
+#include "simple-ntpd/core/clock_history.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace simple_ntpd {
+
+namespace {
+// Offset, delay and jitter statistics shared by both sample kinds.
+void accumulate(HistorySummary &summary, double &sum_squares, int64_t offset_us,
+                int64_t delay_us, int64_t jitter_us) {
+  if (summary.good == 0) {
+    summary.min_offset_us = summary.max_offset_us = offset_us;
+    summary.min_delay_us = summary.max_delay_us = delay_us;
+  }
+  ++summary.good;
+  summary.min_offset_us = std::min(summary.min_offset_us, offset_us);
+  summary.max_offset_us = std::max(summary.max_offset_us, offset_us);
+  summary.min_delay_us = std::min(summary.min_delay_us, delay_us);
+  summary.max_delay_us = std::max(summary.max_delay_us, delay_us);
+  summary.max_jitter_us = std::max(summary.max_jitter_us, jitter_us);
+  sum_squares += static_cast<double>(offset_us) * static_cast<double>(offset_us);
+}
+
+void finish(HistorySummary &summary, double sum_squares) {
+  if (summary.good > 0) {
+    summary.rms_offset_us =
+        static_cast<int64_t>(std::sqrt(sum_squares / static_cast<double>(summary.good)));
+  }
+}
+
+template <typename T>
+std::vector<T> withinWindow(const SampleRing<T> &ring, int64_t oldest) {
+  std::vector<T> out;
+  ring.forEach([&](const T &sample) {
+    if (sample.unix_time >= oldest) {
+      out.push_back(sample);
+    }
+  });
+  return out;
+}
+} // namespace
+
+HistorySummary summarizeHistory(const std::vector<ClockHistorySample> &samples) {
+  HistorySummary summary;
+  double sum_squares = 0.0;
+  summary.samples = samples.size();
+  for (const auto &sample : samples) {
+    // Holdover and unsynchronized rounds have no measured offset.
+    if (sample.synced && !sample.holdover) {
+      accumulate(summary, sum_squares, sample.offset_us, sample.root_delay_us,
+                 sample.jitter_us);
+    }
+  }
+  finish(summary, sum_squares);
+  return summary;
+}
+
+HistorySummary summarizeHistory(const std::vector<PeerHistorySample> &samples) {
+  HistorySummary summary;
+  double sum_squares = 0.0;
+  summary.samples = samples.size();
+  for (const auto &sample : samples) {
+    if (sample.reachable) {
+      accumulate(summary, sum_squares, sample.offset_us, sample.delay_us, sample.jitter_us);
+    }
+    if (sample.tally == '*' || sample.tally == '+') {
+      ++summary.selected;
+    }
+  }
+  finish(summary, sum_squares);
+  return summary;
+}
+
+std::string formatClockHistory(const std::vector<ClockHistorySample> &samples) {
+  std::ostringstream out;
+  out << "time state stratum survivors offset_us jitter_us freq_ppm dispersion_us"
+         " root_delay_us root_dispersion_us\n";
+  out << std::fixed << std::setprecision(3);
+  for (const auto &s : samples) {
+    out << s.unix_time << " " << (s.synced ? (s.holdover ? "holdover" : "synced") : "unsynced")
+        << " " << static_cast<int>(s.stratum) << " " << static_cast<int>(s.survivors) << " "
+        << s.offset_us << " " << s.jitter_us << " " << s.frequency_ppm << " "
+        << s.dispersion_us << " " << s.root_delay_us << " " << s.root_dispersion_us << "\n";
+  }
+  return out.str();
+}
+
+std::string formatPeerHistory(const PeerHistory &history) {
+  std::ostringstream out;
+  out << "# " << history.server;
+  if (!history.address.empty() && history.address != history.server) {
+    out << " (" << history.address << ")";
+  }
+  out << "\n";
+  out << "time tally reachable stratum offset_us delay_us jitter_us\n";
+  for (const auto &s : history.samples) {
+    // A blank tally would break the columns.
+    out << s.unix_time << " " << (s.tally == ' ' ? '.' : s.tally) << " "
+        << (s.reachable ? 1 : 0) << " " << static_cast<int>(s.stratum) << " " << s.offset_us
+        << " " << s.delay_us << " " << s.jitter_us << "\n";
+  }
+  return out.str();
+}
+
+size_t ClockHistory::capacityFor(int64_t window_seconds, int min_poll) {
+  constexpr int64_t kBurstSlack = 16;
+  const int64_t polls = (std::max<int64_t>(window_seconds, 0) >> std::max(min_poll, 0)) + 1;
+  return static_cast<size_t>(std::min<int64_t>(polls + kBurstSlack, kMaxSamples));
+}
+
+void ClockHistory::configure(int64_t window_seconds, size_t capacity) {
+  window_seconds_ = std::max<int64_t>(window_seconds, 0);
+  capacity_ = enabled() ? std::max<size_t>(capacity, 1) : 0;
+  clock_ = SampleRing<ClockHistorySample>(enabled() ? capacity_ : 1);
+  peers_.clear();
+}
+
+void ClockHistory::recordClock(const ClockHistorySample &sample) {
+  if (enabled()) {
+    clock_.push(sample);
+  }
+}
+
+void ClockHistory::recordPeer(const std::string &server, const std::string &address,
+                              const PeerHistorySample &sample) {
+  if (!enabled()) {
+    return;
+  }
+  auto it = peers_.find({server, address});
+  if (it == peers_.end()) {
+    it = peers_.emplace(std::make_pair(server, address), SampleRing<PeerHistorySample>(capacity_))
+             .first;
+  }
+  it->second.push(sample);
+}
+
+void ClockHistory::retainPeers(const std::vector<std::pair<std::string, std::string>> &keep) {
+  for (auto it = peers_.begin(); it != peers_.end();) {
+    if (std::find(keep.begin(), keep.end(), it->first) == keep.end()) {
+      it = peers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool ClockHistory::latestClock(ClockHistorySample &out) const {
+  if (clock_.empty()) {
+    return false;
+  }
+  out = clock_.newest();
+  return true;
+}
+
+std::vector<ClockHistorySample> ClockHistory::clock(int64_t now_unix) const {
+  if (!enabled()) {
+    return {};
+  }
+  return withinWindow(clock_, now_unix - window_seconds_);
+}
+
+std::vector<PeerHistory> ClockHistory::peers(int64_t now_unix) const {
+  std::vector<PeerHistory> out;
+  for (const auto &entry : peers_) {
+    PeerHistory history;
+    history.server = entry.first.first;
+    history.address = entry.first.second;
+    history.samples = withinWindow(entry.second, now_unix - window_seconds_);
+    out.push_back(std::move(history));
+  }
+  return out;
+}
+
+} // namespace simple_ntpd
@@ -104,8 +104,9 @@ bool NtpConnection::handlePacket(const std::vector<uint8_t> &data) {
     return false;
   }
 
-  // Check if this is a client request
-  if (packet.mode != static_cast<uint8_t>(NtpMode::CLIENT)) {
+  // Answer clients and symmetric active peers
+  if (packet.mode != static_cast<uint8_t>(NtpMode::CLIENT) &&
+      packet.mode != static_cast<uint8_t>(NtpMode::SYMMETRIC_ACTIVE)) {
     logger_->warning(
         "Received non-client packet from " + client_address_ +
         " (mode: " + std::to_string(static_cast<int>(packet.mode)) + ")");
@@ -0,0 +1,214 @@
+/**
+ * @file control_socket.cpp
+ * @brief Unix-domain control socket server and client
+ */
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/control_socket.hpp"
+#include <cerrno>
+#include <cstring>
+
+namespace simple_ntpd {
+
+namespace {
+constexpr size_t kMaxCommandSize = 256;
+constexpr struct timeval kIoTimeout {5, 0};
+
+bool makeAddress(const std::string &path, struct sockaddr_un &addr) {
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+socket_t connectTo(const struct sockaddr_un &addr) {
+  socket_t sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == INVALID_SOCKET) {
+    return INVALID_SOCKET;
+  }
+  if (connect(sock, reinterpret_cast<const struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    CLOSE_SOCKET(sock);
+    return INVALID_SOCKET;
+  }
+  return sock;
+}
+
+void setTimeouts(socket_t sock) {
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &kIoTimeout, sizeof(kIoTimeout));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &kIoTimeout, sizeof(kIoTimeout));
+}
+
+bool sendAll(socket_t sock, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    const ssize_t n = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+} // namespace
+
+ControlServer::ControlServer(std::string path, std::shared_ptr<Logger> logger, Handler handler)
+    : path_(std::move(path)), logger_(std::move(logger)), handler_(std::move(handler)) {}
+
+ControlServer::~ControlServer() { stop(); }
+
+bool ControlServer::start() {
+  if (running_) {
+    return true;
+  }
+  struct sockaddr_un addr {};
+  if (!makeAddress(path_, addr)) {
+    logger_->error("Control socket: path too long or empty: " + path_);
+    return false;
+  }
+  // Refuse to take over a socket a running daemon still answers on.
+  socket_t probe = connectTo(addr);
+  if (probe != INVALID_SOCKET) {
+    CLOSE_SOCKET(probe);
+    logger_->error("Control socket: another process is listening on " + path_);
+    return false;
+  }
+  ::unlink(path_.c_str());
+
+  socket_t sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == INVALID_SOCKET) {
+    logger_->error("Control socket: socket failed: " + std::string(std::strerror(errno)));
+    return false;
+  }
+  if (bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(sock, 8) != 0) {
+    logger_->error("Control socket: failed to listen on " + path_ + ": " +
+                   std::strerror(errno));
+    CLOSE_SOCKET(sock);
+    return false;
+  }
+  // Owner and group only: reload and the client list are not for everyone.
+  ::chmod(path_.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+  socket_ = sock;
+  running_ = true;
+  thread_ = std::thread(&ControlServer::serveLoop, this);
+  logger_->info("Control socket on " + path_);
+  return true;
+}
+
+void ControlServer::stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (socket_ != INVALID_SOCKET) {
+    CLOSE_SOCKET(socket_);
+    socket_ = INVALID_SOCKET;
+    ::unlink(path_.c_str());
+  }
+}
+
+void ControlServer::serveLoop() {
+  while (running_) {
+    struct pollfd pfd {socket_, POLLIN, 0};
+    if (::poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    socket_t client = accept(socket_, nullptr, nullptr);
+    if (client == INVALID_SOCKET) {
+      continue;
+    }
+    serveClient(client);
+    CLOSE_SOCKET(client);
+  }
+}
+
+void ControlServer::serveClient(socket_t client) {
+  setTimeouts(client);
+  std::string command;
+  char buffer[kMaxCommandSize];
+  while (command.find('\n') == std::string::npos && command.size() < kMaxCommandSize) {
+    const ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      break;
+    }
+    command.append(buffer, static_cast<size_t>(received));
+  }
+  command = command.substr(0, command.find('\n'));
+  if (!command.empty() && command.back() == '\r') {
+    command.pop_back();
+  }
+  if (command.empty()) {
+    return;
+  }
+  ++commands_;
+  handler_(command, [client](const std::string &chunk) { return sendAll(client, chunk); });
+}
+
+bool queryControlSocket(const std::string &path, const std::string &command, std::ostream &out,
+                        std::string &error) {
+  struct sockaddr_un addr {};
+  if (!makeAddress(path, addr)) {
+    error = "invalid control socket path: " + path;
+    return false;
+  }
+  socket_t sock = connectTo(addr);
+  if (sock == INVALID_SOCKET) {
+    error = "no daemon answering on " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  setTimeouts(sock);
+  if (!sendAll(sock, command + "\n")) {
+    error = "failed to send command: " + std::string(std::strerror(errno));
+    CLOSE_SOCKET(sock);
+    return false;
+  }
+
+  // Status line first, then stream the body straight through.
+  std::string status;
+  bool in_body = false;
+  char buffer[16384];
+  ssize_t received;
+  while ((received = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+    const char *data = buffer;
+    size_t length = static_cast<size_t>(received);
+    if (!in_body) {
+      const char *newline = static_cast<const char *>(std::memchr(data, '\n', length));
+      const size_t head = newline ? static_cast<size_t>(newline - data) : length;
+      status.append(data, head);
+      if (!newline) {
+        continue;
+      }
+      in_body = true;
+      data += head + 1;
+      length -= head + 1;
+    }
+    out.write(data, static_cast<std::streamsize>(length));
+  }
+  const int recv_errno = errno;
+  CLOSE_SOCKET(sock);
+  out.flush();
+  if (!in_body) {
+    error = received < 0 ? "no reply: " + std::string(std::strerror(recv_errno))
+                         : "daemon closed the connection without a reply";
+    return false;
+  }
+  if (status == "OK") {
+    return true;
+  }
+  error = status.compare(0, 4, "ERR ") == 0 ? status.substr(4) : status;
+  return false;
+}
+
+} // namespace simple_ntpd
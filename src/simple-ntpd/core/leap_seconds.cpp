@@ -0,0 +1,142 @@
+/**
+ * @file leap_seconds.cpp
+ * @brief IERS/NIST leap-seconds.list table, leap announcement and smearing
+ */
+
+#include "simple-ntpd/core/leap_seconds.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace simple_ntpd {
+
+namespace {
+// Seconds between the NTP (1900) and POSIX (1970) epochs
+constexpr int64_t kNtpToUnix = 2208988800LL;
+constexpr int64_t kAnnounceWindow = 86400;
+
+bool parseNtpSeconds(const std::string &text, int64_t &out) {
+  std::istringstream in(text);
+  int64_t ntp_seconds = 0;
+  if (!(in >> ntp_seconds) || ntp_seconds <= kNtpToUnix) {
+    return false;
+  }
+  out = ntp_seconds - kNtpToUnix;
+  return true;
+}
+} // namespace
+
+bool LeapSecondTable::parse(std::istream &in, std::string &error) {
+  std::vector<LeapSecond> entries;
+  int64_t expires = 0;
+  int64_t updated = 0;
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    const std::string where = "line " + std::to_string(line_number);
+    if (line.size() >= 2 && line[0] == '#') {
+      if (line[1] == '@' && !parseNtpSeconds(line.substr(2), expires)) {
+        error = where + ": invalid expiry";
+        return false;
+      }
+      if (line[1] == '$' && !parseNtpSeconds(line.substr(2), updated)) {
+        error = where + ": invalid update time";
+        return false;
+      }
+      continue;
+    }
+    const std::string data = line.substr(0, line.find('#'));
+    if (data.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+
+    std::istringstream fields(data);
+    int64_t ntp_seconds = 0;
+    LeapSecond entry;
+    if (!(fields >> ntp_seconds >> entry.tai_offset) || ntp_seconds <= kNtpToUnix) {
+      error = where + ": expected '<NTP seconds> <TAI-UTC>'";
+      return false;
+    }
+    entry.time = ntp_seconds - kNtpToUnix;
+    if (!entries.empty()) {
+      const LeapSecond &previous = entries.back();
+      if (entry.time <= previous.time) {
+        error = where + ": entries are not in increasing time order";
+        return false;
+      }
+      if (std::abs(entry.tai_offset - previous.tai_offset) != 1) {
+        error = where + ": TAI-UTC must change by exactly one second";
+        return false;
+      }
+    }
+    entries.push_back(entry);
+  }
+  if (entries.empty()) {
+    error = "no leap second entries";
+    return false;
+  }
+
+  entries_ = std::move(entries);
+  expires_ = expires;
+  updated_ = updated;
+  return true;
+}
+
+bool LeapSecondTable::loadFromFile(const std::string &path, std::string &error) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    error = "cannot open " + path;
+    return false;
+  }
+  return parse(file, error);
+}
+
+int LeapSecondTable::taiOffsetAt(int64_t now) const {
+  const auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), now,
+      [](int64_t t, const LeapSecond &entry) { return t < entry.time; });
+  return it == entries_.begin() ? 0 : std::prev(it)->tai_offset;
+}
+
+LeapSchedule LeapSecondTable::scheduleAt(int64_t now, int64_t smear_interval) const {
+  LeapSchedule schedule;
+  schedule.has_table = !entries_.empty();
+  schedule.smearing = smear_interval > 0;
+  const int64_t half_smear = std::max<int64_t>(0, smear_interval) / 2;
+
+  // The first row only sets the initial offset; later rows are leaps.
+  for (size_t i = 1; i < entries_.size(); ++i) {
+    const LeapSecond &leap = entries_[i];
+    if (leap.time + half_smear <= now) {
+      continue;
+    }
+    schedule.step = static_cast<int8_t>(leap.tai_offset - entries_[i - 1].tai_offset);
+    schedule.leap_time = leap.time;
+    if (half_smear == 0) {
+      schedule.announce_from = leap.time - kAnnounceWindow;
+      schedule.valid_until = leap.time;
+      return schedule;
+    }
+
+    // Smeared time lags (or leads) true UTC by step * elapsed / interval.
+    // After the leap POSIX time has absorbed the step, so the correction
+    // jumps by one step and returns to zero at the end of the window.
+    const double start = static_cast<double>(leap.time - half_smear);
+    const double interval = static_cast<double>(2 * half_smear);
+    const double step = static_cast<double>(schedule.step);
+    schedule.announce_from = schedule.leap_time; // Never announced
+    schedule.smear_from = start;
+    schedule.smear_until = static_cast<double>(leap.time + half_smear);
+    schedule.slope = -step / interval;
+    schedule.intercept_before = step * start / interval;
+    schedule.intercept_after = schedule.intercept_before + step;
+    schedule.valid_until = leap.time + half_smear;
+    return schedule;
+  }
+  return schedule;
+}
+
+} // namespace simple_ntpd
@@ -0,0 +1,310 @@
+/**
+ * @file metrics_http.cpp
+ * @brief Non-blocking HTTP endpoint for /metrics and /health
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/metrics_http.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace simple_ntpd {
+
+namespace {
+constexpr size_t kMaxClients = 32;
+constexpr size_t kMaxRequestSize = 8192;
+constexpr auto kClientTimeout = std::chrono::seconds(5);
+constexpr char kMetricsContentType[] = "text/plain; version=0.0.4; charset=utf-8";
+
+const char *reasonPhrase(int status) {
+  switch (status) {
+  case 200:
+    return "OK";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 503:
+    return "Service Unavailable";
+  default:
+    return "Error";
+  }
+}
+
+/** Appends status line, headers and (unless HEAD) the body to @p out */
+void appendResponse(std::string &out, int status, const char *content_type,
+                    const std::string &body, bool head) {
+  out += "HTTP/1.1 ";
+  out += std::to_string(status);
+  out += ' ';
+  out += reasonPhrase(status);
+  out += "\r\nContent-Type: ";
+  out += content_type;
+  out += "\r\nContent-Length: ";
+  out += std::to_string(body.size());
+  if (status == 405) {
+    out += "\r\nAllow: GET, HEAD";
+  }
+  out += "\r\nConnection: close\r\n\r\n";
+  if (!head) {
+    out += body;
+  }
+}
+
+bool setNonBlocking(socket_t sock) {
+  const int flags = fcntl(sock, F_GETFL, 0);
+  return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+} // namespace
+
+MetricsHttpServer::MetricsHttpServer(std::shared_ptr<NtpConfig> config,
+                                     std::shared_ptr<Logger> logger,
+                                     MetricsRenderer metrics, Renderer health)
+    : config_(std::move(config)), logger_(std::move(logger)), metrics_(std::move(metrics)),
+      health_(std::move(health)) {}
+
+MetricsHttpServer::~MetricsHttpServer() { stop(); }
+
+bool MetricsHttpServer::start() {
+  if (running_) {
+    return true;
+  }
+  socket_t sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock == INVALID_SOCKET) {
+    logger_->error("Metrics HTTP: socket failed: " + std::string(std::strerror(errno)));
+    return false;
+  }
+  const int on = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(config_->metrics_http_port);
+  if (inet_pton(AF_INET, config_->metrics_http_address.c_str(), &addr.sin_addr) != 1 ||
+      bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(sock, 16) != 0 || !setNonBlocking(sock)) {
+    logger_->error("Metrics HTTP: failed to listen on " + config_->metrics_http_address + ":" +
+                   std::to_string(config_->metrics_http_port) + ": " + std::strerror(errno));
+    CLOSE_SOCKET(sock);
+    return false;
+  }
+  socket_ = sock;
+  metrics_valid_ = false;
+  running_ = true;
+  thread_ = std::thread(&MetricsHttpServer::serveLoop, this);
+  logger_->info("Metrics HTTP endpoint on " + config_->metrics_http_address + ":" +
+                std::to_string(config_->metrics_http_port));
+  return true;
+}
+
+void MetricsHttpServer::stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  for (auto &client : clients_) {
+    if (client.socket != INVALID_SOCKET) {
+      CLOSE_SOCKET(client.socket);
+      client.socket = INVALID_SOCKET;
+    }
+  }
+  if (socket_ != INVALID_SOCKET) {
+    CLOSE_SOCKET(socket_);
+    socket_ = INVALID_SOCKET;
+  }
+}
+
+void MetricsHttpServer::serveLoop() {
+  std::vector<struct pollfd> fds;
+  std::vector<size_t> slots; // clients_ index of fds[i + 1]
+  while (running_) {
+    fds.clear();
+    slots.clear();
+    fds.push_back({socket_, POLLIN, 0});
+    for (size_t i = 0; i < clients_.size(); ++i) {
+      const Client &client = clients_[i];
+      if (client.socket != INVALID_SOCKET) {
+        fds.push_back({client.socket, client.response.empty() ? short(POLLIN) : short(POLLOUT),
+                       0});
+        slots.push_back(i);
+      }
+    }
+    if (::poll(fds.data(), fds.size(), 100) < 0) {
+      continue;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < slots.size(); ++i) {
+      Client &client = clients_[slots[i]];
+      bool open = now < client.deadline;
+      if (open && fds[i + 1].revents != 0) {
+        open = client.response.empty() ? readRequest(client) : writeResponse(client);
+      }
+      if (!open) {
+        CLOSE_SOCKET(client.socket);
+        client.socket = INVALID_SOCKET;
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      acceptClients();
+    }
+  }
+}
+
+void MetricsHttpServer::acceptClients() {
+  while (true) {
+    socket_t sock = accept(socket_, nullptr, nullptr);
+    if (sock == INVALID_SOCKET) {
+      return;
+    }
+    // Free slots keep their buffers, so steady-state scraping reuses them.
+    Client *slot = nullptr;
+    for (auto &client : clients_) {
+      if (client.socket == INVALID_SOCKET) {
+        slot = &client;
+        break;
+      }
+    }
+    if (slot == nullptr && clients_.size() < kMaxClients) {
+      clients_.emplace_back();
+      slot = &clients_.back();
+    }
+    if (slot == nullptr || !setNonBlocking(sock)) {
+      CLOSE_SOCKET(sock);
+      continue;
+    }
+    slot->socket = sock;
+    slot->request.clear();
+    slot->response.clear();
+    slot->sent = 0;
+    slot->deadline = std::chrono::steady_clock::now() + kClientTimeout;
+  }
+}
+
+bool MetricsHttpServer::readRequest(Client &client) {
+  char buffer[2048];
+  while (true) {
+    const ssize_t received = recv(client.socket, buffer, sizeof(buffer), 0);
+    if (received == 0) {
+      return false;
+    }
+    if (received < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client.request.append(buffer, static_cast<size_t>(received));
+    if (client.request.find("\r\n\r\n") != std::string::npos ||
+        client.request.find("\n\n") != std::string::npos ||
+        client.request.size() > kMaxRequestSize) {
+      ++requests_;
+      buildResponse(client.request, client.response);
+      return writeResponse(client);
+    }
+  }
+}
+
+bool MetricsHttpServer::writeResponse(Client &client) {
+  while (client.sent < client.response.size()) {
+    const ssize_t sent = send(client.socket, client.response.data() + client.sent,
+                              client.response.size() - client.sent, MSG_NOSIGNAL);
+    if (sent < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client.sent += static_cast<size_t>(sent);
+  }
+  return false; // Done; every response closes its connection
+}
+
+void MetricsHttpServer::buildResponse(const std::string &request, std::string &response) {
+  const size_t line_end = request.find_first_of("\r\n");
+  if (request.size() > kMaxRequestSize || line_end == std::string::npos) {
+    appendResponse(response, 400, "text/plain", "bad request\n", false);
+    return;
+  }
+  const std::string line = request.substr(0, line_end);
+  const size_t first = line.find(' ');
+  const size_t second = first == std::string::npos ? first : line.find(' ', first + 1);
+  if (second == std::string::npos) {
+    appendResponse(response, 400, "text/plain", "bad request\n", false);
+    return;
+  }
+  const std::string method = line.substr(0, first);
+  std::string path = line.substr(first + 1, second - first - 1);
+  path = path.substr(0, path.find('?'));
+  const bool head = method == "HEAD";
+  if (method != "GET" && !head) {
+    appendResponse(response, 405, "text/plain", "method not allowed\n", false);
+  } else if (path == "/metrics") {
+    appendResponse(response, 200, kMetricsContentType, cachedMetrics(), head);
+  } else if (path == "/health") {
+    const std::string report = health_();
+    const bool healthy = report.find("overall_status: healthy") != std::string::npos;
+    appendResponse(response, healthy ? 200 : 503, "text/plain", report, head);
+  } else {
+    appendResponse(response, 404, "text/plain", "not found\n", head);
+  }
+}
+
+const std::string &MetricsHttpServer::cachedMetrics() {
+  const auto now = std::chrono::steady_clock::now();
+  if (!metrics_valid_ || now - metrics_rendered_at_ >= config_->metrics_http_cache_interval) {
+    // Cleared, not replaced, so the buffer keeps its capacity.
+    metrics_cache_.clear();
+    metrics_(metrics_cache_);
+    metrics_rendered_at_ = now;
+    metrics_valid_ = true;
+    ++renders_;
+  }
+  return metrics_cache_;
+}
+
+bool fetchMetricsHttp(const std::string &address, port_t port, const std::string &path,
+                      int &status, std::string &body) {
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    return false;
+  }
+  socket_t sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock == INVALID_SOCKET) {
+    return false;
+  }
+  struct timeval timeout {2, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  const std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + address + "\r\n\r\n";
+  std::string reply;
+  bool ok = connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0 &&
+            send(sock, request.data(), request.size(), MSG_NOSIGNAL) ==
+                static_cast<ssize_t>(request.size());
+  char buffer[4096];
+  ssize_t received = 0;
+  while (ok && (received = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+    reply.append(buffer, static_cast<size_t>(received));
+  }
+  CLOSE_SOCKET(sock);
+  if (!ok || received < 0) {
+    return false;
+  }
+
+  const size_t header_end = reply.find("\r\n\r\n");
+  if (reply.compare(0, 5, "HTTP/") != 0 || header_end == std::string::npos) {
+    return false;
+  }
+  const size_t code = reply.find(' ');
+  if (code == std::string::npos || code > header_end) {
+    return false;
+  }
+  status = std::atoi(reply.c_str() + code + 1);
+  body = reply.substr(header_end + 4);
+  return status > 0;
+}
+
+} // namespace simple_ntpd
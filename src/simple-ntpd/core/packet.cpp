@@ -6,6 +6,9 @@
  * @license Apache-2.0
  */
 
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
 #include "simple-ntpd/core/packet.hpp"
 #include "simple-ntpd/utils/logger.hpp"
 #include <algorithm>
@@ -35,6 +38,56 @@ uint32_t readU32Be(const uint8_t *p) {
          static_cast<uint32_t>(p[3]);
 }
 
+// Reference ID from its text form: first four characters, NUL padded.
+uint32_t referenceIdFromString(const std::string &reference_id) {
+  uint32_t ref_id = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    const uint8_t c = i < reference_id.length() ? static_cast<uint8_t>(reference_id[i]) : 0;
+    ref_id = (ref_id << 8) | c;
+  }
+  return ref_id;
+}
+
+const EVP_MD *symmetricKeyDigest(NtpConfig::AuthAlgorithm algorithm) {
+  switch (algorithm) {
+  case NtpConfig::AuthAlgorithm::MD5:
+    return EVP_md5();
+  case NtpConfig::AuthAlgorithm::SHA1:
+    return EVP_sha1();
+  case NtpConfig::AuthAlgorithm::SHA256:
+    return EVP_sha256();
+  case NtpConfig::AuthAlgorithm::NONE:
+  default:
+    return nullptr;
+  }
+}
+
+// Digest of key || packet, truncated to the MAC length.
+bool symmetricKeyMac(const uint8_t *packet, size_t length, const std::string &key,
+                     NtpConfig::AuthAlgorithm algorithm, std::vector<uint8_t> &mac) {
+  const EVP_MD *md = symmetricKeyDigest(algorithm);
+  if (md == nullptr) {
+    return false;
+  }
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_len = 0;
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  if (!ctx) {
+    return false;
+  }
+  const bool ok = EVP_DigestInit_ex(ctx, md, nullptr) == 1 &&
+                  EVP_DigestUpdate(ctx, key.data(), key.size()) == 1 &&
+                  EVP_DigestUpdate(ctx, packet, length) == 1 &&
+                  EVP_DigestFinal_ex(ctx, digest, &digest_len) == 1;
+  EVP_MD_CTX_free(ctx);
+  const size_t mac_len = symmetricKeyDigestLength(algorithm);
+  if (!ok || digest_len < mac_len) {
+    return false;
+  }
+  mac.assign(digest, digest + mac_len);
+  return true;
+}
+
 void writeU32Be(uint8_t *p, uint32_t value) {
   p[0] = static_cast<uint8_t>((value >> 24) & 0xFF);
   p[1] = static_cast<uint8_t>((value >> 16) & 0xFF);
@@ -81,7 +134,7 @@ NtpPacket NtpPacket::createClientRequest() {
   packet.mode = static_cast<uint8_t>(NtpMode::CLIENT);
   packet.stratum = 0;
   packet.poll = 4;
-  packet.precision = -6;
+  packet.precision = systemClockPrecision();
 
   // Set transmit timestamp to current time
   auto now = std::chrono::system_clock::now();
@@ -90,6 +143,25 @@ NtpPacket NtpPacket::createClientRequest() {
   return packet;
 }
 
+NtpPacket NtpPacket::createBroadcastPacket(NtpStratum stratum,
+                                           const std::string &reference_id,
+                                           int8_t poll) {
+  NtpPacket packet;
+  packet.leap_indicator = 0;
+  packet.version = NTP_VERSION;
+  packet.mode = static_cast<uint8_t>(NtpMode::BROADCAST);
+  packet.stratum = static_cast<uint8_t>(stratum);
+  packet.poll = poll;
+  packet.precision = systemClockPrecision();
+
+  // Nothing to echo: only the transmit timestamp is set
+  const auto now = std::chrono::system_clock::now();
+  packet.reference_ts = NtpTimestamp::fromSystemTime(now);
+  packet.transmit_ts = NtpTimestamp::fromSystemTime(now);
+  packet.reference_id = referenceIdFromString(reference_id);
+  return packet;
+}
+
 NtpPacket NtpPacket::createServerResponse(const NtpPacket &client_packet,
                                           NtpStratum stratum,
                                           const std::string &reference_id) {
@@ -99,7 +171,7 @@ NtpPacket NtpPacket::createServerResponse(const NtpPacket &client_packet,
   packet.mode = static_cast<uint8_t>(NtpMode::SERVER);
   packet.stratum = static_cast<uint8_t>(stratum);
   packet.poll = 4;
-  packet.precision = -6;
+  packet.precision = systemClockPrecision();
 
   // Copy timestamps from client packet
   packet.originate_ts = client_packet.transmit_ts;
@@ -112,12 +184,7 @@ NtpPacket NtpPacket::createServerResponse(const NtpPacket &client_packet,
   packet.reference_ts =
       NtpTimestamp::fromSystemTime(std::chrono::system_clock::now());
 
-  // Convert reference_id string to uint32_t (first 4 characters)
-  uint32_t ref_id = 0;
-  for (size_t i = 0; i < std::min(reference_id.length(), size_t(4)); ++i) {
-    ref_id = (ref_id << 8) | static_cast<uint8_t>(reference_id[i]);
-  }
-  packet.reference_id = ref_id;
+  packet.reference_id = referenceIdFromString(reference_id);
 
   return packet;
 }
@@ -410,4 +477,93 @@ NtpTimestamp NtpTimestamp::now() {
   return fromSystemTime(std::chrono::system_clock::now());
 }
 
+uint32_t microsecondsToShortFormat(int64_t us) {
+  if (us <= 0) {
+    return 0;
+  }
+  const uint64_t value = (static_cast<uint64_t>(us) << 16) / 1000000ULL;
+  return value > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(value);
+}
+
+int64_t shortFormatToMicroseconds(uint32_t value) {
+  return static_cast<int64_t>((static_cast<uint64_t>(value) * 1000000ULL) >> 16);
+}
+
+int8_t measureClockPrecision() {
+  constexpr int kReadings = 2000;
+  using clock = std::chrono::system_clock;
+  auto previous = clock::now();
+  clock::duration tick = clock::duration::max();
+  for (int i = 0; i < kReadings; ++i) {
+    const auto current = clock::now();
+    if (current > previous) {
+      tick = std::min(tick, current - previous);
+    }
+    previous = current;
+  }
+  if (tick == clock::duration::max()) {
+    return -6; // Clock never advanced; fall back to the old constant
+  }
+
+  // Rounded log2 of the tick in seconds, as ntpd's default_get_precision.
+  double seconds = std::chrono::duration<double>(tick).count();
+  int exponent = 0;
+  while (seconds <= 1.0 && exponent < 30) {
+    seconds *= 2.0;
+    ++exponent;
+  }
+  if (seconds - 1.0 > 1.0 - seconds / 2.0) {
+    --exponent;
+  }
+  return static_cast<int8_t>(-exponent);
+}
+
+int8_t systemClockPrecision() {
+  static const int8_t precision = measureClockPrecision();
+  return precision;
+}
+
+size_t symmetricKeyDigestLength(NtpConfig::AuthAlgorithm algorithm) {
+  switch (algorithm) {
+  case NtpConfig::AuthAlgorithm::MD5:
+    return 16;
+  case NtpConfig::AuthAlgorithm::SHA1:
+  case NtpConfig::AuthAlgorithm::SHA256:
+    return 20;
+  case NtpConfig::AuthAlgorithm::NONE:
+  default:
+    return 0;
+  }
+}
+
+bool appendSymmetricKeyMac(std::vector<uint8_t> &data, uint32_t key_id,
+                           const std::string &key, NtpConfig::AuthAlgorithm algorithm) {
+  std::vector<uint8_t> mac;
+  if (!symmetricKeyMac(data.data(), data.size(), key, algorithm, mac)) {
+    return false;
+  }
+  const size_t offset = data.size();
+  data.resize(offset + 4);
+  writeU32Be(data.data() + offset, key_id);
+  data.insert(data.end(), mac.begin(), mac.end());
+  return true;
+}
+
+bool verifySymmetricKeyMac(const std::vector<uint8_t> &data,
+                           const std::unordered_map<uint32_t, std::string> &keys,
+                           NtpConfig::AuthAlgorithm algorithm, uint32_t &key_id) {
+  const size_t mac_len = symmetricKeyDigestLength(algorithm);
+  if (mac_len == 0 || data.size() != NTP_PACKET_SIZE + 4 + mac_len) {
+    return false;
+  }
+  key_id = readU32Be(data.data() + NTP_PACKET_SIZE);
+  const auto key = keys.find(key_id);
+  std::vector<uint8_t> expected;
+  if (key == keys.end() ||
+      !symmetricKeyMac(data.data(), NTP_PACKET_SIZE, key->second, algorithm, expected)) {
+    return false;
+  }
+  return CRYPTO_memcmp(expected.data(), data.data() + NTP_PACKET_SIZE + 4, mac_len) == 0;
+}
+
 } // namespace simple_ntpd
@@ -0,0 +1,126 @@
+/**
+ * @file refclock.cpp
+ * @brief Local reference clock drivers (ntpd/gpsd shared memory segment)
+ */
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "simple-ntpd/core/refclock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace simple_ntpd {
+
+ShmRefClock::ShmRefClock(int unit, const std::string &reference_id) : unit_(unit) {
+  // Reference IDs of local clocks are up to four ASCII characters, NUL padded.
+  uint32_t id = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    const uint8_t c = i < reference_id.size() ? static_cast<uint8_t>(reference_id[i]) : 0;
+    id = (id << 8) | c;
+  }
+  reference_id_ = id;
+}
+
+ShmRefClock::~ShmRefClock() {
+  if (segment_ != nullptr) {
+    shmdt(segment_);
+  }
+}
+
+std::string ShmRefClock::name() const { return "SHM(" + std::to_string(unit_) + ")"; }
+
+bool ShmRefClock::open(std::string &error) {
+  if (segment_ != nullptr) {
+    return true;
+  }
+  const int permissions = unit_ <= 1 ? 0600 : 0666;
+  const int id = shmget(static_cast<key_t>(kShmKeyBase + unit_), sizeof(ShmTimeSegment),
+                        IPC_CREAT | permissions);
+  if (id < 0) {
+    error = name() + ": shmget failed: " + std::strerror(errno);
+    return false;
+  }
+  void *address = shmat(id, nullptr, 0);
+  if (address == reinterpret_cast<void *>(-1)) {
+    error = name() + ": shmat failed: " + std::strerror(errno);
+    return false;
+  }
+  segment_ = static_cast<ShmTimeSegment *>(address);
+  return true;
+}
+
+bool ShmRefClock::poll(RefClockSample &sample) {
+  if (segment_ == nullptr) {
+    return false;
+  }
+  volatile ShmTimeSegment *shm = segment_;
+  if (!shm->valid) {
+    return false; // Nothing new since the last poll
+  }
+
+  // Mode 1 writers bump count before and after filling the segment; a
+  // changed count means we raced the writer and the sample is dropped.
+  const int mode = shm->mode;
+  const int count = shm->count;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const time_t clock_sec = shm->clock_sec;
+  const int clock_usec = shm->clock_usec;
+  const unsigned clock_nsec = shm->clock_nsec;
+  const time_t receive_sec = shm->receive_sec;
+  const int receive_usec = shm->receive_usec;
+  const unsigned receive_nsec = shm->receive_nsec;
+  const int leap = shm->leap;
+  const int precision = shm->precision;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const bool torn = mode == 1 && shm->count != count;
+  shm->valid = 0;
+  if (torn || (mode != 0 && mode != 1)) {
+    return false;
+  }
+
+  // Old writers only fill the microsecond fields; trust the nanosecond
+  // ones only when they agree (as ntpd does).
+  auto fraction = [](int usec, unsigned nsec) {
+    const int64_t from_usec = static_cast<int64_t>(usec) * 1000;
+    const int64_t ns = static_cast<int64_t>(nsec);
+    return static_cast<double>(ns >= from_usec && ns < from_usec + 1000 ? ns : from_usec) /
+           1e9;
+  };
+  const double clock_time = static_cast<double>(clock_sec) + fraction(clock_usec, clock_nsec);
+  sample.receive_time =
+      static_cast<double>(receive_sec) + fraction(receive_usec, receive_nsec);
+  sample.offset = clock_time - sample.receive_time;
+  sample.leap = leap & 0x3;
+  sample.precision = std::clamp(precision, -30, 0);
+  return true;
+}
+
+std::shared_ptr<RefClock> createRefClock(const NtpConfig &config,
+                                         std::shared_ptr<Logger> logger) {
+  if (!config.enable_reference_clock_support) {
+    return nullptr;
+  }
+  std::string source = config.reference_clock_source;
+  std::transform(source.begin(), source.end(), source.begin(), ::tolower);
+  if (source != "shm") {
+    return nullptr;
+  }
+  auto clock = std::make_shared<ShmRefClock>(config.reference_clock_shm_unit,
+                                             config.reference_clock_refid);
+  std::string error;
+  if (!clock->open(error)) {
+    if (logger) {
+      logger->error("Reference clock unavailable: " + error);
+    }
+    return nullptr;
+  }
+  if (logger) {
+    logger->info("Attached reference clock " + clock->name());
+  }
+  return clock;
+}
+
+} // namespace simple_ntpd
@@ -0,0 +1,570 @@
+/**
+ * @file roughtime.cpp
+ * @brief Roughtime message codec, Merkle batching, signer and UDP responder
+ */
+
+#include <arpa/inet.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/roughtime.hpp"
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace simple_ntpd {
+
+namespace {
+constexpr char kPacketMagic[] = "ROUGHTIM";
+constexpr size_t kPacketHeaderSize = 12; // Magic and message length
+constexpr size_t kMaxMessageTags = 64;
+constexpr size_t kEd25519KeySize = 32;
+constexpr size_t kEd25519SignatureSize = 64;
+
+uint32_t readLe32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void appendLe32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+RoughtimeHash truncatedSha512(const uint8_t prefix, const uint8_t *a, size_t a_len,
+                              const uint8_t *b, size_t b_len) {
+  uint8_t digest[64];
+  unsigned int digest_len = 0;
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(ctx, EVP_sha512(), nullptr);
+  EVP_DigestUpdate(ctx, &prefix, 1);
+  EVP_DigestUpdate(ctx, a, a_len);
+  if (b_len != 0) {
+    EVP_DigestUpdate(ctx, b, b_len);
+  }
+  EVP_DigestFinal_ex(ctx, digest, &digest_len);
+  EVP_MD_CTX_free(ctx);
+  RoughtimeHash hash;
+  std::memcpy(hash.data(), digest, hash.size());
+  return hash;
+}
+
+bool parseHexSeed(const std::string &text, std::vector<uint8_t> &seed) {
+  std::string hex;
+  for (char c : text) {
+    if (!std::isspace(static_cast<unsigned char>(c))) {
+      hex.push_back(c);
+    }
+  }
+  if (hex.size() != 2 * kEd25519KeySize) {
+    return false;
+  }
+  seed.clear();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    char *end = nullptr;
+    const std::string byte = hex.substr(i, 2);
+    const unsigned long value = std::strtoul(byte.c_str(), &end, 16);
+    if (end != byte.c_str() + 2) {
+      return false;
+    }
+    seed.push_back(static_cast<uint8_t>(value));
+  }
+  return true;
+}
+
+std::string toHex(const std::vector<uint8_t> &bytes) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  for (uint8_t b : bytes) {
+    out.push_back(digits[b >> 4]);
+    out.push_back(digits[b & 0x0f]);
+  }
+  return out;
+}
+
+std::vector<uint8_t> rawPublicKey(EVP_PKEY *key) {
+  std::vector<uint8_t> out(kEd25519KeySize);
+  size_t length = out.size();
+  if (key == nullptr || EVP_PKEY_get_raw_public_key(key, out.data(), &length) != 1) {
+    return {};
+  }
+  out.resize(length);
+  return out;
+}
+} // namespace
+
+void RoughtimeMessage::setUint32(uint32_t tag, uint32_t value) {
+  std::vector<uint8_t> bytes;
+  appendLe32(bytes, value);
+  set(tag, std::move(bytes));
+}
+
+void RoughtimeMessage::setUint64(uint32_t tag, uint64_t value) {
+  std::vector<uint8_t> bytes;
+  appendLe32(bytes, static_cast<uint32_t>(value));
+  appendLe32(bytes, static_cast<uint32_t>(value >> 32));
+  set(tag, std::move(bytes));
+}
+
+const std::vector<uint8_t> *RoughtimeMessage::find(uint32_t tag) const {
+  auto it = fields_.find(tag);
+  return it == fields_.end() ? nullptr : &it->second;
+}
+
+std::vector<uint8_t> RoughtimeMessage::serialize() const {
+  std::vector<uint8_t> out;
+  appendLe32(out, static_cast<uint32_t>(fields_.size()));
+  uint32_t offset = 0;
+  bool first = true;
+  for (const auto &field : fields_) {
+    if (!first) {
+      appendLe32(out, offset);
+    }
+    first = false;
+    offset += static_cast<uint32_t>((field.second.size() + 3) & ~size_t{3});
+  }
+  for (const auto &field : fields_) {
+    appendLe32(out, field.first);
+  }
+  for (const auto &field : fields_) {
+    out.insert(out.end(), field.second.begin(), field.second.end());
+    out.resize((out.size() + 3) & ~size_t{3}, 0);
+  }
+  return out;
+}
+
+bool RoughtimeMessage::parse(const uint8_t *data, size_t length) {
+  fields_.clear();
+  if (length < 4 || length % 4 != 0) {
+    return false;
+  }
+  const uint32_t count = readLe32(data);
+  if (count == 0) {
+    return length == 4;
+  }
+  if (count > kMaxMessageTags || length < 8 * static_cast<size_t>(count)) {
+    return false;
+  }
+  const size_t header = 8 * static_cast<size_t>(count);
+  const size_t values = length - header;
+  const uint8_t *offsets = data + 4;
+  const uint8_t *tags = offsets + 4 * (count - 1);
+
+  // Offsets are four-byte aligned and non-decreasing; tags strictly ascend.
+  size_t start = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const size_t end = i + 1 < count ? readLe32(offsets + 4 * i) : values;
+    const uint32_t tag = readLe32(tags + 4 * i);
+    if (end % 4 != 0 || end < start || end > values ||
+        (i > 0 && tag <= readLe32(tags + 4 * (i - 1)))) {
+      fields_.clear();
+      return false;
+    }
+    fields_[tag].assign(data + header + start, data + header + end);
+    start = end;
+  }
+  return true;
+}
+
+std::vector<uint8_t> wrapRoughtimePacket(const RoughtimeMessage &message) {
+  const std::vector<uint8_t> body = message.serialize();
+  std::vector<uint8_t> out(kPacketMagic, kPacketMagic + 8);
+  appendLe32(out, static_cast<uint32_t>(body.size()));
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+bool unwrapRoughtimePacket(const uint8_t *data, size_t length, RoughtimeMessage &message) {
+  if (length < kPacketHeaderSize || std::memcmp(data, kPacketMagic, 8) != 0) {
+    return false;
+  }
+  const uint32_t body_length = readLe32(data + 8);
+  if (body_length > length - kPacketHeaderSize) {
+    return false;
+  }
+  return message.parse(data + kPacketHeaderSize, body_length);
+}
+
+RoughtimeHash roughtimeLeafHash(const uint8_t *nonce, size_t length) {
+  return truncatedSha512(0x00, nonce, length, nullptr, 0);
+}
+
+RoughtimeHash roughtimeNodeHash(const RoughtimeHash &left, const RoughtimeHash &right) {
+  return truncatedSha512(0x01, left.data(), left.size(), right.data(), right.size());
+}
+
+RoughtimeMerkleTree::RoughtimeMerkleTree(std::vector<RoughtimeHash> leaves) {
+  if (leaves.empty()) {
+    leaves.push_back(roughtimeLeafHash(nullptr, 0));
+  }
+  levels_.push_back(std::move(leaves));
+  while (levels_.back().size() > 1) {
+    const std::vector<RoughtimeHash> &below = levels_.back();
+    std::vector<RoughtimeHash> level;
+    level.reserve((below.size() + 1) / 2);
+    for (size_t i = 0; i < below.size(); i += 2) {
+      const RoughtimeHash &right = i + 1 < below.size() ? below[i + 1] : below[i];
+      level.push_back(roughtimeNodeHash(below[i], right));
+    }
+    levels_.push_back(std::move(level));
+  }
+}
+
+std::vector<uint8_t> RoughtimeMerkleTree::path(size_t index) const {
+  std::vector<uint8_t> out;
+  for (size_t depth = 0; depth + 1 < levels_.size(); ++depth) {
+    const std::vector<RoughtimeHash> &level = levels_[depth];
+    size_t sibling = index ^ 1;
+    if (sibling >= level.size()) {
+      sibling = index; // Odd node out is paired with itself
+    }
+    out.insert(out.end(), level[sibling].begin(), level[sibling].end());
+    index >>= 1;
+  }
+  return out;
+}
+
+bool verifyRoughtimePath(const RoughtimeHash &leaf, uint32_t index,
+                         const std::vector<uint8_t> &path, const RoughtimeHash &root) {
+  if (path.size() % leaf.size() != 0) {
+    return false;
+  }
+  RoughtimeHash node = leaf;
+  for (size_t offset = 0; offset < path.size(); offset += leaf.size()) {
+    RoughtimeHash sibling;
+    std::memcpy(sibling.data(), path.data() + offset, sibling.size());
+    node = (index & 1) ? roughtimeNodeHash(sibling, node) : roughtimeNodeHash(node, sibling);
+    index >>= 1;
+  }
+  return index == 0 && node == root;
+}
+
+RoughtimeSigner::RoughtimeSigner() = default;
+
+RoughtimeSigner::~RoughtimeSigner() {
+  EVP_PKEY_free(long_term_);
+  EVP_PKEY_free(online_);
+}
+
+bool RoughtimeSigner::setLongTermSeed(const std::vector<uint8_t> &seed, std::string &error) {
+  if (seed.size() != kEd25519KeySize) {
+    error = "Ed25519 seed must be 32 bytes";
+    return false;
+  }
+  EVP_PKEY *key =
+      EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, nullptr, seed.data(), seed.size());
+  if (key == nullptr) {
+    error = "invalid Ed25519 seed";
+    return false;
+  }
+  EVP_PKEY_free(long_term_);
+  long_term_ = key;
+  // A new identity invalidates the delegation.
+  EVP_PKEY_free(online_);
+  online_ = nullptr;
+  cert_.clear();
+  return true;
+}
+
+bool RoughtimeSigner::generateLongTermKey(std::string &error) {
+  std::vector<uint8_t> seed(kEd25519KeySize);
+  if (RAND_bytes(seed.data(), static_cast<int>(seed.size())) != 1) {
+    error = "no randomness for the long-term key";
+    return false;
+  }
+  return setLongTermSeed(seed, error);
+}
+
+std::vector<uint8_t> RoughtimeSigner::longTermPublicKey() const {
+  return rawPublicKey(long_term_);
+}
+
+bool RoughtimeSigner::sign(EVP_PKEY *key, const char *context, size_t context_length,
+                           const std::vector<uint8_t> &message,
+                           std::vector<uint8_t> &signature) const {
+  // Ed25519 is one-shot: the context is prepended rather than streamed.
+  std::vector<uint8_t> input(context, context + context_length);
+  input.insert(input.end(), message.begin(), message.end());
+  signature.assign(kEd25519SignatureSize, 0);
+  size_t length = signature.size();
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  const bool ok = ctx != nullptr && EVP_DigestSignInit(ctx, nullptr, nullptr, nullptr, key) == 1 &&
+                  EVP_DigestSign(ctx, signature.data(), &length, input.data(), input.size()) == 1;
+  EVP_MD_CTX_free(ctx);
+  return ok && length == kEd25519SignatureSize;
+}
+
+bool RoughtimeSigner::rotate(int64_t now, int64_t lifetime, std::string &error) {
+  if (long_term_ == nullptr) {
+    error = "no long-term key";
+    return false;
+  }
+  std::vector<uint8_t> seed(kEd25519KeySize);
+  if (RAND_bytes(seed.data(), static_cast<int>(seed.size())) != 1) {
+    error = "no randomness for the online key";
+    return false;
+  }
+  EVP_PKEY *online =
+      EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, nullptr, seed.data(), seed.size());
+  if (online == nullptr) {
+    error = "failed to create the online key";
+    return false;
+  }
+
+  // Valid a little before now so a client clock slightly behind ours still
+  // accepts the delegation.
+  RoughtimeMessage dele;
+  dele.set(kRoughtimeTagPUBK, rawPublicKey(online));
+  dele.setUint64(kRoughtimeTagMINT, static_cast<uint64_t>(now - 60));
+  dele.setUint64(kRoughtimeTagMAXT, static_cast<uint64_t>(now + lifetime));
+  const std::vector<uint8_t> dele_bytes = dele.serialize();
+  std::vector<uint8_t> signature;
+  if (!sign(long_term_, kRoughtimeDelegationContext, sizeof(kRoughtimeDelegationContext),
+            dele_bytes, signature)) {
+    EVP_PKEY_free(online);
+    error = "failed to sign the delegation";
+    return false;
+  }
+
+  RoughtimeMessage cert;
+  cert.set(kRoughtimeTagDELE, dele_bytes);
+  cert.set(kRoughtimeTagSIG, std::move(signature));
+  cert_ = cert.serialize();
+  EVP_PKEY_free(online_);
+  online_ = online;
+  rotate_at_ = now + lifetime / 2;
+  expires_at_ = now + lifetime;
+  return true;
+}
+
+std::vector<std::vector<uint8_t>>
+RoughtimeSigner::respond(const std::vector<std::vector<uint8_t>> &nonces, uint64_t midpoint,
+                         uint32_t radius) {
+  // Clients reject a response outside MINT..MAXT, so do not sign one.
+  if (nonces.empty() || expired(static_cast<int64_t>(midpoint))) {
+    return {};
+  }
+  std::vector<RoughtimeHash> leaves;
+  leaves.reserve(nonces.size());
+  for (const auto &nonce : nonces) {
+    leaves.push_back(roughtimeLeafHash(nonce.data(), nonce.size()));
+  }
+  const RoughtimeMerkleTree tree(std::move(leaves));
+
+  // One signature over the signed response covers the whole batch.
+  RoughtimeMessage srep;
+  srep.set(kRoughtimeTagROOT, std::vector<uint8_t>(tree.root().begin(), tree.root().end()));
+  srep.setUint64(kRoughtimeTagMIDP, midpoint);
+  srep.setUint32(kRoughtimeTagRADI, radius);
+  std::vector<uint8_t> srep_bytes = srep.serialize();
+  std::vector<uint8_t> signature;
+  if (!sign(online_, kRoughtimeResponseContext, sizeof(kRoughtimeResponseContext), srep_bytes,
+            signature)) {
+    return {};
+  }
+
+  RoughtimeMessage response;
+  response.set(kRoughtimeTagSIG, std::move(signature));
+  response.setUint32(kRoughtimeTagVER, kRoughtimeVersion);
+  response.set(kRoughtimeTagSREP, std::move(srep_bytes));
+  response.set(kRoughtimeTagCERT, cert_);
+  std::vector<std::vector<uint8_t>> out;
+  out.reserve(nonces.size());
+  for (size_t i = 0; i < nonces.size(); ++i) {
+    response.set(kRoughtimeTagNONC, nonces[i]);
+    response.set(kRoughtimeTagPATH, tree.path(i));
+    response.setUint32(kRoughtimeTagINDX, static_cast<uint32_t>(i));
+    out.push_back(wrapRoughtimePacket(response));
+  }
+  return out;
+}
+
+RoughtimeServer::RoughtimeServer(std::shared_ptr<NtpConfig> config,
+                                 std::shared_ptr<Logger> logger, TimeSource time_source)
+    : config_(std::move(config)), logger_(std::move(logger)),
+      time_source_(std::move(time_source)) {}
+
+RoughtimeServer::~RoughtimeServer() { stop(); }
+
+bool RoughtimeServer::loadKey(std::string &error) {
+  if (config_->roughtime_key_file.empty()) {
+    if (!signer_.generateLongTermKey(error)) {
+      return false;
+    }
+    logger_->warning("Roughtime: no roughtime_key_file, using an ephemeral long-term key " +
+                     toHex(signer_.longTermPublicKey()));
+    return true;
+  }
+  std::ifstream file(config_->roughtime_key_file);
+  if (!file) {
+    error = "cannot read " + config_->roughtime_key_file;
+    return false;
+  }
+  std::stringstream content;
+  content << file.rdbuf();
+  std::vector<uint8_t> seed;
+  if (!parseHexSeed(content.str(), seed)) {
+    error = config_->roughtime_key_file + ": expected a 64 hex digit Ed25519 seed";
+    return false;
+  }
+  return signer_.setLongTermSeed(seed, error);
+}
+
+bool RoughtimeServer::start() {
+  if (running_) {
+    return true;
+  }
+  std::string error;
+  const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+  if (!loadKey(error) || !signer_.rotate(now, config_->roughtime_key_lifetime.count(), error)) {
+    logger_->error("Roughtime: " + error);
+    return false;
+  }
+
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock == INVALID_SOCKET) {
+    logger_->error("Roughtime: socket failed: " + std::string(std::strerror(errno)));
+    return false;
+  }
+  const int on = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(config_->roughtime_port);
+  if (inet_pton(AF_INET, config_->listen_address.c_str(), &addr.sin_addr) != 1 ||
+      bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    logger_->error("Roughtime: failed to bind " + config_->listen_address + ":" +
+                   std::to_string(config_->roughtime_port) + ": " + std::strerror(errno));
+    CLOSE_SOCKET(sock);
+    return false;
+  }
+  socket_ = sock;
+  running_ = true;
+  thread_ = std::thread(&RoughtimeServer::serveLoop, this);
+  logger_->info("Roughtime responder on " + config_->listen_address + ":" +
+                std::to_string(config_->roughtime_port) + ", public key " +
+                toHex(signer_.longTermPublicKey()));
+  return true;
+}
+
+void RoughtimeServer::stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (socket_ != INVALID_SOCKET) {
+    CLOSE_SOCKET(socket_);
+    socket_ = INVALID_SOCKET;
+  }
+}
+
+void RoughtimeServer::serveLoop() {
+  const size_t batch_size = static_cast<size_t>(config_->roughtime_batch_size);
+  const auto window = config_->roughtime_batch_window;
+  std::vector<uint8_t> buffer(65536);
+  std::vector<std::vector<uint8_t>> nonces;
+  std::vector<struct sockaddr_storage> peers;
+  std::vector<socklen_t> peer_lengths;
+
+  while (running_) {
+    // The first request opens the window; the batch is answered when it is
+    // full or the window closes, whichever comes first.
+    std::chrono::steady_clock::time_point deadline{};
+    while (running_ && nonces.size() < batch_size) {
+      int timeout_ms = 100;
+      if (!nonces.empty()) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+          break;
+        }
+        timeout_ms = static_cast<int>(left.count());
+      }
+      struct pollfd pfd {socket_, POLLIN, 0};
+      if (::poll(&pfd, 1, timeout_ms) <= 0) {
+        continue;
+      }
+      struct sockaddr_storage from {};
+      socklen_t from_len = sizeof(from);
+      const ssize_t received =
+          recvfrom(socket_, buffer.data(), buffer.size(), MSG_DONTWAIT,
+                   reinterpret_cast<struct sockaddr *>(&from), &from_len);
+      if (received <= 0) {
+        continue;
+      }
+      ++requests_;
+
+      // Requests are padded to at least 1 KiB so that a response can never
+      // amplify; anything else, or without a 32-byte nonce, is dropped.
+      RoughtimeMessage request;
+      if (static_cast<size_t>(received) < kRoughtimeMinRequestSize ||
+          !unwrapRoughtimePacket(buffer.data(), static_cast<size_t>(received), request)) {
+        continue;
+      }
+      const std::vector<uint8_t> *nonce = request.find(kRoughtimeTagNONC);
+      if (nonce == nullptr || nonce->size() != kRoughtimeNonceSize) {
+        continue;
+      }
+      if (const std::vector<uint8_t> *versions = request.find(kRoughtimeTagVER)) {
+        bool supported = false;
+        for (size_t i = 0; i + 4 <= versions->size(); i += 4) {
+          supported = supported || readLe32(versions->data() + i) == kRoughtimeVersion;
+        }
+        if (!supported) {
+          continue;
+        }
+      }
+      if (nonces.empty()) {
+        deadline = std::chrono::steady_clock::now() + window;
+      }
+      nonces.push_back(*nonce);
+      peers.push_back(from);
+      peer_lengths.push_back(from_len);
+    }
+    if (!nonces.empty()) {
+      answerBatch(nonces, peers, peer_lengths);
+    }
+  }
+}
+
+void RoughtimeServer::answerBatch(std::vector<std::vector<uint8_t>> &nonces,
+                                  std::vector<struct sockaddr_storage> &peers,
+                                  std::vector<socklen_t> &peer_lengths) {
+  uint64_t midpoint = 0;
+  uint32_t radius = 0;
+  if (time_source_(midpoint, radius)) {
+    const int64_t now = static_cast<int64_t>(midpoint);
+    std::string error;
+    if (signer_.needsRotation(now) &&
+        !signer_.rotate(now, config_->roughtime_key_lifetime.count(), error)) {
+      logger_->error("Roughtime: online key rotation failed: " + error);
+    }
+    if (signer_.expired(now)) {
+      logger_->error("Roughtime: online key delegation has expired, not answering " +
+                     std::to_string(nonces.size()) + " request(s)");
+    }
+    const auto responses = signer_.respond(nonces, midpoint, radius);
+    for (size_t i = 0; i < responses.size(); ++i) {
+      if (sendto(socket_, responses[i].data(), responses[i].size(), 0,
+                 reinterpret_cast<const struct sockaddr *>(&peers[i]), peer_lengths[i]) > 0) {
+        ++responses_;
+      }
+    }
+    ++batches_;
+  }
+  nonces.clear();
+  peers.clear();
+  peer_lengths.clear();
+}
+
+} // namespace simple_ntpd
@@ -11,10 +11,15 @@
 #include "simple-ntpd/config/config.hpp"
 #include "simple-ntpd/core/connection.hpp"
 #include "simple-ntpd/utils/net.hpp"
+#include "simple-ntpd/utils/string_sink.hpp"
+#include "simple-ntpd/utils/trace.hpp"
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <thread>
 #if !__has_include(<filesystem>)
@@ -46,19 +51,23 @@ NtpServer::NtpServer(std::shared_ptr<NtpConfig> config,
       workers_running_(false),
       config_watch_thread_(), config_watch_running_(false),
       config_mtime_initialized_(false),
-      stats_(), stats_mutex_(),
+      stats_start_time_(), stats_mutex_(), worker_stats_(), worker_latency_(),
+      worker_stages_(),
       config_change_callback_(),
       last_cleanup_time_(std::chrono::steady_clock::now()),
       cleanup_interval_(std::chrono::seconds(300)),
       restart_count_(0),
-      healthy_upstreams_(),
-      upstream_rr_index_(0),
       security_mutex_(),
       connection_rate_buckets_(),
-      request_second_buckets_(),
-      rng_(std::random_device{}()) {
+      request_second_buckets_() {
+
+  // Measure before serving so the first response does not pay for it.
+  const int8_t precision = systemClockPrecision();
+  precision_dispersion_ = std::max<uint32_t>(
+      1, microsecondsToShortFormat(static_cast<int64_t>(std::ldexp(1e6, precision))));
 
   logger_->info("NTP Server initialized with configuration");
+  logger_->debug("Measured clock precision: 2^" + std::to_string(precision) + " s");
   logger_->debug("Server will listen on " + config->listen_address + ":" +
                  std::to_string(config->listen_port));
 }
@@ -100,6 +109,23 @@ bool NtpServer::start() {
     return false;
   }
 
+  capture_.reset();
+  if (config_->enable_packet_capture) {
+    CaptureFilter filter;
+    filter.sample_every = static_cast<uint32_t>(config_->capture_sample_every);
+    filter.drops_only = config_->capture_drops_only;
+    if (!config_->capture_client_prefix.empty()) {
+      parseIpv4Cidr(config_->capture_client_prefix, filter.network, filter.mask);
+    }
+    // Replies leave from the listen address; 0.0.0.0 when bound to all.
+    struct in_addr listen {};
+    inet_pton(AF_INET, config_->listen_address.c_str(), &listen);
+    capture_ = std::make_unique<PacketCapture>(static_cast<size_t>(config_->capture_ring_size),
+                                               filter, listen.s_addr,
+                                               static_cast<uint16_t>(config_->listen_port),
+                                               static_cast<size_t>(config_->worker_threads));
+  }
+
   // Start worker threads
   startWorkerThreads();
 
@@ -107,17 +133,60 @@ bool NtpServer::start() {
   startConfigWatcher();
 
   running_ = true;
-  stats_.start_time = std::chrono::steady_clock::now();
-  loadState();
-  healthy_upstreams_ = config_->upstream_servers;
+  stats_start_time_ = std::chrono::steady_clock::now();
 
-  if (!config_->upstream_servers.empty()) {
+  if (config_->hasSyncSources()) {
     upstream_sync_ =
         std::make_shared<UpstreamSyncManager>(config_, logger_);
+  }
+  loadLeapSeconds();
+
+  // Warm start the sync manager before its first round.
+  loadState();
+  if (upstream_sync_) {
     upstream_sync_->start();
     logger_->info("Upstream synchronization started (" +
                    std::to_string(config_->upstream_servers.size()) +
-                   " server(s))");
+                   " server(s), " + std::to_string(config_->upstream_pools.size()) +
+                   " pool(s))");
+  }
+
+  if (config_->enable_broadcast && !startBroadcast()) {
+    logger_->error("Broadcast mode disabled; serving unicast only");
+  }
+  if (config_->enable_roughtime) {
+    roughtime_ = std::make_unique<RoughtimeServer>(
+        config_, logger_,
+        [this](uint64_t &midpoint, uint32_t &radius) { return roughtimeNow(midpoint, radius); });
+    if (!roughtime_->start()) {
+      logger_->error("Roughtime responder disabled");
+    }
+  }
+  if (config_->enable_metrics_http) {
+    metrics_http_ = std::make_unique<MetricsHttpServer>(
+        config_, logger_, [this](std::string &out) { appendPrometheusMetrics(out); },
+        [this] { return runHealthChecks(); });
+    if (!metrics_http_->start()) {
+      logger_->error("Metrics HTTP endpoint disabled");
+    }
+  }
+  if (config_->enable_control_socket) {
+    control_ = std::make_unique<ControlServer>(
+        config_->control_socket_path, logger_,
+        [this](const std::string &command, const ControlSink &sink) {
+          handleControlCommand(command, sink);
+        });
+    if (!control_->start()) {
+      logger_->error("Control socket disabled");
+    }
+  }
+  if (config_->enable_stats_segment && !startStatsSegment()) {
+    logger_->error("Statistics segment disabled");
+  }
+  if (config_->enable_stage_accounting) {
+    // Calibrate now rather than on the first status or metrics request.
+    logger_->info("Stage accounting on; cycle counter at " +
+                  std::to_string(static_cast<uint64_t>(cycleCounterHz())) + " Hz");
   }
 
   logger_->info("NTP Server started successfully");
@@ -171,6 +240,7 @@ bool NtpServer::reloadConfig() {
 
   // Replace config pointer
   config_ = new_config;
+  loadLeapSeconds();
   logger_->info("Configuration reloaded successfully");
   if (config_change_callback_) {
     config_change_callback_();
@@ -187,10 +257,22 @@ void NtpServer::stop() {
 
   running_ = false;
 
+  stopStatsSegment();
+  if (control_) {
+    control_->stop();
+  }
+  if (metrics_http_) {
+    metrics_http_->stop();
+  }
+  stopBroadcast();
+  if (roughtime_) {
+    roughtime_->stop();
+  }
   if (upstream_sync_) {
     upstream_sync_->stop();
-    upstream_sync_.reset();
   }
+  persistState();
+  upstream_sync_.reset();
 
   // Stop worker threads
   stopWorkerThreads();
@@ -200,12 +282,17 @@ void NtpServer::stop() {
 
   // Close all connections
   cleanupConnections();
-  persistState();
   backupConfig();
 
   // Cleanup socket
   closeSocket();
 
+  // Last copy for readers: final counters, marked stopped.
+  if (stats_segment_.isOpen()) {
+    stats_segment_.publish(collectStatsSegment());
+    stats_segment_.close();
+  }
+
   logger_->info("NTP Server stopped");
 }
 
@@ -235,6 +322,13 @@ bool NtpServer::initializeSocket() {
                      std::string(std::strerror(errno)));
   }
 
+#ifdef SO_TIMESTAMPNS
+  // Kernel receive timestamps feed the kernel-to-user and residence histograms.
+  if (setsockopt(server_socket_, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) < 0) {
+    logger_->warning("Failed to set SO_TIMESTAMPNS: " + std::string(std::strerror(errno)));
+  }
+#endif
+
 #ifndef _WIN32
   int flags = fcntl(server_socket_, F_GETFL, 0);
   if (flags < 0 || fcntl(server_socket_, F_SETFL, flags | O_NONBLOCK) < 0) {
@@ -348,12 +442,22 @@ bool NtpServer::bindSocket() {
 void NtpServer::startWorkerThreads() {
   size_t thread_count = config_->worker_threads;
 
+  // Must be set before spawning, or a worker may see false and exit at once.
+  workers_running_ = true;
+
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    while (worker_stats_.size() < thread_count) {
+      worker_stats_.push_back(std::make_unique<SeqLock<WorkerStats>>());
+      worker_latency_.push_back(std::make_unique<WorkerLatency>());
+      worker_stages_.push_back(std::make_unique<WorkerStages>());
+    }
+  }
+
   for (size_t i = 0; i < thread_count; ++i) {
     worker_threads_.emplace_back(&NtpServer::workerThreadFunction, this, i);
     logger_->debug("Started worker thread " + std::to_string(i));
   }
-
-  workers_running_ = true;
 }
 
 void NtpServer::stopWorkerThreads() {
@@ -372,9 +476,22 @@ void NtpServer::stopWorkerThreads() {
 void NtpServer::workerThreadFunction(size_t thread_id) {
   logger_->debug("Worker thread " + std::to_string(thread_id) + " started");
 
+  // Blocks are only added, never moved, so the reference stays valid. A
+  // restarted worker carries on from what its predecessor published.
+  SeqLock<WorkerStats> *published = nullptr;
+  WorkerLatency *latency = nullptr;
+  WorkerStages *stages = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    published = worker_stats_[thread_id].get();
+    latency = worker_latency_[thread_id].get();
+    stages = worker_stages_[thread_id].get();
+  }
+  WorkerStats stats = published->load();
+
   while (workers_running_) {
     // Process incoming packets
-    processIncomingPackets();
+    processIncomingPackets(thread_id, stats, *published, *latency, *stages);
 
     // Clean up inactive connections
     cleanupConnections();
@@ -386,17 +503,54 @@ void NtpServer::workerThreadFunction(size_t thread_id) {
   logger_->debug("Worker thread " + std::to_string(thread_id) + " stopped");
 }
 
-void NtpServer::processIncomingPackets() {
+namespace {
+int64_t unixNanoseconds(std::chrono::system_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+CapturedExchange makeExchange(const std::vector<uint8_t> &request,
+                              const struct sockaddr_in &client_addr,
+                              std::chrono::system_clock::time_point received) {
+  CapturedExchange exchange;
+  exchange.received_unix_ns = unixNanoseconds(received);
+  exchange.client_addr = client_addr.sin_addr.s_addr;
+  exchange.client_port = ntohs(client_addr.sin_port);
+  exchange.request_length = static_cast<uint16_t>(request.size());
+  std::memcpy(exchange.request, request.data(),
+              std::min(request.size(), CapturedExchange::kMaxBytes));
+  return exchange;
+}
+} // namespace
+
+void NtpServer::processIncomingPackets(size_t worker, WorkerStats &stats,
+                                       SeqLock<WorkerStats> &published, WorkerLatency &latency,
+                                       WorkerStages &stages) {
   std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
   struct sockaddr_in client_addr;
-  socklen_t client_addr_len = sizeof(client_addr);
 
   while (workers_running_) {
     std::memset(&client_addr, 0, sizeof(client_addr));
+    StageTimer timer(config_->enable_stage_accounting ? &stages : nullptr);
+    timer.start();
 
+#ifndef _WIN32
+    // recvmsg rather than recvfrom to pick up the kernel receive timestamp.
+    struct iovec iov {buffer.data(), buffer.size()};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr msg {};
+    msg.msg_name = &client_addr;
+    msg.msg_namelen = sizeof(client_addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t bytes_received = recvmsg(server_socket_, &msg, 0);
+#else
+    socklen_t client_addr_len = sizeof(client_addr);
     ssize_t bytes_received = recvfrom(
         server_socket_, buffer.data(), buffer.size(), 0,
         reinterpret_cast<struct sockaddr *>(&client_addr), &client_addr_len);
+#endif
 
     if (bytes_received < 0) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -423,9 +577,34 @@ void NtpServer::processIncomingPackets() {
       continue;
     }
 
+    // Without a kernel timestamp, the residence time starts here.
+    const auto user_received = std::chrono::system_clock::now();
+    auto received = user_received;
+#if !defined(_WIN32) && defined(SO_TIMESTAMPNS)
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+        struct timespec ts {};
+        std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        received = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+        const auto queued = user_received - received;
+        if (queued.count() >= 0) {
+          latency.kernel_to_user.record(static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(queued).count()));
+        }
+      }
+    }
+#endif
+    timer.mark(PipelineStage::RECEIVE);
+    SIMPLE_NTPD_PROBE3(packet__receive, client_addr.sin_addr.s_addr,
+                       ntohs(client_addr.sin_port), bytes_received);
+
     // Process the received packet
     buffer.resize(bytes_received);
-    processPacket(buffer, client_addr);
+    processPacket(buffer, client_addr, worker, stats, latency, received, timer);
+    published.store(stats);
 
     // Reset buffer size for next iteration
     buffer.resize(NTP_PACKET_SIZE);
@@ -433,37 +612,50 @@ void NtpServer::processIncomingPackets() {
 }
 
 void NtpServer::processPacket(const std::vector<uint8_t> &data,
-                              const struct sockaddr_in &client_addr) {
+                              const struct sockaddr_in &client_addr, size_t worker,
+                              WorkerStats &stats, WorkerLatency &latency,
+                              std::chrono::system_clock::time_point received,
+                              StageTimer &timer) {
   auto start_us = std::chrono::steady_clock::now();
   char client_ip[INET_ADDRSTRLEN];
   inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
   uint16_t client_port = ntohs(client_addr.sin_port);
   const std::string client_ip_str(client_ip);
 
-  if (!isClientAllowed(client_ip_str)) {
+  const bool allowed = isClientAllowed(client_ip_str);
+  timer.mark(PipelineStage::ACL);
+  if (!allowed) {
+    noteDrop(data, client_addr, worker, received, DropReason::ACL);
     logger_->warning("Dropped packet from ACL-restricted client " + client_ip_str);
-    stats_.total_errors++;
+    stats.errors++;
     return;
   }
 
   if (isRateLimitExceeded(client_ip_str)) {
+    timer.mark(PipelineStage::RATE_LIMIT);
+    noteDrop(data, client_addr, worker, received, DropReason::RATE_LIMIT);
     logger_->warning("Dropped packet due to connection/request rate limit for " +
                      client_ip_str);
-    stats_.total_errors++;
+    stats.errors++;
     return;
   }
 
-  if (isDdosAnomaly(client_ip_str)) {
+  const bool anomaly = isDdosAnomaly(client_ip_str);
+  timer.mark(PipelineStage::RATE_LIMIT);
+  if (anomaly) {
     logger_->warning("Potential DDoS anomaly detected for " + client_ip_str);
     if (config_ && config_->enable_graceful_degradation) {
-      stats_.total_errors++;
+      noteDrop(data, client_addr, worker, received, DropReason::DDOS);
+      stats.errors++;
       return;
     }
   }
 
   // Create or get connection for this client
-  auto connection = getOrCreateConnection(client_ip_str, client_port);
+  auto connection = getOrCreateConnection(client_ip_str, client_port, stats);
+  timer.mark(PipelineStage::LOOKUP);
   if (!connection) {
+    noteDrop(data, client_addr, worker, received, DropReason::CONNECTION);
     logger_->warning("Failed to create connection for " +
                      std::string(client_ip) + ":" +
                      std::to_string(client_port));
@@ -473,79 +665,101 @@ void NtpServer::processPacket(const std::vector<uint8_t> &data,
   // Process the packet
   if (connection->handlePacket(data)) {
     NtpPacket request_packet;
-    if (!request_packet.parseFromData(data)) {
+    const bool parsed = request_packet.parseFromData(data);
+    timer.mark(PipelineStage::PARSE);
+    if (!parsed) {
+      noteDrop(data, client_addr, worker, received, DropReason::PARSE);
       logger_->warning("Failed to parse packet for response generation from " +
                        std::string(client_ip));
-      stats_.total_errors++;
+      stats.errors++;
       return;
     }
 
-    NtpStratum response_stratum = config_->stratum;
-    if (upstream_sync_ && upstream_sync_->isSynced()) {
-      response_stratum = static_cast<NtpStratum>(upstream_sync_->effectiveStratum(
-          static_cast<uint8_t>(config_->stratum)));
-    }
-
     NtpPacket response_packet = NtpPacket::createServerResponse(
-        request_packet, response_stratum, effectiveReferenceId());
-    applyDynamicStratum();
-
-    if (upstream_sync_) {
-      const int64_t offset_us = upstream_sync_->clockOffsetUs();
-      if (offset_us != 0) {
-        const auto offset = std::chrono::microseconds(offset_us);
-        response_packet.receive_ts = NtpTimestamp::fromSystemTime(
-            response_packet.receive_ts.toSystemTime() + offset);
-        response_packet.transmit_ts = NtpTimestamp::fromSystemTime(
-            response_packet.transmit_ts.toSystemTime() + offset);
+        request_packet, config_->stratum, effectiveReferenceId());
+    applyDynamicStratum(stats);
+    const bool synced = applySyncState(response_packet);
+
+    // A symmetric active peer gets a passive reply. Siblings must not follow
+    // a node that has lost its own sources, so that is sent as unsynchronized:
+    // LI 3 and stratum 16. Stratum 0 would read as a kiss-o'-death.
+    if (request_packet.mode == static_cast<uint8_t>(NtpMode::SYMMETRIC_ACTIVE)) {
+      response_packet.mode = static_cast<uint8_t>(NtpMode::SYMMETRIC_PASSIVE);
+      if (upstream_sync_ && !synced) {
+        response_packet.leap_indicator = 3;
+        response_packet.stratum = 16;
       }
     }
-    const std::string selected_upstream = selectUpstreamServer();
-    if (!selected_upstream.empty()) {
-      logger_->debug("Selected upstream server: " + selected_upstream);
-    }
+
     auto response_data = response_packet.serializeToData();
+    const auto residence = std::chrono::system_clock::now() - received;
+    if (residence.count() >= 0) {
+      latency.residence.record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(residence).count()));
+    }
+    timer.mark(PipelineStage::BUILD);
     ssize_t bytes_sent = sendto(
         server_socket_, response_data.data(), response_data.size(), 0,
         reinterpret_cast<const struct sockaddr *>(&client_addr),
         sizeof(client_addr));
+    timer.mark(PipelineStage::SEND);
     if (bytes_sent < 0) {
+      noteDrop(data, client_addr, worker, received, DropReason::SEND);
       logger_->error("Failed to send NTP response to " + std::string(client_ip) +
                      ":" + std::to_string(client_port) + ": " +
                      std::string(std::strerror(errno)));
-      stats_.total_errors++;
-      if (config_ && config_->enable_upstream_failover && !selected_upstream.empty()) {
-        auto it = std::find(healthy_upstreams_.begin(), healthy_upstreams_.end(),
-                            selected_upstream);
-        if (it != healthy_upstreams_.end()) {
-          healthy_upstreams_.erase(it);
-        }
-      }
+      stats.errors++;
       return;
     }
 
-    stats_.total_requests++;
-    stats_.total_bytes_transferred += data.size();
-    stats_.total_responses++;
+    SIMPLE_NTPD_PROBE4(response__send, client_addr.sin_addr.s_addr, client_port,
+                       response_packet.stratum,
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(residence).count());
+    if (capture_ && capture_->matches(client_addr.sin_addr.s_addr, false, worker)) {
+      CapturedExchange exchange = makeExchange(data, client_addr, received);
+      exchange.sent_unix_ns = unixNanoseconds(received + residence);
+      exchange.response_length = static_cast<uint16_t>(response_data.size());
+      std::memcpy(exchange.response, response_data.data(),
+                  std::min(response_data.size(), CapturedExchange::kMaxBytes));
+      capture_->record(exchange);
+    }
+
+    stats.requests++;
+    stats.bytes += data.size();
+    stats.responses++;
   } else {
-    stats_.total_errors++;
+    timer.mark(PipelineStage::PARSE);
+    noteDrop(data, client_addr, worker, received, DropReason::INVALID);
+    stats.errors++;
   }
 
   auto end_us = std::chrono::steady_clock::now();
   auto dur_us = std::chrono::duration_cast<std::chrono::microseconds>(end_us - start_us).count();
-  stats_.total_request_processing_time_us += static_cast<uint64_t>(dur_us);
-  stats_.processed_request_count++;
-  if (static_cast<uint64_t>(dur_us) > stats_.max_request_processing_time_us) {
-    stats_.max_request_processing_time_us = static_cast<uint64_t>(dur_us);
-  }
-  if (static_cast<uint64_t>(dur_us) < stats_.min_request_processing_time_us) {
-    stats_.min_request_processing_time_us = static_cast<uint64_t>(dur_us);
+  latency.processing.record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end_us - start_us).count()));
+  stats.processing_time_us += static_cast<uint64_t>(dur_us);
+  stats.processed++;
+  stats.max_processing_time_us =
+      std::max(stats.max_processing_time_us, static_cast<uint64_t>(dur_us));
+  stats.min_processing_time_us =
+      std::min(stats.min_processing_time_us, static_cast<uint64_t>(dur_us));
+}
+
+void NtpServer::noteDrop(const std::vector<uint8_t> &data, const struct sockaddr_in &client_addr,
+                         size_t worker, std::chrono::system_clock::time_point received,
+                         DropReason reason) {
+  SIMPLE_NTPD_PROBE3(packet__drop, client_addr.sin_addr.s_addr, ntohs(client_addr.sin_port),
+                     dropReasonName(reason));
+  if (capture_ && capture_->matches(client_addr.sin_addr.s_addr, true, worker)) {
+    CapturedExchange exchange = makeExchange(data, client_addr, received);
+    exchange.drop = reason;
+    capture_->record(exchange);
   }
 }
 
 std::shared_ptr<NtpConnection>
 NtpServer::getOrCreateConnection(const std::string &client_ip,
-                                 uint16_t client_port) {
+                                 uint16_t client_port, WorkerStats &stats) {
   std::lock_guard<std::mutex> lock(connections_mutex_);
 
   std::string client_key = client_ip + ":" + std::to_string(client_port);
@@ -564,8 +778,8 @@ NtpServer::getOrCreateConnection(const std::string &client_ip,
   if (connection) {
     connection->setTrusted(isClientAllowed(client_ip));
     active_connections_[client_key] = connection;
-    stats_.total_connections++;
-    stats_.active_connections++;
+    active_connection_count_.store(active_connections_.size(), std::memory_order_relaxed);
+    stats.connections++;
     return connection;
   }
 
@@ -591,11 +805,11 @@ void NtpServer::cleanupConnections() {
   while (it != active_connections_.end()) {
     if (!it->second->isActive()) {
       it = active_connections_.erase(it);
-      stats_.active_connections--;
     } else {
       ++it;
     }
   }
+  active_connection_count_.store(active_connections_.size(), std::memory_order_relaxed);
 }
 
 std::shared_ptr<NtpConfig> NtpServer::getConfig() const { return config_; }
@@ -604,34 +818,281 @@ std::shared_ptr<UpstreamSyncManager> NtpServer::getUpstreamSync() const {
   return upstream_sync_;
 }
 
+namespace {
+NtpServerStats sumWorkerStats(const std::vector<WorkerStats> &workers) {
+  NtpServerStats total;
+  for (const WorkerStats &worker : workers) {
+    total.total_requests += worker.requests;
+    total.total_responses += worker.responses;
+    total.total_bytes_transferred += worker.bytes;
+    total.total_errors += worker.errors;
+    total.total_connections += worker.connections;
+    total.total_request_processing_time_us += worker.processing_time_us;
+    total.processed_request_count += worker.processed;
+    total.max_request_processing_time_us =
+        std::max(total.max_request_processing_time_us, worker.max_processing_time_us);
+    total.min_request_processing_time_us =
+        std::min(total.min_request_processing_time_us, worker.min_processing_time_us);
+  }
+  return total;
+}
+
+// Prometheus buckets at powers of two from 256 ns to about 1 s; the
+// histogram's own buckets are finer and split exactly at these bounds.
+void writeLatencyHistogram(std::ostream &out, const std::string &name, const std::string &help,
+                           const LatencyHistogram::Snapshot &histogram) {
+  // Bounds and sum at nanosecond resolution; the default six digits would
+  // round the larger bounds.
+  const auto seconds = [](uint64_t ns) {
+    std::ostringstream text;
+    text << std::setprecision(10) << static_cast<double>(ns) / 1e9;
+    return text.str();
+  };
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " histogram\n";
+  for (unsigned exponent = 8; exponent <= 30; ++exponent) {
+    const uint64_t bound_ns = uint64_t{1} << exponent;
+    out << name << "_bucket{le=\"" << seconds(bound_ns) << "\"} "
+        << histogram.countBelow(bound_ns) << "\n";
+  }
+  out << name << "_bucket{le=\"+Inf\"} " << histogram.count << "\n";
+  out << name << "_sum " << seconds(histogram.sum_ns) << "\n";
+  out << name << "_count " << histogram.count << "\n";
+}
+
+std::string formatPercentiles(const LatencyHistogram::Snapshot &histogram) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  const char *separator = "";
+  for (double quantile : {0.5, 0.99, 0.999}) {
+    out << separator << static_cast<double>(histogram.valueAtQuantile(quantile)) / 1e3;
+    separator = " / ";
+  }
+  return out.str();
+}
+
+// Average cost of each stage and its share of all stage cycles.
+std::string formatStageCosts(const StageSnapshot &stages) {
+  uint64_t total = 0;
+  for (uint64_t cycles : stages.cycles) {
+    total += cycles;
+  }
+  const double ns_per_cycle = 1e9 / cycleCounterHz();
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  for (size_t i = 0; i < kPipelineStageCount; ++i) {
+    const double avg_ns =
+        stages.calls[i] > 0 ? static_cast<double>(stages.cycles[i]) * ns_per_cycle /
+                                  static_cast<double>(stages.calls[i])
+                            : 0.0;
+    const double share =
+        total > 0 ? 100.0 * static_cast<double>(stages.cycles[i]) / static_cast<double>(total)
+                  : 0.0;
+    out << "    " << kPipelineStageNames[i] << ": " << avg_ns << " ns/call, " << share
+        << "% (" << stages.calls[i] << " calls)\n";
+  }
+  return out.str();
+}
+
+// Label value in the Prometheus text format: backslash, quote and newline
+// are escaped.
+std::string escapeLabelValue(const std::string &value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    default:
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string upstreamLabels(const std::string &server, const std::string &address) {
+  return "{server=\"" + escapeLabelValue(server) + "\",address=\"" +
+         escapeLabelValue(address) + "\"}";
+}
+} // namespace
+
 NtpServerStats NtpServer::getStats() const {
+  NtpServerStats total = sumWorkerStats(getWorkerStats());
+  total.start_time = stats_start_time_;
+  total.active_connections = getActiveConnectionCount();
+  return total;
+}
+
+std::vector<WorkerStats> NtpServer::getWorkerStats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  std::vector<WorkerStats> workers;
+  workers.reserve(worker_stats_.size());
+  for (const auto &published : worker_stats_) {
+    workers.push_back(published->load());
+  }
+  return workers;
+}
+
+LatencySnapshot NtpServer::getLatencySnapshot() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  LatencySnapshot merged;
+  for (const auto &latency : worker_latency_) {
+    merged.processing.merge(latency->processing.snapshot());
+    merged.kernel_to_user.merge(latency->kernel_to_user.snapshot());
+    merged.residence.merge(latency->residence.snapshot());
+  }
+  return merged;
+}
+
+std::vector<StageSnapshot> NtpServer::getStageSnapshots() const {
   std::lock_guard<std::mutex> lock(stats_mutex_);
-  return stats_;
+  std::vector<StageSnapshot> workers;
+  workers.reserve(worker_stages_.size());
+  for (const auto &stages : worker_stages_) {
+    workers.push_back(stages->snapshot());
+  }
+  return workers;
 }
 
 size_t NtpServer::getActiveConnectionCount() const {
-  std::lock_guard<std::mutex> lock(connections_mutex_);
-  return active_connections_.size();
+  // Kept in step with the table so stats readers never contend with the
+  // workers' per-packet lookups.
+  return active_connection_count_.load(std::memory_order_relaxed);
 }
 
 std::string NtpServer::listConnections() const {
-  std::stringstream ss;
-  ss << "Active NTP Clients:\n";
-  std::lock_guard<std::mutex> lock(connections_mutex_);
-  if (active_connections_.empty()) {
-    ss << "  (none)\n";
-    return ss.str();
-  }
-  for (const auto &entry : active_connections_) {
-    const auto &conn = entry.second;
-    const auto stats = conn->getStats();
-    ss << "  " << entry.first << " packets_rx=" << stats.packets_received
-       << " packets_tx=" << stats.packets_sent << " errors=" << stats.errors
-       << "\n";
+  std::string out;
+  streamConnections([&out](const std::string &chunk) {
+    out += chunk;
+    return true;
+  });
+  return out;
+}
+
+void NtpServer::streamConnections(const ControlSink &sink, size_t batch) const {
+  if (!sink("Active NTP Clients:\n")) {
+    return;
+  }
+  // Walk the table a few buckets at a time. The lock is held only to copy
+  // out the next batch; formatting and writing happen without it, so a slow
+  // reader never stalls the workers. Entries that move while the table
+  // rehashes between batches may be skipped or listed twice.
+  batch = std::max<size_t>(1, batch);
+  std::vector<std::pair<std::string, std::shared_ptr<NtpConnection>>> entries;
+  entries.reserve(batch);
+  std::string chunk;
+  size_t bucket = 0;
+  bool listed_any = false;
+  bool done = false;
+  while (!done) {
+    entries.clear();
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex_);
+      const size_t buckets = active_connections_.bucket_count();
+      for (; bucket < buckets && entries.size() < batch; ++bucket) {
+        for (auto it = active_connections_.begin(bucket); it != active_connections_.end(bucket);
+             ++it) {
+          entries.emplace_back(it->first, it->second);
+        }
+      }
+      done = bucket >= buckets;
+    }
+    chunk.clear();
+    for (const auto &entry : entries) {
+      const auto stats = entry.second->getStats();
+      chunk += "  " + entry.first + " packets_rx=" + std::to_string(stats.packets_received) +
+               " packets_tx=" + std::to_string(stats.packets_sent) +
+               " errors=" + std::to_string(stats.errors) + "\n";
+    }
+    if (!chunk.empty()) {
+      listed_any = true;
+      if (!sink(chunk)) {
+        return;
+      }
+    }
   }
+  if (!listed_any) {
+    sink("  (none)\n");
+  }
+}
+
+std::string NtpServer::getStatsReport() const {
+  const NtpServerStats stats = getStats();
+  std::stringstream ss;
+  ss << "NTP Server Statistics:\n";
+  ss << "  Total Connections: " << stats.total_connections << "\n";
+  ss << "  Active Connections: " << stats.active_connections << "\n";
+  ss << "  Total Requests: " << stats.total_requests << "\n";
+  ss << "  Total Responses: " << stats.total_responses << "\n";
+  ss << "  Total Errors: " << stats.total_errors << "\n";
+  ss << "  Bytes Transferred: " << stats.total_bytes_transferred << "\n";
   return ss.str();
 }
 
+bool NtpServer::writePacketCapture(std::ostream &out) const {
+  if (!capture_) {
+    return false;
+  }
+  capture_->writePcap(out);
+  return true;
+}
+
+void NtpServer::handleControlCommand(const std::string &command, const ControlSink &sink) {
+  if (command == "status") {
+    sink("OK\n") && sink(getStatus());
+  } else if (command == "stats") {
+    sink("OK\n") && sink(getStatsReport());
+  } else if (command == "connections") {
+    if (sink("OK\n")) {
+      streamConnections(sink);
+    }
+  } else if (command == "metrics") {
+    sink("OK\n") && sink(exportPrometheusMetrics());
+  } else if (command == "health") {
+    const std::string report = runHealthChecks();
+    const bool healthy = report.find("overall_status: healthy") != std::string::npos;
+    sink(healthy ? "OK\n" : "ERR degraded\n") && sink(report);
+  } else if (command == "reload") {
+    sink(reloadConfig() ? "OK\nConfiguration reloaded\n" : "ERR reload failed, see log\n");
+  } else if (command == "capture") {
+    std::ostringstream pcap;
+    if (writePacketCapture(pcap)) {
+      sink("OK\n") && sink(pcap.str());
+    } else {
+      sink("ERR packet capture is off\n");
+    }
+  } else if (command == "history" || command.rfind("history ", 0) == 0) {
+    // "history" lists the system clock, "history NAME" the matching upstreams
+    const std::string name = command.size() > 8 ? command.substr(8) : "";
+    if (!upstream_sync_ || upstream_sync_->historyWindowSeconds() == 0) {
+      sink("ERR clock history is off\n");
+    } else if (name.empty()) {
+      sink("OK\n") && sink(formatClockHistory(upstream_sync_->clockHistory()));
+    } else {
+      std::string listing;
+      for (const auto &history : upstream_sync_->upstreamHistory()) {
+        if (history.server == name || history.address == name) {
+          listing += formatPeerHistory(history);
+        }
+      }
+      if (listing.empty()) {
+        sink("ERR no upstream named " + name + "\n");
+      } else {
+        sink("OK\n") && sink(listing);
+      }
+    }
+  } else {
+    sink("ERR unknown command: " + command + "\n");
+  }
+}
+
 std::string NtpServer::getStatus() const {
   std::stringstream ss;
 
@@ -639,27 +1100,38 @@ std::string NtpServer::getStatus() const {
   ss << "  Status: " << (running_ ? "Running" : "Stopped") << "\n";
 
   if (running_) {
-    auto uptime = std::chrono::steady_clock::now() - stats_.start_time;
+    const NtpServerStats stats = getStats();
+    auto uptime = std::chrono::steady_clock::now() - stats.start_time;
     auto uptime_seconds =
         std::chrono::duration_cast<std::chrono::seconds>(uptime).count();
     ss << "  Uptime: " << uptime_seconds << " seconds\n";
     ss << "  Listen Address: " << server_address_ << ":" << server_port_
        << "\n";
     ss << "  Worker Threads: " << worker_threads_.size() << "\n";
-    ss << "  Active Connections: " << stats_.active_connections << "\n";
-    ss << "  Total Requests: " << stats_.total_requests << "\n";
-    ss << "  Total Bytes: " << stats_.total_bytes_transferred << "\n";
-    ss << "  Total Errors: " << stats_.total_errors << "\n";
-    if (stats_.processed_request_count > 0) {
-      double avg_us = static_cast<double>(stats_.total_request_processing_time_us) /
-                      static_cast<double>(stats_.processed_request_count);
+    ss << "  Active Connections: " << stats.active_connections << "\n";
+    ss << "  Total Requests: " << stats.total_requests << "\n";
+    ss << "  Total Bytes: " << stats.total_bytes_transferred << "\n";
+    ss << "  Total Errors: " << stats.total_errors << "\n";
+    if (stats.processed_request_count > 0) {
+      double avg_us = static_cast<double>(stats.total_request_processing_time_us) /
+                      static_cast<double>(stats.processed_request_count);
       ss << "  Avg Proc Time (us): " << static_cast<uint64_t>(avg_us) << "\n";
-      ss << "  Max Proc Time (us): " << stats_.max_request_processing_time_us << "\n";
-      ss << "  Min Proc Time (us): " << stats_.min_request_processing_time_us << "\n";
-      double throughput = static_cast<double>(stats_.total_requests) /
+      const LatencySnapshot latency = getLatencySnapshot();
+      ss << "  Processing p50/p99/p999 (us): " << formatPercentiles(latency.processing) << "\n";
+      ss << "  Kernel-to-user p50/p99/p999 (us): "
+         << formatPercentiles(latency.kernel_to_user) << "\n";
+      ss << "  Residence p50/p99/p999 (us): " << formatPercentiles(latency.residence) << "\n";
+      double throughput = static_cast<double>(stats.total_requests) /
                           std::max(1.0, static_cast<double>(uptime_seconds));
       ss << "  Throughput (req/s): " << throughput << "\n";
     }
+    if (config_->enable_stage_accounting) {
+      StageSnapshot merged;
+      for (const auto &worker : getStageSnapshots()) {
+        merged.merge(worker);
+      }
+      ss << "  Stage Costs (all workers):\n" << formatStageCosts(merged);
+    }
     if (upstream_sync_) {
       ss << upstream_sync_->statusSummary();
     }
@@ -669,36 +1141,140 @@ std::string NtpServer::getStatus() const {
 }
 
 std::string NtpServer::exportPrometheusMetrics() const {
-  std::stringstream m;
+  std::string out;
+  appendPrometheusMetrics(out);
+  return out;
+}
+
+void NtpServer::appendPrometheusMetrics(std::string &out) const {
+  const std::vector<WorkerStats> workers = getWorkerStats();
+  // Totals and the per-worker breakdown come from the same snapshots.
+  NtpServerStats stats = sumWorkerStats(workers);
+  stats.start_time = stats_start_time_;
+  StringSink sink(out);
+  std::ostream m(&sink);
   m << "# HELP simple_ntpd_requests_total Total NTP requests processed\n";
   m << "# TYPE simple_ntpd_requests_total counter\n";
-  m << "simple_ntpd_requests_total " << stats_.total_requests << "\n";
+  m << "simple_ntpd_requests_total " << stats.total_requests << "\n";
 
   m << "# HELP simple_ntpd_errors_total Total NTP errors\n";
   m << "# TYPE simple_ntpd_errors_total counter\n";
-  m << "simple_ntpd_errors_total " << stats_.total_errors << "\n";
+  m << "simple_ntpd_errors_total " << stats.total_errors << "\n";
 
   m << "# HELP simple_ntpd_bytes_total Total bytes transferred\n";
   m << "# TYPE simple_ntpd_bytes_total counter\n";
-  m << "simple_ntpd_bytes_total " << stats_.total_bytes_transferred << "\n";
-
-  m << "# HELP simple_ntpd_request_proc_time_us Request processing time (us)\n";
-  m << "# TYPE simple_ntpd_request_proc_time_us summary\n";
-  double avg_us = stats_.processed_request_count == 0 ? 0.0 :
-                  static_cast<double>(stats_.total_request_processing_time_us) /
-                  static_cast<double>(stats_.processed_request_count);
-  m << "simple_ntpd_request_proc_time_us_count " << stats_.processed_request_count << "\n";
-  m << "simple_ntpd_request_proc_time_us_sum " << stats_.total_request_processing_time_us << "\n";
-  m << "simple_ntpd_request_proc_time_us_avg " << static_cast<uint64_t>(avg_us) << "\n";
-  m << "simple_ntpd_request_proc_time_us_max " << stats_.max_request_processing_time_us << "\n";
-  m << "simple_ntpd_request_proc_time_us_min " << (stats_.min_request_processing_time_us == UINT64_MAX ? 0 : stats_.min_request_processing_time_us) << "\n";
-
-  auto uptime = std::chrono::steady_clock::now() - stats_.start_time;
+  m << "simple_ntpd_bytes_total " << stats.total_bytes_transferred << "\n";
+
+  const LatencySnapshot latency = getLatencySnapshot();
+  writeLatencyHistogram(m, "simple_ntpd_request_processing_seconds",
+                        "Time spent handling one request", latency.processing);
+  writeLatencyHistogram(m, "simple_ntpd_kernel_to_user_seconds",
+                        "Kernel receive timestamp to the worker reading the packet",
+                        latency.kernel_to_user);
+  writeLatencyHistogram(m, "simple_ntpd_residence_seconds",
+                        "Kernel receive timestamp to the reply being sent", latency.residence);
+
+  auto uptime = std::chrono::steady_clock::now() - stats.start_time;
   auto uptime_seconds = std::chrono::duration_cast<std::chrono::seconds>(uptime).count();
   m << "# HELP simple_ntpd_uptime_seconds Server uptime in seconds\n";
   m << "# TYPE simple_ntpd_uptime_seconds gauge\n";
   m << "simple_ntpd_uptime_seconds " << uptime_seconds << "\n";
 
+  m << "# HELP simple_ntpd_worker_requests_total NTP requests answered per worker thread\n";
+  m << "# TYPE simple_ntpd_worker_requests_total counter\n";
+  for (size_t i = 0; i < workers.size(); ++i) {
+    m << "simple_ntpd_worker_requests_total{worker=\"" << i << "\"} " << workers[i].requests
+      << "\n";
+  }
+  m << "# HELP simple_ntpd_worker_errors_total Dropped or failed packets per worker thread\n";
+  m << "# TYPE simple_ntpd_worker_errors_total counter\n";
+  for (size_t i = 0; i < workers.size(); ++i) {
+    m << "simple_ntpd_worker_errors_total{worker=\"" << i << "\"} " << workers[i].errors
+      << "\n";
+  }
+  m << "# HELP simple_ntpd_worker_bytes_total Request bytes per worker thread\n";
+  m << "# TYPE simple_ntpd_worker_bytes_total counter\n";
+  for (size_t i = 0; i < workers.size(); ++i) {
+    m << "simple_ntpd_worker_bytes_total{worker=\"" << i << "\"} " << workers[i].bytes << "\n";
+  }
+  m << "# HELP simple_ntpd_worker_request_proc_time_us_sum Processing time per worker thread\n";
+  m << "# TYPE simple_ntpd_worker_request_proc_time_us_sum counter\n";
+  for (size_t i = 0; i < workers.size(); ++i) {
+    m << "simple_ntpd_worker_request_proc_time_us_sum{worker=\"" << i << "\"} "
+      << workers[i].processing_time_us << "\n";
+  }
+
+  if (config_->enable_stage_accounting) {
+    const std::vector<StageSnapshot> stages = getStageSnapshots();
+    m << "# HELP simple_ntpd_stage_cycles_total Cycle counter ticks spent per pipeline stage "
+         "and worker thread\n";
+    m << "# TYPE simple_ntpd_stage_cycles_total counter\n";
+    for (size_t i = 0; i < stages.size(); ++i) {
+      for (size_t s = 0; s < kPipelineStageCount; ++s) {
+        m << "simple_ntpd_stage_cycles_total{worker=\"" << i << "\",stage=\""
+          << kPipelineStageNames[s] << "\"} " << stages[i].cycles[s] << "\n";
+      }
+    }
+    m << "# HELP simple_ntpd_stage_calls_total Times each pipeline stage ran per worker "
+         "thread\n";
+    m << "# TYPE simple_ntpd_stage_calls_total counter\n";
+    for (size_t i = 0; i < stages.size(); ++i) {
+      for (size_t s = 0; s < kPipelineStageCount; ++s) {
+        m << "simple_ntpd_stage_calls_total{worker=\"" << i << "\",stage=\""
+          << kPipelineStageNames[s] << "\"} " << stages[i].calls[s] << "\n";
+      }
+    }
+    m << "# HELP simple_ntpd_cycle_counter_hz Cycle counter ticks per second\n";
+    m << "# TYPE simple_ntpd_cycle_counter_hz gauge\n";
+    m << "simple_ntpd_cycle_counter_hz " << static_cast<uint64_t>(cycleCounterHz())
+      << "\n";
+  }
+
+  if (capture_) {
+    m << "# HELP simple_ntpd_capture_exchanges_total Exchanges written into the capture ring\n";
+    m << "# TYPE simple_ntpd_capture_exchanges_total counter\n";
+    m << "simple_ntpd_capture_exchanges_total " << capture_->captured() << "\n";
+    m << "# HELP simple_ntpd_capture_skipped_total Sampled exchanges lost to a busy ring slot\n";
+    m << "# TYPE simple_ntpd_capture_skipped_total counter\n";
+    m << "simple_ntpd_capture_skipped_total " << capture_->skipped() << "\n";
+  }
+
+  m << "# HELP simple_ntpd_broadcast_packets_total Broadcast (mode 5) packets sent\n";
+  m << "# TYPE simple_ntpd_broadcast_packets_total counter\n";
+  m << "simple_ntpd_broadcast_packets_total " << broadcasts_sent_.load() << "\n";
+
+  if (roughtime_) {
+    m << "# HELP simple_ntpd_roughtime_requests_total Datagrams received on the Roughtime port\n";
+    m << "# TYPE simple_ntpd_roughtime_requests_total counter\n";
+    m << "simple_ntpd_roughtime_requests_total " << roughtime_->requests() << "\n";
+    m << "# HELP simple_ntpd_roughtime_responses_total Signed Roughtime responses sent\n";
+    m << "# TYPE simple_ntpd_roughtime_responses_total counter\n";
+    m << "simple_ntpd_roughtime_responses_total " << roughtime_->responses() << "\n";
+    m << "# HELP simple_ntpd_roughtime_batches_total Roughtime batches (one signature each)\n";
+    m << "# TYPE simple_ntpd_roughtime_batches_total counter\n";
+    m << "simple_ntpd_roughtime_batches_total " << roughtime_->batches() << "\n";
+  }
+
+  if (metrics_http_) {
+    m << "# HELP simple_ntpd_http_requests_total Requests to the metrics HTTP endpoint\n";
+    m << "# TYPE simple_ntpd_http_requests_total counter\n";
+    m << "simple_ntpd_http_requests_total " << metrics_http_->requests() << "\n";
+    m << "# HELP simple_ntpd_http_metrics_renders_total Scrapes that rendered fresh metrics\n";
+    m << "# TYPE simple_ntpd_http_metrics_renders_total counter\n";
+    m << "simple_ntpd_http_metrics_renders_total " << metrics_http_->renders() << "\n";
+  }
+
+  const double unix_now = std::chrono::duration<double>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  const LeapSchedule leap = leap_schedule_.load();
+  m << "# HELP simple_ntpd_leap_indicator Leap indicator announced from the leap table\n";
+  m << "# TYPE simple_ntpd_leap_indicator gauge\n";
+  m << "simple_ntpd_leap_indicator "
+    << static_cast<int>(leap.leapIndicatorAt(static_cast<int64_t>(unix_now))) << "\n";
+  m << "# HELP simple_ntpd_leap_smear_offset_seconds Leap smear applied to responses\n";
+  m << "# TYPE simple_ntpd_leap_smear_offset_seconds gauge\n";
+  m << "simple_ntpd_leap_smear_offset_seconds " << leap.smearAt(unix_now) << "\n";
+
   if (upstream_sync_) {
     m << "# HELP simple_ntpd_upstream_synced Whether upstream sync succeeded\n";
     m << "# TYPE simple_ntpd_upstream_synced gauge\n";
@@ -707,6 +1283,135 @@ std::string NtpServer::exportPrometheusMetrics() const {
     m << "# HELP simple_ntpd_clock_offset_us Estimated clock offset from upstream\n";
     m << "# TYPE simple_ntpd_clock_offset_us gauge\n";
     m << "simple_ntpd_clock_offset_us " << upstream_sync_->clockOffsetUs() << "\n";
+    m << "# HELP simple_ntpd_clock_frequency_ppm Disciplined clock frequency correction\n";
+    m << "# TYPE simple_ntpd_clock_frequency_ppm gauge\n";
+    m << "simple_ntpd_clock_frequency_ppm " << upstream_sync_->frequencyPpm() << "\n";
+    m << "# HELP simple_ntpd_kernel_clock_discipline Whether the system clock is steered\n";
+    m << "# TYPE simple_ntpd_kernel_clock_discipline gauge\n";
+    m << "simple_ntpd_kernel_clock_discipline "
+      << (upstream_sync_->steersSystemClock() ? 1 : 0) << "\n";
+    m << "# HELP simple_ntpd_upstream_selection_policy Active system peer policy\n";
+    m << "# TYPE simple_ntpd_upstream_selection_policy gauge\n";
+    m << "simple_ntpd_upstream_selection_policy{policy=\""
+      << selectionPolicyName(config_->upstream_selection_algorithm) << "\"} 1\n";
+
+    // Per-upstream health, labelled by configured name and address.
+    const auto peers = upstream_sync_->peerStatus();
+    auto labels = [](const UpstreamPeerStatus &peer) {
+      return upstreamLabels(peer.server, peer.address);
+    };
+    m << "# HELP simple_ntpd_upstream_reach Reachability register of the last 8 polls\n";
+    m << "# TYPE simple_ntpd_upstream_reach gauge\n";
+    for (const auto &peer : peers) {
+      m << "simple_ntpd_upstream_reach" << labels(peer) << " "
+        << static_cast<int>(peer.health.reach) << "\n";
+    }
+    m << "# HELP simple_ntpd_upstream_polls_total Polls sent to the upstream\n";
+    m << "# TYPE simple_ntpd_upstream_polls_total counter\n";
+    for (const auto &peer : peers) {
+      m << "simple_ntpd_upstream_polls_total" << labels(peer) << " " << peer.health.polls
+        << "\n";
+    }
+    m << "# HELP simple_ntpd_upstream_errors_total Polls that got no valid reply\n";
+    m << "# TYPE simple_ntpd_upstream_errors_total counter\n";
+    for (const auto &peer : peers) {
+      m << "simple_ntpd_upstream_errors_total" << labels(peer) << " " << peer.health.errors
+        << "\n";
+    }
+    m << "# HELP simple_ntpd_upstream_delay_score_us Smoothed round-trip delay\n";
+    m << "# TYPE simple_ntpd_upstream_delay_score_us gauge\n";
+    for (const auto &peer : peers) {
+      m << "simple_ntpd_upstream_delay_score_us" << labels(peer) << " "
+        << static_cast<int64_t>(peer.health.delay_score * 1e6) << "\n";
+    }
+    m << "# HELP simple_ntpd_upstream_jitter_score_us Smoothed clock filter jitter\n";
+    m << "# TYPE simple_ntpd_upstream_jitter_score_us gauge\n";
+    for (const auto &peer : peers) {
+      m << "simple_ntpd_upstream_jitter_score_us" << labels(peer) << " "
+        << static_cast<int64_t>(peer.health.jitter_score * 1e6) << "\n";
+    }
+    m << "# HELP simple_ntpd_upstream_system_peer Whether the upstream is the system peer\n";
+    m << "# TYPE simple_ntpd_upstream_system_peer gauge\n";
+    for (const auto &peer : peers) {
+      m << "simple_ntpd_upstream_system_peer" << labels(peer) << " "
+        << (peer.tally == '*' ? 1 : 0) << "\n";
+    }
+
+    // Aggregates over the clock history window
+    const int64_t window = upstream_sync_->historyWindowSeconds();
+    if (window > 0) {
+      const HistorySummary clock = summarizeHistory(upstream_sync_->clockHistory());
+      m << "# HELP simple_ntpd_clock_history_window_seconds Span of the clock history\n";
+      m << "# TYPE simple_ntpd_clock_history_window_seconds gauge\n";
+      m << "simple_ntpd_clock_history_window_seconds " << window << "\n";
+      m << "# HELP simple_ntpd_clock_history_samples Clock state samples in the window\n";
+      m << "# TYPE simple_ntpd_clock_history_samples gauge\n";
+      m << "simple_ntpd_clock_history_samples " << clock.samples << "\n";
+      m << "# HELP simple_ntpd_clock_history_synced_samples Samples taken while synced\n";
+      m << "# TYPE simple_ntpd_clock_history_synced_samples gauge\n";
+      m << "simple_ntpd_clock_history_synced_samples " << clock.good << "\n";
+      m << "# HELP simple_ntpd_clock_history_offset_us Combined offset over the window\n";
+      m << "# TYPE simple_ntpd_clock_history_offset_us gauge\n";
+      m << "simple_ntpd_clock_history_offset_us{stat=\"min\"} " << clock.min_offset_us << "\n";
+      m << "simple_ntpd_clock_history_offset_us{stat=\"max\"} " << clock.max_offset_us << "\n";
+      m << "simple_ntpd_clock_history_offset_us{stat=\"rms\"} " << clock.rms_offset_us << "\n";
+      m << "# HELP simple_ntpd_clock_history_jitter_max_us Highest system jitter in the window\n";
+      m << "# TYPE simple_ntpd_clock_history_jitter_max_us gauge\n";
+      m << "simple_ntpd_clock_history_jitter_max_us " << clock.max_jitter_us << "\n";
+
+      std::vector<std::pair<std::string, HistorySummary>> upstreams;
+      for (const auto &history : upstream_sync_->upstreamHistory()) {
+        upstreams.emplace_back(upstreamLabels(history.server, history.address),
+                               summarizeHistory(history.samples));
+      }
+      auto with_stat = [](const std::string &label, const char *stat) {
+        return label.substr(0, label.size() - 1) + ",stat=\"" + stat + "\"}";
+      };
+      m << "# HELP simple_ntpd_upstream_history_samples Polls in the history window\n";
+      m << "# TYPE simple_ntpd_upstream_history_samples gauge\n";
+      for (const auto &entry : upstreams) {
+        m << "simple_ntpd_upstream_history_samples" << entry.first << " "
+          << entry.second.samples << "\n";
+      }
+      m << "# HELP simple_ntpd_upstream_history_replies Polls answered in the window\n";
+      m << "# TYPE simple_ntpd_upstream_history_replies gauge\n";
+      for (const auto &entry : upstreams) {
+        m << "simple_ntpd_upstream_history_replies" << entry.first << " " << entry.second.good
+          << "\n";
+      }
+      m << "# HELP simple_ntpd_upstream_history_selected Polls after which the upstream "
+           "was a survivor\n";
+      m << "# TYPE simple_ntpd_upstream_history_selected gauge\n";
+      for (const auto &entry : upstreams) {
+        m << "simple_ntpd_upstream_history_selected" << entry.first << " "
+          << entry.second.selected << "\n";
+      }
+      m << "# HELP simple_ntpd_upstream_history_offset_us Measured offset over the window\n";
+      m << "# TYPE simple_ntpd_upstream_history_offset_us gauge\n";
+      for (const auto &entry : upstreams) {
+        m << "simple_ntpd_upstream_history_offset_us" << with_stat(entry.first, "min") << " "
+          << entry.second.min_offset_us << "\n";
+        m << "simple_ntpd_upstream_history_offset_us" << with_stat(entry.first, "max") << " "
+          << entry.second.max_offset_us << "\n";
+        m << "simple_ntpd_upstream_history_offset_us" << with_stat(entry.first, "rms") << " "
+          << entry.second.rms_offset_us << "\n";
+      }
+      m << "# HELP simple_ntpd_upstream_history_delay_us Round-trip delay over the window\n";
+      m << "# TYPE simple_ntpd_upstream_history_delay_us gauge\n";
+      for (const auto &entry : upstreams) {
+        m << "simple_ntpd_upstream_history_delay_us" << with_stat(entry.first, "min") << " "
+          << entry.second.min_delay_us << "\n";
+        m << "simple_ntpd_upstream_history_delay_us" << with_stat(entry.first, "max") << " "
+          << entry.second.max_delay_us << "\n";
+      }
+      m << "# HELP simple_ntpd_upstream_history_jitter_max_us Highest filter jitter in the "
+           "window\n";
+      m << "# TYPE simple_ntpd_upstream_history_jitter_max_us gauge\n";
+      for (const auto &entry : upstreams) {
+        m << "simple_ntpd_upstream_history_jitter_max_us" << entry.first << " "
+          << entry.second.max_jitter_us << "\n";
+      }
+    }
   }
 
 #ifndef _WIN32
@@ -727,12 +1432,12 @@ std::string NtpServer::exportPrometheusMetrics() const {
   }
 #endif
 
-  return m.str();
 }
 
 std::string NtpServer::runHealthChecks() const {
   std::stringstream ss;
   bool healthy = true;
+  const NtpServerStats stats = getStats();
 
   ss << "Health Check Report\n";
   if (!running_) {
@@ -740,11 +1445,11 @@ std::string NtpServer::runHealthChecks() const {
   }
   ss << "running: " << (running_ ? "true" : "false") << "\n";
   ss << "socket_bound: " << (server_socket_ != INVALID_SOCKET ? "true" : "false") << "\n";
-  ss << "active_connections: " << stats_.active_connections << "\n";
-  ss << "total_errors: " << stats_.total_errors << "\n";
+  ss << "active_connections: " << stats.active_connections << "\n";
+  ss << "total_errors: " << stats.total_errors << "\n";
   ss << "config_loaded: " << (config_ && !config_->lastConfigFile().empty() ? "true" : "false") << "\n";
 
-  if (config_ && !config_->upstream_servers.empty()) {
+  if (config_ && config_->hasSyncSources()) {
     const bool synced = upstream_sync_ && upstream_sync_->isSynced();
     ss << "upstream_synced: " << (synced ? "true" : "false") << "\n";
     if (!synced) {
@@ -754,27 +1459,27 @@ std::string NtpServer::runHealthChecks() const {
   }
 
   if (config_ && config_->enable_leap_second_handling) {
-#if __has_include(<filesystem>)
-    namespace fs = std::filesystem;
-    std::error_code ec;
-    const bool leap_exists = fs::exists(config_->leap_second_file, ec);
-    ss << "leap_second_file_present: " << (leap_exists ? "true" : "false") << "\n";
-    if (!leap_exists) {
+    std::lock_guard<std::mutex> lock(leap_mutex_);
+    const bool leap_loaded = !leap_table_.empty();
+    ss << "leap_second_file_present: " << (leap_loaded ? "true" : "false") << "\n";
+    if (!leap_loaded) {
       healthy = false;
-      ss << "warning: leap second handling enabled but leap second file missing\n";
-    }
-#else
-    std::ifstream leap_file(config_->leap_second_file);
-    const bool leap_exists = leap_file.good();
-    ss << "leap_second_file_present: " << (leap_exists ? "true" : "false") << "\n";
-    if (!leap_exists) {
-      healthy = false;
-      ss << "warning: leap second handling enabled but leap second file missing\n";
+      ss << "warning: leap second handling enabled but leap second file missing ("
+         << leap_error_ << ")\n";
+    } else {
+      const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count();
+      const bool expired = leap_table_.expiredAt(now);
+      ss << "leap_second_entries: " << leap_table_.entries().size() << "\n";
+      ss << "leap_second_file_expired: " << (expired ? "true" : "false") << "\n";
+      if (expired) {
+        healthy = false;
+        ss << "warning: leap second file has expired\n";
+      }
     }
-#endif
   }
 
-  if (stats_.total_requests > 0 && stats_.total_errors > (stats_.total_requests / 2)) {
+  if (stats.total_requests > 0 && stats.total_errors > (stats.total_requests / 2)) {
     healthy = false;
     ss << "warning: high error ratio detected\n";
   }
@@ -846,15 +1551,30 @@ void NtpServer::persistState() const {
   if (!config_ || !config_->enable_state_persistence || config_->state_file.empty()) {
     return;
   }
-  std::ofstream state(config_->state_file, std::ios::trunc);
-  if (!state.is_open()) {
-    return;
+  const std::string tmp = config_->state_file + ".tmp";
+  {
+    std::ofstream state(tmp, std::ios::trunc);
+    if (!state.is_open()) {
+      logger_->warning("Failed to write state file " + config_->state_file);
+      return;
+    }
+    const NtpServerStats stats = getStats();
+    state << "{\n";
+    state << "  \"total_requests\": " << stats.total_requests << ",\n";
+    state << "  \"total_errors\": " << stats.total_errors << ",\n";
+    state << "  \"total_connections\": " << stats.total_connections;
+    if (upstream_sync_) {
+      state << ",\n  \"upstream_sync\": "
+            << formatUpstreamSyncState(upstream_sync_->captureState());
+    }
+    state << "\n}\n";
+  }
+  // Replace atomically so a crash never leaves a truncated state file.
+  if (std::rename(tmp.c_str(), config_->state_file.c_str()) != 0) {
+    logger_->warning("Failed to replace state file " + config_->state_file + ": " +
+                     std::string(std::strerror(errno)));
+    std::remove(tmp.c_str());
   }
-  state << "{\n";
-  state << "  \"total_requests\": " << stats_.total_requests << ",\n";
-  state << "  \"total_errors\": " << stats_.total_errors << ",\n";
-  state << "  \"total_connections\": " << stats_.total_connections << "\n";
-  state << "}\n";
 }
 
 void NtpServer::loadState() {
@@ -870,6 +1590,10 @@ void NtpServer::loadState() {
   if (content.find("total_requests") != std::string::npos) {
     logger_->info("Loaded persisted state from " + config_->state_file);
   }
+  UpstreamSyncState sync_state;
+  if (upstream_sync_ && parseUpstreamSyncState(content, sync_state)) {
+    upstream_sync_->restoreState(sync_state);
+  }
 }
 
 void NtpServer::backupConfig() const {
@@ -884,43 +1608,319 @@ void NtpServer::backupConfig() const {
   dst << src.rdbuf();
 }
 
-std::string NtpServer::selectUpstreamServer() {
-  if (!config_ || config_->upstream_servers.empty()) {
-    return std::string();
+void NtpServer::applyDynamicStratum(const WorkerStats &stats) {
+  if (!config_ || !config_->enable_dynamic_stratum_adjustment) {
+    return;
   }
-  if (healthy_upstreams_.empty()) {
-    healthy_upstreams_ = config_->upstream_servers;
+  // Basic adaptive stratum: increase stratum when error ratio rises. The
+  // calling worker's own counters stand in for the total, which would
+  // mean reading every other worker's block per packet.
+  if (stats.requests > 100) {
+    const double error_ratio =
+        static_cast<double>(stats.errors) / static_cast<double>(stats.requests);
+    if (error_ratio > 0.20 && static_cast<int>(config_->stratum) < 15) {
+      config_->stratum = static_cast<NtpStratum>(static_cast<int>(config_->stratum) + 1);
+    }
   }
-  if (healthy_upstreams_.size() == 1) {
-    return healthy_upstreams_.front();
+}
+
+void NtpServer::loadLeapSeconds() {
+  std::lock_guard<std::mutex> lock(leap_mutex_);
+  leap_table_ = LeapSecondTable();
+  leap_error_.clear();
+  if (config_->enable_leap_second_handling) {
+    LeapSecondTable table;
+    if (table.loadFromFile(config_->leap_second_file, leap_error_)) {
+      leap_table_ = std::move(table);
+      logger_->info("Loaded " + std::to_string(leap_table_.entries().size()) +
+                    " leap second entries from " + config_->leap_second_file);
+    } else {
+      logger_->warning("Leap second file not loaded: " + leap_error_);
+    }
   }
-  switch (config_->upstream_selection_algorithm) {
-  case NtpConfig::UpstreamSelectionAlgorithm::RANDOM: {
-    std::uniform_int_distribution<size_t> dist(0, healthy_upstreams_.size() - 1);
-    return healthy_upstreams_[dist(rng_)];
+  const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  leap_schedule_.store(leap_table_.scheduleAt(now, config_->leap_smear_interval));
+}
+
+void NtpServer::refreshLeapSchedule(int64_t now) {
+  // One worker rebuilds; the rest keep the old schedule, which reports no
+  // leap and no smear once its leap is over.
+  std::unique_lock<std::mutex> lock(leap_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || now < leap_schedule_.load().valid_until) {
+    return;
   }
-  case NtpConfig::UpstreamSelectionAlgorithm::LEAST_ERRORS:
-    // For now fallback to round-robin until per-upstream error accounting is added.
-  case NtpConfig::UpstreamSelectionAlgorithm::ROUND_ROBIN:
-  default: {
-    const size_t idx = upstream_rr_index_.fetch_add(1) % healthy_upstreams_.size();
-    return healthy_upstreams_[idx];
+  leap_schedule_.store(leap_table_.scheduleAt(now, config_->leap_smear_interval));
+}
+
+bool NtpServer::applySyncState(NtpPacket &packet) {
+  // One lock-free read of the published sync state per packet.
+  SyncSnapshot sync;
+  double sync_now = 0.0;
+  bool synced = false;
+  if (upstream_sync_) {
+    sync = upstream_sync_->snapshot();
+    sync_now = SyncSnapshot::monotonicNow();
+    packet.stratum = sync.stratumAt(sync_now, packet.stratum);
+    synced = sync.syncedAt(sync_now);
+  }
+
+  // Reference ID and root distance were worked out on the control path;
+  // only the dispersion growth since the last update is added here.
+  // Unsynchronized, we are our own root and the error is the precision.
+  if (synced) {
+    if (sync.reference_id != 0) {
+      packet.reference_id = sync.reference_id;
+    }
+    packet.root_delay = microsecondsToShortFormat(sync.root_delay_us);
+    packet.root_dispersion = microsecondsToShortFormat(sync.rootDispersionUsAt(sync_now));
+  } else {
+    packet.root_dispersion = precision_dispersion_;
+  }
+
+  // Leap indicator and smear come from the schedule for the next leap;
+  // it is only rebuilt once that leap is over. Without a table the
+  // system peer's leap indicator is passed on.
+  const double unix_now = std::chrono::duration<double>(
+      packet.transmit_ts.toSystemTime().time_since_epoch()).count();
+  LeapSchedule leap = leap_schedule_.load();
+  if (unix_now >= static_cast<double>(leap.valid_until)) {
+    refreshLeapSchedule(static_cast<int64_t>(unix_now));
+    leap = leap_schedule_.load();
+  }
+  if (leap.has_table) {
+    packet.leap_indicator = leap.leapIndicatorAt(static_cast<int64_t>(unix_now));
+  } else if (!leap.smearing && synced) {
+    packet.leap_indicator = sync.leap;
+  }
+
+  // When the kernel clock is disciplined the raw clock is already correct
+  // and the snapshot reports no offset. Broadcasts have no receive time.
+  int64_t offset_us = upstream_sync_ ? sync.offsetUsAt(sync_now) : 0;
+  offset_us += std::llround(leap.smearAt(unix_now) * 1e6);
+  if (offset_us != 0) {
+    const auto offset = std::chrono::microseconds(offset_us);
+    if (packet.receive_ts.seconds != 0) {
+      packet.receive_ts =
+          NtpTimestamp::fromSystemTime(packet.receive_ts.toSystemTime() + offset);
+    }
+    packet.transmit_ts =
+        NtpTimestamp::fromSystemTime(packet.transmit_ts.toSystemTime() + offset);
+  }
+  return synced;
+}
+
+bool NtpServer::startBroadcast() {
+  std::string host;
+  std::string service;
+  splitUpstreamHostPort(config_->broadcast_address, host, service);
+  std::vector<ResolvedAddress> addresses;
+  if (!resolveAddresses(host, service, addresses, true)) {
+    logger_->error("broadcast_address must be a numeric address: " +
+                   config_->broadcast_address);
+    return false;
+  }
+  const ResolvedAddress &dest = addresses.front();
+  const auto *dest_addr = reinterpret_cast<const struct sockaddr *>(&dest.storage);
+  socket_t sock = socket(dest_addr->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock == INVALID_SOCKET) {
+    logger_->error("Failed to create broadcast socket: " + std::string(std::strerror(errno)));
+    return false;
+  }
+
+  // Broadcasts leave through the listen address when one is configured.
+  bool ok = true;
+  const int ttl = config_->broadcast_ttl;
+  if (dest_addr->sa_family == AF_INET) {
+    const int on = 1;
+    ok = setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) == 0 &&
+         setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == 0;
+    struct sockaddr_in local {};
+    local.sin_family = AF_INET;
+    if (ok && inet_pton(AF_INET, config_->listen_address.c_str(), &local.sin_addr) == 1 &&
+        local.sin_addr.s_addr != htonl(INADDR_ANY)) {
+      ok = bind(sock, reinterpret_cast<struct sockaddr *>(&local), sizeof(local)) == 0 &&
+           setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &local.sin_addr,
+                      sizeof(local.sin_addr)) == 0;
+    }
+  } else {
+    ok = setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl)) == 0;
   }
+  if (!ok) {
+    logger_->error("Failed to set up broadcast socket: " + std::string(std::strerror(errno)));
+    CLOSE_SOCKET(sock);
+    return false;
   }
+
+  std::memcpy(&broadcast_dest_, &dest.storage, dest.length);
+  broadcast_dest_len_ = dest.length;
+  broadcast_socket_ = sock;
+  broadcast_running_ = true;
+  broadcast_thread_ = std::thread(&NtpServer::broadcastLoop, this);
+  logger_->info("Broadcasting to " + dest.text + " every " +
+                std::to_string(config_->broadcast_interval.count()) + " s" +
+                (config_->broadcast_key_id != 0
+                     ? " with key " + std::to_string(config_->broadcast_key_id)
+                     : std::string()));
+  return true;
 }
 
-void NtpServer::applyDynamicStratum() {
-  if (!config_ || !config_->enable_dynamic_stratum_adjustment) {
-    return;
+void NtpServer::stopBroadcast() {
+  {
+    std::lock_guard<std::mutex> lock(broadcast_mutex_);
+    broadcast_running_ = false;
   }
-  // Basic adaptive stratum: increase stratum when error ratio rises.
-  if (stats_.total_requests > 100) {
-    const double error_ratio =
-        static_cast<double>(stats_.total_errors) / static_cast<double>(stats_.total_requests);
-    if (error_ratio > 0.20 && static_cast<int>(config_->stratum) < 15) {
-      config_->stratum = static_cast<NtpStratum>(static_cast<int>(config_->stratum) + 1);
+  broadcast_cv_.notify_all();
+  if (broadcast_thread_.joinable()) {
+    broadcast_thread_.join();
+  }
+  if (broadcast_socket_ != INVALID_SOCKET) {
+    CLOSE_SOCKET(broadcast_socket_);
+    broadcast_socket_ = INVALID_SOCKET;
+  }
+}
+
+void NtpServer::broadcastLoop() {
+  while (broadcast_running_) {
+    sendBroadcast();
+    std::unique_lock<std::mutex> lock(broadcast_mutex_);
+    broadcast_cv_.wait_for(lock, config_->broadcast_interval,
+                           [this] { return !broadcast_running_; });
+  }
+}
+
+bool NtpServer::sendBroadcast() {
+  // The poll field advertises the broadcast interval; receivers expect 4-17.
+  const double interval =
+      std::max<double>(1.0, static_cast<double>(config_->broadcast_interval.count()));
+  const auto poll = static_cast<int8_t>(std::clamp<long>(std::lround(std::log2(interval)), 4, 17));
+  NtpPacket packet =
+      NtpPacket::createBroadcastPacket(config_->stratum, effectiveReferenceId(), poll);
+  // A node that has lost its sources stays quiet rather than mislead a LAN.
+  if (!applySyncState(packet) && upstream_sync_) {
+    logger_->debug("Not synchronized; broadcast skipped");
+    return false;
+  }
+
+  auto data = packet.serializeToData();
+  if (config_->broadcast_key_id != 0) {
+    const auto key = config_->authentication_keys.find(config_->broadcast_key_id);
+    if (key == config_->authentication_keys.end() ||
+        !appendSymmetricKeyMac(data, key->first, key->second,
+                               config_->authentication_algorithm)) {
+      logger_->error("Broadcast key " + std::to_string(config_->broadcast_key_id) +
+                     " unusable; broadcast skipped");
+      return false;
     }
   }
+  const ssize_t sent =
+      sendto(broadcast_socket_, data.data(), data.size(), 0,
+             reinterpret_cast<const struct sockaddr *>(&broadcast_dest_), broadcast_dest_len_);
+  if (sent != static_cast<ssize_t>(data.size())) {
+    logger_->warning("Failed to send broadcast: " + std::string(std::strerror(errno)));
+    return false;
+  }
+  broadcasts_sent_++;
+  return true;
+}
+
+bool NtpServer::startStatsSegment() {
+  std::string error;
+  if (!stats_segment_.open(config_->stats_segment_path, error)) {
+    logger_->error("Statistics segment: " + error);
+    return false;
+  }
+  stats_segment_.publish(collectStatsSegment());
+  stats_segment_running_ = true;
+  stats_segment_thread_ = std::thread(&NtpServer::statsSegmentLoop, this);
+  logger_->info("Publishing statistics to " + config_->stats_segment_path);
+  return true;
+}
+
+void NtpServer::stopStatsSegment() {
+  {
+    std::lock_guard<std::mutex> lock(stats_segment_mutex_);
+    stats_segment_running_ = false;
+  }
+  stats_segment_cv_.notify_all();
+  if (stats_segment_thread_.joinable()) {
+    stats_segment_thread_.join();
+  }
+}
+
+void NtpServer::statsSegmentLoop() {
+  while (stats_segment_running_) {
+    {
+      std::unique_lock<std::mutex> lock(stats_segment_mutex_);
+      stats_segment_cv_.wait_for(lock, config_->stats_segment_interval,
+                                 [this] { return !stats_segment_running_; });
+    }
+    if (stats_segment_running_) {
+      stats_segment_.publish(collectStatsSegment());
+    }
+  }
+}
+
+StatsSegmentPayload NtpServer::collectStatsSegment() {
+  // Reads only the workers' published blocks, the atomic connection count
+  // and the sync snapshot, never connections_mutex_ or anything else the
+  // serving threads wait on.
+  StatsSegmentPayload payload;
+  const auto now = std::chrono::system_clock::now();
+  const auto since_start = std::chrono::steady_clock::now() - stats_start_time_;
+  payload.published_unix_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+  payload.started_unix_ns =
+      payload.published_unix_ns -
+      std::chrono::duration_cast<std::chrono::nanoseconds>(since_start).count();
+  payload.pid = static_cast<int64_t>(getpid());
+
+  const NtpServerStats stats = getStats();
+  payload.total_connections = stats.total_connections;
+  payload.active_connections = stats.active_connections;
+  payload.total_requests = stats.total_requests;
+  payload.total_responses = stats.total_responses;
+  payload.total_bytes = stats.total_bytes_transferred;
+  payload.total_errors = stats.total_errors;
+  payload.processing_time_us = stats.total_request_processing_time_us;
+  payload.processed_requests = stats.processed_request_count;
+  payload.worker_threads = static_cast<uint32_t>(worker_threads_.size());
+  payload.running = running_ ? 1 : 0;
+
+  // What a client asking now would be told.
+  NtpPacket packet;
+  packet.stratum = static_cast<uint8_t>(config_->stratum);
+  packet.transmit_ts = NtpTimestamp::fromSystemTime(now);
+  payload.synced = applySyncState(packet) ? 1 : 0;
+  payload.stratum = packet.stratum;
+  payload.leap_indicator = static_cast<uint8_t>(packet.leap_indicator);
+  if (upstream_sync_) {
+    payload.clock_offset_us = upstream_sync_->clockOffsetUs();
+    payload.frequency_ppm = upstream_sync_->frequencyPpm();
+  }
+
+  const LatencySnapshot latency = getLatencySnapshot();
+  payload.processing = latency.processing;
+  payload.kernel_to_user = latency.kernel_to_user;
+  payload.residence = latency.residence;
+  return payload;
+}
+
+bool NtpServer::roughtimeNow(uint64_t &midpoint, uint32_t &radius) {
+  // Same corrected time and root distance an NTP client would get.
+  NtpPacket packet;
+  packet.transmit_ts = NtpTimestamp::fromSystemTime(std::chrono::system_clock::now());
+  if (!applySyncState(packet) && upstream_sync_) {
+    return false;
+  }
+  const double distance = (static_cast<double>(packet.root_delay) / 2.0 +
+                           static_cast<double>(packet.root_dispersion)) / 65536.0;
+  midpoint = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                                       packet.transmit_ts.toSystemTime().time_since_epoch())
+                                       .count());
+  // Whole seconds on the wire, so the truncated midpoint costs up to one more.
+  radius = static_cast<uint32_t>(std::ceil(distance)) + 1;
+  return true;
 }
 
 std::string NtpServer::effectiveReferenceId() const {
@@ -938,6 +1938,9 @@ std::string NtpServer::effectiveReferenceId() const {
   if (source == "hardware") {
     return "HARD";
   }
+  if (source == "shm") {
+    return config_->reference_clock_refid;
+  }
   return config_->reference_id.empty() ? "LOCL" : config_->reference_id;
 }
 
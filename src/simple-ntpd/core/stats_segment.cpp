@@ -0,0 +1,123 @@
+/**
+ * @file stats_segment.cpp
+ * @brief Memory-mapped statistics file: writer and reader
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/stats_segment.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+namespace simple_ntpd {
+
+namespace {
+using PayloadLock = SeqLock<StatsSegmentPayload>;
+
+constexpr size_t kSegmentSize = sizeof(StatsSegmentHeader) + sizeof(PayloadLock);
+// A store takes microseconds; this many torn reads in a row means the
+// writer is not coming back to finish it.
+constexpr unsigned kReadAttempts = 100000;
+} // namespace
+
+StatsSegment::~StatsSegment() { close(); }
+
+bool StatsSegment::open(const std::string &path, std::string &error) {
+  close();
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(kSegmentSize)) != 0) {
+    error = "cannot size " + path + ": " + std::strerror(errno);
+    ::close(fd);
+    return false;
+  }
+  void *map = ::mmap(nullptr, kSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd); // The mapping keeps the file
+  if (map == MAP_FAILED) {
+    error = "cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  // Invalidate the magic first, so a reader never accepts a half-built file,
+  // and write it last.
+  auto *header = static_cast<StatsSegmentHeader *>(map);
+  std::memset(header->magic, 0, sizeof(header->magic));
+  std::atomic_thread_fence(std::memory_order_release);
+  lock_ = new (static_cast<char *>(map) + sizeof(StatsSegmentHeader)) PayloadLock();
+  header->version = kStatsSegmentVersion;
+  header->header_size = sizeof(StatsSegmentHeader);
+  header->payload_size = sizeof(StatsSegmentPayload);
+  std::memset(header->reserved, 0, sizeof(header->reserved));
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header->magic, kStatsSegmentMagic, sizeof(header->magic));
+  map_ = map;
+  size_ = kSegmentSize;
+  return true;
+}
+
+void StatsSegment::publish(const StatsSegmentPayload &payload) {
+  if (lock_ != nullptr) {
+    lock_->store(payload);
+  }
+}
+
+void StatsSegment::close() {
+  if (map_ != nullptr) {
+    // SeqLock is trivially destructible; the bytes stay in the file.
+    ::munmap(map_, size_);
+    map_ = nullptr;
+    size_ = 0;
+    lock_ = nullptr;
+  }
+}
+
+bool readStatsSegment(const std::string &path, StatsSegmentPayload &payload,
+                      std::string &error) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat info {};
+  if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < kSegmentSize) {
+    error = path + " is not a statistics segment (too small)";
+    ::close(fd);
+    return false;
+  }
+  void *map = ::mmap(nullptr, kSegmentSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    error = "cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  const auto *header = static_cast<const StatsSegmentHeader *>(map);
+  bool ok = false;
+  if (std::memcmp(header->magic, kStatsSegmentMagic, sizeof(header->magic)) != 0) {
+    error = path + " is not a statistics segment (bad magic)";
+  } else if (header->version != kStatsSegmentVersion ||
+             header->header_size != sizeof(StatsSegmentHeader) ||
+             header->payload_size != sizeof(StatsSegmentPayload)) {
+    error = path + " has segment version " + std::to_string(header->version) +
+            ", expected " + std::to_string(kStatsSegmentVersion);
+  } else {
+    const auto *lock = reinterpret_cast<const PayloadLock *>(static_cast<const char *>(map) +
+                                                             sizeof(StatsSegmentHeader));
+    ok = lock->tryLoad(payload, kReadAttempts);
+    if (!ok) {
+      error = path + " was left mid-update by its writer";
+    }
+  }
+  ::munmap(map, kSegmentSize);
+  return ok;
+}
+
+} // namespace simple_ntpd
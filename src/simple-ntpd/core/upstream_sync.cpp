@@ -3,122 +3,671 @@
  * @brief Upstream NTP synchronization
  */
 
+#include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#ifdef SIMPLE_NTPD_HAVE_JSONCPP
+#include <json/json.h>
+#endif
 
 #include "simple-ntpd/core/upstream_sync.hpp"
 #include "simple-ntpd/core/packet.hpp"
+#include "simple-ntpd/utils/trace.hpp"
 #include <algorithm>
 #include <array>
+#include <bitset>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <sstream>
 
 namespace simple_ntpd {
 
 namespace {
 
-socket_t createUdpSocket(std::chrono::milliseconds timeout) {
-  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-  if (sock == INVALID_SOCKET) {
-    return INVALID_SOCKET;
-  }
+// Assumed local clock precision (log2 s) used in sample dispersion.
+constexpr int kLocalPrecisionLog2 = -20;
 
-  const auto ms = static_cast<int>(timeout.count());
-  struct timeval tv {};
-  tv.tv_sec = ms / 1000;
-  tv.tv_usec = (ms % 1000) * 1000;
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-  return sock;
+double monotonicSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
 }
 
-} // namespace
+int64_t secondsToUs(double seconds) {
+  return static_cast<int64_t>(std::llround(seconds * 1e6));
+}
 
-UpstreamSyncResult queryUpstreamServer(const std::string &host,
-                                       std::chrono::milliseconds timeout) {
-  UpstreamSyncResult result;
-  result.server = host;
+// RFC 5905 refid of an address: the IPv4 address itself, or for IPv6 the
+// first four octets of the MD5 hash of the address.
+uint32_t referenceIdForAddress(const struct sockaddr_storage &address) {
+  const auto *sa = reinterpret_cast<const struct sockaddr *>(&address);
+  if (sa->sa_family == AF_INET) {
+    return ntohl(reinterpret_cast<const struct sockaddr_in *>(sa)->sin_addr.s_addr);
+  }
+  if (sa->sa_family != AF_INET6) {
+    return 0;
+  }
+  const auto *sin6 = reinterpret_cast<const struct sockaddr_in6 *>(sa);
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  if (EVP_Digest(sin6->sin6_addr.s6_addr, sizeof(sin6->sin6_addr.s6_addr), digest,
+                 &length, EVP_md5(), nullptr) != 1 ||
+      length < 4) {
+    return 0;
+  }
+  return (static_cast<uint32_t>(digest[0]) << 24) | (static_cast<uint32_t>(digest[1]) << 16) |
+         (static_cast<uint32_t>(digest[2]) << 8) | static_cast<uint32_t>(digest[3]);
+}
 
-  struct addrinfo hints {};
-  hints.ai_family = AF_INET;
-  hints.ai_socktype = SOCK_DGRAM;
+uint32_t referenceIdFor(const UpstreamAssociation &association) {
+  if (association.refclock) {
+    return association.refclock->referenceId();
+  }
+  return association.address_len == 0 ? 0 : referenceIdForAddress(association.address);
+}
 
-  struct addrinfo *res = nullptr;
-  const int gai = getaddrinfo(host.c_str(), "123", &hints, &res);
-  if (gai != 0 || res == nullptr) {
-    return result;
+// Bind a peer socket to the configured listen address, so siblings see
+// the same source address they are configured with.
+bool bindPeerSocket(socket_t sock, int family, const std::string &bind_address) {
+  struct sockaddr_storage local {};
+  socklen_t length = 0;
+  if (family == AF_INET) {
+    auto *sin = reinterpret_cast<struct sockaddr_in *>(&local);
+    if (inet_pton(AF_INET, bind_address.c_str(), &sin->sin_addr) != 1 ||
+        sin->sin_addr.s_addr == htonl(INADDR_ANY)) {
+      return true;
+    }
+    sin->sin_family = AF_INET;
+    length = sizeof(*sin);
+  } else {
+    auto *sin6 = reinterpret_cast<struct sockaddr_in6 *>(&local);
+    if (inet_pton(AF_INET6, bind_address.c_str(), &sin6->sin6_addr) != 1 ||
+        IN6_IS_ADDR_UNSPECIFIED(&sin6->sin6_addr)) {
+      return true;
+    }
+    sin6->sin6_family = AF_INET6;
+    length = sizeof(*sin6);
   }
+  return bind(sock, reinterpret_cast<struct sockaddr *>(&local), length) == 0;
+}
 
-  socket_t sock = createUdpSocket(timeout);
+bool openAssociation(UpstreamAssociation &association) {
+  if (association.address_len == 0) {
+    return false;
+  }
+  const auto *addr = reinterpret_cast<const struct sockaddr *>(&association.address);
+  socket_t sock = socket(addr->sa_family, SOCK_DGRAM, IPPROTO_UDP);
   if (sock == INVALID_SOCKET) {
-    freeaddrinfo(res);
-    return result;
+    return false;
+  }
+  const int flags = fcntl(sock, F_GETFL, 0);
+  // A connected socket only accepts datagrams from the upstream itself and
+  // reports ICMP errors back to us, which lets dead servers fail fast.
+  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0 ||
+      (association.symmetric &&
+       !bindPeerSocket(sock, addr->sa_family, association.bind_address)) ||
+      connect(sock, addr, association.address_len) < 0) {
+    CLOSE_SOCKET(sock);
+    return false;
+  }
+  // A peer synchronized to us advertises our address as its refid.
+  struct sockaddr_storage local {};
+  socklen_t local_len = sizeof(local);
+  association.local_reference_id =
+      getsockname(sock, reinterpret_cast<struct sockaddr *>(&local), &local_len) == 0
+          ? referenceIdForAddress(local)
+          : 0;
+  association.socket = sock;
+  return true;
+}
+
+void assignAddress(UpstreamAssociation &association, const ResolvedAddress &address) {
+  std::memcpy(&association.address, &address.storage, address.length);
+  association.address_len = address.length;
+  association.address_text = address.text;
+}
+
+// Take the refclock's newest sample; one older than @p max_age counts as a
+// miss, like an unanswered poll.
+void pollRefClock(UpstreamAssociation &association, double max_age) {
+  UpstreamSyncResult result;
+  result.server = association.spec;
+  RefClockSample sample;
+  const double unix_now = std::chrono::duration<double>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  if (association.refclock->poll(sample) && unix_now - sample.receive_time <= max_age) {
+    result.success = true;
+    result.offset_us = secondsToUs(sample.offset);
+    result.stratum = 0; // The reference itself
+    result.leap_indicator = static_cast<uint8_t>(sample.leap);
+    result.precision = static_cast<int8_t>(sample.precision);
+    result.reference_id = association.refclock->referenceId();
   }
+  association.last_result = result;
+}
 
+void drainSocket(socket_t sock) {
+  std::array<uint8_t, NTP_MAX_PACKET_SIZE> scratch{};
+  while (recv(sock, scratch.data(), scratch.size(), 0) > 0) {
+  }
+}
+
+bool sendRequest(UpstreamAssociation &association) {
   NtpPacket request = NtpPacket::createClientRequest();
+  if (association.symmetric) {
+    request.mode = static_cast<uint8_t>(NtpMode::SYMMETRIC_ACTIVE);
+  }
   const auto request_data = request.serializeToData();
-  const NtpTimestamp t1 = request.transmit_ts;
+  const ssize_t sent =
+      send(association.socket, request_data.data(), request_data.size(), 0);
+  if (sent != static_cast<ssize_t>(request_data.size())) {
+    return false;
+  }
+  association.origin_ts = request.transmit_ts;
+  return true;
+}
 
-  bool sent_any = false;
-  for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
-    if (ai->ai_family != AF_INET) {
+/**
+ * Read every pending datagram on the association socket. Returns true once a
+ * reply matching the outstanding request has been decoded into @p result.
+ */
+bool receiveReply(UpstreamAssociation &association, UpstreamSyncResult &result,
+                  bool &hard_error) {
+  std::array<uint8_t, NTP_MAX_PACKET_SIZE> buffer{};
+  while (true) {
+    const ssize_t received =
+        recv(association.socket, buffer.data(), buffer.size(), 0);
+    if (received < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        hard_error = true;
+      }
+      return false;
+    }
+    const NtpTimestamp t4 = NtpTimestamp::now();
+    if (received < static_cast<ssize_t>(NTP_PACKET_SIZE)) {
+      continue;
+    }
+
+    NtpPacket response;
+    std::vector<uint8_t> response_data(buffer.begin(),
+                                       buffer.begin() + received);
+    const NtpMode expected = association.symmetric ? NtpMode::SYMMETRIC_PASSIVE
+                                                   : NtpMode::SERVER;
+    if (!response.parseFromData(response_data) || !response.isValid() ||
+        response.mode != static_cast<uint8_t>(expected)) {
       continue;
     }
-    ssize_t sent = sendto(sock, request_data.data(), request_data.size(), 0,
-                          ai->ai_addr, ai->ai_addrlen);
-    if (sent == static_cast<ssize_t>(request_data.size())) {
-      sent_any = true;
+    // Ignore late replies to an earlier round and anything not echoing our
+    // transmit timestamp.
+    if (response.originate_ts.seconds != association.origin_ts.seconds ||
+        response.originate_ts.fraction != association.origin_ts.fraction) {
+      continue;
+    }
+    // An answer, but not a usable one: kiss codes, unsynchronized servers,
+    // and peers synchronized to us (a timing loop).
+    if (response.stratum == 0 || response.stratum >= 16 || response.leap_indicator == 3 ||
+        (association.symmetric && association.local_reference_id != 0 &&
+         response.reference_id == association.local_reference_id)) {
+      return true;
+    }
+
+    const NtpTimestamp &t1 = association.origin_ts;
+    NtpPacketHandler handler;
+    result.offset_us = handler
+                           .calculateOffset(t1, response.receive_ts,
+                                            response.transmit_ts, t4)
+                           .count();
+    result.delay_us = handler
+                          .calculateRoundTripDelay(t1, response.receive_ts,
+                                                   response.transmit_ts, t4)
+                          .count();
+    result.stratum = response.stratum;
+    result.leap_indicator = response.leap_indicator;
+    result.precision = response.precision;
+    result.reference_id = response.reference_id;
+    result.root_delay_us = shortFormatToMicroseconds(response.root_delay);
+    result.root_dispersion_us = shortFormatToMicroseconds(response.root_dispersion);
+    result.success = true;
+    return true;
+  }
+}
+
+std::string jsonEscape(const std::string &value) {
+  std::string out;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+#ifdef SIMPLE_NTPD_HAVE_JSONCPP
+// Numeric member of a state file object, or @p fallback if absent.
+double jsonNumber(const Json::Value &object, const char *key, double fallback = 0.0) {
+  const Json::Value &value = object[key];
+  return value.isNumeric() ? value.asDouble() : fallback;
+}
+#endif
+
+} // namespace
+
+std::string formatUpstreamSyncState(const UpstreamSyncState &state) {
+  std::ostringstream out;
+  out.precision(17);
+  out << "{\n";
+  out << "    \"saved_at\": " << state.saved_at << ",\n";
+  out << "    \"synced\": " << (state.synced ? 1 : 0) << ",\n";
+  out << "    \"clock_offset_s\": " << state.offset << ",\n";
+  out << "    \"clock_frequency\": " << state.frequency << ",\n";
+  out << "    \"clock_dispersion_s\": " << state.dispersion << ",\n";
+  out << "    \"system_stratum\": " << static_cast<int>(state.stratum) << ",\n";
+  out << "    \"system_peer\": \"" << jsonEscape(state.upstream) << "\",\n";
+  out << "    \"system_jitter_us\": " << state.jitter_us << ",\n";
+  out << "    \"upstreams\": [";
+  for (size_t i = 0; i < state.associations.size(); ++i) {
+    const auto &a = state.associations[i];
+    out << (i == 0 ? "\n" : ",\n");
+    out << "      {\"spec\": \"" << jsonEscape(a.spec) << "\", \"address\": \""
+        << jsonEscape(a.address) << "\", \"stratum\": " << static_cast<int>(a.stratum)
+        << ", \"consecutive_failures\": " << a.consecutive_failures
+        << ", \"poll\": " << a.poll << ", \"reach\": " << static_cast<int>(a.reach)
+        << ", \"polls\": " << a.polls << ", \"errors\": " << a.errors << "}";
+  }
+  out << (state.associations.empty() ? "]\n" : "\n    ]\n");
+  out << "  }";
+  return out.str();
+}
+
+bool parseUpstreamSyncState(const std::string &text, UpstreamSyncState &state) {
+#ifdef SIMPLE_NTPD_HAVE_JSONCPP
+  Json::CharReaderBuilder builder;
+  const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+  Json::Value root;
+  std::string errors;
+  if (!reader->parse(text.data(), text.data() + text.size(), &root, &errors) ||
+      !root.isObject()) {
+    return false;
+  }
+  const Json::Value &sync = root["upstream_sync"];
+  if (!sync.isObject() || !sync["saved_at"].isNumeric()) {
+    return false;
+  }
+  state.saved_at = sync["saved_at"].asDouble();
+  state.synced = jsonNumber(sync, "synced") != 0.0;
+  state.offset = jsonNumber(sync, "clock_offset_s");
+  state.frequency = jsonNumber(sync, "clock_frequency");
+  state.dispersion = jsonNumber(sync, "clock_dispersion_s");
+  state.stratum = static_cast<uint8_t>(std::clamp(jsonNumber(sync, "system_stratum"), 0.0, 16.0));
+  state.upstream = sync["system_peer"].isString() ? sync["system_peer"].asString() : "";
+  state.jitter_us = static_cast<int64_t>(jsonNumber(sync, "system_jitter_us"));
+
+  state.associations.clear();
+  const Json::Value &upstreams = sync["upstreams"];
+  if (!upstreams.isArray()) {
+    return true;
+  }
+  for (const Json::Value &entry : upstreams) {
+    if (!entry.isObject() || !entry["spec"].isString() || !entry["address"].isString()) {
+      continue;
+    }
+    UpstreamAssociationState a;
+    a.spec = entry["spec"].asString();
+    a.address = entry["address"].asString();
+    a.stratum = static_cast<uint8_t>(std::clamp(jsonNumber(entry, "stratum"), 0.0, 16.0));
+    a.consecutive_failures =
+        static_cast<uint32_t>(std::max(0.0, jsonNumber(entry, "consecutive_failures")));
+    a.poll = static_cast<int>(
+        std::clamp(jsonNumber(entry, "poll"), 0.0, static_cast<double>(NTP_MAXPOLL)));
+    a.reach = static_cast<uint8_t>(std::clamp(jsonNumber(entry, "reach"), 0.0, 255.0));
+    a.polls = static_cast<uint64_t>(std::max(0.0, jsonNumber(entry, "polls")));
+    a.errors = static_cast<uint64_t>(std::max(0.0, jsonNumber(entry, "errors")));
+    state.associations.push_back(std::move(a));
+  }
+  return true;
+#else
+  (void)text;
+  (void)state;
+  return false;
+#endif
+}
+
+void splitUpstreamHostPort(const std::string &spec, std::string &host,
+                           std::string &service) {
+  host = spec;
+  service = "123";
+  if (!spec.empty() && spec.front() == '[') {
+    const size_t close = spec.find(']');
+    if (close == std::string::npos) {
+      return;
+    }
+    host = spec.substr(1, close - 1);
+    if (close + 1 < spec.size() && spec[close + 1] == ':') {
+      service = spec.substr(close + 2);
+    }
+    return;
+  }
+  const size_t colon = spec.find(':');
+  if (colon != std::string::npos && spec.find(':', colon + 1) == std::string::npos) {
+    host = spec.substr(0, colon);
+    service = spec.substr(colon + 1);
+  }
+}
+
+void resetUpstreamAssociation(UpstreamAssociation &association) {
+  if (association.socket != INVALID_SOCKET) {
+    CLOSE_SOCKET(association.socket);
+    association.socket = INVALID_SOCKET;
+  }
+  association.awaiting_reply = false;
+}
+
+std::vector<UpstreamSyncResult>
+pollUpstreamAssociations(std::vector<UpstreamAssociation *> &associations,
+                         std::chrono::milliseconds timeout) {
+  std::vector<UpstreamSyncResult> results(associations.size());
+  auto now = std::chrono::steady_clock::now();
+  size_t pending = 0;
+
+  for (size_t i = 0; i < associations.size(); ++i) {
+    UpstreamAssociation &assoc = *associations[i];
+    results[i].server = assoc.spec;
+    assoc.awaiting_reply = false;
+    if (assoc.socket == INVALID_SOCKET && !openAssociation(assoc)) {
+      continue;
+    }
+    drainSocket(assoc.socket);
+    if (!sendRequest(assoc)) {
+      resetUpstreamAssociation(assoc);
+      continue;
+    }
+    assoc.awaiting_reply = true;
+    assoc.deadline = now + timeout;
+    ++pending;
+  }
+
+  std::vector<struct pollfd> fds;
+  std::vector<size_t> fd_owner;
+  fds.reserve(pending);
+  fd_owner.reserve(pending);
+
+  while (pending > 0) {
+    fds.clear();
+    fd_owner.clear();
+    auto earliest = std::chrono::steady_clock::time_point::max();
+    for (size_t i = 0; i < associations.size(); ++i) {
+      const UpstreamAssociation &assoc = *associations[i];
+      if (!assoc.awaiting_reply) {
+        continue;
+      }
+      fds.push_back({assoc.socket, POLLIN, 0});
+      fd_owner.push_back(i);
+      earliest = std::min(earliest, assoc.deadline);
+    }
+
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        earliest - now);
+    const int wait_ms =
+        static_cast<int>(std::max<int64_t>(0, wait.count() + 1));
+    const int ready = poll(fds.data(), static_cast<nfds_t>(fds.size()), wait_ms);
+    if (ready < 0 && errno != EINTR) {
       break;
     }
+    now = std::chrono::steady_clock::now();
+
+    for (size_t k = 0; ready > 0 && k < fds.size(); ++k) {
+      if (fds[k].revents == 0) {
+        continue;
+      }
+      const size_t i = fd_owner[k];
+      UpstreamAssociation &assoc = *associations[i];
+      bool hard_error = false;
+      if (receiveReply(assoc, results[i], hard_error)) {
+        assoc.awaiting_reply = false;
+        --pending;
+      } else if (hard_error) {
+        // Typically ECONNREFUSED from an ICMP port unreachable.
+        assoc.awaiting_reply = false;
+        --pending;
+      }
+    }
+
+    for (size_t i = 0; i < associations.size(); ++i) {
+      UpstreamAssociation &assoc = *associations[i];
+      if (assoc.awaiting_reply && now >= assoc.deadline) {
+        assoc.awaiting_reply = false;
+        --pending;
+      }
+    }
   }
-  freeaddrinfo(res);
-  if (!sent_any) {
-    CLOSE_SOCKET(sock);
-    return result;
+
+  for (size_t i = 0; i < associations.size(); ++i) {
+    associations[i]->awaiting_reply = false;
+    associations[i]->last_result = results[i];
+  }
+  return results;
+}
+
+UpstreamSyncResult queryUpstreamServer(const std::string &host,
+                                       std::chrono::milliseconds timeout) {
+  UpstreamAssociation association;
+  association.spec = host;
+  splitUpstreamHostPort(host, association.host, association.service);
+  std::vector<ResolvedAddress> addresses;
+  if (resolveAddresses(association.host, association.service, addresses)) {
+    assignAddress(association, addresses.front());
+  }
+
+  std::vector<UpstreamAssociation *> batch{&association};
+  const auto results = pollUpstreamAssociations(batch, timeout);
+  resetUpstreamAssociation(association);
+  return results.front();
+}
+
+// SyncSnapshot implementation
+double SyncSnapshot::monotonicNow() { return monotonicSeconds(); }
+
+int64_t SyncSnapshot::offsetUsAt(double now) const {
+  if (steering || !clock.valid) {
+    return 0;
   }
+  return secondsToUs(clock.offsetAt(now));
+}
 
-  std::array<uint8_t, NTP_PACKET_SIZE> buffer{};
-  struct sockaddr_in from_addr {};
-  socklen_t from_len = sizeof(from_addr);
-  const ssize_t received =
-      recvfrom(sock, buffer.data(), buffer.size(), 0,
-               reinterpret_cast<struct sockaddr *>(&from_addr), &from_len);
-  CLOSE_SOCKET(sock);
+uint8_t SyncSnapshot::stratumAt(double now, uint8_t configured_stratum) const {
+  // A stratum 0 system peer is a local reference clock; we are stratum 1.
+  if (!syncedAt(now)) {
+    return configured_stratum;
+  }
+  return static_cast<uint8_t>(std::clamp(static_cast<int>(stratum) + 1, 1, 15));
+}
 
-  if (received < static_cast<ssize_t>(NTP_PACKET_SIZE)) {
-    return result;
+int64_t SyncSnapshot::rootDispersionUsAt(double now) const {
+  const double elapsed = clock.valid ? std::max(0.0, now - clock.last_update) : 0.0;
+  return root_dispersion_us + static_cast<int64_t>(NTP_PHI * elapsed * 1e6);
+}
+
+// UpstreamHealth implementation
+void UpstreamHealth::recordPoll(bool answered) {
+  reach = static_cast<uint8_t>((reach << 1) | (answered ? 1 : 0));
+  ++polls;
+  if (!answered) {
+    ++errors;
   }
+}
 
-  NtpPacket response;
-  std::vector<uint8_t> response_data(buffer.begin(), buffer.begin() + received);
-  if (!response.parseFromData(response_data) || !response.isValid()) {
-    return result;
+void UpstreamHealth::recordSample(double delay, double jitter) {
+  // Smoothed like a TCP RTT estimate (gain 1/8); the first sample seeds it.
+  constexpr double kGain = 0.125;
+  if (polls - errors <= 1) {
+    delay_score = delay;
+    jitter_score = jitter;
+    return;
   }
+  delay_score += kGain * (delay - delay_score);
+  jitter_score += kGain * (jitter - jitter_score);
+}
 
-  if (response.mode != static_cast<uint8_t>(NtpMode::SERVER)) {
-    return result;
+int UpstreamHealth::recentMisses() const {
+  const int window = static_cast<int>(std::min<uint64_t>(polls, 8));
+  return window - static_cast<int>(std::bitset<8>(reach).count());
+}
+
+const char *selectionPolicyName(NtpConfig::UpstreamSelectionAlgorithm policy) {
+  switch (policy) {
+  case NtpConfig::UpstreamSelectionAlgorithm::RANDOM:
+    return "random";
+  case NtpConfig::UpstreamSelectionAlgorithm::LEAST_ERRORS:
+    return "least_errors";
+  case NtpConfig::UpstreamSelectionAlgorithm::ROUND_ROBIN:
+  default:
+    return "round_robin";
   }
+}
 
-  const NtpTimestamp t4 = NtpTimestamp::now();
-  NtpPacketHandler handler;
-  result.offset_us =
-      handler.calculateOffset(t1, response.receive_ts, response.transmit_ts, t4)
-          .count();
-  result.delay_us = handler
-                        .calculateRoundTripDelay(t1, response.receive_ts,
-                                                 response.transmit_ts, t4)
-                        .count();
-  result.stratum = response.stratum;
-  result.success = true;
-  return result;
+bool healthierThan(const UpstreamHealth &a, const UpstreamHealth &b) {
+  if (a.recentMisses() != b.recentMisses()) {
+    return a.recentMisses() < b.recentMisses();
+  }
+  // Compare error rates without dividing: a.errors/a.polls vs b.errors/b.polls.
+  const uint64_t lhs = a.errors * std::max<uint64_t>(b.polls, 1);
+  const uint64_t rhs = b.errors * std::max<uint64_t>(a.polls, 1);
+  if (lhs != rhs) {
+    return lhs < rhs;
+  }
+  return a.delay_score + a.jitter_score < b.delay_score + b.jitter_score;
+}
+
+size_t selectSystemPeer(NtpConfig::UpstreamSelectionAlgorithm policy,
+                        const std::vector<const UpstreamHealth *> &survivors, size_t current,
+                        bool failover, uint64_t round, uint64_t random) {
+  constexpr int kFailoverMisses = 4;
+  std::vector<size_t> eligible;
+  for (size_t i = 0; i < survivors.size(); ++i) {
+    if (!failover || survivors[i]->recentMisses() < kFailoverMisses) {
+      eligible.push_back(i);
+    }
+  }
+  if (eligible.empty()) {
+    for (size_t i = 0; i < survivors.size(); ++i) {
+      eligible.push_back(i);
+    }
+  }
+  if (eligible.empty()) {
+    return 0;
+  }
+  if (std::find(eligible.begin(), eligible.end(), current) != eligible.end()) {
+    return current;
+  }
+
+  switch (policy) {
+  case NtpConfig::UpstreamSelectionAlgorithm::RANDOM:
+    return eligible[random % eligible.size()];
+  case NtpConfig::UpstreamSelectionAlgorithm::LEAST_ERRORS: {
+    // Ties keep merit order.
+    size_t best = eligible.front();
+    for (size_t i : eligible) {
+      if (healthierThan(*survivors[i], *survivors[best])) {
+        best = i;
+      }
+    }
+    return best;
+  }
+  case NtpConfig::UpstreamSelectionAlgorithm::ROUND_ROBIN:
+  default:
+    return eligible[round % eligible.size()];
+  }
 }
 
 UpstreamSyncManager::UpstreamSyncManager(std::shared_ptr<NtpConfig> config,
                                          std::shared_ptr<Logger> logger)
-    : config_(std::move(config)), logger_(std::move(logger)) {}
+    : config_(std::move(config)), logger_(std::move(logger)) {
+  if (!config_) {
+    return;
+  }
+  resolver_.setTtl(config_->dns_cache_ttl);
+  const int64_t history_window = static_cast<int64_t>(config_->clock_history_hours) * 3600;
+  history_.configure(history_window,
+                     ClockHistory::capacityFor(history_window, config_->min_poll));
+  discipline_.setFrequencyTracking(config_->enable_drift_compensation);
+  if (config_->enable_drift_compensation && !config_->drift_file.empty()) {
+    if (discipline_.loadDriftFile(config_->drift_file)) {
+      if (logger_) {
+        logger_->info("Loaded clock frequency " +
+                      std::to_string(discipline_.frequency() * 1e6) +
+                      " ppm from " + config_->drift_file);
+      }
+    } else if (logger_) {
+      logger_->debug("No usable drift file at " + config_->drift_file);
+    }
+  }
+  setClockAdjuster(createClockAdjuster(config_->system_clock_discipline, logger_));
+  refclock_ = createRefClock(*config_, logger_);
+}
 
-UpstreamSyncManager::~UpstreamSyncManager() { stop(); }
+void UpstreamSyncManager::setClockAdjuster(std::shared_ptr<ClockAdjuster> adjuster) {
+  std::lock_guard<std::mutex> poll_lock(poll_mutex_);
+  adjuster_ = std::move(adjuster);
+  steering_clock_ = adjuster_ && adjuster_->steersSystemClock();
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    clock_backend_ = adjuster_ ? adjuster_->name() : "response offset";
+    publishSnapshotLocked();
+  }
+  if (!adjuster_) {
+    return;
+  }
+  if (logger_) {
+    logger_->info("System clock discipline backend: " + adjuster_->name());
+  }
+  if (discipline_.frequency() != 0.0) {
+    adjuster_->setFrequency(discipline_.frequency());
+  }
+}
+
+bool UpstreamSyncManager::steerSystemClock(double offset, double max_error,
+                                           double est_error, int poll_log2,
+                                           double &frequency) {
+  const bool ok = std::fabs(offset) > ClockDiscipline::kStepThreshold
+                      ? adjuster_->step(offset)
+                      : adjuster_->slew(offset, max_error, est_error, poll_log2);
+  if (ok && adjuster_->readFrequency(frequency)) {
+    return true;
+  }
+  if (steering_clock_ && logger_) {
+    logger_->error("System clock adjustment failed (" + adjuster_->lastError() +
+                   "); falling back to offsetting response timestamps");
+  }
+  // Without a working backend the hot path must apply the offset again.
+  adjuster_.reset();
+  steering_clock_ = false;
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  clock_backend_ = "response offset";
+  publishSnapshotLocked();
+  return false;
+}
+
+UpstreamSyncManager::~UpstreamSyncManager() {
+  stop();
+  for (auto &association : associations_) {
+    resetUpstreamAssociation(association);
+  }
+}
 
 void UpstreamSyncManager::start() {
   if (running_.exchange(true)) {
@@ -131,78 +680,710 @@ void UpstreamSyncManager::stop() {
   if (!running_.exchange(false)) {
     return;
   }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  wake_cv_.notify_all();
   if (sync_thread_.joinable()) {
     sync_thread_.join();
   }
+  saveDriftFile(true);
+}
+
+void UpstreamSyncManager::saveDriftFile(bool force) {
+  if (!config_ || !config_->enable_drift_compensation || config_->drift_file.empty()) {
+    return;
+  }
+  ClockDiscipline snapshot;
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    if (discipline_.state() != ClockDiscipline::State::SYNC) {
+      return;
+    }
+    const double now = monotonicSeconds();
+    // Like ntpd, rewrite the drift file at most once an hour.
+    if (!force && last_drift_save_ > 0.0 && now - last_drift_save_ < 3600.0) {
+      return;
+    }
+    last_drift_save_ = now;
+    snapshot = discipline_;
+  }
+  if (!snapshot.saveDriftFile(config_->drift_file) && logger_) {
+    logger_->warning("Failed to write drift file " + config_->drift_file);
+  }
+}
+
+void UpstreamSyncManager::reconcileAssociations() {
+  struct Wanted {
+    std::string spec;
+    std::string host;
+    std::string service;
+    bool pool = false;
+    bool symmetric = false;
+    std::vector<ResolvedAddress> addresses;
+  };
+
+  std::vector<Wanted> wanted;
+  for (const auto &spec : config_->upstream_servers) {
+    Wanted w;
+    w.spec = spec;
+    splitUpstreamHostPort(spec, w.host, w.service);
+    wanted.push_back(std::move(w));
+  }
+  for (const auto &spec : config_->upstream_pools) {
+    Wanted w;
+    w.spec = spec;
+    w.pool = true;
+    splitUpstreamHostPort(spec, w.host, w.service);
+    wanted.push_back(std::move(w));
+  }
+  for (const auto &spec : config_->peers) {
+    Wanted w;
+    w.spec = spec;
+    w.symmetric = true;
+    splitUpstreamHostPort(spec, w.host, w.service);
+    wanted.push_back(std::move(w));
+  }
+
+  // Cached answers only; misses resolve in the background. On cold start,
+  // wait (bounded by the poll timeout) so the first round has addresses.
+  bool any_resolved = false;
+  for (auto &w : wanted) {
+    any_resolved = resolver_.lookup(w.host, w.service, w.addresses) || any_resolved;
+  }
+  if (!any_resolved) {
+    std::vector<std::pair<std::string, std::string>> names;
+    for (const auto &w : wanted) {
+      names.emplace_back(w.host, w.service);
+    }
+    resolver_.waitFor(names, config_->timeout);
+    for (auto &w : wanted) {
+      resolver_.lookup(w.host, w.service, w.addresses);
+    }
+  }
+
+  const double now = monotonicSeconds();
+  for (auto it = banned_addresses_.begin(); it != banned_addresses_.end();) {
+    it = now >= it->second ? banned_addresses_.erase(it) : std::next(it);
+  }
+
+  std::vector<UpstreamAssociation> next;
+  std::vector<bool> taken(associations_.size(), false);
+  std::unordered_map<std::string, bool> used; // Address text already polled
+
+  // The reference clock leads the list and polls at a fixed 2^min_poll.
+  if (refclock_) {
+    auto it = std::find_if(associations_.begin(), associations_.end(),
+                           [](const UpstreamAssociation &a) { return a.refclock != nullptr; });
+    if (it != associations_.end()) {
+      taken[static_cast<size_t>(it - associations_.begin())] = true;
+      next.push_back(std::move(*it));
+    } else {
+      UpstreamAssociation clock;
+      clock.spec = refclock_->name();
+      clock.refclock = refclock_;
+      clock.poll = PollController(config_->min_poll, config_->min_poll, config_->min_poll);
+      next.push_back(std::move(clock));
+    }
+  }
+
+  auto adopt = [&](const Wanted &w, const ResolvedAddress *address) {
+    for (size_t j = 0; j < associations_.size(); ++j) {
+      const UpstreamAssociation &old = associations_[j];
+      if (!taken[j] && old.spec == w.spec &&
+          old.address_text == (address ? address->text : std::string())) {
+        taken[j] = true;
+        next.push_back(std::move(associations_[j]));
+        return;
+      }
+    }
+    UpstreamAssociation fresh;
+    fresh.spec = w.spec;
+    fresh.host = w.host;
+    fresh.service = w.service;
+    fresh.pool_member = w.pool;
+    fresh.symmetric = w.symmetric;
+    if (w.symmetric) {
+      fresh.bind_address = config_->listen_address;
+    }
+    // New associations start at sync_interval, rounded to a power of two.
+    const double initial = std::chrono::duration<double>(config_->sync_interval).count();
+    fresh.poll = PollController(static_cast<int>(std::lround(std::log2(std::max(1.0, initial)))),
+                                config_->min_poll, config_->max_poll);
+    if (address) {
+      assignAddress(fresh, *address);
+      auto saved = restored_associations_.find(w.spec + "|" + address->text);
+      if (saved != restored_associations_.end()) {
+        fresh.last_sample.stratum = saved->second.stratum;
+        fresh.consecutive_failures = saved->second.consecutive_failures;
+        if (saved->second.poll > 0) {
+          fresh.poll.setPoll(saved->second.poll);
+        }
+        fresh.health.reach = saved->second.reach;
+        fresh.health.polls = saved->second.polls;
+        fresh.health.errors = std::min(saved->second.errors, saved->second.polls);
+        restored_associations_.erase(saved);
+      }
+    }
+    next.push_back(std::move(fresh));
+  };
+
+  for (const auto &w : wanted) {
+    if (!w.pool) {
+      // Stay on the current address while DNS still lists it.
+      const ResolvedAddress *pick = nullptr;
+      for (const auto &old : associations_) {
+        for (const auto &a : w.addresses) {
+          if (!pick && old.spec == w.spec && old.address_text == a.text && !used[a.text]) {
+            pick = &a;
+          }
+        }
+      }
+      for (const auto &a : w.addresses) {
+        if (!pick && !used[a.text]) {
+          pick = &a;
+        }
+      }
+      if (!pick && !w.addresses.empty()) {
+        continue; // Same address as another configured server
+      }
+      if (pick) {
+        used[pick->text] = true;
+      }
+      adopt(w, pick);
+      continue;
+    }
+
+    // Pools: keep healthy members, then fill up from the resolved list.
+    std::vector<const ResolvedAddress *> members;
+    for (const auto &a : w.addresses) {
+      const bool current = std::any_of(
+          associations_.begin(), associations_.end(),
+          [&](const UpstreamAssociation &old) {
+            return old.spec == w.spec && old.address_text == a.text;
+          });
+      if (current && !used[a.text] && banned_addresses_.count(a.text) == 0) {
+        used[a.text] = true;
+        members.push_back(&a);
+      }
+    }
+    for (const auto &a : w.addresses) {
+      if (members.size() >= config_->max_pool_associations) {
+        break;
+      }
+      if (!used[a.text] && banned_addresses_.count(a.text) == 0) {
+        used[a.text] = true;
+        members.push_back(&a);
+      }
+    }
+    if (members.size() > config_->max_pool_associations) {
+      members.resize(config_->max_pool_associations);
+    }
+    for (const ResolvedAddress *a : members) {
+      adopt(w, a);
+    }
+  }
+
+  for (size_t j = 0; j < associations_.size(); ++j) {
+    if (!taken[j]) {
+      resetUpstreamAssociation(associations_[j]);
+    }
+  }
+  associations_ = std::move(next);
 }
 
-UpstreamSyncResult UpstreamSyncManager::syncOnce() {
-  if (!config_ || config_->upstream_servers.empty()) {
+void UpstreamSyncManager::noteFailures(const std::vector<UpstreamAssociation *> &batch,
+                                       double now) {
+  constexpr uint32_t kReresolveAfterFailures = 4;
+  for (UpstreamAssociation *entry : batch) {
+    UpstreamAssociation &assoc = *entry;
+    if (assoc.last_result.success) {
+      assoc.consecutive_failures = 0;
+      continue;
+    }
+    // Poll a dead upstream less often: one step per run of misses.
+    if (++assoc.consecutive_failures % kReresolveAfterFailures == 0) {
+      assoc.poll.backoff();
+    }
+    if (assoc.refclock || assoc.consecutive_failures != kReresolveAfterFailures) {
+      continue;
+    }
+    // Gone bad: look the name up again in the background and, for pools,
+    // swap the member for another address at the next round.
+    resolver_.refresh(assoc.host, assoc.service);
+    if (assoc.pool_member && !assoc.address_text.empty()) {
+      banned_addresses_[assoc.address_text] =
+          now + std::chrono::duration<double>(config_->dns_cache_ttl).count();
+    }
+    if (logger_) {
+      logger_->info("Upstream " + assoc.spec + " (" + assoc.address_text +
+                    ") unreachable; re-resolving");
+    }
+  }
+}
+
+UpstreamSyncResult UpstreamSyncManager::syncOnce() { return runRound(true); }
+
+UpstreamSyncResult UpstreamSyncManager::runRound(bool poll_all) {
+  if (!config_ || !config_->hasSyncSources()) {
     return UpstreamSyncResult{};
   }
 
-  UpstreamSyncResult best;
+  std::lock_guard<std::mutex> poll_lock(poll_mutex_);
+  reconcileAssociations();
 
-  // Try all configured servers; keep the result with lowest delay.
-  for (const auto &server : config_->upstream_servers) {
-    UpstreamSyncResult attempt =
-        queryUpstreamServer(server, config_->timeout);
-    if (attempt.success) {
-      if (!best.success || attempt.delay_us < best.delay_us) {
-        best = attempt;
+  // Only associations whose poll interval has elapsed are queried.
+  const double started = monotonicSeconds();
+  std::vector<UpstreamAssociation *> batch;
+  std::vector<UpstreamAssociation *> network;
+  std::vector<bool> polled(associations_.size(), false);
+  batch.reserve(associations_.size());
+  for (size_t i = 0; i < associations_.size(); ++i) {
+    if (poll_all || associations_[i].next_poll <= started) {
+      batch.push_back(&associations_[i]);
+      polled[i] = true;
+      if (associations_[i].refclock) {
+        pollRefClock(associations_[i], associations_[i].poll.interval());
+      } else {
+        network.push_back(&associations_[i]);
       }
-    } else if (logger_) {
-      logger_->debug("Upstream sync failed for " + server);
     }
   }
+  if (batch.empty()) {
+    return UpstreamSyncResult{};
+  }
+  if (!network.empty()) {
+    pollUpstreamAssociations(network, config_->timeout);
+  }
 
-  if (best.success) {
+  // Feed every reply (or miss) through the association's clock filter and
+  // let the sample steer the association's poll exponent.
+  const double now = monotonicSeconds();
+  noteFailures(batch, now);
+  for (UpstreamAssociation *entry : batch) {
+    UpstreamAssociation &assoc = *entry;
+    const UpstreamSyncResult &attempt = assoc.last_result;
+    assoc.health.recordPoll(attempt.success);
+    if (!attempt.success) {
+      assoc.filter.addMissedSample(now);
+      assoc.next_poll = now + assoc.poll.interval();
+      if (logger_) {
+        logger_->debug("Upstream sync failed for " + attempt.server);
+      }
+      continue;
+    }
+    const bool had_sample = assoc.filter.hasSample();
+    const double previous_offset = assoc.filter.offset();
+    const double previous_jitter = assoc.filter.jitter();
+    const double offset = static_cast<double>(attempt.offset_us) / 1e6;
+    const double delay = static_cast<double>(attempt.delay_us) / 1e6;
+    const double dispersion = std::ldexp(1.0, attempt.precision) +
+                              std::ldexp(1.0, kLocalPrecisionLog2) +
+                              NTP_PHI * delay;
+    assoc.filter.addSample(offset, delay, dispersion, now);
+    SIMPLE_NTPD_PROBE4(upstream__sample, assoc.spec.c_str(), attempt.offset_us, attempt.delay_us,
+                       attempt.stratum);
+    assoc.last_sample = attempt;
+    assoc.health.recordSample(delay, assoc.filter.jitter());
+    if (had_sample && assoc.poll.update(offset - previous_offset, previous_jitter) &&
+        logger_) {
+      logger_->debug("Upstream " + assoc.spec + " poll interval now " +
+                     std::to_string(static_cast<int64_t>(assoc.poll.interval())) + " s");
+    }
+    assoc.next_poll = now + assoc.poll.interval();
+  }
+
+  std::vector<ClockCandidate> candidates;
+  std::vector<size_t> candidate_owner;
+  for (size_t i = 0; i < associations_.size(); ++i) {
+    const UpstreamAssociation &assoc = associations_[i];
+    if (!assoc.filter.hasSample()) {
+      continue;
+    }
+    ClockCandidate c;
+    c.name = assoc.spec;
+    c.stratum = assoc.last_sample.stratum;
+    c.offset = assoc.filter.offset();
+    c.delay = assoc.filter.delay();
+    c.dispersion = assoc.filter.dispersion();
+    c.jitter = assoc.filter.jitter();
+    c.root_distance = assoc.filter.rootDistance(
+        now, static_cast<double>(assoc.last_sample.root_delay_us) / 1e6,
+        static_cast<double>(assoc.last_sample.root_dispersion_us) / 1e6);
+    candidates.push_back(c);
+    candidate_owner.push_back(i);
+  }
+
+  const ClockSelection selection = selectClockSources(candidates);
+  size_t system_peer = selection.system_peer;
+  if (selection.synchronized && selection.survivors.size() > 1) {
+    std::vector<const UpstreamHealth *> health;
+    size_t current = selection.survivors.size();
+    for (size_t k = 0; k < selection.survivors.size(); ++k) {
+      const UpstreamAssociation &assoc = associations_[candidate_owner[selection.survivors[k]]];
+      health.push_back(&assoc.health);
+      if (assoc.spec == system_peer_spec_ && assoc.address_text == system_peer_address_) {
+        current = k;
+      }
+    }
+    const size_t chosen =
+        selectSystemPeer(config_->upstream_selection_algorithm, health, current,
+                         config_->enable_upstream_failover, selection_round_, rng_());
+    if (chosen != current) {
+      ++selection_round_;
+    }
+    system_peer = selection.survivors[chosen];
+  }
+  if (selection.synchronized) {
+    const UpstreamAssociation &assoc = associations_[candidate_owner[system_peer]];
+    system_peer_spec_ = assoc.spec;
+    system_peer_address_ = assoc.address_text;
+  } else {
+    system_peer_spec_.clear();
+    system_peer_address_.clear();
+  }
+
+  std::vector<UpstreamPeerStatus> peers(associations_.size());
+  for (size_t i = 0; i < associations_.size(); ++i) {
+    peers[i].server = associations_[i].spec;
+    peers[i].address = associations_[i].address_text;
+    peers[i].reachable = associations_[i].last_result.success;
+    peers[i].symmetric = associations_[i].symmetric;
+    peers[i].stratum = associations_[i].last_sample.stratum;
+    peers[i].poll = associations_[i].poll.poll();
+    peers[i].health = associations_[i].health;
+  }
+  auto mark = [&](const std::vector<size_t> &which, char tally) {
+    for (size_t k : which) {
+      peers[candidate_owner[k]].tally = tally;
+    }
+  };
+  mark(selection.falsetickers, 'x');
+  mark(selection.truechimers, '-');
+  mark(selection.survivors, '+');
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    auto &peer = peers[candidate_owner[k]];
+    peer.offset_us = secondsToUs(candidates[k].offset);
+    peer.delay_us = secondsToUs(candidates[k].delay);
+    peer.jitter_us = secondsToUs(candidates[k].jitter);
+    peer.root_distance_us = secondsToUs(candidates[k].root_distance);
+  }
+
+  UpstreamSyncResult best;
+  // The clock is only disciplined when the system peer has a new sample;
+  // its poll interval sets the loop time constant.
+  bool fresh_sample = false;
+  int system_poll = 0;
+  uint32_t reference_id = 0;
+  int64_t root_delay_us = 0;
+  int64_t root_dispersion_us = 0;
+  if (selection.synchronized) {
+    const size_t owner = candidate_owner[system_peer];
+    peers[owner].tally = '*';
+    best = associations_[owner].last_sample;
+    best.success = true;
+    best.offset_us = secondsToUs(selection.offset);
+    best.delay_us = secondsToUs(candidates[system_peer].delay);
+    fresh_sample = polled[owner];
+    system_poll = associations_[owner].poll.poll();
+    // Our distance to the root is the peer's plus the path to the peer.
+    const ClockCandidate &peer = candidates[system_peer];
+    reference_id = referenceIdFor(associations_[owner]);
+    root_delay_us = best.root_delay_us + secondsToUs(peer.delay);
+    root_dispersion_us =
+        best.root_dispersion_us + secondsToUs(peer.dispersion + selection.jitter);
+  }
+
+  // With a steering backend the kernel absorbs the offset, so the model
+  // only tracks the kernel frequency and the error bound.
+  bool kernel_disciplined = false;
+  double kernel_frequency = 0.0;
+  if (best.success && fresh_sample && adjuster_) {
+    const bool steering = steering_clock_;
+    const double max_error = candidates[system_peer].root_distance;
+    kernel_disciplined =
+        steerSystemClock(selection.offset, max_error, selection.jitter, system_poll,
+                         kernel_frequency) &&
+        steering;
+  }
+
+  {
     std::lock_guard<std::mutex> lock(state_mutex_);
-    clock_offset_us_ = best.offset_us;
-    last_delay_us_ = best.delay_us;
-    upstream_stratum_ = best.stratum;
-    synced_upstream_ = best.server;
-    last_sync_time_ = std::chrono::system_clock::now();
-    synced_ = true;
-    if (logger_) {
-      logger_->info("Synced with upstream " + best.server + " offset_us=" +
-                    std::to_string(best.offset_us) + " stratum=" +
-                    std::to_string(best.stratum));
+    peer_status_ = std::move(peers);
+    if (best.success) {
+      const bool was_synced = discipline_.state() == ClockDiscipline::State::SYNC;
+      bool stepped = false;
+      if (kernel_disciplined) {
+        stepped = std::fabs(selection.offset) > ClockDiscipline::kStepThreshold;
+        discipline_.restore(0.0, kernel_frequency, selection.jitter, now);
+      } else if (fresh_sample) {
+        stepped = discipline_.update(selection.offset, selection.jitter, now,
+                                     std::ldexp(1.0, system_poll));
+      }
+      if (kernel_disciplined || fresh_sample) {
+        // Offset and jitter in ns, frequency in ppb
+        SIMPLE_NTPD_PROBE4(clock__update, static_cast<int64_t>(selection.offset * 1e9),
+                           static_cast<int64_t>(discipline_.frequency() * 1e9),
+                           static_cast<int64_t>(selection.jitter * 1e9), stepped ? 1 : 0);
+      }
+      last_delay_us_ = best.delay_us;
+      upstream_stratum_ = best.stratum;
+      system_leap_ = best.leap_indicator;
+      system_reference_id_ = reference_id;
+      system_root_delay_us_ = root_delay_us;
+      system_root_dispersion_us_ = root_dispersion_us;
+      synced_upstream_ = best.server;
+      system_jitter_us_ = secondsToUs(selection.jitter);
+      last_sync_time_ = std::chrono::system_clock::now();
+      synced_ = true;
+      holdover_ = false;
+      if (logger_) {
+        if (stepped && was_synced) {
+          logger_->warning("Clock model stepped by " +
+                           std::to_string(best.offset_us) + " us");
+        }
+        logger_->info("Synced with upstream " + best.server + " offset_us=" +
+                      std::to_string(best.offset_us) + " jitter_us=" +
+                      std::to_string(system_jitter_us_) + " freq_ppm=" +
+                      std::to_string(discipline_.frequency() * 1e6) +
+                      " survivors=" + std::to_string(selection.survivors.size()) +
+                      " stratum=" + std::to_string(best.stratum));
+      }
+    } else if (synced_ && syncedAt(now)) {
+      // Keep serving the disciplined clock while its error bound holds.
+      if (!holdover_ && logger_) {
+        logger_->warning("No usable upstream servers; entering holdover");
+      }
+      holdover_ = true;
+    } else {
+      if (synced_ && logger_) {
+        logger_->warning("Holdover dispersion exceeded; clock unsynchronized");
+      } else if (logger_) {
+        logger_->warning(
+            "Upstream synchronization failed: no majority of upstream servers agree");
+      }
+      synced_ = false;
+      holdover_ = false;
     }
-  } else if (logger_) {
-    logger_->warning("Upstream synchronization failed for all configured servers");
+    recordHistoryLocked(polled, selection, fresh_sample, now);
+    publishSnapshotLocked();
   }
 
+  if (best.success) {
+    saveDriftFile(false);
+  }
   return best;
 }
 
+void UpstreamSyncManager::recordHistoryLocked(const std::vector<bool> &polled,
+                                              const ClockSelection &selection,
+                                              bool fresh_sample, double now) {
+  if (!history_.enabled()) {
+    return;
+  }
+  const int64_t unix_now = std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+  std::vector<std::pair<std::string, std::string>> present;
+  for (size_t i = 0; i < associations_.size(); ++i) {
+    const UpstreamAssociation &assoc = associations_[i];
+    const UpstreamPeerStatus &peer = peer_status_[i];
+    present.emplace_back(peer.server, peer.address);
+    if (!polled[i]) {
+      continue;
+    }
+    PeerHistorySample sample;
+    sample.unix_time = unix_now;
+    sample.reachable = assoc.last_result.success;
+    sample.tally = peer.tally;
+    sample.stratum = peer.stratum;
+    if (sample.reachable) {
+      sample.offset_us = assoc.last_result.offset_us;
+      sample.delay_us = assoc.last_result.delay_us;
+      sample.jitter_us = peer.jitter_us;
+    }
+    history_.recordPeer(peer.server, peer.address, sample);
+  }
+  history_.retainPeers(present);
+
+  ClockHistorySample sample;
+  sample.unix_time = unix_now;
+  sample.synced = synced_;
+  sample.holdover = holdover_;
+  // Between system peer samples the state only drifts, so rounds driven by
+  // other associations add at most one sample per minimum poll interval.
+  ClockHistorySample last;
+  const bool changed = !history_.latestClock(last) || last.synced != sample.synced ||
+                       last.holdover != sample.holdover;
+  if (!changed && !fresh_sample &&
+      unix_now - last.unix_time < (int64_t{1} << std::max(config_->min_poll, 0))) {
+    return;
+  }
+  if (synced_) {
+    sample.stratum = upstream_stratum_;
+    sample.jitter_us = system_jitter_us_;
+    sample.root_delay_us = system_root_delay_us_;
+    sample.root_dispersion_us = system_root_dispersion_us_;
+  }
+  if (synced_ && !holdover_) {
+    sample.survivors = static_cast<uint8_t>(std::min<size_t>(selection.survivors.size(), 255));
+    sample.offset_us = secondsToUs(selection.offset);
+  }
+  sample.frequency_ppm = discipline_.frequency() * 1e6;
+  sample.dispersion_us = secondsToUs(discipline_.dispersionAt(now));
+  history_.recordClock(sample);
+}
+
+UpstreamSyncState UpstreamSyncManager::captureState() const {
+  UpstreamSyncState state;
+  state.saved_at = std::chrono::duration<double>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  const double now = monotonicSeconds();
+  state.synced = syncedAt(now);
+  state.offset = steering_clock_ ? 0.0 : discipline_.offsetAt(now);
+  state.frequency = discipline_.frequency();
+  state.dispersion = discipline_.dispersionAt(now);
+  state.stratum = upstream_stratum_;
+  state.upstream = synced_upstream_;
+  state.jitter_us = system_jitter_us_;
+  for (const auto &peer : peer_status_) {
+    if (peer.address.empty()) {
+      continue;
+    }
+    UpstreamAssociationState a;
+    a.spec = peer.server;
+    a.address = peer.address;
+    a.stratum = peer.stratum;
+    a.consecutive_failures = peer.reachable ? 0 : 1;
+    a.poll = peer.poll;
+    a.reach = peer.health.reach;
+    a.polls = peer.health.polls;
+    a.errors = peer.health.errors;
+    state.associations.push_back(std::move(a));
+  }
+  return state;
+}
+
+bool UpstreamSyncManager::restoreState(const UpstreamSyncState &state) {
+  // Seed the resolver with the addresses each name had last time.
+  std::unordered_map<std::string, std::vector<ResolvedAddress>> by_name;
+  for (const auto &a : state.associations) {
+    std::string host;
+    std::string service;
+    std::vector<ResolvedAddress> literal;
+    splitUpstreamHostPort(a.address, host, service);
+    if (!resolveAddresses(host, service, literal, true)) {
+      continue;
+    }
+    by_name[a.spec].push_back(literal.front());
+    restored_associations_[a.spec + "|" + literal.front().text] = a;
+  }
+  for (const auto &entry : by_name) {
+    std::string host;
+    std::string service;
+    splitUpstreamHostPort(entry.first, host, service);
+    resolver_.seed(host, service, entry.second);
+  }
+
+  if (!state.synced) {
+    return false;
+  }
+  const double wall_now = std::chrono::duration<double>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+  const double elapsed = wall_now - state.saved_at;
+  const double dispersion = state.dispersion + NTP_PHI * std::max(0.0, elapsed);
+  if (elapsed < 0.0 || dispersion >= NTP_MAXDIST) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  const double offset = steering_clock_ ? 0.0 : state.offset + state.frequency * elapsed;
+  discipline_.restore(offset, state.frequency, dispersion, monotonicSeconds());
+  upstream_stratum_ = state.stratum;
+  synced_upstream_ = state.upstream;
+  system_jitter_us_ = state.jitter_us;
+  synced_ = true;
+  holdover_ = true;
+  publishSnapshotLocked();
+  if (logger_) {
+    logger_->info("Warm start: restored clock offset " +
+                  std::to_string(secondsToUs(offset)) + " us, frequency " +
+                  std::to_string(state.frequency * 1e6) + " ppm (" +
+                  std::to_string(static_cast<int64_t>(elapsed)) + " s old)");
+  }
+  return true;
+}
+
 void UpstreamSyncManager::syncLoop() {
-  // Initial sync soon after startup.
+  // iburst: a quick run of rounds fills the clock filters (a fresh
+  // association needs about four samples before it is selectable), so a
+  // cold node synchronizes within about two seconds.
+  constexpr int kIburstRounds = 6;
+  constexpr auto kIburstSpacing = std::chrono::milliseconds(500);
+  int burst_left = (config_ && config_->enable_iburst) ? kIburstRounds - 1 : 0;
   syncOnce();
 
+  // After the burst, wake up whenever the next association is due.
   while (running_) {
-    const auto interval =
-        config_ ? config_->sync_interval : std::chrono::seconds(64);
-  std::this_thread::sleep_for(interval);
+    const bool burst = burst_left > 0;
+    if (burst) {
+      --burst_left;
+    }
+    const auto interval = burst ? kIburstSpacing : nextPollDelay();
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_cv_.wait_for(lock, interval, [this] { return !running_; });
+    }
     if (!running_) {
       break;
     }
-    syncOnce();
+    runRound(burst);
+  }
+}
+
+std::chrono::milliseconds UpstreamSyncManager::nextPollDelay() {
+  std::lock_guard<std::mutex> poll_lock(poll_mutex_);
+  if (associations_.empty()) {
+    return std::chrono::milliseconds(
+        static_cast<int64_t>(std::ldexp(1000.0, config_ ? config_->min_poll : 6)));
+  }
+  double due = associations_.front().next_poll;
+  for (const auto &assoc : associations_) {
+    due = std::min(due, assoc.next_poll);
   }
+  const double wait = std::max(0.0, due - monotonicSeconds());
+  return std::chrono::milliseconds(static_cast<int64_t>(std::ceil(wait * 1000.0)));
+}
+
+void UpstreamSyncManager::publishSnapshotLocked() {
+  SyncSnapshot snapshot;
+  snapshot.clock = discipline_.model();
+  snapshot.synced = synced_;
+  snapshot.steering = steering_clock_;
+  snapshot.leap = system_leap_;
+  snapshot.stratum = upstream_stratum_;
+  snapshot.reference_id = system_reference_id_;
+  snapshot.root_delay_us = system_root_delay_us_;
+  snapshot.root_dispersion_us = system_root_dispersion_us_;
+  snapshot_.store(snapshot);
+}
+
+bool UpstreamSyncManager::syncedAt(double now) const {
+  // In holdover the model's dispersion grows at PHI; once the error bound
+  // passes the RFC 5905 distance threshold clients would reject us anyway.
+  return synced_ && discipline_.hasEstimate() &&
+         discipline_.dispersionAt(now) < NTP_MAXDIST;
 }
 
 int64_t UpstreamSyncManager::clockOffsetUs() const {
-  std::lock_guard<std::mutex> lock(state_mutex_);
-  return clock_offset_us_;
+  return snapshot_.load().offsetUsAt(monotonicSeconds());
 }
 
 uint8_t UpstreamSyncManager::effectiveStratum(uint8_t configured_stratum) const {
-  std::lock_guard<std::mutex> lock(state_mutex_);
-  if (!synced_ || upstream_stratum_ == 0) {
-    return configured_stratum;
-  }
-  const int derived = static_cast<int>(upstream_stratum_) + 1;
-  return static_cast<uint8_t>(std::clamp(derived, 1, 15));
+  return snapshot_.load().stratumAt(monotonicSeconds(), configured_stratum);
 }
 
 std::string UpstreamSyncManager::syncedUpstream() const {
@@ -216,20 +1397,94 @@ std::chrono::system_clock::time_point UpstreamSyncManager::lastSyncTime() const
 }
 
 bool UpstreamSyncManager::isSynced() const {
+  return snapshot_.load().syncedAt(monotonicSeconds());
+}
+
+double UpstreamSyncManager::frequencyPpm() const {
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return discipline_.frequency() * 1e6;
+}
+
+bool UpstreamSyncManager::inHoldover() const {
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return holdover_ && syncedAt(monotonicSeconds());
+}
+
+int64_t UpstreamSyncManager::dispersionUs() const {
   std::lock_guard<std::mutex> lock(state_mutex_);
-  return synced_;
+  return secondsToUs(discipline_.dispersionAt(monotonicSeconds()));
+}
+
+int64_t UpstreamSyncManager::systemJitterUs() const {
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return system_jitter_us_;
+}
+
+std::vector<UpstreamPeerStatus> UpstreamSyncManager::peerStatus() const {
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return peer_status_;
+}
+
+int64_t UpstreamSyncManager::historyWindowSeconds() const {
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return history_.windowSeconds();
+}
+
+std::vector<ClockHistorySample> UpstreamSyncManager::clockHistory() const {
+  const int64_t unix_now = std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return history_.clock(unix_now);
+}
+
+std::vector<PeerHistory> UpstreamSyncManager::upstreamHistory() const {
+  const int64_t unix_now = std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  return history_.peers(unix_now);
 }
 
 std::string UpstreamSyncManager::statusSummary() const {
   std::lock_guard<std::mutex> lock(state_mutex_);
+  const double now = monotonicSeconds();
+  const bool synced = syncedAt(now);
   std::stringstream ss;
-  ss << "  Upstream Sync: " << (synced_ ? "Synced" : "Not synced") << "\n";
-  if (synced_) {
+  ss << "  Upstream Sync: "
+     << (synced ? (holdover_ ? "Holdover" : "Synced") : "Not synced") << "\n";
+  if (synced) {
     ss << "  Synced Upstream: " << synced_upstream_ << "\n";
-    ss << "  Clock Offset (us): " << clock_offset_us_ << "\n";
+    ss << "  Clock Offset (us): "
+       << (steering_clock_ ? 0 : secondsToUs(discipline_.offsetAt(now))) << "\n";
+    ss << "  Clock Discipline: "
+       << clock_backend_ << "\n";
+    ss << "  Frequency (ppm): " << discipline_.frequency() * 1e6 << "\n";
+    ss << "  Dispersion (us): " << secondsToUs(discipline_.dispersionAt(now)) << "\n";
+    ss << "  System Jitter (us): " << system_jitter_us_ << "\n";
     ss << "  Last RTT (us): " << last_delay_us_ << "\n";
     ss << "  Upstream Stratum: " << static_cast<int>(upstream_stratum_) << "\n";
   }
+  if (!peer_status_.empty()) {
+    ss << "  Selection Policy: "
+       << selectionPolicyName(config_->upstream_selection_algorithm) << "\n";
+    ss << "  Upstream Servers:\n";
+    for (const auto &peer : peer_status_) {
+      ss << "    " << peer.tally << " " << peer.server;
+      if (!peer.address.empty() && peer.address != peer.server) {
+        ss << " (" << peer.address << ")";
+      }
+      if (peer.symmetric) {
+        ss << " peer";
+      }
+      ss << " reach=" << std::oct << static_cast<int>(peer.health.reach) << std::dec
+         << " errors=" << peer.health.errors
+         << " stratum=" << static_cast<int>(peer.stratum)
+         << " offset_us=" << peer.offset_us << " delay_us=" << peer.delay_us
+         << " jitter_us=" << peer.jitter_us << " poll=" << (1LL << peer.poll)
+         << "s\n";
+    }
+  }
   return ss.str();
 }
 
@@ -9,6 +9,9 @@
 #include "simple-ntpd/utils/logger.hpp"
 #include <chrono>
 #include <cstring>
+#if __has_include(<filesystem>)
+#include <filesystem>
+#endif
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -34,4 +34,27 @@ bool isIpInCidr(const std::string &ip, const std::string &cidr) {
   return (ip_u & mask) == (base_u & mask);
 }
 
+bool parseIpv4Cidr(const std::string &cidr, uint32_t &network, uint32_t &mask) {
+  const size_t slash = cidr.find('/');
+  int prefix = 32;
+  if (slash != std::string::npos) {
+    const std::string length = cidr.substr(slash + 1);
+    if (length.empty() || length.size() > 2 ||
+        length.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    prefix = std::stoi(length);
+    if (prefix > 32) {
+      return false;
+    }
+  }
+  struct in_addr addr {};
+  if (inet_pton(AF_INET, cidr.substr(0, slash).c_str(), &addr) != 1) {
+    return false;
+  }
+  mask = prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - prefix);
+  network = ntohl(addr.s_addr) & mask;
+  return true;
+}
+
 } // namespace simple_ntpd
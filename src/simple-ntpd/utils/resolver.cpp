@@ -0,0 +1,208 @@
+/**
+ * @file resolver.cpp
+ * @brief Background DNS resolver with a TTL cache
+ */
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "simple-ntpd/utils/resolver.hpp"
+#include <cstring>
+
+namespace simple_ntpd {
+
+namespace {
+std::string addressText(const struct sockaddr *sa) {
+  char host[INET6_ADDRSTRLEN] = {0};
+  if (sa->sa_family == AF_INET) {
+    const auto *sin = reinterpret_cast<const struct sockaddr_in *>(sa);
+    inet_ntop(AF_INET, &sin->sin_addr, host, sizeof(host));
+    return std::string(host) + ":" + std::to_string(ntohs(sin->sin_port));
+  }
+  const auto *sin6 = reinterpret_cast<const struct sockaddr_in6 *>(sa);
+  inet_ntop(AF_INET6, &sin6->sin6_addr, host, sizeof(host));
+  return "[" + std::string(host) + "]:" + std::to_string(ntohs(sin6->sin6_port));
+}
+} // namespace
+
+bool resolveAddresses(const std::string &host, const std::string &service,
+                      std::vector<ResolvedAddress> &out, bool numeric_only) {
+  out.clear();
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = numeric_only ? AI_NUMERICHOST : 0;
+
+  struct addrinfo *res = nullptr;
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &res) != 0 || res == nullptr) {
+    return false;
+  }
+  for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
+    if ((ai->ai_family != AF_INET && ai->ai_family != AF_INET6) ||
+        ai->ai_addrlen > sizeof(struct sockaddr_storage)) {
+      continue;
+    }
+    ResolvedAddress address;
+    std::memcpy(&address.storage, ai->ai_addr, ai->ai_addrlen);
+    address.length = static_cast<socklen_t>(ai->ai_addrlen);
+    address.text = addressText(ai->ai_addr);
+    bool duplicate = false;
+    for (const auto &existing : out) {
+      duplicate = duplicate || existing.text == address.text;
+    }
+    if (!duplicate) {
+      out.push_back(std::move(address));
+    }
+  }
+  freeaddrinfo(res);
+  return !out.empty();
+}
+
+// AsyncResolver implementation
+AsyncResolver::AsyncResolver(std::chrono::seconds ttl, std::chrono::seconds negative_ttl)
+    : ttl_(ttl), negative_ttl_(negative_ttl) {
+  worker_ = std::thread(&AsyncResolver::workerLoop, this);
+}
+
+AsyncResolver::~AsyncResolver() { stop(); }
+
+void AsyncResolver::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  work_cv_.notify_all();
+  done_cv_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void AsyncResolver::setTtl(std::chrono::seconds ttl) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ttl_ = ttl;
+}
+
+std::string AsyncResolver::key(const std::string &host, const std::string &service) {
+  return host + "\n" + service;
+}
+
+void AsyncResolver::schedule(const std::string &k, Entry &entry) {
+  if (entry.in_flight || !running_) {
+    return;
+  }
+  entry.in_flight = true;
+  queue_.push_back(k);
+  work_cv_.notify_one();
+}
+
+bool AsyncResolver::lookup(const std::string &host, const std::string &service,
+                           std::vector<ResolvedAddress> &out) {
+  const std::string k = key(host, service);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = cache_.find(k);
+  if (it == cache_.end()) {
+    Entry entry;
+    // Literal addresses need no DNS round trip.
+    if (resolveAddresses(host, service, entry.addresses, true)) {
+      entry.answered = true;
+      entry.permanent = true;
+    }
+    it = cache_.emplace(k, std::move(entry)).first;
+  }
+
+  Entry &entry = it->second;
+  if (!entry.permanent &&
+      (!entry.answered || std::chrono::steady_clock::now() >= entry.expires)) {
+    schedule(k, entry);
+  }
+  out = entry.addresses;
+  return !out.empty();
+}
+
+void AsyncResolver::waitFor(const std::vector<std::pair<std::string, std::string>> &names,
+                            std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait_for(lock, timeout, [&] {
+    if (!running_) {
+      return true;
+    }
+    for (const auto &name : names) {
+      auto it = cache_.find(key(name.first, name.second));
+      if (it != cache_.end() && !it->second.answered) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void AsyncResolver::seed(const std::string &host, const std::string &service,
+                         const std::vector<ResolvedAddress> &addresses) {
+  if (addresses.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry &entry = cache_[key(host, service)];
+  if (entry.answered) {
+    return;
+  }
+  entry.addresses = addresses;
+  entry.answered = true;
+  entry.expires = std::chrono::steady_clock::now();
+}
+
+void AsyncResolver::refresh(const std::string &host, const std::string &service) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = cache_.find(key(host, service));
+  if (it == cache_.end() || it->second.permanent) {
+    return;
+  }
+  it->second.expires = std::chrono::steady_clock::now();
+  schedule(it->first, it->second);
+}
+
+uint64_t AsyncResolver::resolutionCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return resolutions_;
+}
+
+void AsyncResolver::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this] { return !running_ || !queue_.empty(); });
+    if (!running_) {
+      return;
+    }
+    const std::string k = queue_.front();
+    queue_.pop_front();
+    const size_t split = k.find('\n');
+    const std::string host = k.substr(0, split);
+    const std::string service = k.substr(split + 1);
+
+    lock.unlock();
+    std::vector<ResolvedAddress> addresses;
+    const bool ok = resolveAddresses(host, service, addresses);
+    lock.lock();
+
+    ++resolutions_;
+    Entry &entry = cache_[k];
+    entry.in_flight = false;
+    entry.answered = true;
+    if (ok) {
+      entry.addresses = std::move(addresses);
+      entry.expires = std::chrono::steady_clock::now() + ttl_;
+    } else {
+      // Keep serving the last good answer; retry sooner.
+      entry.expires = std::chrono::steady_clock::now() + negative_ttl_;
+    }
+    done_cv_.notify_all();
+  }
+}
+
+} // namespace simple_ntpd
@@ -0,0 +1,184 @@
+/**
+ * @file test_ntp_bench.cpp
+ * @brief Load generator: reply checks, a short run against a local server
+ *        and a misbehaving responder
+ */
+
+#include "simple-ntpd/bench/load_generator.hpp"
+#include "simple-ntpd/core/server.hpp"
+#include "simple-ntpd/utils/logger.hpp"
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kServerPort = 9156;
+constexpr uint16_t kReflectorPort = 9157;
+
+void put64(uint8_t *data, uint64_t value) {
+  for (int i = 7; i >= 0; --i) {
+    data[i] = static_cast<uint8_t>(value);
+    value >>= 8;
+  }
+}
+
+void testResponseChecks() {
+  constexpr uint64_t kCookie = 0x0000000100000007ULL;
+  std::array<uint8_t, NTP_PACKET_SIZE> reply{};
+  reply[0] = (4 << 3) | 4; // LI 0, VN 4, server
+  reply[1] = 2;
+  put64(reply.data() + 24, kCookie);
+  put64(reply.data() + 32, 0xe8000000'00000000ULL);
+  put64(reply.data() + 40, 0xe8000000'00001000ULL);
+  assert(checkResponse(reply.data(), reply.size(), kCookie) == ResponseCheck::VALID);
+  assert(checkResponse(reply.data(), 47, kCookie) == ResponseCheck::SHORT);
+  assert(checkResponse(reply.data(), reply.size(), kCookie + 1) == ResponseCheck::BAD_ORIGIN);
+
+  auto with = [&](size_t offset, uint8_t value) {
+    auto copy = reply;
+    copy[offset] = value;
+    return checkResponse(copy.data(), copy.size(), kCookie);
+  };
+  assert(with(0, (4 << 3) | 3) == ResponseCheck::BAD_MODE);
+  assert(with(0, (3 << 3) | 4) == ResponseCheck::BAD_VERSION);
+  assert(with(0, (3 << 6) | (4 << 3) | 4) == ResponseCheck::UNSYNCHRONIZED);
+  assert(with(1, 0) == ResponseCheck::KISS_OF_DEATH);
+  assert(with(46, 0xff) == ResponseCheck::VALID);
+  assert(with(38, 0xff) == ResponseCheck::BAD_TIMESTAMPS); // Transmit before receive
+  assert(std::string(responseCheckName(ResponseCheck::BAD_ORIGIN)) == "bad_origin");
+
+  LoadOptions options;
+  std::string error;
+  options.target_address = "192.0.2.1";
+  options.source_addresses = 4;
+  assert(!LoadGenerator(options).validate(error));
+  assert(error.find("loopback") != std::string::npos);
+  options.target_address = "localhost";
+  assert(!LoadGenerator(options).validate(error));
+}
+
+void testAgainstServer(const std::shared_ptr<Logger> &logger) {
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kServerPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->enable_rate_limiting = false;
+  config->enable_ddos_protection = false;
+  config->worker_threads = 1;
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  LoadOptions options;
+  options.target_port = kServerPort;
+  options.threads = 2;
+  options.sockets_per_thread = 4;
+  options.source_addresses = 4;
+  options.window = 8;
+  options.batch = 8;
+  options.duration = std::chrono::milliseconds(300);
+  LoadResult result;
+  std::string error;
+  assert(LoadGenerator(options).run(result, error));
+
+  const uint64_t answered =
+      result.count(ResponseCheck::VALID) + result.count(ResponseCheck::UNSYNCHRONIZED);
+  std::cout << "Bench run: " << result.sent << " sent, " << answered << " answered, "
+            << result.lost << " lost" << std::endl;
+  assert(answered > 0 && result.invalid() == 0);
+  assert(result.rtt.count == answered);
+  assert(result.received == answered + result.count(ResponseCheck::LATE));
+  assert(result.sent == answered + result.lost);
+  assert(result.seconds > 0.2 && result.seconds <= 0.3);
+
+  // Eight source ports spread over four source addresses.
+  std::string listing;
+  server.streamConnections([&listing](const std::string &chunk) {
+    listing += chunk;
+    return true;
+  });
+  server.stop();
+  std::set<std::string> addresses;
+  size_t ports = 0;
+  std::istringstream lines(listing);
+  for (std::string line; std::getline(lines, line);) {
+    if (line.compare(0, 10, "  127.0.0.") == 0) {
+      addresses.insert(line.substr(2, line.find(':') - 2));
+      ++ports;
+    }
+  }
+  assert(addresses.size() == 4 && ports == 8);
+}
+
+// Every request comes straight back, still mode 3: nothing may count as valid.
+void testReflector() {
+  const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kReflectorPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+  std::atomic<bool> done{false};
+  std::thread reflector([&] {
+    uint8_t buffer[512];
+    while (!done) {
+      struct pollfd pfd {sock, POLLIN, 0};
+      if (poll(&pfd, 1, 10) <= 0) {
+        continue;
+      }
+      struct sockaddr_in from {};
+      socklen_t from_len = sizeof(from);
+      const ssize_t n = recvfrom(sock, buffer, sizeof(buffer), 0,
+                                 reinterpret_cast<struct sockaddr *>(&from), &from_len);
+      if (n > 0) {
+        sendto(sock, buffer, static_cast<size_t>(n), 0,
+               reinterpret_cast<struct sockaddr *>(&from), from_len);
+      }
+    }
+  });
+
+  LoadOptions options;
+  options.target_port = kReflectorPort;
+  options.sockets_per_thread = 2;
+  options.window = 4;
+  options.duration = std::chrono::milliseconds(100);
+  options.timeout = std::chrono::milliseconds(100);
+  LoadResult result;
+  std::string error;
+  assert(LoadGenerator(options).run(result, error));
+  done = true;
+  reflector.join();
+  close(sock);
+
+  assert(result.received > 0);
+  assert(result.count(ResponseCheck::VALID) == 0 && result.rtt.count == 0);
+  assert(result.count(ResponseCheck::BAD_MODE) == result.received);
+  assert(result.invalid() == result.received);
+}
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Load Generator Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testResponseChecks();
+  testAgainstServer(shared_logger);
+  testReflector();
+
+  std::cout << "Load generator tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file test_ntp_broadcast.cpp
+ * @brief Broadcast (mode 5) server tests with plain and authenticated packets
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/server.hpp"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kServerPort = 9145;
+constexpr uint16_t kReceiverPort = 9146;
+constexpr uint16_t kDeadUpstreamPort = 9147;
+
+socket_t openReceiver(int timeout_ms) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kReceiverPort);
+  assert(inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr) == 1);
+  assert(bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+  struct timeval tv {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  return sock;
+}
+
+std::shared_ptr<NtpConfig> broadcastConfig() {
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kServerPort;
+  config->upstream_servers.clear();
+  config->stratum = NtpStratum::PRIMARY_REFERENCE;
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 1;
+  config->enable_broadcast = true;
+  config->broadcast_address = "127.0.0.1:" + std::to_string(kReceiverPort);
+  config->broadcast_interval = std::chrono::seconds(1);
+  return config;
+}
+
+double unixNow() {
+  return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void testPlainBroadcast(const std::shared_ptr<Logger> &logger) {
+  socket_t receiver = openReceiver(3000);
+  auto config = broadcastConfig();
+  std::vector<std::string> errors;
+  assert(config->validateDetailed(errors));
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  // One packet per interval, without anyone asking.
+  std::vector<uint8_t> buffer(NTP_MAX_PACKET_SIZE);
+  for (int i = 0; i < 2; ++i) {
+    const ssize_t received = recv(receiver, buffer.data(), buffer.size(), 0);
+    assert(received == static_cast<ssize_t>(NTP_PACKET_SIZE));
+    NtpPacket packet;
+    assert(packet.parseFromData(std::vector<uint8_t>(buffer.begin(), buffer.begin() + received)));
+    assert(packet.isValid());
+    assert(packet.mode == static_cast<uint8_t>(NtpMode::BROADCAST));
+    assert(packet.stratum == 1 && packet.leap_indicator == 0);
+    assert(packet.poll == 4); // 1 s, clamped to the smallest valid poll
+    assert(packet.reference_id == 0x4c4f434c); // "LOCL"
+    assert(packet.originate_ts.seconds == 0 && packet.receive_ts.seconds == 0);
+    const double sent = std::chrono::duration<double>(
+        packet.transmit_ts.toSystemTime().time_since_epoch()).count();
+    assert(std::fabs(sent - unixNow()) < 0.5);
+  }
+  assert(server.exportPrometheusMetrics().find("simple_ntpd_broadcast_packets_total") !=
+         std::string::npos);
+  server.stop();
+  close(receiver);
+}
+
+void testAuthenticatedBroadcast(const std::shared_ptr<Logger> &logger) {
+  socket_t receiver = openReceiver(3000);
+  auto config = broadcastConfig();
+  config->authentication_algorithm = NtpConfig::AuthAlgorithm::SHA1;
+  config->broadcast_key_id = 7;
+  std::vector<std::string> errors;
+  assert(!config->validateDetailed(errors)); // Key 7 is not defined yet
+  config->authentication_keys[7] = "broadcast-secret";
+  assert(config->validateDetailed(errors));
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  std::vector<uint8_t> buffer(NTP_MAX_PACKET_SIZE);
+  const ssize_t received = recv(receiver, buffer.data(), buffer.size(), 0);
+  server.stop();
+  close(receiver);
+  assert(received == static_cast<ssize_t>(NTP_PACKET_SIZE + 4 + 20));
+  buffer.resize(static_cast<size_t>(received));
+
+  uint32_t key_id = 0;
+  assert(verifySymmetricKeyMac(buffer, config->authentication_keys,
+                               NtpConfig::AuthAlgorithm::SHA1, key_id));
+  assert(key_id == 7);
+  std::unordered_map<uint32_t, std::string> wrong_keys{{7, "guess"}};
+  assert(!verifySymmetricKeyMac(buffer, wrong_keys, NtpConfig::AuthAlgorithm::SHA1, key_id));
+  assert(!verifySymmetricKeyMac(buffer, config->authentication_keys,
+                                NtpConfig::AuthAlgorithm::MD5, key_id));
+  buffer[40] ^= 0x01; // Tampered transmit timestamp
+  assert(!verifySymmetricKeyMac(buffer, config->authentication_keys,
+                                NtpConfig::AuthAlgorithm::SHA1, key_id));
+  assert(symmetricKeyDigestLength(NtpConfig::AuthAlgorithm::MD5) == 16);
+}
+
+void testUnsynchronizedSilence(const std::shared_ptr<Logger> &logger) {
+  socket_t receiver = openReceiver(1500);
+  auto config = broadcastConfig();
+  config->upstream_servers = {"127.0.0.1:" + std::to_string(kDeadUpstreamPort)};
+  config->enable_drift_compensation = false;
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  std::vector<uint8_t> buffer(NTP_MAX_PACKET_SIZE);
+  assert(recv(receiver, buffer.data(), buffer.size(), 0) < 0);
+  server.stop();
+  close(receiver);
+}
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Broadcast Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testPlainBroadcast(shared_logger);
+  testAuthenticatedBroadcast(shared_logger);
+  testUnsynchronizedSilence(shared_logger);
+
+  std::cout << "Broadcast tests passed." << std::endl;
+  return 0;
+}
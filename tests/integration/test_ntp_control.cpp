@@ -0,0 +1,196 @@
+/**
+ * @file test_ntp_control.cpp
+ * @brief Unix control socket commands against a live server
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/packet.hpp"
+#include "simple-ntpd/core/server.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kNtpPort = 9153;
+constexpr uint64_t kClients = 300;
+
+std::string socketPath() {
+  return "/tmp/simple_ntpd_test_control_" + std::to_string(getpid()) + ".sock";
+}
+
+// Each query comes from a new ephemeral port, so each adds a table entry.
+// The socket stays open so that its port is not handed out again.
+socket_t query() {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {2, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in dest {};
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons(kNtpPort);
+  inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr);
+  const auto request = NtpPacket::createClientRequest().serializeToData();
+  assert(sendto(sock, request.data(), request.size(), 0,
+                reinterpret_cast<struct sockaddr *>(&dest), sizeof(dest)) ==
+         static_cast<ssize_t>(request.size()));
+  std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
+  assert(recv(sock, buffer.data(), buffer.size(), 0) == static_cast<ssize_t>(NTP_PACKET_SIZE));
+  return sock;
+}
+
+bool run(const std::string &command, std::string &body, std::string &error) {
+  std::ostringstream out;
+  const bool ok = queryControlSocket(socketPath(), command, out, error);
+  body = out.str();
+  return ok;
+}
+
+std::set<std::string> clientLines(const std::string &text, size_t &lines) {
+  std::set<std::string> unique;
+  std::istringstream in(text);
+  std::string line;
+  lines = 0;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 12, "  127.0.0.1:") == 0) {
+      unique.insert(line.substr(0, line.find(' ', 2)));
+      ++lines;
+    }
+  }
+  return unique;
+}
+
+void testCommands(const std::shared_ptr<Logger> &logger) {
+  // A socket file left behind by a crashed daemon is replaced.
+  {
+    socket_t stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socketPath().c_str());
+    ::unlink(addr.sun_path);
+    assert(bind(stale, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+    close(stale);
+  }
+
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kNtpPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 2;
+  config->enable_control_socket = true;
+  config->control_socket_path = socketPath();
+  config->enable_packet_capture = true;
+  config->capture_ring_size = 1024;
+  std::vector<std::string> errors;
+  assert(config->validateDetailed(errors));
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  struct stat info {};
+  assert(stat(socketPath().c_str(), &info) == 0 && S_ISSOCK(info.st_mode));
+  assert((info.st_mode & S_IRWXO) == 0);
+
+  // A live socket is not taken over by a second instance.
+  ControlServer second(socketPath(), logger, [](const std::string &, const ControlSink &) {});
+  assert(!second.start());
+
+  std::vector<socket_t> clients;
+  for (uint64_t i = 0; i < kClients; ++i) {
+    clients.push_back(query());
+  }
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (server.getStats().total_requests < kClients &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::string body;
+  std::string error;
+  assert(run("status", body, error));
+  assert(body.find("Status: Running") != std::string::npos);
+  assert(run("stats", body, error));
+  assert(body.find("Total Requests: " + std::to_string(kClients)) != std::string::npos);
+  assert(run("metrics", body, error));
+  assert(body.find("simple_ntpd_requests_total " + std::to_string(kClients)) !=
+         std::string::npos);
+  assert(run("health", body, error));
+  assert(body.find("overall_status: healthy") != std::string::npos);
+
+  assert(run("connections", body, error));
+  assert(body.compare(0, 19, "Active NTP Clients:") == 0);
+  size_t lines = 0;
+  assert(clientLines(body, lines).size() == kClients && lines == kClients);
+
+  // Every exchange was captured: a request and a response record each.
+  assert(run("capture", body, error));
+  assert(body.size() > 24 && body.compare(0, 4, "\x4d\x3c\xb2\xa1", 4) == 0);
+  size_t records = 0;
+  for (size_t offset = 24; offset + 16 <= body.size(); ++records) {
+    uint32_t kept = 0;
+    std::memcpy(&kept, body.data() + offset + 8, sizeof(kept));
+    assert(kept == 28 + NTP_PACKET_SIZE);
+    offset += 16 + kept;
+  }
+  assert(records == 2 * kClients);
+  assert(server.exportPrometheusMetrics().find("simple_ntpd_capture_exchanges_total " +
+                                               std::to_string(kClients)) != std::string::npos);
+
+  // History comes from upstream sync, which this server does not run.
+  assert(!run("history", body, error));
+  assert(error == "clock history is off");
+
+  // No config file was loaded, so there is nothing to reload.
+  assert(!run("reload", body, error));
+  assert(error == "reload failed, see log");
+  assert(!run("shutdown", body, error));
+  assert(error.find("unknown command") != std::string::npos);
+
+  // The listing arrives in pieces; a reader that goes away ends it.
+  size_t chunks = 0;
+  std::string streamed;
+  server.streamConnections(
+      [&](const std::string &chunk) {
+        ++chunks;
+        streamed += chunk;
+        return true;
+      },
+      16);
+  assert(chunks > kClients / 32);
+  assert(clientLines(streamed, lines).size() == kClients && lines == kClients);
+  chunks = 0;
+  server.streamConnections([&](const std::string &) { return ++chunks < 2; }, 16);
+  assert(chunks == 2);
+
+  server.stop();
+  for (socket_t client : clients) {
+    close(client);
+  }
+  assert(stat(socketPath().c_str(), &info) != 0);
+  assert(!run("status", body, error));
+  assert(error.find("no daemon answering") == 0);
+}
+} // namespace
+
+int main() {
+  std::cout << "Running Control Socket Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testCommands(shared_logger);
+
+  std::cout << "Control socket tests passed." << std::endl;
+  return 0;
+}
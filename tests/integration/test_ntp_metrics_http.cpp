@@ -0,0 +1,170 @@
+/**
+ * @file test_ntp_metrics_http.cpp
+ * @brief HTTP /metrics and /health endpoint of a running server
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/server.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kNtpPort = 9151;
+constexpr uint16_t kHttpPort = 9152;
+
+std::shared_ptr<NtpConfig> makeConfig(std::chrono::milliseconds cache_interval) {
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kNtpPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 1;
+  config->enable_metrics_http = true;
+  config->metrics_http_address = "127.0.0.1";
+  config->metrics_http_port = kHttpPort;
+  config->metrics_http_cache_interval = cache_interval;
+  std::vector<std::string> errors;
+  assert(config->validateDetailed(errors));
+  return config;
+}
+
+socket_t connectHttp() {
+  socket_t sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  assert(sock != INVALID_SOCKET);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kHttpPort);
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  assert(connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+  return sock;
+}
+
+/** Sends @p request verbatim and returns everything until the server closes */
+std::string rawExchange(const std::string &request) {
+  socket_t sock = connectHttp();
+  assert(send(sock, request.data(), request.size(), 0) ==
+         static_cast<ssize_t>(request.size()));
+  std::string reply;
+  char buffer[4096];
+  ssize_t received;
+  while ((received = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+    reply.append(buffer, static_cast<size_t>(received));
+  }
+  close(sock);
+  return reply;
+}
+
+void testScrapeAndHealth(std::shared_ptr<Logger> logger) {
+  NtpServer server(makeConfig(std::chrono::milliseconds(60000)), logger);
+  assert(server.start());
+
+  // A client that connects and never sends must not hold up the others.
+  socket_t stalled = connectHttp();
+
+  int status = 0;
+  std::string first;
+  assert(fetchMetricsHttp("127.0.0.1", kHttpPort, "/metrics", status, first));
+  assert(status == 200);
+  assert(first.find("# TYPE simple_ntpd_requests_total counter") != std::string::npos);
+  assert(first.find("simple_ntpd_uptime_seconds") != std::string::npos);
+
+  // Within the cache interval the same rendering is served again.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::string second;
+  assert(fetchMetricsHttp("127.0.0.1", kHttpPort, "/metrics?x=1", status, second));
+  assert(status == 200 && second == first);
+
+  std::string health;
+  assert(fetchMetricsHttp("127.0.0.1", kHttpPort, "/health", status, health));
+  assert(status == 200);
+  assert(health.find("overall_status: healthy") != std::string::npos);
+
+  std::string missing;
+  assert(fetchMetricsHttp("127.0.0.1", kHttpPort, "/nope", status, missing));
+  assert(status == 404);
+
+  const std::string head = rawExchange("HEAD /metrics HTTP/1.1\r\nHost: x\r\n\r\n");
+  assert(head.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+  assert(head.find("Content-Type: text/plain; version=0.0.4") != std::string::npos);
+  assert(head.size() == head.find("\r\n\r\n") + 4); // No body
+
+  const std::string post = rawExchange("POST /metrics HTTP/1.1\r\n\r\n");
+  assert(post.compare(0, 12, "HTTP/1.1 405") == 0);
+  assert(post.find("Allow: GET, HEAD") != std::string::npos);
+
+  assert(rawExchange("garbage\r\n\r\n").compare(0, 12, "HTTP/1.1 400") == 0);
+  close(stalled);
+
+  const std::string metrics = server.exportPrometheusMetrics();
+  assert(metrics.find("simple_ntpd_http_requests_total 7") != std::string::npos);
+  assert(metrics.find("simple_ntpd_http_metrics_renders_total 1") != std::string::npos);
+  // Rendering appends to the caller's buffer.
+  std::string buffer = "prefix\n";
+  server.appendPrometheusMetrics(buffer);
+  assert(buffer.compare(0, 7, "prefix\n") == 0);
+  assert(buffer.find("simple_ntpd_http_requests_total", 7) != std::string::npos);
+  server.stop();
+
+  // Nothing listens once the server has stopped.
+  assert(!fetchMetricsHttp("127.0.0.1", kHttpPort, "/metrics", status, first));
+}
+
+void testUncached(std::shared_ptr<Logger> logger) {
+  NtpServer server(makeConfig(std::chrono::milliseconds(0)), logger);
+  assert(server.start());
+  int status = 0;
+  std::string body;
+  for (int i = 0; i < 3; ++i) {
+    assert(fetchMetricsHttp("127.0.0.1", kHttpPort, "/metrics", status, body));
+    assert(status == 200);
+  }
+  assert(server.exportPrometheusMetrics().find("simple_ntpd_http_metrics_renders_total 3") !=
+         std::string::npos);
+  server.stop();
+}
+
+void testScrapeCost(std::shared_ptr<Logger> logger) {
+  // An interval far longer than the run, so the count does not depend on timing.
+  NtpServer server(makeConfig(std::chrono::milliseconds(60000)), logger);
+  assert(server.start());
+  constexpr int kScrapes = 200;
+  int status = 0;
+  std::string body;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kScrapes; ++i) {
+    assert(fetchMetricsHttp("127.0.0.1", kHttpPort, "/metrics", status, body));
+  }
+  const double us_per_scrape =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+          .count() /
+      kScrapes;
+  std::cout << "Cached /metrics scrape: " << us_per_scrape << " us" << std::endl;
+  // Every scrape inside one interval is served from a single render.
+  const std::string metrics = server.exportPrometheusMetrics();
+  assert(metrics.find("simple_ntpd_http_metrics_renders_total 1") != std::string::npos);
+  server.stop();
+}
+} // namespace
+
+int main() {
+  std::cout << "Running Metrics HTTP Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testScrapeAndHealth(shared_logger);
+  testUncached(shared_logger);
+  testScrapeCost(shared_logger);
+
+  std::cout << "Metrics HTTP tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,228 @@
+/**
+ * @file test_ntp_peers.cpp
+ * @brief Symmetric peering between simple-ntpd nodes on loopback addresses
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/server.hpp"
+#include "simple-ntpd/core/upstream_sync.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kUpstreamPortA = 9139;
+constexpr uint16_t kSiblingPort = 9140;
+constexpr uint16_t kUpstreamPortB = 9141;
+constexpr uint16_t kLoopingPeerPort = 9142;
+constexpr uint16_t kUnsyncedNodePort = 9143;
+constexpr uint16_t kDeadUpstreamPort = 9144;
+
+// Every node gets its own loopback address, as it would its own host, so
+// refids tell them apart.
+constexpr const char *kUpstreamAddress = "127.0.0.1";
+constexpr const char *kNodeAddress = "127.0.0.2";
+constexpr const char *kSiblingAddress = "127.0.0.3";
+constexpr const char *kLoopingPeerAddress = "127.0.0.4";
+
+std::string endpoint(const char *address, uint16_t port) {
+  return std::string(address) + ":" + std::to_string(port);
+}
+
+struct sockaddr_in loopback(const char *address, uint16_t port) {
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  assert(inet_pton(AF_INET, address, &addr.sin_addr) == 1);
+  return addr;
+}
+
+std::shared_ptr<NtpConfig> nodeConfig(const char *address, uint16_t port) {
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = address;
+  config->listen_port = port;
+  config->upstream_servers.clear();
+  config->timeout = std::chrono::milliseconds(300);
+  config->enable_leap_second_handling = false;
+  config->enable_drift_compensation = false;
+  config->worker_threads = 1;
+  return config;
+}
+
+// Send one request in @p mode and parse the reply.
+NtpPacket query(const char *address, uint16_t port, NtpMode mode) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {1, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in dest = loopback(address, port);
+  NtpPacket request = NtpPacket::createClientRequest();
+  request.mode = static_cast<uint8_t>(mode);
+  const auto data = request.serializeToData();
+  assert(sendto(sock, data.data(), data.size(), 0, reinterpret_cast<struct sockaddr *>(&dest),
+                sizeof(dest)) == static_cast<ssize_t>(data.size()));
+  std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
+  assert(recv(sock, buffer.data(), buffer.size(), 0) == static_cast<ssize_t>(NTP_PACKET_SIZE));
+  close(sock);
+  NtpPacket response;
+  assert(response.parseFromData(buffer));
+  return response;
+}
+
+// A sibling that claims to be synchronized to @p victim: every passive
+// reply carries the victim's address as refid.
+void runLoopingPeer(std::atomic<bool> &running, const char *victim) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct sockaddr_in addr = loopback(kLoopingPeerAddress, kLoopingPeerPort);
+  assert(bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+  struct timeval tv {0, 100000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct in_addr victim_addr {};
+  assert(inet_pton(AF_INET, victim, &victim_addr) == 1);
+
+  std::vector<uint8_t> buffer(NTP_MAX_PACKET_SIZE);
+  while (running) {
+    struct sockaddr_in from {};
+    socklen_t from_len = sizeof(from);
+    const ssize_t received = recvfrom(sock, buffer.data(), buffer.size(), 0,
+                                      reinterpret_cast<struct sockaddr *>(&from), &from_len);
+    if (received < static_cast<ssize_t>(NTP_PACKET_SIZE)) {
+      continue;
+    }
+    NtpPacket request;
+    if (!request.parseFromData(std::vector<uint8_t>(buffer.begin(), buffer.begin() + received))) {
+      continue;
+    }
+    NtpPacket reply = NtpPacket::createServerResponse(request, NtpStratum::TERTIARY_REFERENCE, "");
+    reply.mode = static_cast<uint8_t>(NtpMode::SYMMETRIC_PASSIVE);
+    reply.reference_id = ntohl(victim_addr.s_addr);
+    const auto data = reply.serializeToData();
+    sendto(sock, data.data(), data.size(), 0, reinterpret_cast<struct sockaddr *>(&from),
+           from_len);
+  }
+  close(sock);
+}
+
+const UpstreamPeerStatus &findPeer(const std::vector<UpstreamPeerStatus> &peers,
+                                   const std::string &spec) {
+  auto it = std::find_if(peers.begin(), peers.end(),
+                         [&](const UpstreamPeerStatus &p) { return p.server == spec; });
+  assert(it != peers.end());
+  return *it;
+}
+
+void testPassiveReplies(const std::shared_ptr<Logger> &logger) {
+  // Sources configured but unreachable: clients still get the configured
+  // stratum, peers are told not to follow us.
+  auto config = nodeConfig(kUpstreamAddress, kUnsyncedNodePort);
+  config->upstream_servers = {endpoint(kUpstreamAddress, kDeadUpstreamPort)};
+  NtpServer node(config, logger);
+  assert(node.start());
+
+  const NtpPacket client = query(kUpstreamAddress, kUnsyncedNodePort, NtpMode::CLIENT);
+  assert(client.mode == static_cast<uint8_t>(NtpMode::SERVER));
+  assert(client.stratum == 2 && client.leap_indicator == 0);
+
+  const NtpPacket peer = query(kUpstreamAddress, kUnsyncedNodePort, NtpMode::SYMMETRIC_ACTIVE);
+  assert(peer.mode == static_cast<uint8_t>(NtpMode::SYMMETRIC_PASSIVE));
+  // Unsynchronized rather than a kiss code (stratum 0).
+  assert(peer.leap_indicator == 3 && peer.stratum == 16);
+  node.stop();
+}
+
+void testSiblingFailover(const std::shared_ptr<Logger> &logger) {
+  // Two stratum 1 upstreams: one for our node, one for its sibling.
+  auto upstream_a_config = nodeConfig(kUpstreamAddress, kUpstreamPortA);
+  upstream_a_config->stratum = NtpStratum::PRIMARY_REFERENCE;
+  auto upstream_b_config = nodeConfig(kUpstreamAddress, kUpstreamPortB);
+  upstream_b_config->stratum = NtpStratum::PRIMARY_REFERENCE;
+  auto upstream_a = std::make_unique<NtpServer>(upstream_a_config, logger);
+  NtpServer upstream_b(upstream_b_config, logger);
+  assert(upstream_a->start() && upstream_b.start());
+
+  // The sibling is a full node that only answers us passively.
+  auto sibling_config = nodeConfig(kSiblingAddress, kSiblingPort);
+  sibling_config->upstream_servers = {endpoint(kUpstreamAddress, kUpstreamPortB)};
+  NtpServer sibling(sibling_config, logger);
+  assert(sibling.start());
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!sibling.getUpstreamSync()->isSynced() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  assert(sibling.getUpstreamSync()->isSynced());
+
+  const NtpPacket passive = query(kSiblingAddress, kSiblingPort, NtpMode::SYMMETRIC_ACTIVE);
+  assert(passive.mode == static_cast<uint8_t>(NtpMode::SYMMETRIC_PASSIVE));
+  assert(passive.stratum == 2 && passive.leap_indicator == 0);
+  assert(passive.reference_id == 0x7f000001); // Its upstream
+
+  std::atomic<bool> looping_running{true};
+  std::thread looping(runLoopingPeer, std::ref(looping_running), kNodeAddress);
+
+  const std::string sibling_spec = endpoint(kSiblingAddress, kSiblingPort);
+  const std::string looping_spec = endpoint(kLoopingPeerAddress, kLoopingPeerPort);
+  auto config = nodeConfig(kNodeAddress, 0);
+  config->upstream_servers = {endpoint(kUpstreamAddress, kUpstreamPortA)};
+  config->peers = {sibling_spec, looping_spec};
+  assert(config->hasSyncSources());
+  UpstreamSyncManager manager(config, logger);
+  for (int round = 0; round < 5; ++round) {
+    manager.syncOnce();
+  }
+  assert(manager.isSynced());
+  auto peers = manager.peerStatus();
+  assert(peers.size() == 3);
+  const UpstreamPeerStatus &sibling_status = findPeer(peers, sibling_spec);
+  assert(sibling_status.symmetric && sibling_status.reachable);
+  assert(sibling_status.tally == '+' || sibling_status.tally == '*');
+  assert(sibling_status.stratum == 2);
+  // Synchronized to us: answered, but never used.
+  const UpstreamPeerStatus &looping_status = findPeer(peers, looping_spec);
+  assert(looping_status.symmetric && !looping_status.reachable);
+  assert(looping_status.tally == ' ');
+  assert(manager.statusSummary().find(sibling_spec + " peer") != std::string::npos);
+
+  // Our only upstream goes away; the sibling carries us.
+  upstream_a->stop();
+  upstream_a.reset();
+  bool followed = false;
+  for (int round = 0; round < 20 && !followed; ++round) {
+    manager.syncOnce();
+    followed = manager.isSynced() && manager.syncedUpstream() == sibling_spec;
+  }
+  assert(followed);
+  assert(manager.effectiveStratum(10) == 3);
+  assert(manager.snapshot().reference_id == 0x7f000003);
+  peers = manager.peerStatus();
+  assert(findPeer(peers, sibling_spec).tally == '*');
+  assert(!findPeer(peers, endpoint(kUpstreamAddress, kUpstreamPortA)).reachable);
+
+  looping_running = false;
+  looping.join();
+  sibling.stop();
+  upstream_b.stop();
+}
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Symmetric Peer Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testPassiveReplies(shared_logger);
+  testSiblingFailover(shared_logger);
+
+  std::cout << "Symmetric peer tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file test_ntp_refclock.cpp
+ * @brief Shared memory reference clock tests with a stand-in gpsd writer
+ */
+
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/refclock.hpp"
+#include "simple-ntpd/core/server.hpp"
+#include "simple-ntpd/core/upstream_sync.hpp"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kRefclockServerPort = 9138;
+constexpr double kReferenceOffset = 0.25; // Reference clock ahead of us (s)
+
+// Private units (>= 2 are world-writable) so parallel runs do not collide.
+int testUnit() { return 2 + static_cast<int>(getpid() % 250); }
+
+ShmTimeSegment *attachWriter(int unit) {
+  const int id = shmget(static_cast<key_t>(kShmKeyBase + unit), sizeof(ShmTimeSegment),
+                        IPC_CREAT | 0666);
+  assert(id >= 0);
+  void *address = shmat(id, nullptr, 0);
+  assert(address != reinterpret_cast<void *>(-1));
+  return static_cast<ShmTimeSegment *>(address);
+}
+
+void removeSegment(int unit) {
+  const int id = shmget(static_cast<key_t>(kShmKeyBase + unit), sizeof(ShmTimeSegment), 0);
+  if (id >= 0) {
+    shmctl(id, IPC_RMID, nullptr);
+  }
+}
+
+// What gpsd does for every fix: mode 1, count bumped around the update.
+void writeSample(ShmTimeSegment *shm, double offset) {
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+  const int64_t receive_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+  const int64_t clock_ns = receive_ns + static_cast<int64_t>(offset * 1e9);
+  volatile ShmTimeSegment *seg = shm;
+  seg->valid = 0;
+  seg->count = seg->count + 1;
+  seg->mode = 1;
+  seg->clock_sec = static_cast<time_t>(clock_ns / 1000000000);
+  seg->clock_nsec = static_cast<unsigned>(clock_ns % 1000000000);
+  seg->clock_usec = static_cast<int>(seg->clock_nsec / 1000);
+  seg->receive_sec = static_cast<time_t>(receive_ns / 1000000000);
+  seg->receive_nsec = static_cast<unsigned>(receive_ns % 1000000000);
+  seg->receive_usec = static_cast<int>(seg->receive_nsec / 1000);
+  seg->leap = 0;
+  seg->precision = -20;
+  seg->count = seg->count + 1;
+  seg->valid = 1;
+}
+
+void testShmProtocol() {
+  const int unit = testUnit();
+  ShmRefClock clock(unit, "GPS");
+  std::string error;
+  assert(clock.open(error));
+  assert(clock.name() == "SHM(" + std::to_string(unit) + ")");
+  assert(clock.referenceId() == 0x47505300); // "GPS\0"
+
+  ShmTimeSegment *shm = attachWriter(unit);
+  RefClockSample sample;
+  shm->valid = 0;
+  assert(!clock.poll(sample));
+
+  writeSample(shm, kReferenceOffset);
+  assert(clock.poll(sample));
+  assert(std::fabs(sample.offset - kReferenceOffset) < 1e-6);
+  assert(sample.precision == -20 && sample.leap == 0);
+  assert(shm->valid == 0);      // Consumed
+  assert(!clock.poll(sample)); // No new sample since
+
+  // Mode 0 writers that only fill microseconds; nsec garbage is ignored.
+  shm->mode = 0;
+  shm->clock_sec = 1000;
+  shm->clock_usec = 500000;
+  shm->clock_nsec = 7;
+  shm->receive_sec = 1000;
+  shm->receive_usec = 250000;
+  shm->receive_nsec = 250000400;
+  shm->precision = 5;
+  shm->valid = 1;
+  assert(clock.poll(sample));
+  assert(std::fabs(sample.offset - 0.2499996) < 1e-9);
+  assert(sample.precision == 0);
+
+  shm->mode = 7; // Unknown protocol
+  shm->valid = 1;
+  assert(!clock.poll(sample));
+
+  shmdt(shm);
+  removeSegment(unit);
+}
+
+void testWriterProcess(const std::shared_ptr<Logger> &logger) {
+  const int unit = testUnit();
+  const pid_t writer = fork();
+  assert(writer >= 0);
+  if (writer == 0) {
+    // Stand-in for gpsd: a fix every 100 ms for ten seconds.
+    ShmTimeSegment *shm = attachWriter(unit);
+    for (int i = 0; i < 100; ++i) {
+      writeSample(shm, kReferenceOffset);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    _exit(0);
+  }
+
+  auto config = std::make_shared<NtpConfig>();
+  config->upstream_servers.clear();
+  config->enable_reference_clock_support = true;
+  config->reference_clock_source = "shm";
+  config->reference_clock_shm_unit = unit;
+  config->reference_clock_refid = "GPS";
+  config->enable_drift_compensation = false;
+  assert(config->hasSyncSources());
+
+  {
+    UpstreamSyncManager manager(config, logger);
+    for (int round = 0; round < 5; ++round) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(150));
+      manager.syncOnce();
+    }
+    assert(manager.isSynced());
+    assert(std::llabs(manager.clockOffsetUs() - 250000) < 5000);
+    assert(manager.effectiveStratum(10) == 1);
+    const auto peers = manager.peerStatus();
+    assert(peers.size() == 1 && peers[0].tally == '*');
+    assert(peers[0].server == "SHM(" + std::to_string(unit) + ")");
+    assert(manager.snapshot().reference_id == 0x47505300);
+  }
+
+  // The refclock alone is enough to run a stratum 1 server.
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kRefclockServerPort;
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 1;
+  NtpServer server(config, logger);
+  assert(server.start());
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!server.getUpstreamSync()->isSynced() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  assert(server.getUpstreamSync()->isSynced());
+
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {2, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in dest {};
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons(kRefclockServerPort);
+  assert(inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr) == 1);
+  const auto request = NtpPacket::createClientRequest().serializeToData();
+  assert(sendto(sock, request.data(), request.size(), 0,
+                reinterpret_cast<struct sockaddr *>(&dest), sizeof(dest)) ==
+         static_cast<ssize_t>(request.size()));
+  std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
+  assert(recv(sock, buffer.data(), buffer.size(), 0) == static_cast<ssize_t>(NTP_PACKET_SIZE));
+  close(sock);
+  NtpPacket response;
+  assert(response.parseFromData(buffer));
+  assert(response.stratum == 1);
+  assert(response.reference_id == 0x47505300);
+  const double served = std::chrono::duration<double>(
+      response.transmit_ts.toSystemTime().time_since_epoch()).count();
+  const double local = std::chrono::duration<double>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  assert(std::fabs((served - local) - kReferenceOffset) < 0.05);
+  server.stop();
+
+  kill(writer, SIGTERM);
+  waitpid(writer, nullptr, 0);
+  removeSegment(unit);
+}
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Reference Clock Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testShmProtocol();
+  testWriterProcess(shared_logger);
+
+  std::cout << "Reference clock tests passed." << std::endl;
+  return 0;
+}
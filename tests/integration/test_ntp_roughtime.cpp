@@ -0,0 +1,348 @@
+/**
+ * @file test_ntp_roughtime.cpp
+ * @brief Roughtime message format, Merkle batching and signed responses
+ */
+
+#include <arpa/inet.h>
+#include <openssl/evp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/roughtime.hpp"
+#include "simple-ntpd/core/server.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kNtpPort = 9148;
+constexpr uint16_t kRoughtimePort = 9149;
+
+const std::vector<uint8_t> kSeed(32, 0x42);
+
+uint64_t le64(const std::vector<uint8_t> &v) {
+  uint64_t out = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    out |= static_cast<uint64_t>(v[i]) << (8 * i);
+  }
+  return out;
+}
+
+uint32_t le32(const std::vector<uint8_t> &v) {
+  return static_cast<uint32_t>(v[0]) | (static_cast<uint32_t>(v[1]) << 8) |
+         (static_cast<uint32_t>(v[2]) << 16) | (static_cast<uint32_t>(v[3]) << 24);
+}
+
+uint64_t unixNow() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                                   std::chrono::system_clock::now().time_since_epoch())
+                                   .count());
+}
+
+std::vector<uint8_t> publicKeyFromSeed(const std::vector<uint8_t> &seed) {
+  EVP_PKEY *key = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, nullptr, seed.data(), seed.size());
+  assert(key != nullptr);
+  std::vector<uint8_t> out(32);
+  size_t length = out.size();
+  assert(EVP_PKEY_get_raw_public_key(key, out.data(), &length) == 1);
+  EVP_PKEY_free(key);
+  return out;
+}
+
+bool verifyEd25519(const std::vector<uint8_t> &public_key, const char *context,
+                   size_t context_length, const std::vector<uint8_t> &message,
+                   const std::vector<uint8_t> &signature) {
+  EVP_PKEY *key = EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr, public_key.data(),
+                                              public_key.size());
+  assert(key != nullptr);
+  std::vector<uint8_t> input(context, context + context_length);
+  input.insert(input.end(), message.begin(), message.end());
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  const bool ok = EVP_DigestVerifyInit(ctx, nullptr, nullptr, nullptr, key) == 1 &&
+                  EVP_DigestVerify(ctx, signature.data(), signature.size(), input.data(),
+                                   input.size()) == 1;
+  EVP_MD_CTX_free(ctx);
+  EVP_PKEY_free(key);
+  return ok;
+}
+
+struct VerifiedTime {
+  uint64_t midpoint = 0;
+  uint32_t radius = 0;
+  std::vector<uint8_t> srep;
+};
+
+// What a client does with a response: check the delegation against the
+// long-term key, the signed response against the online key, and that the
+// nonce is in the signed Merkle tree.
+VerifiedTime verifyResponse(const std::vector<uint8_t> &packet, const std::vector<uint8_t> &nonce,
+                            const std::vector<uint8_t> &long_term_key) {
+  RoughtimeMessage response;
+  assert(unwrapRoughtimePacket(packet.data(), packet.size(), response));
+  for (uint32_t tag : {kRoughtimeTagSIG, kRoughtimeTagVER, kRoughtimeTagNONC, kRoughtimeTagPATH,
+                       kRoughtimeTagSREP, kRoughtimeTagCERT, kRoughtimeTagINDX}) {
+    assert(response.find(tag) != nullptr);
+  }
+  assert(le32(*response.find(kRoughtimeTagVER)) == kRoughtimeVersion);
+  assert(*response.find(kRoughtimeTagNONC) == nonce);
+
+  RoughtimeMessage cert;
+  const auto &cert_bytes = *response.find(kRoughtimeTagCERT);
+  assert(cert.parse(cert_bytes.data(), cert_bytes.size()));
+  const auto &dele_bytes = *cert.find(kRoughtimeTagDELE);
+  assert(verifyEd25519(long_term_key, kRoughtimeDelegationContext,
+                       sizeof(kRoughtimeDelegationContext), dele_bytes,
+                       *cert.find(kRoughtimeTagSIG)));
+  RoughtimeMessage dele;
+  assert(dele.parse(dele_bytes.data(), dele_bytes.size()));
+
+  const auto &srep_bytes = *response.find(kRoughtimeTagSREP);
+  assert(verifyEd25519(*dele.find(kRoughtimeTagPUBK), kRoughtimeResponseContext,
+                       sizeof(kRoughtimeResponseContext), srep_bytes,
+                       *response.find(kRoughtimeTagSIG)));
+  // The long-term key cannot sign responses itself.
+  assert(!verifyEd25519(long_term_key, kRoughtimeResponseContext,
+                        sizeof(kRoughtimeResponseContext), srep_bytes,
+                        *response.find(kRoughtimeTagSIG)));
+  RoughtimeMessage srep;
+  assert(srep.parse(srep_bytes.data(), srep_bytes.size()));
+
+  VerifiedTime time;
+  time.midpoint = le64(*srep.find(kRoughtimeTagMIDP));
+  time.radius = le32(*srep.find(kRoughtimeTagRADI));
+  time.srep = srep_bytes;
+  assert(le64(*dele.find(kRoughtimeTagMINT)) <= time.midpoint);
+  assert(time.midpoint <= le64(*dele.find(kRoughtimeTagMAXT)));
+
+  RoughtimeHash root;
+  const auto &root_bytes = *srep.find(kRoughtimeTagROOT);
+  assert(root_bytes.size() == root.size());
+  std::memcpy(root.data(), root_bytes.data(), root.size());
+  assert(verifyRoughtimePath(roughtimeLeafHash(nonce.data(), nonce.size()),
+                             le32(*response.find(kRoughtimeTagINDX)),
+                             *response.find(kRoughtimeTagPATH), root));
+  return time;
+}
+
+std::vector<uint8_t> makeNonce(uint8_t seed) {
+  std::vector<uint8_t> nonce(kRoughtimeNonceSize);
+  for (size_t i = 0; i < nonce.size(); ++i) {
+    nonce[i] = static_cast<uint8_t>(seed * 31 + i);
+  }
+  return nonce;
+}
+
+// A client request padded to the 1 KiB minimum.
+std::vector<uint8_t> makeRequest(const std::vector<uint8_t> &nonce, size_t size) {
+  RoughtimeMessage request;
+  request.set(kRoughtimeTagNONC, nonce);
+  request.setUint32(kRoughtimeTagVER, kRoughtimeVersion);
+  request.set(kRoughtimeTagZZZZ, {});
+  const size_t base = wrapRoughtimePacket(request).size();
+  request.set(kRoughtimeTagZZZZ, std::vector<uint8_t>(size > base ? size - base : 0, 0));
+  return wrapRoughtimePacket(request);
+}
+
+void testMessageFormat() {
+  RoughtimeMessage message;
+  message.setUint32(kRoughtimeTagRADI, 7);
+  message.setUint64(kRoughtimeTagMIDP, 0x0102030405060708ULL);
+  message.set(kRoughtimeTagNONC, makeNonce(1));
+  const auto bytes = message.serialize();
+  // Header: count, two offsets, three tags; values are 4 + 8 + 32 bytes.
+  assert(bytes.size() == 4 + 8 + 12 + 44);
+  assert(le32(bytes) == 3);
+
+  RoughtimeMessage parsed;
+  assert(parsed.parse(bytes.data(), bytes.size()));
+  assert(parsed.size() == 3);
+  assert(le32(*parsed.find(kRoughtimeTagRADI)) == 7);
+  assert(le64(*parsed.find(kRoughtimeTagMIDP)) == 0x0102030405060708ULL);
+  assert(*parsed.find(kRoughtimeTagNONC) == makeNonce(1));
+  assert(parsed.find(kRoughtimeTagSIG) == nullptr);
+
+  // Tags out of order, a misaligned offset and a truncated header.
+  auto swapped = bytes;
+  std::swap_ranges(swapped.begin() + 12, swapped.begin() + 16, swapped.begin() + 16);
+  assert(!parsed.parse(swapped.data(), swapped.size()));
+  auto misaligned = bytes;
+  misaligned[4] = 3;
+  assert(!parsed.parse(misaligned.data(), misaligned.size()));
+  assert(!parsed.parse(bytes.data(), 12));
+
+  const auto packet = makeRequest(makeNonce(2), kRoughtimeMinRequestSize);
+  assert(packet.size() == kRoughtimeMinRequestSize);
+  assert(std::memcmp(packet.data(), "ROUGHTIM", 8) == 0);
+  assert(unwrapRoughtimePacket(packet.data(), packet.size(), parsed));
+  assert(*parsed.find(kRoughtimeTagNONC) == makeNonce(2));
+  auto bad_magic = packet;
+  bad_magic[0] = 'X';
+  assert(!unwrapRoughtimePacket(bad_magic.data(), bad_magic.size(), parsed));
+}
+
+void testMerkleTree() {
+  for (size_t count = 1; count <= 9; ++count) {
+    std::vector<RoughtimeHash> leaves;
+    for (size_t i = 0; i < count; ++i) {
+      const auto nonce = makeNonce(static_cast<uint8_t>(i));
+      leaves.push_back(roughtimeLeafHash(nonce.data(), nonce.size()));
+    }
+    const RoughtimeMerkleTree tree(leaves);
+    for (size_t i = 0; i < count; ++i) {
+      const auto path = tree.path(i);
+      assert(verifyRoughtimePath(leaves[i], static_cast<uint32_t>(i), path, tree.root()));
+      if ((i ^ 1) < count) {
+        assert(!verifyRoughtimePath(leaves[i], static_cast<uint32_t>(i ^ 1), path, tree.root()));
+      }
+    }
+    if (count == 1) {
+      assert(tree.path(0).empty() && tree.root() == leaves[0]);
+    }
+  }
+}
+
+void testSignerBatch() {
+  RoughtimeSigner signer;
+  std::string error;
+  std::vector<std::vector<uint8_t>> nonces{makeNonce(1)};
+  assert(signer.respond(nonces, unixNow(), 1).empty()); // No keys yet
+  assert(signer.setLongTermSeed(kSeed, error));
+  assert(signer.longTermPublicKey() == publicKeyFromSeed(kSeed));
+  assert(signer.needsRotation(0));
+  const int64_t now = static_cast<int64_t>(unixNow());
+  assert(signer.rotate(now, 3600, error));
+  assert(!signer.needsRotation(now) && signer.needsRotation(now + 1800));
+  assert(!signer.expired(now + 3600) && signer.expired(now + 3601));
+  // Past MAXT (e.g. rotation kept failing) nothing is signed.
+  assert(signer.respond(nonces, static_cast<uint64_t>(now + 3601), 3).empty());
+
+  for (uint8_t i = 2; i <= 5; ++i) {
+    nonces.push_back(makeNonce(i));
+  }
+  const auto responses = signer.respond(nonces, static_cast<uint64_t>(now), 3);
+  assert(responses.size() == nonces.size());
+  std::vector<uint8_t> srep;
+  for (size_t i = 0; i < responses.size(); ++i) {
+    const VerifiedTime time = verifyResponse(responses[i], nonces[i], publicKeyFromSeed(kSeed));
+    assert(time.midpoint == static_cast<uint64_t>(now) && time.radius == 3);
+    // One signed response for the whole batch.
+    assert(srep.empty() || srep == time.srep);
+    srep = time.srep;
+  }
+
+  // Another server's delegation does not verify under our identity.
+  RoughtimeSigner other;
+  assert(other.generateLongTermKey(error) && other.rotate(now, 3600, error));
+  const auto foreign = other.respond(nonces, static_cast<uint64_t>(now), 3);
+  RoughtimeMessage response;
+  assert(unwrapRoughtimePacket(foreign[0].data(), foreign[0].size(), response));
+  RoughtimeMessage cert;
+  const auto &cert_bytes = *response.find(kRoughtimeTagCERT);
+  assert(cert.parse(cert_bytes.data(), cert_bytes.size()));
+  assert(!verifyEd25519(publicKeyFromSeed(kSeed), kRoughtimeDelegationContext,
+                        sizeof(kRoughtimeDelegationContext), *cert.find(kRoughtimeTagDELE),
+                        *cert.find(kRoughtimeTagSIG)));
+}
+
+socket_t clientSocket(int timeout_ms) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  return sock;
+}
+
+void sendRequest(socket_t sock, const std::vector<uint8_t> &request) {
+  struct sockaddr_in dest {};
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons(kRoughtimePort);
+  assert(inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr) == 1);
+  assert(sendto(sock, request.data(), request.size(), 0,
+                reinterpret_cast<struct sockaddr *>(&dest), sizeof(dest)) ==
+         static_cast<ssize_t>(request.size()));
+}
+
+void testResponder(const std::shared_ptr<Logger> &logger) {
+  char key_path[] = "/tmp/simple-ntpd-roughtime-XXXXXX";
+  const int fd = mkstemp(key_path);
+  assert(fd >= 0);
+  std::string hex;
+  for (size_t i = 0; i < kSeed.size(); ++i) {
+    hex += "42";
+  }
+  hex += "\n";
+  assert(write(fd, hex.data(), hex.size()) == static_cast<ssize_t>(hex.size()));
+  close(fd);
+
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kNtpPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 1;
+  config->enable_roughtime = true;
+  config->roughtime_port = kRoughtimePort;
+  config->roughtime_key_file = key_path;
+  config->roughtime_batch_size = 8;
+  config->roughtime_batch_window = std::chrono::milliseconds(200);
+  std::vector<std::string> errors;
+  assert(config->validateDetailed(errors));
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  // Three clients inside one window share a batch and a signature.
+  std::vector<socket_t> clients;
+  for (uint8_t i = 0; i < 3; ++i) {
+    clients.push_back(clientSocket(2000));
+    sendRequest(clients.back(), makeRequest(makeNonce(10 + i), kRoughtimeMinRequestSize));
+  }
+  std::vector<uint8_t> srep;
+  std::vector<uint8_t> buffer(4096);
+  for (uint8_t i = 0; i < 3; ++i) {
+    const ssize_t received = recv(clients[i], buffer.data(), buffer.size(), 0);
+    assert(received > 0 && static_cast<size_t>(received) < kRoughtimeMinRequestSize);
+    const VerifiedTime time =
+        verifyResponse(std::vector<uint8_t>(buffer.begin(), buffer.begin() + received),
+                       makeNonce(10 + i), publicKeyFromSeed(kSeed));
+    assert(time.midpoint + 2 >= unixNow() && time.midpoint <= unixNow() + 1);
+    assert(time.radius >= 1 && time.radius <= 2);
+    assert(srep.empty() || srep == time.srep);
+    srep = time.srep;
+    close(clients[i]);
+  }
+
+  // Short requests could amplify and get no answer.
+  socket_t small = clientSocket(500);
+  sendRequest(small, makeRequest(makeNonce(20), 512));
+  assert(recv(small, buffer.data(), buffer.size(), 0) < 0);
+  close(small);
+
+  const std::string metrics = server.exportPrometheusMetrics();
+  assert(metrics.find("simple_ntpd_roughtime_responses_total 3") != std::string::npos);
+  assert(metrics.find("simple_ntpd_roughtime_batches_total 1") != std::string::npos);
+  assert(metrics.find("simple_ntpd_roughtime_requests_total 4") != std::string::npos);
+  server.stop();
+  std::remove(key_path);
+}
+} // namespace
+
+int main() {
+  std::cout << "Running Roughtime Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testMessageFormat();
+  testMerkleTree();
+  testSignerBatch();
+  testResponder(shared_logger);
+
+  std::cout << "Roughtime tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file test_ntp_stats_segment.cpp
+ * @brief Memory-mapped statistics segment: format, torn-read safety and a
+ *        live server publishing into it
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simple-ntpd/core/packet.hpp"
+#include "simple-ntpd/core/server.hpp"
+#include "simple-ntpd/core/stats_segment.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace simple_ntpd;
+
+namespace {
+constexpr uint16_t kNtpPort = 9154;
+
+std::string segmentPath(const char *name) {
+  return std::string("/tmp/simple_ntpd_test_") + name + "_" + std::to_string(getpid());
+}
+
+void query() {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {2, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in dest {};
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons(kNtpPort);
+  inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr);
+  const auto request = NtpPacket::createClientRequest().serializeToData();
+  assert(sendto(sock, request.data(), request.size(), 0,
+                reinterpret_cast<struct sockaddr *>(&dest), sizeof(dest)) ==
+         static_cast<ssize_t>(request.size()));
+  std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
+  assert(recv(sock, buffer.data(), buffer.size(), 0) == static_cast<ssize_t>(NTP_PACKET_SIZE));
+  close(sock);
+}
+
+// A reader mapping the file sees whole updates only, while another mapping
+// of the same file is being written.
+void testFormatAndTornReads() {
+  const std::string path = segmentPath("segment");
+  StatsSegmentPayload payload;
+  std::string error;
+  assert(!readStatsSegment(path, payload, error)); // Not there yet
+
+  StatsSegment segment;
+  assert(segment.open(path, error));
+  std::atomic<bool> done{false};
+  std::atomic<uint64_t> reads{0};
+  std::thread reader([&] {
+    uint64_t last = 0;
+    while (!done.load(std::memory_order_relaxed)) {
+      StatsSegmentPayload seen;
+      std::string read_error;
+      assert(readStatsSegment(path, seen, read_error));
+      assert(seen.total_responses == seen.total_requests * 2);
+      assert(seen.processing.count == seen.total_requests);
+      assert(seen.total_requests >= last);
+      last = seen.total_requests;
+      reads.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  for (uint64_t i = 1; i <= 20000; ++i) {
+    StatsSegmentPayload update;
+    update.total_requests = i;
+    update.total_responses = i * 2;
+    update.processing.counts[3] = i;
+    update.processing.count = i;
+    segment.publish(update);
+  }
+  done = true;
+  reader.join();
+  assert(reads.load() > 0);
+
+  // Unmapping keeps the last copy in the file.
+  segment.close();
+  assert(readStatsSegment(path, payload, error));
+  assert(payload.total_requests == 20000);
+
+  // A writer that died mid-update leaves an odd sequence behind; readers
+  // give up instead of spinning.
+  {
+    const int fd = ::open(path.c_str(), O_RDWR);
+    uint64_t sequence = 0;
+    assert(pread(fd, &sequence, sizeof(sequence), sizeof(StatsSegmentHeader)) == 8);
+    ++sequence;
+    assert(pwrite(fd, &sequence, sizeof(sequence), sizeof(StatsSegmentHeader)) == 8);
+    ::close(fd);
+  }
+  assert(!readStatsSegment(path, payload, error));
+  assert(error.find("mid-update") != std::string::npos);
+
+  // A layout from another version is refused.
+  {
+    const int fd = ::open(path.c_str(), O_RDWR);
+    const uint32_t version = kStatsSegmentVersion + 1;
+    assert(pwrite(fd, &version, sizeof(version), offsetof(StatsSegmentHeader, version)) == 4);
+    ::close(fd);
+  }
+  assert(!readStatsSegment(path, payload, error));
+  assert(error.find("version") != std::string::npos);
+  std::remove(path.c_str());
+}
+
+void testServerPublishes(const std::shared_ptr<Logger> &logger) {
+  const std::string path = segmentPath("server_stats");
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kNtpPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 2;
+  config->enable_stats_segment = true;
+  config->stats_segment_path = path;
+  config->stats_segment_interval = std::chrono::milliseconds(20);
+  std::vector<std::string> errors;
+  assert(config->validateDetailed(errors));
+
+  StatsSegmentPayload payload;
+  std::string error;
+  {
+    NtpServer server(config, logger);
+    assert(server.start());
+    assert(readStatsSegment(path, payload, error));
+    assert(payload.running == 1 && payload.pid == getpid());
+    assert(payload.worker_threads == 2);
+    assert(payload.stratum == static_cast<uint8_t>(config->stratum));
+
+    constexpr uint64_t kQueries = 50;
+    for (uint64_t i = 0; i < kQueries; ++i) {
+      query();
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    do {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      assert(readStatsSegment(path, payload, error));
+    } while (payload.total_requests < kQueries && std::chrono::steady_clock::now() < deadline);
+    assert(payload.total_requests == kQueries && payload.total_responses == kQueries);
+    assert(payload.processing.count == kQueries && payload.residence.count == kQueries);
+    assert(payload.started_unix_ns <= payload.published_unix_ns);
+    server.stop();
+
+    // The final copy is written on stop.
+    assert(readStatsSegment(path, payload, error));
+    assert(payload.running == 0 && payload.total_requests == kQueries);
+  }
+
+  // And outlives the server, as it would a crash.
+  assert(readStatsSegment(path, payload, error));
+  assert(payload.total_requests == 50);
+  std::remove(path.c_str());
+}
+} // namespace
+
+int main() {
+  std::cout << "Running Statistics Segment Tests..." << std::endl;
+
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testFormatAndTornReads();
+  testServerPublishes(shared_logger);
+
+  std::cout << "Statistics segment tests passed." << std::endl;
+  return 0;
+}
@@ -10,7 +10,10 @@
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <sys/socket.h>
 #include <thread>
@@ -20,7 +23,198 @@ using namespace simple_ntpd;
 
 namespace {
 constexpr uint16_t kTestPort = 9123;
+constexpr uint16_t kLeapPort = 9136;
+constexpr uint16_t kSmearPort = 9137;
+constexpr uint16_t kWorkersPort = 9150;
+constexpr uint16_t kStagesPort = 9155;
+
+NtpPacket query(uint16_t port) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {2, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in dest {};
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons(port);
+  assert(inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr) == 1);
+  const auto request_data = NtpPacket::createClientRequest().serializeToData();
+  assert(sendto(sock, request_data.data(), request_data.size(), 0,
+                reinterpret_cast<struct sockaddr *>(&dest), sizeof(dest)) ==
+         static_cast<ssize_t>(request_data.size()));
+  std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
+  const ssize_t received = recv(sock, buffer.data(), buffer.size(), 0);
+  close(sock);
+  assert(received == static_cast<ssize_t>(NTP_PACKET_SIZE));
+  NtpPacket response;
+  assert(response.parseFromData(buffer));
+  return response;
+}
+
+// A leap one hour away is announced; with a day-long smear it is not, and
+// responses lag by the smear instead.
+void testLeapSecondResponses(const std::shared_ptr<Logger> &logger) {
+  const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  const int64_t leap = now + 3600;
+  const std::string leap_file =
+      "/tmp/simple_ntpd_test_leap_" + std::to_string(getpid()) + ".list";
+  {
+    std::ofstream out(leap_file);
+    out << "#@ " << (leap + 2208988800LL + 86400 * 180) << "\n";
+    out << (now + 2208988800LL - 86400 * 365) << " 37\n";
+    out << (leap + 2208988800LL) << " 38\n";
+  }
+
+  auto make_config = [&](uint16_t port, int smear) {
+    auto config = std::make_shared<NtpConfig>();
+    config->listen_address = "127.0.0.1";
+    config->listen_port = port;
+    config->upstream_servers.clear();
+    config->enable_leap_second_handling = true;
+    config->leap_second_file = leap_file;
+    config->leap_smear_interval = smear;
+    config->worker_threads = 1;
+    return config;
+  };
+  NtpServer announcing(make_config(kLeapPort, 0), logger);
+  NtpServer smearing(make_config(kSmearPort, 86400), logger);
+  assert(announcing.start());
+  assert(smearing.start());
+
+  assert(query(kLeapPort).leap_indicator == 1);
+  assert(announcing.exportPrometheusMetrics().find("simple_ntpd_leap_indicator 1") !=
+         std::string::npos);
+  assert(announcing.runHealthChecks().find("leap_second_entries: 2") != std::string::npos);
+
+  // Noon-to-noon smear, one hour before the leap: 0.5 s * 39600 / 43200
+  const NtpPacket smeared = query(kSmearPort);
+  const double served = std::chrono::duration<double>(
+      smeared.transmit_ts.toSystemTime().time_since_epoch()).count();
+  const double local = std::chrono::duration<double>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  assert(smeared.leap_indicator == 0);
+  assert(std::fabs((served - local) - (-0.5 * 39600.0 / 43200.0)) < 0.05);
+
+  smearing.stop();
+  announcing.stop();
+  std::remove(leap_file.c_str());
+}
+
+// Every worker counts into its own block; totals are exact sums of them.
+void testWorkerCounters(const std::shared_ptr<Logger> &logger) {
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kWorkersPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 4;
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  constexpr uint64_t kQueries = 200;
+  for (uint64_t i = 0; i < kQueries; ++i) {
+    query(kWorkersPort);
+  }
+  // A worker publishes right after sending, so the last reply may beat it.
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (server.getStats().total_requests < kQueries &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  const NtpServerStats stats = server.getStats();
+  assert(stats.total_requests == kQueries && stats.total_responses == kQueries);
+  assert(stats.total_bytes_transferred == kQueries * NTP_PACKET_SIZE);
+  assert(stats.processed_request_count == kQueries && stats.total_errors == 0);
+  assert(stats.min_request_processing_time_us <= stats.max_request_processing_time_us);
+  const auto workers = server.getWorkerStats();
+  assert(workers.size() == 4);
+  uint64_t requests = 0;
+  for (const WorkerStats &worker : workers) {
+    requests += worker.requests;
+  }
+  assert(requests == kQueries);
+
+  // Every answered request lands in each latency histogram once.
+  const LatencySnapshot latency = server.getLatencySnapshot();
+  assert(latency.processing.count == kQueries && latency.residence.count == kQueries);
+#ifdef SO_TIMESTAMPNS
+  assert(latency.kernel_to_user.count == kQueries);
+#endif
+  assert(latency.processing.valueAtQuantile(0.5) <= latency.processing.valueAtQuantile(0.999));
+  assert(server.getStatus().find("Processing p50/p99/p999 (us): ") != std::string::npos);
+
+  const std::string metrics = server.exportPrometheusMetrics();
+  assert(metrics.find("simple_ntpd_requests_total " + std::to_string(kQueries)) !=
+         std::string::npos);
+  assert(metrics.find("# TYPE simple_ntpd_request_processing_seconds histogram") !=
+         std::string::npos);
+  assert(metrics.find("simple_ntpd_residence_seconds_count " + std::to_string(kQueries)) !=
+         std::string::npos);
+  assert(metrics.find("simple_ntpd_request_processing_seconds_bucket{le=\"+Inf\"} " +
+                      std::to_string(kQueries)) != std::string::npos);
+  assert(metrics.find("_bucket{le=\"1.073741824\"}") != std::string::npos);
+  assert(metrics.find("simple_ntpd_request_proc_time_us_avg") == std::string::npos);
+  assert(metrics.find("simple_ntpd_worker_requests_total{worker=\"3\"} " +
+                      std::to_string(workers[3].requests)) != std::string::npos);
+  // Stage accounting is off by default and costs nothing.
+  assert(metrics.find("simple_ntpd_stage_cycles_total") == std::string::npos);
+  for (const StageSnapshot &stages : server.getStageSnapshots()) {
+    assert(stages.calls[static_cast<size_t>(PipelineStage::RECEIVE)] == 0);
+  }
+  server.stop();
+  assert(server.getStats().total_requests == kQueries);
+}
+
+// Each answered request passes every stage once, on the worker that read it.
+void testStageAccounting(const std::shared_ptr<Logger> &logger) {
+  auto config = std::make_shared<NtpConfig>();
+  config->listen_address = "127.0.0.1";
+  config->listen_port = kStagesPort;
+  config->upstream_servers.clear();
+  config->enable_leap_second_handling = false;
+  config->worker_threads = 2;
+  config->enable_stage_accounting = true;
+  NtpServer server(config, logger);
+  assert(server.start());
+
+  constexpr uint64_t kQueries = 100;
+  for (uint64_t i = 0; i < kQueries; ++i) {
+    query(kStagesPort);
+  }
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (server.getStats().total_requests < kQueries &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  const auto workers = server.getWorkerStats();
+  const auto stages = server.getStageSnapshots();
+  assert(stages.size() == 2);
+  StageSnapshot merged;
+  for (size_t i = 0; i < stages.size(); ++i) {
+    for (size_t s = 0; s < kPipelineStageCount; ++s) {
+      assert(stages[i].calls[s] == workers[i].requests);
+    }
+    merged.merge(stages[i]);
+  }
+  const size_t send = static_cast<size_t>(PipelineStage::SEND);
+  assert(merged.calls[send] == kQueries && merged.cycles[send] > 0);
+  assert(cycleCounterHz() > 0.0);
+
+  const std::string status = server.getStatus();
+  assert(status.find("Stage Costs (all workers):") != std::string::npos);
+  assert(status.find("    rate_limit: ") != std::string::npos);
+  assert(status.find("(" + std::to_string(kQueries) + " calls)") != std::string::npos);
+
+  const std::string metrics = server.exportPrometheusMetrics();
+  assert(metrics.find("# TYPE simple_ntpd_stage_cycles_total counter") != std::string::npos);
+  assert(metrics.find("simple_ntpd_stage_calls_total{worker=\"1\",stage=\"lookup\"} " +
+                      std::to_string(workers[1].requests)) != std::string::npos);
+  assert(metrics.find("simple_ntpd_cycle_counter_hz ") != std::string::npos);
+  server.stop();
 }
+} // namespace
 
 int main() {
   std::cout << "Running NTP UDP Integration Tests..." << std::endl;
@@ -92,6 +286,10 @@ int main() {
   server->stop();
   server_thread.join();
 
+  testLeapSecondResponses(std::shared_ptr<Logger>(&logger, [](Logger *) {}));
+  testWorkerCounters(std::shared_ptr<Logger>(&logger, [](Logger *) {}));
+  testStageAccounting(std::shared_ptr<Logger>(&logger, [](Logger *) {}));
+
   std::cout << "UDP integration tests passed." << std::endl;
   return 0;
 }
@@ -3,24 +3,573 @@
  * @brief Upstream NTP synchronization tests
  */
 
+#include "simple-ntpd/core/server.hpp"
 #include "simple-ntpd/core/upstream_sync.hpp"
+#include <arpa/inet.h>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <algorithm>
 #include <iostream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 using namespace simple_ntpd;
 
+namespace {
+constexpr uint16_t kLocalServerPort = 9124;
+constexpr uint16_t kBlackholePortA = 9125;
+constexpr uint16_t kBlackholePortB = 9126;
+constexpr uint16_t kDisciplineServerPort = 9127;
+constexpr uint16_t kPoolServerPort = 9128;
+constexpr uint16_t kWarmUpstreamPort = 9129;
+constexpr uint16_t kWarmNodePort = 9130;
+constexpr uint16_t kAdaptiveServerPort = 9131;
+constexpr uint16_t kAdaptiveBlackholePort = 9132;
+constexpr uint16_t kHealthServerPort = 9133;
+constexpr uint16_t kHealthBlackholePort = 9134;
+constexpr uint16_t kHealthNodePort = 9135;
+constexpr uint16_t kStablePortA = 9158;
+constexpr uint16_t kStablePortB = 9159;
+
+// Kernel backend stand-in that always fails, as without CAP_SYS_TIME.
+class FailingClockAdjuster : public ClockAdjuster {
+public:
+  std::string name() const override { return "failing"; }
+  bool steersSystemClock() const override { return true; }
+  bool slew(double, double, double, int) override { return false; }
+  bool step(double) override { return false; }
+  bool setFrequency(double) override { return false; }
+  bool readFrequency(double &) override { return false; }
+  std::string lastError() const override { return "Operation not permitted"; }
+};
+
+// Bound UDP socket that swallows requests without answering.
+socket_t openBlackhole(uint16_t port) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  assert(inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr) == 1);
+  assert(bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+  return sock;
+}
+
+// Send one client request to a local server and parse its reply.
+NtpPacket queryServer(uint16_t port) {
+  socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  assert(sock != INVALID_SOCKET);
+  struct timeval tv {1, 0};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  assert(inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr) == 1);
+  const auto request = NtpPacket::createClientRequest().serializeToData();
+  assert(sendto(sock, request.data(), request.size(), 0,
+                reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) ==
+         static_cast<ssize_t>(request.size()));
+  std::vector<uint8_t> buffer(NTP_PACKET_SIZE);
+  const ssize_t received = recv(sock, buffer.data(), buffer.size(), 0);
+  close(sock);
+  assert(received == static_cast<ssize_t>(NTP_PACKET_SIZE));
+  NtpPacket response;
+  assert(response.parseFromData(buffer));
+  return response;
+}
+
+void testHostPortParsing() {
+  std::string host;
+  std::string service;
+  splitUpstreamHostPort("pool.ntp.org", host, service);
+  assert(host == "pool.ntp.org" && service == "123");
+  splitUpstreamHostPort("127.0.0.1:9123", host, service);
+  assert(host == "127.0.0.1" && service == "9123");
+  splitUpstreamHostPort("[::1]:4123", host, service);
+  assert(host == "::1" && service == "4123");
+  splitUpstreamHostPort("fe80::1", host, service);
+  assert(host == "fe80::1" && service == "123");
+}
+
+// One live loopback server plus two silent ones: a round must finish in
+// roughly one timeout, not one timeout per dead server.
+void testConcurrentPolling(const std::shared_ptr<Logger> &logger) {
+  auto server_config = std::make_shared<NtpConfig>();
+  server_config->listen_address = "127.0.0.1";
+  server_config->listen_port = kLocalServerPort;
+  server_config->upstream_servers.clear();
+  server_config->enable_leap_second_handling = false;
+  server_config->worker_threads = 1;
+  NtpServer server(server_config, logger);
+  assert(server.start());
+
+  socket_t hole_a = openBlackhole(kBlackholePortA);
+  socket_t hole_b = openBlackhole(kBlackholePortB);
+
+  auto config = std::make_shared<NtpConfig>();
+  config->upstream_servers = {"127.0.0.1:" + std::to_string(kBlackholePortA),
+                              "127.0.0.1:" + std::to_string(kLocalServerPort),
+                              "127.0.0.1:" + std::to_string(kBlackholePortB)};
+  config->timeout = std::chrono::milliseconds(400);
+  UpstreamSyncManager manager(config, logger);
+
+  // A fresh association needs a few filter stages before its root distance
+  // drops under the RFC 5905 threshold.
+  UpstreamSyncResult result;
+  for (int round = 0; round < 5; ++round) {
+    const auto start = std::chrono::steady_clock::now();
+    result = manager.syncOnce();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    assert(elapsed < std::chrono::milliseconds(700));
+  }
+  assert(result.success);
+  assert(result.server == config->upstream_servers[1]);
+  assert(result.stratum >= 1);
+  assert(manager.isSynced());
+
+  const auto peers = manager.peerStatus();
+  assert(peers.size() == 3);
+  assert(peers[1].tally == '*' && peers[1].reachable);
+  assert(!peers[0].reachable && !peers[2].reachable);
+  assert(!manager.inHoldover());
+
+  // Every poll lands in its association's history, answered or not.
+  const auto histories = manager.upstreamHistory();
+  assert(histories.size() == 3);
+  for (const auto &history : histories) {
+    assert(history.samples.size() == 5);
+    const HistorySummary summary = summarizeHistory(history.samples);
+    const bool local = history.server == config->upstream_servers[1];
+    assert(summary.good == (local ? 5u : 0u));
+    assert(!local || history.samples.back().tally == '*');
+  }
+  auto clock = manager.clockHistory();
+  assert(!clock.empty() && clock.back().synced && !clock.back().holdover);
+  assert(clock.back().survivors == 1);
+
+  // Losing every upstream keeps serving the disciplined clock in holdover.
+  // Stale filter samples stay selectable until they age out of all stages.
+  server.stop();
+  config->timeout = std::chrono::milliseconds(100);
+  int rounds = 0;
+  while (manager.syncOnce().success) {
+    assert(++rounds <= static_cast<int>(ClockFilter::kStages));
+  }
+  assert(manager.isSynced());
+  assert(manager.inHoldover());
+  assert(manager.effectiveStratum(2) == result.stratum + 1);
+  clock = manager.clockHistory();
+  assert(clock.back().synced && clock.back().holdover && clock.back().offset_us == 0);
+
+  close(hole_a);
+  close(hole_b);
+}
+// With a steering backend the kernel absorbs the offset: the manager hands
+// it every combined offset and responses stamp the raw clock.
+void testSystemClockDiscipline(const std::shared_ptr<Logger> &logger) {
+  auto server_config = std::make_shared<NtpConfig>();
+  server_config->listen_address = "127.0.0.1";
+  server_config->listen_port = kDisciplineServerPort;
+  server_config->upstream_servers.clear();
+  server_config->enable_leap_second_handling = false;
+  server_config->worker_threads = 1;
+  NtpServer server(server_config, logger);
+  assert(server.start());
+
+  auto config = std::make_shared<NtpConfig>();
+  config->upstream_servers = {"127.0.0.1:" + std::to_string(kDisciplineServerPort)};
+  config->timeout = std::chrono::milliseconds(400);
+  config->enable_drift_compensation = false;
+
+  UpstreamSyncManager manager(config, logger);
+  assert(!manager.steersSystemClock());
+  auto mock = std::make_shared<MockClockAdjuster>(true);
+  manager.setClockAdjuster(mock);
+  assert(manager.steersSystemClock());
+  for (int round = 0; round < 5; ++round) {
+    manager.syncOnce();
+  }
+  assert(manager.isSynced());
+  assert(manager.clockOffsetUs() == 0);
+  const auto calls = mock->calls();
+  assert(!calls.empty());
+  for (const auto &call : calls) {
+    assert(call.action == MockClockAdjuster::Action::SLEW);
+  }
+
+  // A backend that cannot adjust the clock falls back to response offsets.
+  UpstreamSyncManager fallback(config, logger);
+  fallback.setClockAdjuster(std::make_shared<FailingClockAdjuster>());
+  assert(fallback.steersSystemClock());
+  UpstreamSyncResult result;
+  for (int round = 0; round < 5 && !result.success; ++round) {
+    result = fallback.syncOnce();
+  }
+  assert(result.success);
+  assert(!fallback.steersSystemClock());
+  assert(fallback.isSynced());
+
+  server.stop();
+}
+// A pool name expands to one association per resolved address, and an
+// address already used by a configured server is not polled twice.
+void testPoolExpansion(const std::shared_ptr<Logger> &logger) {
+  auto server_config = std::make_shared<NtpConfig>();
+  server_config->listen_address = "127.0.0.1";
+  server_config->listen_port = kPoolServerPort;
+  server_config->upstream_servers.clear();
+  server_config->enable_leap_second_handling = false;
+  server_config->worker_threads = 1;
+  NtpServer server(server_config, logger);
+  assert(server.start());
+
+  const std::string port = std::to_string(kPoolServerPort);
+  std::vector<ResolvedAddress> expected;
+  assert(resolveAddresses("localhost", port, expected));
+
+  auto config = std::make_shared<NtpConfig>();
+  config->upstream_servers.clear();
+  config->upstream_pools = {"localhost:" + port};
+  config->max_pool_associations = 4;
+  config->timeout = std::chrono::milliseconds(400);
+  config->enable_drift_compensation = false;
+  UpstreamSyncManager pool_only(config, logger);
+  pool_only.syncOnce();
+  auto peers = pool_only.peerStatus();
+  assert(peers.size() == std::min<size_t>(expected.size(), 4));
+  for (const auto &peer : peers) {
+    assert(peer.server == config->upstream_pools.front());
+    assert(!peer.address.empty());
+  }
+
+  config->upstream_servers = {"127.0.0.1:" + port};
+  UpstreamSyncManager mixed(config, logger);
+  mixed.syncOnce();
+  peers = mixed.peerStatus();
+  size_t loopback_v4 = 0;
+  for (const auto &peer : peers) {
+    loopback_v4 += peer.address == "127.0.0.1:" + port ? 1 : 0;
+  }
+  assert(loopback_v4 == 1);
+  assert(peers.front().server == config->upstream_servers.front());
+
+  server.stop();
+}
+// A stable upstream earns a longer poll interval, and the background loop
+// only queries an association once its own interval has elapsed.
+void testAdaptivePolling(const std::shared_ptr<Logger> &logger) {
+  auto server_config = std::make_shared<NtpConfig>();
+  server_config->listen_address = "127.0.0.1";
+  server_config->listen_port = kAdaptiveServerPort;
+  server_config->upstream_servers.clear();
+  server_config->enable_leap_second_handling = false;
+  server_config->worker_threads = 1;
+  NtpServer server(server_config, logger);
+  assert(server.start());
+
+  auto config = std::make_shared<NtpConfig>();
+  config->upstream_servers = {"127.0.0.1:" + std::to_string(kAdaptiveServerPort)};
+  config->sync_interval = std::chrono::seconds(2);
+  config->min_poll = 1;
+  config->max_poll = 3;
+  config->timeout = std::chrono::milliseconds(400);
+  config->enable_drift_compensation = false;
+  UpstreamSyncManager manager(config, logger);
+  manager.syncOnce();
+  assert(manager.peerStatus().front().poll == 1);
+  for (int i = 0; i < 80 && manager.peerStatus().front().poll < 3; ++i) {
+    manager.syncOnce();
+  }
+  assert(manager.peerStatus().front().poll == 3);
+  assert(manager.statusSummary().find("poll=8s") != std::string::npos);
+  server.stop();
+
+  // Silent upstream polled every 2 s: within 1.5 s only the startup query
+  // may arrive, even though the loop wakes for nothing else.
+  socket_t hole = openBlackhole(kAdaptiveBlackholePort);
+  auto quiet_config = std::make_shared<NtpConfig>();
+  quiet_config->upstream_servers = {"127.0.0.1:" + std::to_string(kAdaptiveBlackholePort)};
+  quiet_config->sync_interval = std::chrono::seconds(2);
+  quiet_config->min_poll = 1;
+  quiet_config->max_poll = 1;
+  quiet_config->timeout = std::chrono::milliseconds(100);
+  quiet_config->enable_iburst = false;
+  quiet_config->enable_drift_compensation = false;
+  UpstreamSyncManager quiet(quiet_config, logger);
+  quiet.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  quiet.stop();
+  int requests = 0;
+  uint8_t buffer[NTP_MAX_PACKET_SIZE];
+  while (recv(hole, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    ++requests;
+  }
+  assert(requests == 1);
+  CLOSE_SOCKET(hole);
+}
+
+// Reach registers, error counts and the system peer policies; the health
+// of every upstream shows up in the node's metrics.
+void testUpstreamHealth(const std::shared_ptr<Logger> &logger) {
+  UpstreamHealth steady;
+  UpstreamHealth flaky;
+  for (int i = 0; i < 8; ++i) {
+    steady.recordPoll(true);
+    steady.recordSample(0.002, 0.0001);
+    flaky.recordPoll(i % 2 == 0);
+  }
+  assert(steady.reach == 0xff && steady.recentMisses() == 0);
+  assert(flaky.reach == 0xaa && flaky.recentMisses() == 4 && flaky.errors == 4);
+  assert(healthierThan(steady, flaky) && !healthierThan(flaky, steady));
+
+  using Policy = NtpConfig::UpstreamSelectionAlgorithm;
+  const std::vector<const UpstreamHealth *> survivors{&flaky, &steady};
+  assert(selectSystemPeer(Policy::LEAST_ERRORS, survivors, 2, false, 0, 0) == 1);
+  assert(selectSystemPeer(Policy::ROUND_ROBIN, survivors, 2, false, 0, 0) == 0);
+  assert(selectSystemPeer(Policy::ROUND_ROBIN, survivors, 2, false, 1, 0) == 1);
+  assert(selectSystemPeer(Policy::RANDOM, survivors, 2, false, 0, 5) == 1);
+  // A surviving system peer is kept whatever the policy would pick.
+  assert(selectSystemPeer(Policy::LEAST_ERRORS, survivors, 0, false, 0, 0) == 0);
+  assert(selectSystemPeer(Policy::ROUND_ROBIN, survivors, 1, false, 0, 0) == 1);
+  // Failover passes over the flaky survivor whatever the policy.
+  assert(selectSystemPeer(Policy::ROUND_ROBIN, survivors, 2, true, 0, 0) == 1);
+  assert(selectSystemPeer(Policy::LEAST_ERRORS, survivors, 0, true, 0, 0) == 1);
+  assert(selectSystemPeer(Policy::RANDOM, {&flaky}, 0, true, 0, 0) == 0);
+
+  auto upstream_config = std::make_shared<NtpConfig>();
+  upstream_config->listen_address = "127.0.0.1";
+  upstream_config->listen_port = kHealthServerPort;
+  upstream_config->upstream_servers.clear();
+  upstream_config->enable_leap_second_handling = false;
+  upstream_config->worker_threads = 1;
+  NtpServer upstream(upstream_config, logger);
+  assert(upstream.start());
+  socket_t hole = openBlackhole(kHealthBlackholePort);
+
+  const std::string live = "127.0.0.1:" + std::to_string(kHealthServerPort);
+  const std::string dead = "127.0.0.1:" + std::to_string(kHealthBlackholePort);
+  auto node_config = std::make_shared<NtpConfig>();
+  node_config->listen_address = "127.0.0.1";
+  node_config->listen_port = kHealthNodePort;
+  // A name that never resolves, with characters label values must escape.
+  const std::string odd = "127.0.0.1:\"odd\\port\"";
+  node_config->upstream_servers = {live, dead, odd};
+  node_config->upstream_selection_algorithm = Policy::LEAST_ERRORS;
+  node_config->timeout = std::chrono::milliseconds(200);
+  node_config->enable_leap_second_handling = false;
+  node_config->enable_drift_compensation = false;
+  node_config->worker_threads = 1;
+  NtpServer node(node_config, logger);
+  assert(node.start());
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!node.getUpstreamSync()->isSynced() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  assert(node.getUpstreamSync()->isSynced());
+
+  for (const auto &peer : node.getUpstreamSync()->peerStatus()) {
+    if (peer.server == live) {
+      assert(peer.tally == '*' && peer.health.errors == 0 && peer.health.reach != 0);
+    } else {
+      assert(peer.health.reach == 0 && peer.health.errors == peer.health.polls);
+    }
+  }
+  const std::string metrics = node.exportPrometheusMetrics();
+  const std::string live_labels = "{server=\"" + live + "\",address=\"" + live + "\"}";
+  const std::string dead_labels = "{server=\"" + dead + "\",address=\"" + dead + "\"}";
+  assert(metrics.find("simple_ntpd_upstream_selection_policy{policy=\"least_errors\"} 1") !=
+         std::string::npos);
+  assert(metrics.find("simple_ntpd_upstream_system_peer" + live_labels + " 1") !=
+         std::string::npos);
+  assert(metrics.find("simple_ntpd_upstream_reach" + dead_labels + " 0") != std::string::npos);
+  assert(metrics.find("simple_ntpd_upstream_errors_total" + live_labels + " 0") !=
+         std::string::npos);
+  assert(metrics.find("simple_ntpd_upstream_reach{server=\"127.0.0.1:\\\"odd\\\\port\\\"\","
+                      "address=\"\"} 0") != std::string::npos);
+
+  // The unsynchronized upstream is its own root; the node adds its path to it.
+  const NtpPacket from_upstream = queryServer(kHealthServerPort);
+  const NtpPacket from_node = queryServer(kHealthNodePort);
+  assert(from_upstream.precision == systemClockPrecision());
+  assert(from_upstream.root_delay == 0 && from_upstream.root_dispersion > 0);
+  assert(from_node.precision == systemClockPrecision());
+  assert(node.getUpstreamSync()->snapshot().root_delay_us > 0);
+  assert(from_node.root_dispersion > from_upstream.root_dispersion);
+
+  node.stop();
+  upstream.stop();
+  CLOSE_SOCKET(hole);
+}
+
+// Two equally good survivors under ROUND_ROBIN: the system peer must stay
+// put from round to round instead of hopping between them.
+void testSystemPeerStability(const std::shared_ptr<Logger> &logger) {
+  std::vector<std::unique_ptr<NtpServer>> upstreams;
+  std::vector<std::string> specs;
+  for (uint16_t port : {kStablePortA, kStablePortB}) {
+    auto config = std::make_shared<NtpConfig>();
+    config->listen_address = "127.0.0.1";
+    config->listen_port = port;
+    config->upstream_servers.clear();
+    config->enable_leap_second_handling = false;
+    config->enable_rate_limiting = false;
+    config->worker_threads = 1;
+    upstreams.push_back(std::make_unique<NtpServer>(config, logger));
+    assert(upstreams.back()->start());
+    specs.push_back("127.0.0.1:" + std::to_string(port));
+  }
+
+  auto config = std::make_shared<NtpConfig>();
+  config->upstream_servers = specs;
+  config->upstream_selection_algorithm = NtpConfig::UpstreamSelectionAlgorithm::ROUND_ROBIN;
+  config->timeout = std::chrono::milliseconds(400);
+  config->enable_drift_compensation = false;
+  UpstreamSyncManager manager(config, logger);
+  // Let both filters fill before their root distance qualifies them.
+  for (int round = 0; round < 5; ++round) {
+    manager.syncOnce();
+  }
+  assert(manager.isSynced());
+  const std::string system_peer = manager.syncedUpstream();
+  assert(!system_peer.empty());
+  for (int round = 0; round < 6; ++round) {
+    assert(manager.syncOnce().success);
+    size_t survivors = 0;
+    for (const auto &peer : manager.peerStatus()) {
+      survivors += peer.tally == '*' || peer.tally == '+';
+    }
+    assert(survivors == 2);
+    assert(manager.syncedUpstream() == system_peer);
+  }
+
+  for (auto &upstream : upstreams) {
+    upstream->stop();
+  }
+}
+
+// iburst synchronizes a fresh node within a couple of seconds; after a
+// restart the state file brings it back synchronized before any poll.
+void testIburstAndWarmStart(const std::shared_ptr<Logger> &logger) {
+  auto upstream_config = std::make_shared<NtpConfig>();
+  upstream_config->listen_address = "127.0.0.1";
+  upstream_config->listen_port = kWarmUpstreamPort;
+  upstream_config->upstream_servers.clear();
+  upstream_config->enable_leap_second_handling = false;
+  upstream_config->worker_threads = 1;
+  NtpServer upstream(upstream_config, logger);
+  assert(upstream.start());
+
+  const std::string state_file =
+      "/tmp/simple_ntpd_test_state_" + std::to_string(getpid()) + ".json";
+  auto node_config = std::make_shared<NtpConfig>();
+  node_config->listen_address = "127.0.0.1";
+  node_config->listen_port = kWarmNodePort;
+  node_config->upstream_servers = {"127.0.0.1:" + std::to_string(kWarmUpstreamPort)};
+  node_config->sync_interval = std::chrono::seconds(3600);
+  node_config->timeout = std::chrono::milliseconds(400);
+  node_config->enable_leap_second_handling = false;
+  node_config->enable_drift_compensation = false;
+  node_config->enable_state_persistence = true;
+  node_config->state_file = state_file;
+  node_config->worker_threads = 1;
+  std::remove(state_file.c_str());
+
+  {
+    NtpServer node(node_config, logger);
+    const auto start = std::chrono::steady_clock::now();
+    assert(node.start());
+    auto sync = node.getUpstreamSync();
+    assert(sync);
+    while (!sync->isSynced() &&
+           std::chrono::steady_clock::now() - start < std::chrono::seconds(4)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    assert(sync->isSynced());
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(3));
+    node.stop();
+  }
+
+  std::string saved;
+  {
+    std::ifstream in(state_file);
+    saved.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  UpstreamSyncState state;
+  assert(parseUpstreamSyncState(saved, state));
+  assert(state.synced);
+  assert(state.associations.size() == 1);
+  assert(state.associations.front().address == node_config->upstream_servers.front());
+
+  // Restarted node: synchronized straight from the state file.
+  {
+    node_config->enable_iburst = false;
+    NtpServer node(node_config, logger);
+    assert(node.start());
+    auto sync = node.getUpstreamSync();
+    assert(sync->isSynced());
+    assert(sync->effectiveStratum(2) == state.stratum + 1);
+    node.stop();
+  }
+
+  // Names that look like keys or need escaping survive the round trip.
+  UpstreamSyncState odd;
+  odd.saved_at = 1700000000.5;
+  odd.upstream = "a\"b\\c\nd";
+  UpstreamAssociationState entry;
+  entry.spec = "\"poll\": 9, \"polls\": 7";
+  entry.address = "127.0.0.1:123";
+  entry.poll = 6;
+  entry.polls = 12;
+  odd.associations.push_back(entry);
+  UpstreamSyncState parsed;
+  assert(parseUpstreamSyncState("{\"upstream_sync\": " + formatUpstreamSyncState(odd) + "}",
+                                parsed));
+  assert(parsed.saved_at == odd.saved_at && parsed.upstream == odd.upstream);
+  assert(parsed.associations.size() == 1 && parsed.associations[0].spec == entry.spec);
+  assert(parsed.associations[0].poll == 6 && parsed.associations[0].polls == 12);
+  assert(!parseUpstreamSyncState("{\"upstream_sync\": {\"saved_at\": ", parsed));
+
+  // A state file that cannot be replaced is reported and the temp file removed.
+  std::remove(state_file.c_str());
+  {
+    NtpServer node(node_config, logger);
+    assert(node.start());
+    assert(mkdir(state_file.c_str(), 0700) == 0);
+    node.stop();
+  }
+  assert(access((state_file + ".tmp").c_str(), F_OK) != 0);
+  rmdir(state_file.c_str());
+  upstream.stop();
+}
+} // namespace
+
 int main() {
   std::cout << "Running NTP Upstream Sync Tests..." << std::endl;
 
+  auto &logger = Logger::getInstance();
+  logger.setLevel(LogLevel::ERROR);
+  auto shared_logger = std::shared_ptr<Logger>(&logger, [](Logger *) {});
+
+  testHostPortParsing();
+  testConcurrentPolling(shared_logger);
+  testSystemClockDiscipline(shared_logger);
+  testPoolExpansion(shared_logger);
+  testIburstAndWarmStart(shared_logger);
+  testAdaptivePolling(shared_logger);
+  testUpstreamHealth(shared_logger);
+  testSystemPeerStability(shared_logger);
+
   if (std::getenv("SIMPLE_NTPD_NETWORK_TESTS") == nullptr) {
     std::cout << "Skipping live upstream tests (set SIMPLE_NTPD_NETWORK_TESTS=1 to enable)."
               << std::endl;
 
     auto config = std::make_shared<NtpConfig>();
-    UpstreamSyncManager manager(config,
-                                std::shared_ptr<Logger>(&Logger::getInstance(),
-                                                        [](Logger *) {}));
+    UpstreamSyncManager manager(config, shared_logger);
     assert(!manager.isSynced());
     assert(manager.effectiveStratum(2) == 2);
     return 0;
@@ -37,11 +586,11 @@ int main() {
   config->sync_interval = std::chrono::seconds(3600);
   config->timeout = std::chrono::milliseconds(2000);
 
-  auto &logger = Logger::getInstance();
-  logger.setLevel(LogLevel::ERROR);
-  UpstreamSyncManager manager(config,
-                              std::shared_ptr<Logger>(&logger, [](Logger *) {}));
-  const UpstreamSyncResult once = manager.syncOnce();
+  UpstreamSyncManager manager(config, shared_logger);
+  UpstreamSyncResult once;
+  for (int round = 0; round < 5; ++round) {
+    once = manager.syncOnce();
+  }
   assert(once.success);
   assert(manager.isSynced());
 
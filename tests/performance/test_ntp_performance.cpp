@@ -1,12 +1,15 @@
 /**
  * @file test_ntp_performance.cpp
- * @brief Basic performance smoke tests for packet processing
+ * @brief Basic performance smoke tests for packet processing and Roughtime
+ *        batch signing
  */
 
 #include "simple-ntpd/core/packet.hpp"
+#include "simple-ntpd/core/roughtime.hpp"
 #include <cassert>
 #include <chrono>
 #include <iostream>
+#include <map>
 
 using namespace simple_ntpd;
 
@@ -37,6 +40,43 @@ int main() {
   assert(elapsed_us > 0);
   assert(elapsed_us < 5'000'000);
 
+  // Roughtime: one Ed25519 signature per batch, so throughput should grow
+  // with the batch size until hashing and encoding dominate.
+  RoughtimeSigner signer;
+  std::string error;
+  assert(signer.generateLongTermKey(error));
+  const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+  assert(signer.rotate(now, 3600, error));
+  constexpr size_t kRoughtimeRequests = 2048;
+  std::vector<std::vector<uint8_t>> all_nonces(kRoughtimeRequests,
+                                               std::vector<uint8_t>(kRoughtimeNonceSize));
+  for (size_t i = 0; i < all_nonces.size(); ++i) {
+    for (size_t j = 0; j < kRoughtimeNonceSize; ++j) {
+      all_nonces[i][j] = static_cast<uint8_t>(i * 7 + j);
+    }
+  }
+  std::map<size_t, double> responses_per_second;
+  for (size_t batch_size : {1, 8, 64, 256}) {
+    const auto batch_start = std::chrono::steady_clock::now();
+    size_t answered = 0;
+    for (size_t first = 0; first < all_nonces.size(); first += batch_size) {
+      const std::vector<std::vector<uint8_t>> batch(all_nonces.begin() + first,
+                                                    all_nonces.begin() + first + batch_size);
+      answered += signer.respond(batch, static_cast<uint64_t>(now), 1).size();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                         batch_start).count();
+    assert(answered == kRoughtimeRequests);
+    responses_per_second[batch_size] = static_cast<double>(answered) / seconds;
+    std::cout << "Roughtime batch " << batch_size << ": "
+              << static_cast<uint64_t>(responses_per_second[batch_size]) << " responses/s, "
+              << static_cast<uint64_t>(static_cast<double>(answered / batch_size) / seconds)
+              << " signatures/s" << std::endl;
+  }
+  assert(responses_per_second[64] > 2.0 * responses_per_second[1]);
+
   std::cout << "Performance tests passed." << std::endl;
   return 0;
 }
@@ -0,0 +1,209 @@
+/**
+ * @file test_ntp_capture.cpp
+ * @brief Packet capture ring: filtering, concurrent writers and pcap output
+ */
+
+#include <arpa/inet.h>
+
+#include "simple-ntpd/core/capture.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace simple_ntpd;
+
+namespace {
+uint32_t address(const char *text) {
+  struct in_addr addr {};
+  assert(inet_pton(AF_INET, text, &addr) == 1);
+  return addr.s_addr;
+}
+
+// Every byte of the exchange derives from one value, so a torn copy shows.
+CapturedExchange patterned(uint8_t value) {
+  CapturedExchange exchange;
+  exchange.client_port = value;
+  exchange.request_length = value;
+  exchange.response_length = value;
+  std::memset(exchange.request, value, sizeof(exchange.request));
+  std::memset(exchange.response, value, sizeof(exchange.response));
+  return exchange;
+}
+
+void testFilter() {
+  CaptureFilter filter;
+  filter.network = 0xC0000200u; // 192.0.2.0/24
+  filter.mask = 0xFFFFFF00u;
+  PacketCapture prefix(16, filter, 0, 123);
+  assert(prefix.matches(address("192.0.2.7"), false));
+  assert(!prefix.matches(address("192.0.3.7"), false));
+
+  filter = CaptureFilter{};
+  filter.drops_only = true;
+  PacketCapture drops(16, filter, 0, 123);
+  assert(drops.matches(address("10.0.0.1"), true));
+  assert(!drops.matches(address("10.0.0.1"), false));
+
+  filter = CaptureFilter{};
+  filter.sample_every = 5;
+  PacketCapture sampled(16, filter, 0, 123);
+  int kept = 0;
+  for (int i = 0; i < 100; ++i) {
+    kept += sampled.matches(address("10.0.0.1"), false) ? 1 : 0;
+  }
+  assert(kept == 20);
+
+  // Each worker counts on its own, and a new capture starts afresh.
+  PacketCapture workers(16, filter, 0, 123, 2);
+  for (int i = 0; i < 4; ++i) {
+    assert(!workers.matches(address("10.0.0.1"), false, 0));
+  }
+  assert(!workers.matches(address("10.0.0.1"), false, 1));
+  assert(workers.matches(address("10.0.0.1"), false, 0));
+  filter.sample_every = 2;
+  PacketCapture restarted(16, filter, 0, 123, 2);
+  assert(!restarted.matches(address("10.0.0.1"), false, 0));
+  assert(restarted.matches(address("10.0.0.1"), false, 0));
+}
+
+void testConcurrentWriters() {
+  constexpr size_t kSlots = 256;
+  constexpr int kWriters = 4;
+  constexpr int kPerWriter = 20000;
+  PacketCapture ring(kSlots, CaptureFilter{}, 0, 123);
+  assert(ring.snapshot().empty());
+
+  std::atomic<bool> done{false};
+  std::thread reader([&] {
+    while (!done.load(std::memory_order_relaxed)) {
+      for (const CapturedExchange &seen : ring.snapshot()) {
+        const uint8_t value = seen.request[0];
+        assert(seen.client_port == value && seen.response_length == value);
+        for (size_t i = 0; i < CapturedExchange::kMaxBytes; ++i) {
+          assert(seen.request[i] == value && seen.response[i] == value);
+        }
+      }
+    }
+  });
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kWriters; ++w) {
+    writers.emplace_back([&ring, w] {
+      for (int i = 0; i < kPerWriter; ++i) {
+        ring.record(patterned(static_cast<uint8_t>(w * 50 + i % 50)));
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  done = true;
+  reader.join();
+
+  const uint64_t taken = ring.captured() + ring.skipped();
+  assert(taken == static_cast<uint64_t>(kWriters) * kPerWriter);
+  const auto kept = ring.snapshot();
+  assert(!kept.empty() && kept.size() <= kSlots);
+  std::set<uint64_t> tickets;
+  for (size_t i = 0; i < kept.size(); ++i) {
+    assert(tickets.insert(kept[i].ticket).second);
+    assert(i == 0 || kept[i - 1].ticket < kept[i].ticket);
+    assert(kept[i].ticket < taken);
+  }
+}
+
+uint32_t read32(const std::string &data, size_t offset) {
+  uint32_t value = 0;
+  std::memcpy(&value, data.data() + offset, sizeof(value));
+  return value;
+}
+
+void testPcap() {
+  const uint32_t server = address("192.0.2.1");
+  PacketCapture ring(16, CaptureFilter{}, server, 123);
+
+  CapturedExchange answered;
+  answered.received_unix_ns = 1700000000123456789;
+  answered.sent_unix_ns = 1700000000123499999;
+  answered.client_addr = address("198.51.100.9");
+  answered.client_port = 40000;
+  answered.request_length = 48;
+  answered.response_length = 48;
+  answered.request[0] = 0x23; // LI 0, VN 4, client
+  answered.response[0] = 0x24;
+  ring.record(answered);
+
+  CapturedExchange dropped;
+  dropped.received_unix_ns = 1700000001000000000;
+  dropped.client_addr = address("203.0.113.5");
+  dropped.client_port = 40001;
+  dropped.request_length = 200; // Longer than the ring keeps
+  dropped.drop = DropReason::ACL;
+  ring.record(dropped);
+
+  std::ostringstream out;
+  ring.writePcap(out);
+  const std::string pcap = out.str();
+  assert(read32(pcap, 0) == 0xa1b23c4d);
+  assert(read32(pcap, 20) == 101);
+
+  // Request, its response, then the dropped request alone.
+  size_t offset = 24;
+  struct Record {
+    uint32_t seconds, nanoseconds, kept, original;
+    std::string packet;
+  };
+  std::vector<Record> records;
+  while (offset < pcap.size()) {
+    Record r{read32(pcap, offset), read32(pcap, offset + 4), read32(pcap, offset + 8),
+             read32(pcap, offset + 12), ""};
+    r.packet = pcap.substr(offset + 16, r.kept);
+    offset += 16 + r.kept;
+    records.push_back(r);
+  }
+  assert(offset == pcap.size() && records.size() == 3);
+
+  const Record &request = records[0];
+  assert(request.seconds == 1700000000 && request.nanoseconds == 123456789);
+  assert(request.kept == 28 + 48 && request.original == 28 + 48);
+  const auto *ip = reinterpret_cast<const uint8_t *>(request.packet.data());
+  uint32_t sum = 0;
+  for (size_t i = 0; i < 20; i += 2) {
+    sum += static_cast<uint32_t>(ip[i] << 8 | ip[i + 1]);
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  assert(sum == 0xffff); // Header checksum verifies
+  assert(ip[9] == IPPROTO_UDP);
+  assert(std::memcmp(ip + 12, &answered.client_addr, 4) == 0);
+  assert(std::memcmp(ip + 16, &server, 4) == 0);
+  assert((ip[20] << 8 | ip[21]) == 40000 && (ip[22] << 8 | ip[23]) == 123);
+  assert(ip[28] == 0x23);
+
+  const auto *reply = reinterpret_cast<const uint8_t *>(records[1].packet.data());
+  assert(records[1].nanoseconds == 123499999);
+  assert(std::memcmp(reply + 12, &server, 4) == 0);
+  assert((reply[22] << 8 | reply[23]) == 40000 && reply[28] == 0x24);
+
+  assert(records[2].kept == 28 + CapturedExchange::kMaxBytes);
+  assert(records[2].original == 28 + 200);
+
+  assert(std::string(dropReasonName(DropReason::RATE_LIMIT)) == "rate_limit");
+}
+} // namespace
+
+int main() {
+  std::cout << "Running Packet Capture Tests..." << std::endl;
+
+  testFilter();
+  testConcurrentWriters();
+  testPcap();
+
+  std::cout << "Packet capture tests passed." << std::endl;
+  return 0;
+}
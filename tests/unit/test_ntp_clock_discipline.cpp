@@ -0,0 +1,122 @@
+/**
+ * @file test_ntp_clock_discipline.cpp
+ * @brief Unit tests for the PLL/FLL clock discipline, drift file and holdover
+ */
+
+#include "simple-ntpd/core/clock_discipline.hpp"
+#include "simple-ntpd/core/clock_filter.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace simple_ntpd;
+
+namespace {
+
+// Local clock running 20 PPM slow: true - local grows by 20 us per second.
+constexpr double kSkew = 20e-6;
+constexpr double kInitialOffset = 0.003;
+constexpr double kPoll = 64.0;
+
+double trueOffset(double t) { return kInitialOffset + kSkew * t; }
+
+void testFirstUpdateSteps() {
+  ClockDiscipline discipline;
+  assert(!discipline.hasEstimate());
+  assert(discipline.offsetAt(5.0) == 0.0);
+  assert(discipline.update(0.010, 0.0001, 5.0, kPoll));
+  assert(discipline.state() == ClockDiscipline::State::FREQ);
+  assert(std::fabs(discipline.offsetAt(5.0) - 0.010) < 1e-12);
+}
+
+void testConvergesToFrequencyAndInterpolates() {
+  ClockDiscipline discipline;
+  double t = 0.0;
+  for (int i = 0; i < 400; ++i, t += kPoll) {
+    discipline.update(trueOffset(t), 0.00001, t, kPoll);
+  }
+  assert(discipline.state() == ClockDiscipline::State::SYNC);
+  assert(std::fabs(discipline.frequency() - kSkew) < 0.5e-6);
+
+  // Between polls the model tracks the drifting clock, not the last sample.
+  const double mid = t - kPoll / 2.0;
+  const double stale_error = std::fabs(trueOffset(mid) - trueOffset(t - kPoll));
+  const double model_error = std::fabs(trueOffset(mid) - discipline.offsetAt(mid));
+  assert(model_error < 50e-6);
+  assert(model_error < stale_error / 4.0);
+}
+
+void testLargeErrorSteps() {
+  ClockDiscipline discipline;
+  discipline.setFrequency(0.0);
+  discipline.update(0.0, 0.0001, 0.0, kPoll);
+  assert(discipline.state() == ClockDiscipline::State::SYNC);
+  assert(!discipline.update(0.001, 0.0001, kPoll, kPoll));
+  assert(discipline.update(0.5, 0.0001, 2 * kPoll, kPoll));
+  assert(std::fabs(discipline.offsetAt(2 * kPoll) - 0.5) < 1e-12);
+}
+
+void testHoldoverDispersionGrows() {
+  ClockDiscipline discipline;
+  discipline.setFrequency(kSkew);
+  discipline.update(trueOffset(0.0), 0.0001, 0.0, kPoll);
+  const double d0 = discipline.dispersionAt(0.0);
+  const double day = 86400.0;
+  assert(std::fabs(discipline.dispersionAt(day) - (d0 + NTP_PHI * day)) < 1e-9);
+  // A day without updates still predicts the drifting clock closely.
+  assert(std::fabs(discipline.offsetAt(day) - trueOffset(day)) < 1e-6);
+  // Eventually the error bound exceeds the distance threshold.
+  assert(discipline.dispersionAt(2 * day) > NTP_MAXDIST);
+}
+
+void testPhaseOnlyWithoutDriftCompensation() {
+  ClockDiscipline discipline;
+  discipline.setFrequencyTracking(false);
+  for (int i = 0; i < 50; ++i) {
+    discipline.update(trueOffset(i * kPoll), 0.00001, i * kPoll, kPoll);
+  }
+  assert(discipline.frequency() == 0.0);
+}
+
+void testDriftFileRoundTrip() {
+  const std::string path = "/tmp/simple_ntpd_test_drift_" + std::to_string(getpid());
+  ClockDiscipline writer;
+  writer.setFrequency(-12.345e-6);
+  writer.update(0.0, 0.0, 0.0, kPoll);
+  assert(writer.saveDriftFile(path));
+
+  ClockDiscipline reader;
+  assert(reader.loadDriftFile(path));
+  assert(std::fabs(reader.frequency() + 12.345e-6) < 1e-9);
+  // A seeded frequency skips the FREQ measurement state.
+  reader.update(0.0, 0.0, 0.0, kPoll);
+  assert(reader.state() == ClockDiscipline::State::SYNC);
+
+  {
+    std::ofstream bad(path, std::ios::trunc);
+    bad << "garbage\n";
+  }
+  ClockDiscipline rejected;
+  assert(!rejected.loadDriftFile(path));
+  assert(!rejected.loadDriftFile(path + ".missing"));
+  std::remove(path.c_str());
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Clock Discipline Tests..." << std::endl;
+
+  testFirstUpdateSteps();
+  testConvergesToFrequencyAndInterpolates();
+  testLargeErrorSteps();
+  testHoldoverDispersionGrows();
+  testPhaseOnlyWithoutDriftCompensation();
+  testDriftFileRoundTrip();
+
+  std::cout << "Clock discipline tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file test_ntp_clock_filter.cpp
+ * @brief Unit tests for the RFC 5905 clock filter and selection algorithms
+ */
+
+#include "simple-ntpd/core/clock_filter.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+using namespace simple_ntpd;
+
+namespace {
+
+ClockCandidate makeCandidate(const std::string &name, double offset,
+                             double distance, double jitter = 0.0005) {
+  ClockCandidate c;
+  c.name = name;
+  c.stratum = 2;
+  c.offset = offset;
+  c.delay = 0.01;
+  c.dispersion = 0.001;
+  c.jitter = jitter;
+  c.root_distance = distance;
+  return c;
+}
+
+bool contains(const std::vector<size_t> &v, size_t x) {
+  return std::find(v.begin(), v.end(), x) != v.end();
+}
+
+void testFilterPicksMinimumDelay() {
+  ClockFilter filter;
+  assert(!filter.hasSample());
+  filter.addSample(0.100, 0.050, 0.001, 1.0);
+  filter.addSample(0.200, 0.010, 0.001, 2.0);
+  filter.addSample(0.300, 0.030, 0.001, 3.0);
+  assert(filter.hasSample());
+  assert(std::fabs(filter.offset() - 0.200) < 1e-9);
+  assert(std::fabs(filter.delay() - 0.010) < 1e-9);
+  assert(filter.jitter() > 0.05);
+}
+
+void testMissedSamplesGrowDispersion() {
+  ClockFilter filter;
+  filter.addSample(0.001, 0.010, 0.001, 1.0);
+  const double before = filter.dispersion();
+  const double distance_before = filter.rootDistance(1.0, 0.0, 0.0);
+  for (int i = 0; i < 4; ++i) {
+    filter.addMissedSample(2.0 + i);
+  }
+  assert(filter.dispersion() > before);
+  assert(filter.rootDistance(6.0, 0.0, 0.0) > distance_before);
+  // The last good sample is still the estimate.
+  assert(std::fabs(filter.offset() - 0.001) < 1e-9);
+}
+
+void testFalsetickerRejected() {
+  std::vector<ClockCandidate> candidates = {
+      makeCandidate("a", 0.0010, 0.010), makeCandidate("b", 0.0012, 0.010),
+      makeCandidate("c", 0.0009, 0.010), makeCandidate("bad", 0.5000, 0.010)};
+  const ClockSelection selection = selectClockSources(candidates);
+  assert(selection.synchronized);
+  assert(contains(selection.falsetickers, 3));
+  assert(!contains(selection.survivors, 3));
+  assert(selection.survivors.size() == 3);
+  assert(std::fabs(selection.offset - 0.00103) < 0.0002);
+  assert(selection.jitter > 0.0);
+}
+
+void testNoMajority() {
+  std::vector<ClockCandidate> candidates = {makeCandidate("a", 0.0, 0.010),
+                                            makeCandidate("b", 1.0, 0.010)};
+  const ClockSelection selection = selectClockSources(candidates);
+  assert(!selection.synchronized);
+}
+
+void testCombineWeightsByDistance() {
+  // The closer source dominates the weighted offset.
+  std::vector<ClockCandidate> candidates = {makeCandidate("near", 0.000, 0.010),
+                                            makeCandidate("far", 0.009, 0.100)};
+  const ClockSelection selection = selectClockSources(candidates);
+  assert(selection.synchronized);
+  assert(selection.system_peer == 0);
+  assert(selection.offset > 0.0 && selection.offset < 0.0045);
+}
+
+void testClusterPrunesOutliers() {
+  std::vector<ClockCandidate> candidates = {
+      makeCandidate("a", 0.0000, 0.050, 0.0001),
+      makeCandidate("b", 0.0001, 0.050, 0.0001),
+      makeCandidate("c", -0.0001, 0.050, 0.0001),
+      makeCandidate("d", 0.0002, 0.050, 0.0001),
+      makeCandidate("outlier", 0.0300, 0.050, 0.0001)};
+  const ClockSelection selection = selectClockSources(candidates);
+  assert(selection.synchronized);
+  assert(contains(selection.truechimers, 4));
+  assert(!contains(selection.survivors, 4));
+}
+
+void testPollAdaptsToStability() {
+  PollController poll(6, 6, 10);
+  // Stable samples: the counter passes LIMIT after six at poll 6.
+  int samples = 0;
+  while (poll.poll() == 6 && samples < 20) {
+    poll.update(0.0001, 0.0002);
+    ++samples;
+  }
+  assert(poll.poll() == 7);
+  assert(samples == 6);
+
+  // Offset changes well beyond PGATE * jitter pull the exponent back down.
+  samples = 0;
+  while (poll.poll() == 7 && samples < 20) {
+    poll.update(0.050, 0.0002);
+    ++samples;
+  }
+  assert(poll.poll() == 6);
+  assert(samples == 3);
+
+  // Never below min_poll, never above max_poll.
+  for (int i = 0; i < 50; ++i) {
+    poll.update(0.050, 0.0002);
+  }
+  assert(poll.poll() == 6);
+  for (int i = 0; i < 200; ++i) {
+    poll.update(0.0, 0.0002);
+  }
+  assert(poll.poll() == 10);
+  assert(!poll.backoff());
+
+  poll.setBounds(4, 8);
+  assert(poll.poll() == 8);
+  poll.setPoll(2);
+  assert(poll.poll() == 4);
+  assert(poll.interval() == 16.0);
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Clock Filter Tests..." << std::endl;
+
+  testFilterPicksMinimumDelay();
+  testMissedSamplesGrowDispersion();
+  testFalsetickerRejected();
+  testNoMajority();
+  testCombineWeightsByDistance();
+  testClusterPrunesOutliers();
+  testPollAdaptsToStability();
+
+  std::cout << "Clock filter tests passed." << std::endl;
+  return 0;
+}
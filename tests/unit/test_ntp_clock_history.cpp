@@ -0,0 +1,135 @@
+/**
+ * @file test_ntp_clock_history.cpp
+ * @brief Sample ring, clock history windowing, summaries and listings
+ */
+
+#include "simple-ntpd/core/clock_history.hpp"
+#include "simple-ntpd/utils/sample_ring.hpp"
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace simple_ntpd;
+
+namespace {
+void testSampleRing() {
+  SampleRing<int> ring(3);
+  assert(ring.empty() && ring.capacity() == 3);
+  ring.push(1);
+  ring.push(2);
+  assert(ring.size() == 2 && ring.newest() == 2);
+  assert((ring.values() == std::vector<int>{1, 2}));
+  for (int i = 3; i <= 7; ++i) {
+    ring.push(i);
+  }
+  assert(ring.size() == 3 && ring.newest() == 7);
+  assert((ring.values() == std::vector<int>{5, 6, 7}));
+}
+
+PeerHistorySample poll(int64_t time, int64_t offset_us, bool reachable = true, char tally = '+') {
+  PeerHistorySample sample;
+  sample.unix_time = time;
+  sample.reachable = reachable;
+  sample.tally = tally;
+  sample.stratum = 2;
+  sample.offset_us = offset_us;
+  sample.delay_us = 1000 + offset_us;
+  sample.jitter_us = 10;
+  return sample;
+}
+
+void testWindowAndRetention() {
+  assert(ClockHistory::capacityFor(24 * 3600, 6) == 24 * 3600 / 64 + 17);
+  assert(ClockHistory::capacityFor(168 * 3600, 0) == ClockHistory::kMaxSamples);
+
+  ClockHistory history;
+  assert(!history.enabled());
+  history.recordPeer("a", "192.0.2.1", poll(0, 0));
+  assert(history.peers(0).empty());
+
+  history.configure(100, 4);
+  assert(history.enabled() && history.capacity() == 4);
+  for (int64_t t = 0; t < 6; ++t) {
+    history.recordPeer("a", "192.0.2.1", poll(t * 30, t));
+  }
+  history.recordPeer("b", "192.0.2.2", poll(150, 0));
+
+  // The ring keeps the last four polls; at t=170 the window drops t=60.
+  auto peers = history.peers(170);
+  assert(peers.size() == 2 && peers[0].server == "a");
+  assert(peers[0].samples.size() == 3 && peers[0].samples.front().unix_time == 90);
+
+  history.retainPeers({{"b", "192.0.2.2"}});
+  peers = history.peers(150);
+  assert(peers.size() == 1 && peers[0].server == "b");
+
+  ClockHistorySample latest;
+  assert(!history.latestClock(latest));
+  ClockHistorySample state;
+  state.unix_time = 140;
+  state.synced = true;
+  history.recordClock(state);
+  assert(history.latestClock(latest) && latest.unix_time == 140);
+  assert(history.clock(150).size() == 1 && history.clock(500).empty());
+}
+
+void testSummaries() {
+  const std::vector<PeerHistorySample> polls = {poll(0, -40), poll(1, 30, true, '*'),
+                                                poll(2, 0, false, 'x'), poll(3, 30, true, '-')};
+  const HistorySummary peer = summarizeHistory(polls);
+  assert(peer.samples == 4 && peer.good == 3 && peer.selected == 2);
+  assert(peer.min_offset_us == -40 && peer.max_offset_us == 30);
+  assert(peer.rms_offset_us == 33); // sqrt((1600 + 900 + 900) / 3)
+  assert(peer.min_delay_us == 960 && peer.max_delay_us == 1030);
+
+  ClockHistorySample synced;
+  synced.synced = true;
+  synced.offset_us = 12;
+  synced.jitter_us = 7;
+  ClockHistorySample holdover = synced;
+  holdover.holdover = true;
+  holdover.jitter_us = 500;
+  const HistorySummary clock = summarizeHistory(std::vector<ClockHistorySample>{
+      synced, holdover, ClockHistorySample{}});
+  assert(clock.samples == 3 && clock.good == 1);
+  assert(clock.min_offset_us == 12 && clock.rms_offset_us == 12 && clock.max_jitter_us == 7);
+  assert(summarizeHistory(std::vector<ClockHistorySample>{}).rms_offset_us == 0);
+}
+
+void testListings() {
+  ClockHistorySample state;
+  state.unix_time = 1700000000;
+  state.synced = true;
+  state.holdover = true;
+  state.stratum = 3;
+  state.frequency_ppm = -12.5;
+  std::istringstream clock(formatClockHistory({state}));
+  std::string header, row;
+  std::getline(clock, header);
+  std::getline(clock, row);
+  assert(header.compare(0, 11, "time state ") == 0);
+  assert(row == "1700000000 holdover 3 0 0 0 -12.500 0 0 0");
+
+  PeerHistory peer{"pool.example", "192.0.2.7", {poll(1700000000, 5, false, ' ')}};
+  std::istringstream listing(formatPeerHistory(peer));
+  std::getline(listing, header);
+  assert(header == "# pool.example (192.0.2.7)");
+  std::getline(listing, header);
+  std::getline(listing, row);
+  assert(row == "1700000000 . 0 2 5 1005 10");
+}
+} // namespace
+
+int main() {
+  std::cout << "Running Clock History Tests..." << std::endl;
+
+  testSampleRing();
+  testWindowAndRetention();
+  testSummaries();
+  testListings();
+
+  std::cout << "Clock history tests passed." << std::endl;
+  return 0;
+}
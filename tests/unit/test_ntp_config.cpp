@@ -122,6 +122,12 @@ enable_console_logging = true
       assert(config.log_level == LogLevel::WARNING);
       assert(config.enable_console_logging == true);
 
+      // A misspelled discipline mode is rejected, not mapped to none.
+      auto discipline = ConfigParserFactory::createParser(ConfigFormat::INI);
+      assert(discipline->parseString("system_clock_discipline = kernel\n", config));
+      assert(discipline->parseString("system_clock_discipline = kernal\n", config));
+      assert(config.system_clock_discipline == NtpConfig::SystemClockDiscipline::KERNEL);
+
       return true;
     } catch (...) {
       return false;
@@ -233,6 +239,106 @@ enable_console_logging: true
       config.authentication_key = "secret";
       errors.clear();
       assert(config.validateDetailed(errors));
+
+      // Poll bounds must be ordered and within 0-17
+      config.min_poll = 11;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.min_poll = 6;
+      config.max_poll = 18;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.max_poll = 10;
+
+      config.leap_smear_interval = -1;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.leap_smear_interval = 86400;
+      errors.clear();
+      assert(config.validateDetailed(errors));
+
+      config.reference_clock_refid = "TOOLONG";
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.reference_clock_refid = "GPS";
+
+      config.enable_broadcast = true;
+      config.broadcast_ttl = 0;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.broadcast_ttl = 1;
+      config.broadcast_key_id = 3;
+      errors.clear();
+      assert(!config.validateDetailed(errors)); // No such key
+      config.broadcast_key_id = 0;
+      config.enable_broadcast = false;
+
+      config.enable_roughtime = true;
+      config.roughtime_port = config.listen_port;
+      errors.clear();
+      assert(!config.validateDetailed(errors)); // Shares the NTP port
+      config.roughtime_port = 2002;
+      config.roughtime_batch_size = 0;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.roughtime_batch_size = 64;
+      config.roughtime_key_lifetime = std::chrono::seconds(10);
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.roughtime_key_lifetime = std::chrono::seconds(86400);
+      config.enable_roughtime = false;
+
+      config.enable_metrics_http = true;
+      errors.clear();
+      assert(config.validateDetailed(errors));
+      config.metrics_http_address = "localhost";
+      errors.clear();
+      assert(!config.validateDetailed(errors)); // Not an IPv4 address
+      config.metrics_http_address = "127.0.0.1";
+      config.metrics_http_cache_interval = std::chrono::milliseconds(-1);
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.metrics_http_cache_interval = std::chrono::milliseconds(1000);
+      config.enable_metrics_http = false;
+
+      config.enable_control_socket = true;
+      errors.clear();
+      assert(config.validateDetailed(errors));
+      config.control_socket_path = "/run/" + std::string(120, 'x');
+      errors.clear();
+      assert(!config.validateDetailed(errors)); // Does not fit sun_path
+      config.control_socket_path = "/run/simple-ntpd/control.sock";
+      config.enable_control_socket = false;
+
+      config.enable_stats_segment = true;
+      config.stats_segment_interval = std::chrono::milliseconds(5);
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.stats_segment_interval = std::chrono::milliseconds(1000);
+      errors.clear();
+      assert(config.validateDetailed(errors));
+      config.enable_stats_segment = false;
+
+      config.enable_packet_capture = true;
+      config.capture_client_prefix = "10.0.0.0/40";
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.capture_client_prefix = "10.0.0.0/8";
+      config.capture_sample_every = 0;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.capture_sample_every = 100;
+      errors.clear();
+      assert(config.validateDetailed(errors));
+      config.enable_packet_capture = false;
+
+      config.clock_history_hours = 169;
+      errors.clear();
+      assert(!config.validateDetailed(errors));
+      config.clock_history_hours = 0;
+      errors.clear();
+      assert(config.validateDetailed(errors));
+      config.clock_history_hours = 24;
       return true;
     } catch (...) {
       return false;
@@ -253,6 +359,17 @@ enable_console_logging: true
       assert(config.worker_threads == 6);
       assert(config.reference_id == "TEST");
 
+      setenv("SIMPLE_NTPD_SYSTEM_CLOCK_DISCIPLINE", "dry_run", 1);
+      NtpConfig dry_run;
+      assert(dry_run.loadFromCommandLine(0, nullptr));
+      assert(dry_run.system_clock_discipline == NtpConfig::SystemClockDiscipline::DRY_RUN);
+      assert(dry_run.toString().find("System Clock Discipline: dry_run") != std::string::npos);
+      setenv("SIMPLE_NTPD_SYSTEM_CLOCK_DISCIPLINE", "7", 1);
+      NtpConfig invalid;
+      assert(invalid.loadFromCommandLine(0, nullptr));
+      assert(invalid.system_clock_discipline == NtpConfig::SystemClockDiscipline::NONE);
+      unsetenv("SIMPLE_NTPD_SYSTEM_CLOCK_DISCIPLINE");
+
       unsetenv("SIMPLE_NTPD_LISTEN_PORT");
       unsetenv("SIMPLE_NTPD_LOG_JSON");
       unsetenv("SIMPLE_NTPD_WORKER_THREADS");
@@ -285,6 +402,56 @@ enable_console_logging: true
       assert(config.parseCommandLineArg("enable_dynamic_stratum_adjustment", "true"));
       assert(config.parseCommandLineArg("enable_reference_clock_support", "true"));
       assert(config.parseCommandLineArg("reference_clock_source", "gps"));
+      config.upstream_servers.clear();
+      assert(!config.hasSyncSources()); // Refid-only source
+      assert(config.parseCommandLineArg("peers", "10.0.0.2, 10.0.0.3:1123"));
+      assert(config.peers.size() == 2 && config.peers[1] == "10.0.0.3:1123");
+      assert(config.hasSyncSources());
+      config.peers.clear();
+      assert(config.parseCommandLineArg("reference_clock_shm_unit", "2"));
+      assert(config.parseCommandLineArg("reference_clock_refid", "PPS"));
+      assert(config.system_clock_discipline == NtpConfig::SystemClockDiscipline::NONE);
+      assert(config.parseCommandLineArg("system_clock_discipline", "dry-run"));
+      assert(!config.parseCommandLineArg("system_clock_discipline", "bogus"));
+      assert(config.min_poll == 6 && config.max_poll == 10);
+      assert(config.parseCommandLineArg("min_poll", "4"));
+      assert(config.parseCommandLineArg("maxpoll", "8"));
+      assert(config.leap_smear_interval == 0);
+      assert(config.parseCommandLineArg("leap_smear_interval", "86400"));
+      assert(!config.parseCommandLineArg("leap_smear_interval", "noon"));
+      assert(config.parseCommandLineArg("enable_broadcast", "true"));
+      assert(config.parseCommandLineArg("broadcast_address", "192.168.1.255"));
+      assert(config.parseCommandLineArg("broadcast_interval", "16"));
+      assert(config.parseCommandLineArg("broadcast_ttl", "4"));
+      assert(config.parseCommandLineArg("broadcast_key_id", "7"));
+      assert(!config.parseCommandLineArg("broadcast_key_id", "seven"));
+      assert(config.parseCommandLineArg("enable_roughtime", "yes"));
+      assert(config.parseCommandLineArg("roughtime_port", "2003"));
+      assert(config.parseCommandLineArg("roughtime_key_file", "/etc/simple-ntpd/roughtime.key"));
+      assert(config.parseCommandLineArg("roughtime_batch_size", "128"));
+      assert(config.parseCommandLineArg("roughtime_batch_window", "10"));
+      assert(config.parseCommandLineArg("roughtime_key_lifetime", "3600"));
+      assert(!config.parseCommandLineArg("roughtime_batch_size", "many"));
+      assert(config.parseCommandLineArg("enable_metrics_http", "true"));
+      assert(config.parseCommandLineArg("metrics_http_address", "0.0.0.0"));
+      assert(config.parseCommandLineArg("metrics_http_port", "9100"));
+      assert(config.parseCommandLineArg("metrics_http_cache_interval", "250"));
+      assert(!config.parseCommandLineArg("metrics_http_port", "http"));
+      assert(config.parseCommandLineArg("enable_control_socket", "yes"));
+      assert(config.parseCommandLineArg("control_socket_path", "/tmp/ntpd.sock"));
+      assert(config.parseCommandLineArg("enable_stats_segment", "1"));
+      assert(config.parseCommandLineArg("stats_segment_path", "/dev/shm/simple-ntpd"));
+      assert(config.parseCommandLineArg("stats_segment_interval", "500"));
+      assert(!config.parseCommandLineArg("stats_segment_interval", "often"));
+      assert(config.parseCommandLineArg("enable_stage_accounting", "true"));
+      assert(config.parseCommandLineArg("enable_packet_capture", "yes"));
+      assert(config.parseCommandLineArg("capture_ring_size", "1024"));
+      assert(config.parseCommandLineArg("capture_sample_every", "10"));
+      assert(config.parseCommandLineArg("capture_drops_only", "true"));
+      assert(config.parseCommandLineArg("capture_client_prefix", "192.0.2.0/24"));
+      assert(!config.parseCommandLineArg("capture_ring_size", "big"));
+      assert(config.parseCommandLineArg("clock_history_hours", "48"));
+      assert(!config.parseCommandLineArg("clock_history_hours", "forever"));
 
       assert(config.enable_acl);
       assert(config.enable_rate_limiting);
@@ -305,6 +472,31 @@ enable_console_logging: true
       assert(config.enable_dynamic_stratum_adjustment);
       assert(config.enable_reference_clock_support);
       assert(config.reference_clock_source == "gps");
+      assert(config.reference_clock_shm_unit == 2 && config.reference_clock_refid == "PPS");
+      assert(config.parseCommandLineArg("reference_clock_source", "SHM"));
+      assert(config.hasSyncSources());
+      assert(config.system_clock_discipline == NtpConfig::SystemClockDiscipline::DRY_RUN);
+      assert(config.min_poll == 4 && config.max_poll == 8);
+      assert(config.leap_smear_interval == 86400);
+      assert(config.enable_broadcast && config.broadcast_address == "192.168.1.255");
+      assert(config.broadcast_interval.count() == 16 && config.broadcast_ttl == 4);
+      assert(config.broadcast_key_id == 7);
+      assert(config.enable_roughtime && config.roughtime_port == 2003);
+      assert(config.roughtime_key_file == "/etc/simple-ntpd/roughtime.key");
+      assert(config.roughtime_batch_size == 128);
+      assert(config.roughtime_batch_window.count() == 10);
+      assert(config.roughtime_key_lifetime.count() == 3600);
+      assert(config.enable_metrics_http && config.metrics_http_address == "0.0.0.0");
+      assert(config.metrics_http_port == 9100);
+      assert(config.metrics_http_cache_interval.count() == 250);
+      assert(config.enable_control_socket && config.control_socket_path == "/tmp/ntpd.sock");
+      assert(config.enable_stats_segment && config.stats_segment_path == "/dev/shm/simple-ntpd");
+      assert(config.stats_segment_interval.count() == 500);
+      assert(config.enable_stage_accounting);
+      assert(config.enable_packet_capture && config.capture_ring_size == 1024);
+      assert(config.capture_sample_every == 10 && config.capture_drops_only);
+      assert(config.capture_client_prefix == "192.0.2.0/24");
+      assert(config.clock_history_hours == 48);
       return true;
     } catch (...) {
       return false;
@@ -0,0 +1,115 @@
+/**
+ * @file test_ntp_histogram.cpp
+ * @brief Unit tests for the log-linear latency histogram
+ */
+
+#include "simple-ntpd/utils/histogram.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+using namespace simple_ntpd;
+
+namespace {
+
+void testBucketLayout() {
+  // Small values are exact; after that, buckets tile the range without gaps
+  // and each is at most 1/16 of its lower bound wide.
+  for (uint64_t v = 0; v < 32; ++v) {
+    const size_t index = LatencyHistogram::bucketIndex(v);
+    assert(LatencyHistogram::bucketUpperBound(index) == v + 1);
+  }
+  uint64_t lower = 0;
+  for (size_t index = 0; index < LatencyHistogram::kBucketCount; ++index) {
+    const uint64_t upper = LatencyHistogram::bucketUpperBound(index);
+    assert(upper > lower);
+    assert(LatencyHistogram::bucketIndex(lower) == index);
+    assert(LatencyHistogram::bucketIndex(upper - 1) == index);
+    assert(lower < 16 || (upper - lower) * 16 <= lower);
+    lower = upper;
+  }
+  assert(lower == uint64_t{1} << LatencyHistogram::kMaxExponent);
+  assert(LatencyHistogram::bucketIndex(UINT64_MAX) == LatencyHistogram::kBucketCount - 1);
+}
+
+void testQuantilesAndMerge() {
+  LatencyHistogram a;
+  LatencyHistogram b;
+  assert(a.snapshot().valueAtQuantile(0.5) == 0);
+  // 1..1000 us, split over two writers.
+  for (uint64_t us = 1; us <= 1000; ++us) {
+    (us % 2 == 0 ? a : b).record(us * 1000);
+  }
+  LatencyHistogram::Snapshot merged = a.snapshot();
+  merged.merge(b.snapshot());
+  assert(merged.count == 1000);
+  assert(merged.sum_ns == 500500ULL * 1000);
+
+  // Reported values are the top of the bucket: never below the true
+  // quantile, at most 1/16 above it.
+  const auto check = [&](double quantile, uint64_t exact_ns) {
+    const uint64_t reported = merged.valueAtQuantile(quantile);
+    assert(reported >= exact_ns);
+    assert(reported - exact_ns <= exact_ns / 16);
+  };
+  check(0.5, 500000);
+  check(0.99, 990000);
+  check(0.999, 999000);
+  check(1.0, 1000000);
+
+  // Powers of two split buckets exactly.
+  assert(merged.countBelow(uint64_t{1} << 19) == 524); // Below 524.288 us
+  assert(merged.countBelow(uint64_t{1} << 20) == 1000);
+}
+
+void testConcurrentSnapshots() {
+  LatencyHistogram histogram;
+  std::atomic<bool> done{false};
+  std::thread reader([&] {
+    uint64_t last = 0;
+    while (!done.load(std::memory_order_relaxed)) {
+      const uint64_t count = histogram.snapshot().count;
+      assert(count >= last); // Counts only grow
+      last = count;
+    }
+  });
+  constexpr uint64_t kRecords = 500000;
+  for (uint64_t i = 0; i < kRecords; ++i) {
+    histogram.record((i * 7919) % 5000000);
+  }
+  done = true;
+  reader.join();
+  assert(histogram.snapshot().count == kRecords);
+}
+
+void testRecordCost() {
+  LatencyHistogram histogram;
+  constexpr uint64_t kRecords = 2000000;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < kRecords; ++i) {
+    histogram.record((i * 7919) % 5000000);
+  }
+  const double ns_per_record =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+      static_cast<double>(kRecords);
+  assert(histogram.snapshot().count == kRecords);
+  // Reported only: a wall-clock limit would fail on loaded or Debug runs.
+  std::cout << "LatencyHistogram::record: " << ns_per_record << " ns" << std::endl;
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Running Latency Histogram Tests..." << std::endl;
+
+  testBucketLayout();
+  testQuantilesAndMerge();
+  testConcurrentSnapshots();
+  testRecordCost();
+
+  std::cout << "Latency histogram tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file test_ntp_leap_seconds.cpp
+ * @brief Unit tests for the leap second table, announcement and smear
+ */
+
+#include "simple-ntpd/core/leap_seconds.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+using namespace simple_ntpd;
+
+namespace {
+
+// Tail of the IERS leap-seconds.list
+const char *kLeapList = "#\tUpdated through IERS Bulletin C\n"
+                        "#$\t 3676924800\n"
+                        "#@\t 3960057600\n"
+                        "#\n"
+                        "3550089600\t35\t# 1 Jul 2012\n"
+                        "3644697600\t36\t# 1 Jul 2015\n"
+                        "3692217600\t37\t# 1 Jan 2017\n"
+                        "#h\t16edd0f0 3666784f 37db6bdd e74ced87 59af48f1\n";
+
+constexpr int64_t kLeap2017 = 1483228800; // 2017-01-01T00:00:00Z
+
+bool near(double a, double b) { return std::fabs(a - b) < 1e-9; }
+
+void testParse() {
+  LeapSecondTable table;
+  std::string error;
+  std::istringstream in(kLeapList);
+  assert(table.parse(in, error));
+  assert(table.entries().size() == 3);
+  assert(table.entries().front().time == 1341100800); // 2012-07-01
+  assert(table.updated() == 3676924800LL - 2208988800LL);
+  assert(table.expires() == 1751068800); // 2025-06-28
+  assert(!table.expiredAt(table.expires() - 1) && table.expiredAt(table.expires()));
+  assert(table.taiOffsetAt(0) == 0);
+  assert(table.taiOffsetAt(kLeap2017 - 1) == 36);
+  assert(table.taiOffsetAt(kLeap2017) == 37);
+
+  // A bad file leaves the loaded table alone.
+  const char *bad[] = {"2272060800 10\n2272060800 11\n", "2272060800 10\n2287785600 12\n",
+                       "2272060800 ten\n", "# comments only\n"};
+  for (const char *text : bad) {
+    std::istringstream bad_in(text);
+    assert(!table.parse(bad_in, error) && !error.empty());
+    assert(table.entries().size() == 3);
+  }
+  assert(!table.loadFromFile("/nonexistent/leap-seconds.list", error));
+}
+
+void testAnnouncement() {
+  LeapSecondTable table;
+  std::string error;
+  std::istringstream in(kLeapList);
+  assert(table.parse(in, error));
+
+  LeapSchedule schedule = table.scheduleAt(kLeap2017 - 30 * 86400, 0);
+  assert(schedule.has_table && !schedule.smearing);
+  assert(schedule.step == 1 && schedule.leap_time == kLeap2017);
+  assert(schedule.valid_until == kLeap2017);
+  // RFC 5905: warn during the last day only
+  assert(schedule.leapIndicatorAt(kLeap2017 - 86401) == 0);
+  assert(schedule.leapIndicatorAt(kLeap2017 - 86400) == 1);
+  assert(schedule.leapIndicatorAt(kLeap2017 - 1) == 1);
+  assert(schedule.leapIndicatorAt(kLeap2017) == 0);
+  assert(schedule.smearAt(static_cast<double>(kLeap2017) - 1.0) == 0.0);
+
+  // Past the last leap there is nothing to announce, ever.
+  schedule = table.scheduleAt(kLeap2017, 0);
+  assert(schedule.has_table && schedule.step == 0);
+  assert(schedule.leapIndicatorAt(kLeap2017 + 1) == 0);
+  assert(schedule.valid_until == INT64_MAX);
+
+  // A negative leap second deletes 23:59:59.
+  LeapSecondTable negative;
+  std::istringstream neg_in("2272060800 10\n3692217600 9\n");
+  assert(negative.parse(neg_in, error));
+  schedule = negative.scheduleAt(kLeap2017 - 3600, 0);
+  assert(schedule.step == -1 && schedule.leapIndicatorAt(kLeap2017 - 1) == 2);
+
+  assert(LeapSecondTable().scheduleAt(kLeap2017, 0).has_table == false);
+}
+
+void testSmear() {
+  LeapSecondTable table;
+  std::string error;
+  std::istringstream in(kLeapList);
+  assert(table.parse(in, error));
+
+  const double leap = static_cast<double>(kLeap2017);
+  const LeapSchedule schedule = table.scheduleAt(kLeap2017 - 86400, 86400);
+  assert(schedule.smearing && schedule.step == 1);
+  assert(schedule.valid_until == kLeap2017 + 43200);
+  // Smeared time never carries LI.
+  assert(schedule.leapIndicatorAt(kLeap2017 - 1) == 0);
+
+  // Noon to noon: lag grows to half a second at the leap. After it, POSIX
+  // time has stepped back one second, so the correction is ahead by the
+  // remainder and falls back to zero.
+  assert(schedule.smearAt(leap - 43201.0) == 0.0);
+  assert(near(schedule.smearAt(leap - 43200.0), 0.0));
+  assert(near(schedule.smearAt(leap - 21600.0), -0.25));
+  assert(near(schedule.smearAt(leap), 0.5));
+  assert(near(schedule.smearAt(leap + 21600.0), 0.25));
+  assert(schedule.smearAt(leap + 43200.0) == 0.0);
+
+  // POSIX L-1 to L spans two SI seconds (23:59:59 and 23:59:60); smeared
+  // time covers them at the smear rate, without a jump.
+  const double before = (leap - 1.0) + schedule.smearAt(leap - 1.0);
+  const double after = leap + schedule.smearAt(leap);
+  assert(std::fabs((after - before) - (2.0 - 1.0 / 86400.0)) < 1e-6);
+
+  // The schedule remains in force until the smear window closes.
+  const LeapSchedule late = table.scheduleAt(kLeap2017 + 100, 86400);
+  assert(late.leap_time == kLeap2017 && near(late.smearAt(leap + 100.0),
+                                              schedule.smearAt(leap + 100.0)));
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Leap Second Tests..." << std::endl;
+
+  testParse();
+  testAnnouncement();
+  testSmear();
+
+  std::cout << "Leap second tests passed." << std::endl;
+  return 0;
+}
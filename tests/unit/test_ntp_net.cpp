@@ -19,6 +19,18 @@ int main() {
   assert(!isIpInCidr("127.0.0.2", "127.0.0.1"));
   assert(isIpInCidr("0.0.0.0", "0.0.0.0/0"));
 
+  uint32_t network = 0;
+  uint32_t mask = 0;
+  assert(parseIpv4Cidr("192.168.1.77/24", network, mask));
+  assert(network == 0xC0A80100u && mask == 0xFFFFFF00u);
+  assert(parseIpv4Cidr("10.0.0.1", network, mask));
+  assert(network == 0x0A000001u && mask == 0xFFFFFFFFu);
+  assert(parseIpv4Cidr("0.0.0.0/0", network, mask) && mask == 0);
+  assert(!parseIpv4Cidr("10.0.0.0/33", network, mask));
+  assert(!parseIpv4Cidr("10.0.0.0/", network, mask));
+  assert(!parseIpv4Cidr("10.0.0.0/x", network, mask));
+  assert(!parseIpv4Cidr("example.com/8", network, mask));
+
   std::cout << "Network utility tests passed." << std::endl;
   return 0;
 }
@@ -8,6 +8,8 @@
 
 #include "simple-ntpd/core/packet.hpp"
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 
@@ -42,6 +44,9 @@ public:
     total++; if (testTimeCalculationsMicroseconds()) { passed++; std::cout << "✓ testTimeCalculationsMicroseconds passed" << std::endl; }
     else { std::cout << "✗ testTimeCalculationsMicroseconds failed" << std::endl; }
 
+    total++; if (testShortFormatAndPrecision()) { passed++; std::cout << "✓ testShortFormatAndPrecision passed" << std::endl; }
+    else { std::cout << "✗ testShortFormatAndPrecision failed" << std::endl; }
+
     std::cout << "\nTest Results: " << passed << "/" << total << " tests passed" << std::endl;
     return (passed == total) ? 0 : 1;
   }
@@ -188,6 +193,29 @@ private:
       return false;
     }
   }
+
+  static bool testShortFormatAndPrecision() {
+    try {
+      // 16.16 fixed point: 1 s is 0x00010000, 1 ms rounds down to 65 units
+      assert(microsecondsToShortFormat(1000000) == 0x00010000u);
+      assert(microsecondsToShortFormat(1000) == 65u);
+      assert(microsecondsToShortFormat(-5) == 0u);
+      assert(microsecondsToShortFormat(INT64_C(1) << 40) == UINT32_MAX);
+      assert(shortFormatToMicroseconds(0x00018000u) == 1500000);
+      assert(std::abs(shortFormatToMicroseconds(microsecondsToShortFormat(25000)) - 25000) <= 16);
+
+      // Any real clock is finer than the old hard-coded 2^-6 s
+      const int8_t precision = systemClockPrecision();
+      assert(precision < -6 && precision >= -30);
+      assert(precision == systemClockPrecision());
+      auto response = NtpPacket::createServerResponse(
+          NtpPacket::createClientRequest(), NtpStratum::SECONDARY_REFERENCE, "LOCL");
+      assert(response.precision == precision);
+      return true;
+    } catch (...) {
+      return false;
+    }
+  }
 };
 
 int main() {
@@ -0,0 +1,85 @@
+/**
+ * @file test_ntp_resolver.cpp
+ * @brief Unit tests for the asynchronous DNS resolver cache
+ */
+
+#include "simple-ntpd/utils/resolver.hpp"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+
+using namespace simple_ntpd;
+
+namespace {
+
+void testNumericHostsResolveInline() {
+  AsyncResolver resolver;
+  std::vector<ResolvedAddress> out;
+  assert(resolver.lookup("127.0.0.1", "9123", out));
+  assert(out.size() == 1);
+  assert(out.front().text == "127.0.0.1:9123");
+  assert(resolver.lookup("::1", "123", out));
+  assert(out.front().text == "[::1]:123");
+  // Literals never reach the background worker.
+  assert(resolver.resolutionCount() == 0);
+}
+
+void testNamesResolveInBackgroundAndCache() {
+  AsyncResolver resolver;
+  std::vector<ResolvedAddress> out;
+  // First lookup only schedules the query.
+  resolver.lookup("localhost", "123", out);
+  resolver.waitFor({{"localhost", "123"}}, std::chrono::milliseconds(2000));
+  assert(resolver.lookup("localhost", "123", out));
+  assert(!out.empty());
+  const uint64_t resolved = resolver.resolutionCount();
+  assert(resolved == 1);
+
+  // Cached: repeated lookups cost no further resolutions.
+  for (int i = 0; i < 10; ++i) {
+    assert(resolver.lookup("localhost", "123", out));
+  }
+  assert(resolver.resolutionCount() == resolved);
+
+  // An explicit refresh re-resolves while the old answer stays usable.
+  resolver.refresh("localhost", "123");
+  assert(resolver.lookup("localhost", "123", out));
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (resolver.resolutionCount() == resolved &&
+         std::chrono::steady_clock::now() < deadline) {
+    resolver.waitFor({{"localhost", "123"}}, std::chrono::milliseconds(10));
+  }
+  assert(resolver.resolutionCount() == resolved + 1);
+}
+
+void testFailedLookupIsAnswered() {
+  AsyncResolver resolver;
+  std::vector<ResolvedAddress> out;
+  assert(!resolver.lookup("no-such-host.invalid", "123", out));
+  const auto start = std::chrono::steady_clock::now();
+  resolver.waitFor({{"no-such-host.invalid", "123"}}, std::chrono::milliseconds(5000));
+  assert(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(5000));
+  assert(!resolver.lookup("no-such-host.invalid", "123", out));
+  assert(out.empty());
+}
+
+void testDuplicatesRemoved() {
+  std::vector<ResolvedAddress> out;
+  assert(resolveAddresses("127.0.0.1", "123", out, true));
+  assert(out.size() == 1);
+  assert(!resolveAddresses("localhost", "123", out, true));
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Running NTP Resolver Tests..." << std::endl;
+
+  testNumericHostsResolveInline();
+  testNamesResolveInBackgroundAndCache();
+  testFailedLookupIsAnswered();
+  testDuplicatesRemoved();
+
+  std::cout << "Resolver tests passed." << std::endl;
+  return 0;
+}